@@ -0,0 +1,22 @@
+package=zlib
+$(package)_version=1.2.11
+$(package)_download_path=https://zlib.net/fossils
+$(package)_file_name=$(package)-$($(package)_version).tar.gz
+$(package)_sha256_hash=c3e5e9fdd5004dcb542feda5ee4f0ff0744628baf8ed2dd5d66f8ca1197cb1a1
+
+define $(package)_set_vars
+$(package)_config_opts=--static
+$(package)_config_opts+=--prefix=$(host_prefix)
+endef
+
+define $(package)_config_cmds
+  env CHOST=$(host) CC="$($(package)_cc)" CFLAGS="$($(package)_cflags) $($(package)_cppflags) -fPIC" AR="$($(package)_ar)" RANLIB="$($(package)_ranlib)" ./configure $($(package)_config_opts)
+endef
+
+define $(package)_build_cmds
+  $(MAKE) libz.a
+endef
+
+define $(package)_stage_cmds
+  $(MAKE) DESTDIR=$($(package)_staging_dir) install
+endef
@@ -141,5 +141,8 @@ namespace epee
         \return Slice starting at `data() + begin` of size `end - begin`. */
     byte_slice get_slice(std::size_t begin, std::size_t end) const;
   };
+
+  //! \return Total number of bytes in the slices of `chain`.
+  std::size_t get_total_size(const std::vector<byte_slice>& chain) noexcept;
 } // epee
 
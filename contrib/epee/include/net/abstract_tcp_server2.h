@@ -137,6 +137,8 @@ namespace net_utils
   private:
     //----------------- i_service_endpoint ---------------------
     virtual bool do_send(byte_slice message); ///< (see do_send from i_service_endpoint)
+    virtual bool do_send(std::vector<byte_slice> message); ///< scatter-gather variant, the slices are never joined
+    virtual bool do_send(std::vector<byte_slice> message, send_priority priority); ///< high priority messages overtake queued normal ones
     virtual bool send_done();
     virtual bool close();
     virtual bool call_run_once_service_io();
@@ -145,7 +147,8 @@ namespace net_utils
     virtual bool add_ref();
     virtual bool release();
     //------------------------------------------------------
-    bool do_send_chunk(byte_slice chunk); ///< will send (or queue) a part of data. internal use only
+    bool do_send_chunks(std::vector<std::vector<byte_slice>> chunks, send_priority priority); ///< will send (or queue) all the parts of a message at once. internal use only
+    static std::vector<boost::asio::const_buffer> get_buffers(const std::vector<byte_slice>& chunk);
 
     boost::shared_ptr<connection<t_protocol_handler> > safe_shared_from_this();
     bool shutdown();
@@ -181,7 +184,6 @@ namespace net_utils
     size_t m_reference_count = 0; // reference count managed through add_ref/release support
     boost::shared_ptr<connection<t_protocol_handler> > m_self_ref; // the reference to hold
     critical_section m_self_refs_lock;
-    critical_section m_chunking_lock; // held while we add small chunks of the big do_send() to small do_send_chunk()
     critical_section m_shutdown_lock; // held while shutting down
     
     t_connection_type m_connection_type;
@@ -255,6 +257,12 @@ namespace net_utils
 
     size_t get_threads_count(){return m_threads_count;}
 
+    /// Give each worker thread its own io_service and SO_REUSEPORT listening
+    /// socket, so connections stay on the thread that accepted or made them
+    /// instead of all threads contending on one reactor. Must be set before
+    /// init_server. \return false if the platform cannot share a port.
+    bool set_io_service_per_thread(bool enable);
+
     void set_connection_filter(i_connection_filter* pfilter);
 
     void set_default_remote(epee::net_utils::network_address remote)
@@ -286,7 +294,8 @@ namespace net_utils
     long get_connections_count() const
     {
       assert(m_state != nullptr); // always set in constructor
-      auto connections_count = m_state->sock_count > 0 ? (m_state->sock_count - 1) : 0; // Socket count minus listening socket
+      const long listening = m_shards_count; // one pending accept per shard
+      auto connections_count = m_state->sock_count > listening ? (m_state->sock_count - listening) : 0; // Socket count minus listening sockets
       return connections_count;
     }
 
@@ -351,10 +360,18 @@ namespace net_utils
   private:
     /// Run the server's io_service loop.
     bool worker_thread();
+    /// Listen on `endpoint` from the given shard and start accepting.
+    void start_accept(size_t shard, bool ipv6, const boost::asio::ip::tcp::endpoint& endpoint);
     /// Handle completion of an asynchronous accept operation.
-    void handle_accept_ipv4(const boost::system::error_code& e);
-    void handle_accept_ipv6(const boost::system::error_code& e);
-    void handle_accept(const boost::system::error_code& e, bool ipv6 = false);
+    void handle_accept(const boost::system::error_code& e, bool ipv6, size_t shard);
+    /// \return The io_service new outgoing connections are placed on
+    boost::asio::io_service& get_next_io_service();
+    boost::asio::io_service& get_shard_io_service(size_t shard);
+    static boost::asio::io_service*& get_current_io_service()
+    {
+      static thread_local boost::asio::io_service* io_service = nullptr;
+      return io_service;
+    }
 
     bool is_thread_worker();
 
@@ -373,6 +390,25 @@ namespace net_utils
     std::unique_ptr<worker> m_io_service_local_instance;
     boost::asio::io_service& io_service_;    
 
+    /// An additional io_service in io_service per thread mode, with its own
+    /// listening sockets. Shard 0 is io_service_ with the members below.
+    struct shard
+    {
+      shard()
+        : acceptor(work.io_service), acceptor_ipv6(work.io_service)
+      {}
+
+      worker work;
+      boost::asio::ip::tcp::acceptor acceptor;
+      boost::asio::ip::tcp::acceptor acceptor_ipv6;
+      connection_ptr new_connection;
+      connection_ptr new_connection_ipv6;
+    };
+    bool m_io_service_per_thread;
+    std::vector<std::unique_ptr<shard>> m_shards; // reserved up front, never reallocated
+    std::atomic<size_t> m_shards_count;
+    std::atomic<size_t> m_next_shard;
+
     /// Acceptor used to listen for incoming connections.
     boost::asio::ip::tcp::acceptor acceptor_;
     boost::asio::ip::tcp::acceptor acceptor_ipv6;
@@ -346,30 +346,19 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         context.m_current_speed_down = current_speed_down;
         context.m_max_speed_down = std::max(context.m_max_speed_down, current_speed_down);
     
-    {
-			CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_in );
-			epee::net_utils::network_throttle_manager::network_throttle_manager::get_global_throttle_in().handle_trafic_exact(bytes_transferred);
-		}
-
-		double delay=0; // will be calculated - how much we should sleep to obey speed limit etc
-
-
+		epee::net_utils::token_bucket &bucket_in = epee::net_utils::network_throttle_manager::get_global_bucket_in();
 		if (speed_limit_is_enabled()) {
-			do // keep sleeping if we should sleep
-			{
-				{ //_scope_dbg1("CRITICAL_REGION_LOCAL");
-					CRITICAL_REGION_LOCAL(	epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in );
-					delay = epee::net_utils::network_throttle_manager::get_global_throttle_in().get_sleep_time_after_tick( bytes_transferred );
-				}
-				
-				delay *= 0.5;
-				if (delay > 0) {
-					long int ms = (long int)(delay * 100);
-					reset_timer(boost::posix_time::milliseconds(ms + 1), true);
-					boost::this_thread::sleep_for(boost::chrono::milliseconds(ms));
-				}
-			} while(delay > 0);
-		} // any form of sleeping
+			// charged as read, then we wait off any debt before reading more
+			const double delay = bucket_in.consume(bytes_transferred);
+			if (delay > 0) {
+				long int ms = (long int)(delay * 1000);
+				reset_timer(boost::posix_time::milliseconds(ms + 1), true);
+				boost::this_thread::sleep_for(boost::chrono::milliseconds(ms));
+				context.m_metrics->throttle_time.add(uint64_t(delay * 1e6));
+			}
+		}
+		else
+			bucket_in.count(bytes_transferred);
 		
       //_info("[sock " << socket().native_handle() << "] RECV " << bytes_transferred);
       logger_handle_net_read(bytes_transferred);
@@ -528,16 +517,26 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   //---------------------------------------------------------------------------------
     template<class t_protocol_handler>
   bool connection<t_protocol_handler>::do_send(byte_slice message) {
+    std::vector<byte_slice> chain;
+    chain.push_back(std::move(message));
+    return do_send(std::move(chain));
+  }
+  //---------------------------------------------------------------------------------
+    template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send(std::vector<byte_slice> message) {
+    return do_send(std::move(message), send_priority::normal);
+  }
+  //---------------------------------------------------------------------------------
+    template<class t_protocol_handler>
+  bool connection<t_protocol_handler>::do_send(std::vector<byte_slice> message, send_priority priority) {
     TRY_ENTRY();
 
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
     auto self = safe_shared_from_this();
     if (!self) return false;
     if (m_was_shutdown) return false;
-		// TODO avoid copy
 
-		std::uint8_t const* const message_data = message.data();
-		const std::size_t message_size = message.size();
+		const std::size_t message_size = get_total_size(message);
 
 		const double factor = 32; // TODO config
 		typedef long long signed int t_safe; // my t_size to avoid any overunderflow in arithmetic
@@ -548,55 +547,59 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         CHECK_AND_ASSERT_MES(! (chunksize_max<0), false, "Negative chunksize_max" ); // make sure it is unsigned before removin sign with cast:
         long long unsigned int chunksize_max_unsigned = static_cast<long long unsigned int>( chunksize_max ) ;
 
+		// all the chunks are queued together, so a high priority message can never land between two of them
+		std::vector<std::vector<byte_slice>> chunks;
         if (allow_split && (message_size > chunksize_max_unsigned)) {
-			{ // LOCK: chunking
-    		epee::critical_region_t<decltype(m_chunking_lock)> send_guard(m_chunking_lock); // *** critical *** 
-
-				MDEBUG("do_send() will SPLIT into small chunks, from packet="<<message_size<<" B for ptr="<<message_data);
-				// 01234567890 
-				// ^^^^        (pos=0, len=4)     ;   pos:=pos+len, pos=4
-				//     ^^^^    (pos=4, len=4)     ;   pos:=pos+len, pos=8
-				//         ^^^ (pos=8, len=4)    ;   
-
-				// const size_t bufsize = chunksize_good; // TODO safecast
-				// char* buf = new char[ bufsize ];
-
-				bool all_ok = true;
-				while (!message.empty()) {
-					byte_slice chunk = message.take_slice(chunksize_good);
-
-					MDEBUG("chunk_start="<<(void*)chunk.data()<<" ptr="<<message_data<<" pos="<<(chunk.data() - message_data));
-					MDEBUG("part of " << message.size() << ": pos="<<(chunk.data() - message_data) << " len="<<chunk.size());
-
-					bool ok = do_send_chunk(std::move(chunk)); // <====== ***
-
-					all_ok = all_ok && ok;
-					if (!all_ok) {
-						MDEBUG("do_send() DONE ***FAILED*** from packet="<<message_size<<" B for ptr="<<message_data);
-						MDEBUG("do_send() SEND was aborted in middle of big package - this is mostly harmless "
-							<< " (e.g. peer closed connection) but if it causes trouble tell us at #monero-dev. " << message_size);
-						return false; // partial failure in sending
+				MDEBUG("do_send() will SPLIT into small chunks, from packet="<<message_size<<" B in "<<message.size()<<" slices");
+				chunks.reserve(message_size / chunksize_good + 1);
+
+				// chunks are cut across slice boundaries with take_slice, so no byte is copied
+				std::vector<byte_slice> chunk;
+				std::size_t chunk_size = 0;
+				for (byte_slice& part : message) {
+					while (part.size()) {
+						byte_slice piece = part.take_slice(chunksize_good - chunk_size);
+						chunk_size += piece.size();
+						chunk.push_back(std::move(piece));
+						if (chunk_size < std::size_t(chunksize_good))
+							continue;
+
+						MDEBUG("chunk of " << chunk.size() << " slices, len=" << chunk_size);
+						chunks.push_back(std::move(chunk));
+						chunk.clear();
+						chunk_size = 0;
 					}
-					// (in catch block, or uniq pointer) delete buf;
-				} // each chunk
-
-				MDEBUG("do_send() DONE SPLIT from packet="<<message_size<<" B for ptr="<<message_data);
-
-                MDEBUG("do_send() m_connection_type = " << m_connection_type);
+				} // each slice
 
-				return all_ok; // done - e.g. queued - all the chunks of current do_send call
-			} // LOCK: chunking
+				if (chunk_size)
+					chunks.push_back(std::move(chunk));
 		} // a big block (to be chunked) - all chunks
 		else { // small block
-			return do_send_chunk(std::move(message)); // just send as 1 big chunk
+			chunks.push_back(std::move(message)); // just send as 1 big chunk
 		}
 
+		if (!do_send_chunks(std::move(chunks), priority)) {
+			MDEBUG("do_send() DONE ***FAILED*** from packet="<<message_size<<" B");
+			return false;
+		}
+		return true;
+
     CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send", false);
 	} // do_send()
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  std::vector<boost::asio::const_buffer> connection<t_protocol_handler>::get_buffers(const std::vector<byte_slice>& chunk)
+  {
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.reserve(chunk.size());
+    for (const byte_slice& part : chunk)
+      buffers.emplace_back(part.data(), part.size());
+    return buffers;
+  }
 
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  bool connection<t_protocol_handler>::do_send_chunk(byte_slice chunk)
+  bool connection<t_protocol_handler>::do_send_chunks(std::vector<std::vector<byte_slice>> chunks, send_priority priority)
   {
     TRY_ENTRY();
     // Use safe_shared_from_this, because of this is public method and it can be called on the object being deleted
@@ -605,10 +608,15 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return false;
     if(m_was_shutdown)
       return false;
+    if(chunks.empty())
+      return true;
+    std::size_t message_size = 0;
+    for (const std::vector<byte_slice>& chunk : chunks)
+      message_size += get_total_size(chunk);
     double current_speed_up;
     {
 		CRITICAL_REGION_LOCAL(m_throttle_speed_out_mutex);
-		m_throttle_speed_out.handle_trafic_exact(chunk.size());
+		m_throttle_speed_out.handle_trafic_exact(message_size);
 		current_speed_up = m_throttle_speed_out.get_current_speed();
 	}
     context.m_current_speed_up = current_speed_up;
@@ -616,7 +624,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     //_info("[sock " << socket().native_handle() << "] SEND " << cb);
     context.m_last_send = time(NULL);
-    context.m_send_cnt += chunk.size();
+    context.m_send_cnt += message_size;
     //some data should be wrote to stream
     //request complete
     
@@ -625,9 +633,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     m_send_que_lock.lock(); // *** critical ***
     epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler([&](){m_send_que_lock.unlock();});
 
+    // high priority messages are rare (new blocks), and must not wait behind the bulk that fills the queue
     long int retry=0;
     const long int retry_limit = 5*4;
-    while (m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
+    while (priority == send_priority::normal && m_send_que.size() > ABSTRACT_SERVER_SEND_QUE_MAX_COUNT)
     {
         retry++;
 
@@ -647,7 +656,7 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         rng.seed(seed);
 
         long int ms = 250 + (rng() % 50);
-        MDEBUG("Sleeping because QUEUE is FULL, in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<chunk.size()); // XXX debug sleep
+        MDEBUG("Sleeping because QUEUE is FULL, in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<message_size); // XXX debug sleep
         m_send_que_lock.unlock();
         boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
         m_send_que_lock.lock();
@@ -659,34 +668,50 @@ PRAGMA_WARNING_DISABLE_VS(4355)
             return false;
         }
     }
+    if(m_was_shutdown)
+      return false;
 
-    m_send_que.push_back(std::move(chunk));
-
-    if(m_send_que.size() > 1)
+    std::vector<queued_chunk> queued;
+    queued.reserve(chunks.size());
+    for (std::vector<byte_slice>& chunk : chunks)
+      queued.push_back(queued_chunk{std::move(chunk), false});
+    queued.back().last = true;
+
+    const bool was_idle = m_send_que.empty();
+    auto where = m_send_que.end();
+    if (priority == send_priority::high && !was_idle)
+    {
+      // the message being written has to go out whole first
+      if (!m_send_que_priority_end)
+        while (m_send_que_priority_end < m_send_que.size())
+          if (m_send_que[m_send_que_priority_end++].last)
+            break;
+      where = m_send_que.begin() + m_send_que_priority_end;
+      m_send_que_priority_end += queued.size();
+      MDEBUG("do_send_chunks() high priority packet="<<message_size<<" B, skips " << (m_send_que.end() - where) << " queued chunks");
+    }
+    m_send_que.insert(where, std::make_move_iterator(queued.begin()), std::make_move_iterator(queued.end()));
+    context.m_metrics->send_queue_bytes.fetch_add(message_size, std::memory_order_relaxed);
+    context.m_metrics->send_queue_depth.add(m_send_que.size());
+
+    if(!was_idle)
     { // active operation should be in progress, nothing to do, just wait last operation callback
-        auto size_now = m_send_que.back().size();
-        MDEBUG("do_send_chunk() NOW just queues: packet="<<size_now<<" B, is added to queue-size="<<m_send_que.size());
+        MDEBUG("do_send_chunks() NOW just queues: packet="<<message_size<<" B, is added to queue-size="<<m_send_que.size());
         //do_send_handler_delayed( ptr , size_now ); // (((H))) // empty function
       
-      LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async send requested " << m_send_que.front().size());
+      LOG_TRACE_CC(context, "[sock " << socket().native_handle() << "] Async send requested " << get_total_size(m_send_que.front().buffers));
     }
     else
     { // no active operation
 
-        if(m_send_que.size()!=1)
-        {
-            _erro("Looks like no active operations, but send que size != 1!!");
-            return false;
-        }
-
-        auto size_now = m_send_que.front().size();
-        MDEBUG("do_send_chunk() NOW SENSD: packet="<<size_now<<" B");
+        const std::vector<byte_slice>& front = m_send_que.front().buffers;
+        auto size_now = get_total_size(front);
+        MDEBUG("do_send_chunks() NOW SENSD: packet="<<size_now<<" B");
         if (speed_limit_is_enabled())
-			do_send_handler_write( m_send_que.back().data(), m_send_que.back().size() ); // (((H)))
+			do_send_handler_write( front.empty() ? nullptr : front.front().data(), size_now ); // (((H)))
 
-        CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), false, "Unexpected queue size");
         reset_timer(get_default_timeout(), false);
-            async_write(boost::asio::buffer(m_send_que.front().data(), size_now ) ,
+            async_write(get_buffers(front) ,
                                  strand_.wrap(
                                  boost::bind(&connection<t_protocol_handler>::handle_write, self, _1, _2)
                                  )
@@ -700,8 +725,8 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
     return true;
 
-    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_chunk", false);
-  } // do_send_chunk
+    CATCH_ENTRY_L0("connection<t_protocol_handler>::do_send_chunks", false);
+  } // do_send_chunks
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
   boost::posix_time::milliseconds connection<t_protocol_handler>::get_default_timeout()
@@ -852,7 +877,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
 
                 // The single sleeping that is needed for correctly handling "out" speed throttling
 		if (speed_limit_is_enabled()) {
-			sleep_before_packet(cb, 1, 1);
+			const double delay = sleep_before_packet(cb, 1, 1);
+			if (delay > 0)
+				context.m_metrics->throttle_time.add(uint64_t(delay * 1e6));
 		}
 
     bool do_shutdown = false;
@@ -863,7 +890,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       return;
     }
 
+    context.m_metrics->send_queue_bytes.fetch_sub(get_total_size(m_send_que.front().buffers), std::memory_order_relaxed);
     m_send_que.pop_front();
+    if (m_send_que_priority_end)
+      --m_send_que_priority_end;
     if(m_send_que.empty())
     {
       if(boost::interprocess::ipcdetail::atomic_read32(&m_want_close_connection))
@@ -874,12 +904,11 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     {
       //have more data to send
 		reset_timer(get_default_timeout(), false);
-		auto size_now = m_send_que.front().size();
+		auto size_now = get_total_size(m_send_que.front().buffers);
 		MDEBUG("handle_write() NOW SENDS: packet="<<size_now<<" B" <<", from  queue size="<<m_send_que.size());
 		if (speed_limit_is_enabled())
-			do_send_handler_write_from_queue(e, m_send_que.front().size() , m_send_que.size()); // (((H)))
-		CHECK_AND_ASSERT_MES( size_now == m_send_que.front().size(), void(), "Unexpected queue size");
-		  async_write(boost::asio::buffer(m_send_que.front().data(), size_now) , 
+			do_send_handler_write_from_queue(e, size_now , m_send_que.size()); // (((H)))
+		  async_write(get_buffers(m_send_que.front().buffers) , 
            strand_.wrap(
             boost::bind(&connection<t_protocol_handler>::handle_write, connection<t_protocol_handler>::shared_from_this(), _1, _2)
 			  )
@@ -918,6 +947,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
     m_state(std::make_shared<typename connection<t_protocol_handler>::shared_state>()),
     m_io_service_local_instance(new worker()),
     io_service_(m_io_service_local_instance->io_service),
+    m_io_service_per_thread(false),
+    m_shards_count(1),
+    m_next_shard(0),
     acceptor_(io_service_),
     acceptor_ipv6(io_service_),
     default_remote(),
@@ -936,6 +968,9 @@ PRAGMA_WARNING_DISABLE_VS(4355)
   boosted_tcp_server<t_protocol_handler>::boosted_tcp_server(boost::asio::io_service& extarnal_io_service, t_connection_type connection_type) :
     m_state(std::make_shared<typename connection<t_protocol_handler>::shared_state>()),
     io_service_(extarnal_io_service),
+    m_io_service_per_thread(false),
+    m_shards_count(1),
+    m_next_shard(0),
     acceptor_(io_service_),
     acceptor_ipv6(io_service_),
     default_remote(),
@@ -989,19 +1024,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
       boost::asio::ip::tcp::resolver resolver(io_service_);
       boost::asio::ip::tcp::resolver::query query(address, boost::lexical_cast<std::string>(port), boost::asio::ip::tcp::resolver::query::canonical_name);
       boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(query);
-      acceptor_.open(endpoint.protocol());
-#if !defined(_WIN32)
-      acceptor_.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
-#endif
-      acceptor_.bind(endpoint);
-      acceptor_.listen();
+      MDEBUG("start accept (IPv4)");
+      start_accept(0, false, endpoint);
       boost::asio::ip::tcp::endpoint binded_endpoint = acceptor_.local_endpoint();
       m_port = binded_endpoint.port();
-      MDEBUG("start accept (IPv4)");
-      new_connection_.reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, m_state->ssl_options().support));
-      acceptor_.async_accept(new_connection_->socket(),
-	boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_ipv4, this,
-	boost::asio::placeholders::error));
     }
     catch (const std::exception &e)
     {
@@ -1025,20 +1051,10 @@ PRAGMA_WARNING_DISABLE_VS(4355)
         boost::asio::ip::tcp::resolver resolver(io_service_);
         boost::asio::ip::tcp::resolver::query query(address_ipv6, boost::lexical_cast<std::string>(port_ipv6), boost::asio::ip::tcp::resolver::query::canonical_name);
         boost::asio::ip::tcp::endpoint endpoint = *resolver.resolve(query);
-        acceptor_ipv6.open(endpoint.protocol());
-#if !defined(_WIN32)
-        acceptor_ipv6.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
-#endif
-        acceptor_ipv6.set_option(boost::asio::ip::v6_only(true));
-        acceptor_ipv6.bind(endpoint);
-        acceptor_ipv6.listen();
+        MDEBUG("start accept (IPv6)");
+        start_accept(0, true, endpoint);
         boost::asio::ip::tcp::endpoint binded_endpoint = acceptor_ipv6.local_endpoint();
         m_port_ipv6 = binded_endpoint.port();
-        MDEBUG("start accept (IPv6)");
-        new_connection_ipv6.reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, m_state->ssl_options().support));
-        acceptor_ipv6.async_accept(new_connection_ipv6->socket(),
-            boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept_ipv6, this,
-              boost::asio::placeholders::error));
       }
       catch (const std::exception &e)
       {
@@ -1101,11 +1117,13 @@ POP_WARNINGS
     thread_name += boost::to_string(local_thr_index) + "]";
     MLOG_SET_THREAD_NAME(thread_name);
     //   _fact("Thread name: " << m_thread_name_prefix);
+    boost::asio::io_service& io_service = get_shard_io_service(local_thr_index % m_shards_count);
+    get_current_io_service() = &io_service;
     while(!m_stop_signal_sent)
     {
       try
       {
-        io_service_.run();
+        io_service.run();
         return true;
       }
       catch(const std::exception& ex)
@@ -1140,12 +1158,85 @@ POP_WARNINGS
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
+  bool boosted_tcp_server<t_protocol_handler>::set_io_service_per_thread(bool enable)
+  {
+#ifdef SO_REUSEPORT
+    m_io_service_per_thread = enable;
+    return true;
+#else
+    if (enable)
+      MWARNING("SO_REUSEPORT is not available, running all threads on one io_service");
+    m_io_service_per_thread = false;
+    return !enable;
+#endif
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  boost::asio::io_service& boosted_tcp_server<t_protocol_handler>::get_shard_io_service(size_t shard)
+  {
+    return shard == 0 ? io_service_ : m_shards[shard - 1]->work.io_service;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  boost::asio::io_service& boosted_tcp_server<t_protocol_handler>::get_next_io_service()
+  {
+    const size_t shards_count = m_shards_count;
+    if (shards_count == 1)
+      return io_service_;
+    // a blocking connect must not wait on the io_service its own thread runs
+    boost::asio::io_service* io_service = &get_shard_io_service(m_next_shard++ % shards_count);
+    if (io_service == get_current_io_service())
+      io_service = &get_shard_io_service(m_next_shard++ % shards_count);
+    return *io_service;
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
+  void boosted_tcp_server<t_protocol_handler>::start_accept(size_t shard, bool ipv6, const boost::asio::ip::tcp::endpoint& endpoint)
+  {
+    boost::asio::ip::tcp::acceptor& acceptor = shard == 0 ? (ipv6 ? acceptor_ipv6 : acceptor_) : (ipv6 ? m_shards[shard - 1]->acceptor_ipv6 : m_shards[shard - 1]->acceptor);
+    connection_ptr& new_connection = shard == 0 ? (ipv6 ? new_connection_ipv6 : new_connection_) : (ipv6 ? m_shards[shard - 1]->new_connection_ipv6 : m_shards[shard - 1]->new_connection);
+
+    acceptor.open(endpoint.protocol());
+#if !defined(_WIN32)
+    acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+#endif
+#ifdef SO_REUSEPORT
+    // every shard listens on the same port, the kernel spreads incoming connections
+    if (m_io_service_per_thread)
+      acceptor.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true));
+#endif
+    if (ipv6)
+      acceptor.set_option(boost::asio::ip::v6_only(true));
+    acceptor.bind(endpoint);
+    acceptor.listen();
+    new_connection.reset(new connection<t_protocol_handler>(get_shard_io_service(shard), m_state, m_connection_type, m_state->ssl_options().support));
+    acceptor.async_accept(new_connection->socket(),
+      boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept, this,
+        boost::asio::placeholders::error, ipv6, shard));
+  }
+  //---------------------------------------------------------------------------------
+  template<class t_protocol_handler>
   bool boosted_tcp_server<t_protocol_handler>::run_server(size_t threads_count, bool wait, const boost::thread::attributes& attrs)
   {
     TRY_ENTRY();
     m_threads_count = threads_count;
     m_main_thread_id = boost::this_thread::get_id();
     MLOG_SET_THREAD_NAME("[SRV_MAIN]");
+    if (m_io_service_per_thread && m_shards.empty() && threads_count > 1)
+    {
+      // the shards listen on the port(s) shard 0 got in init_server
+      m_shards.reserve(threads_count - 1);
+      for (size_t i = 1; i < threads_count; ++i)
+      {
+        m_shards.emplace_back(new shard());
+        if (acceptor_.is_open())
+          start_accept(i, false, acceptor_.local_endpoint());
+        if (acceptor_ipv6.is_open())
+          start_accept(i, true, acceptor_ipv6.local_endpoint());
+        m_shards_count = m_shards.size() + 1;
+      }
+      MINFO("Running " << m_thread_name_prefix << " server with one io_service per thread");
+    }
     while(!m_stop_signal_sent)
     {
 
@@ -1242,34 +1333,23 @@ POP_WARNINGS
     connections_.clear();
     connections_mutex.unlock();
     io_service_.stop();
+    for (size_t i = 1; i < m_shards_count; ++i)
+      m_shards[i - 1]->work.io_service.stop();
     CATCH_ENTRY_L0("boosted_tcp_server<t_protocol_handler>::send_stop_signal()", void());
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
-  void boosted_tcp_server<t_protocol_handler>::handle_accept_ipv4(const boost::system::error_code& e)
-  {
-    this->handle_accept(e, false);
-  }
-  //---------------------------------------------------------------------------------
-  template<class t_protocol_handler>
-  void boosted_tcp_server<t_protocol_handler>::handle_accept_ipv6(const boost::system::error_code& e)
-  {
-    this->handle_accept(e, true);
-  }
-  //---------------------------------------------------------------------------------
-  template<class t_protocol_handler>
-  void boosted_tcp_server<t_protocol_handler>::handle_accept(const boost::system::error_code& e, bool ipv6)
+  void boosted_tcp_server<t_protocol_handler>::handle_accept(const boost::system::error_code& e, bool ipv6, size_t shard)
   {
     MDEBUG("handle_accept");
 
-    boost::asio::ip::tcp::acceptor* current_acceptor = &acceptor_;
-    connection_ptr* current_new_connection = &new_connection_;
-    auto accept_function_pointer = &boosted_tcp_server<t_protocol_handler>::handle_accept_ipv4;
+    boost::asio::io_service& io_service = get_shard_io_service(shard);
+    boost::asio::ip::tcp::acceptor* current_acceptor = shard == 0 ? &acceptor_ : &m_shards[shard - 1]->acceptor;
+    connection_ptr* current_new_connection = shard == 0 ? &new_connection_ : &m_shards[shard - 1]->new_connection;
     if (ipv6)
     {
-      current_acceptor = &acceptor_ipv6;
-      current_new_connection = &new_connection_ipv6;
-      accept_function_pointer = &boosted_tcp_server<t_protocol_handler>::handle_accept_ipv6;
+      current_acceptor = shard == 0 ? &acceptor_ipv6 : &m_shards[shard - 1]->acceptor_ipv6;
+      current_new_connection = shard == 0 ? &new_connection_ipv6 : &m_shards[shard - 1]->new_connection_ipv6;
     }
 
     try
@@ -1288,10 +1368,10 @@ POP_WARNINGS
         (*current_new_connection)->setRpcStation(); // hopefully this is not needed actually
       }
       connection_ptr conn(std::move((*current_new_connection)));
-      (*current_new_connection).reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, conn->get_ssl_support()));
+      (*current_new_connection).reset(new connection<t_protocol_handler>(io_service, m_state, m_connection_type, conn->get_ssl_support()));
       current_acceptor->async_accept((*current_new_connection)->socket(),
-          boost::bind(accept_function_pointer, this,
-            boost::asio::placeholders::error));
+          boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept, this,
+            boost::asio::placeholders::error, ipv6, shard));
 
       boost::asio::socket_base::keep_alive opt(true);
       conn->socket().set_option(opt);
@@ -1323,10 +1403,10 @@ POP_WARNINGS
     assert(m_state != nullptr); // always set in constructor
     _erro("Some problems at accept: " << e.message() << ", connections_count = " << m_state->sock_count);
     misc_utils::sleep_no_w(100);
-    (*current_new_connection).reset(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, (*current_new_connection)->get_ssl_support()));
+    (*current_new_connection).reset(new connection<t_protocol_handler>(io_service, m_state, m_connection_type, (*current_new_connection)->get_ssl_support()));
     current_acceptor->async_accept((*current_new_connection)->socket(),
-        boost::bind(accept_function_pointer, this,
-          boost::asio::placeholders::error));
+        boost::bind(&boosted_tcp_server<t_protocol_handler>::handle_accept, this,
+          boost::asio::placeholders::error, ipv6, shard));
   }
   //---------------------------------------------------------------------------------
   template<class t_protocol_handler>
@@ -1452,7 +1532,8 @@ POP_WARNINGS
   {
     TRY_ENTRY();
 
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, ssl_support) );
+    boost::asio::io_service& io_service = get_next_io_service();
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service, m_state, m_connection_type, ssl_support) );
     connections_mutex.lock();
     connections_.insert(new_connection_l);
     MDEBUG("connections_ size now " << connections_.size());
@@ -1577,7 +1658,8 @@ POP_WARNINGS
   bool boosted_tcp_server<t_protocol_handler>::connect_async(const std::string& adr, const std::string& port, uint32_t conn_timeout, const t_callback &cb, const std::string& bind_ip, epee::net_utils::ssl_support_t ssl_support)
   {
     TRY_ENTRY();    
-    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service_, m_state, m_connection_type, ssl_support) );
+    boost::asio::io_service& io_service = get_next_io_service();
+    connection_ptr new_connection_l(new connection<t_protocol_handler>(io_service, m_state, m_connection_type, ssl_support) );
     connections_mutex.lock();
     connections_.insert(new_connection_l);
     MDEBUG("connections_ size now " << connections_.size());
@@ -1655,7 +1737,7 @@ POP_WARNINGS
       }
     }
     
-    boost::shared_ptr<boost::asio::deadline_timer> sh_deadline(new boost::asio::deadline_timer(io_service_));
+    boost::shared_ptr<boost::asio::deadline_timer> sh_deadline(new boost::asio::deadline_timer(io_service));
     //start deadline
     sh_deadline->expires_from_now(boost::posix_time::milliseconds(conn_timeout));
     sh_deadline->async_wait([=](const boost::system::error_code& error)
@@ -48,11 +48,16 @@ public:
   buffer(size_t reserve = 0): offset(0) { storage.reserve(reserve); }
 
   void append(const void *data, size_t sz);
+  // makes room for sz more bytes, so the next appends up to that size do not reallocate
+  void reserve(size_t sz);
+  // frees the storage if empty and larger than max_capacity
+  void release(size_t max_capacity) { if (size() == 0 && storage.capacity() > max_capacity) { std::vector<uint8_t>().swap(storage); offset = 0; } }
   void erase(size_t sz) { NET_BUFFER_LOG("erasing " << sz << "/" << size()); CHECK_AND_ASSERT_THROW_MES(offset + sz <= storage.size(), "erase: sz too large"); offset += sz; if (offset == storage.size()) { storage.resize(0); offset = 0; } }
   epee::span<const uint8_t> span(size_t sz) const { CHECK_AND_ASSERT_THROW_MES(sz <= size(), "span is too large"); return epee::span<const uint8_t>(storage.data() + offset, sz); }
   // carve must keep the data in scope till next call, other API calls (such as append, erase) can invalidate the carved buffer
   epee::span<const uint8_t> carve(size_t sz) { CHECK_AND_ASSERT_THROW_MES(sz <= size(), "span is too large"); offset += sz; return epee::span<const uint8_t>(storage.data() + offset - sz, sz); }
   size_t size() const { return storage.size() - offset; }
+  size_t capacity() const { return storage.capacity() - offset; }
 
 private:
   std::vector<uint8_t> storage;
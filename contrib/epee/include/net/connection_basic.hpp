@@ -110,7 +110,13 @@ class connection_basic { // not-templated base class for rapid developmet of som
     volatile uint32_t m_want_close_connection;
     std::atomic<bool> m_was_shutdown;
     critical_section m_send_que_lock;
-    std::deque<byte_slice> m_send_que;
+    struct queued_chunk
+    {
+      std::vector<byte_slice> buffers; // written with one gathered write
+      bool last; // ends its message, the queue is only ever reordered after one
+    };
+    std::deque<queued_chunk> m_send_que;
+    size_t m_send_que_priority_end; // high priority messages go here, behind the message being written and earlier high ones; 0 until needed
     volatile bool m_is_multithreaded;
     /// Strand to ensure the connection's handlers are not called concurrently.
     boost::asio::io_service::strand strand_;
@@ -185,9 +191,8 @@ class connection_basic { // not-templated base class for rapid developmet of som
 		static int get_tos_flag();
 
 		// handlers and sleep
-		void sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep ; phase is not really used now(?)
+		double sleep_before_packet(size_t packet_size, int phase, int q_len); // execute a sleep, returns the seconds slept ; phase is not really used now(?)
 		static void save_limit_to_file(int limit); ///< for dr-monero
-		static double get_sleep_time(size_t cb);
 };
 
 } // nameserver
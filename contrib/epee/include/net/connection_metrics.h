@@ -0,0 +1,117 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+namespace epee
+{
+namespace net_utils
+{
+  /*! Counts values in power of two buckets. Recording is a few relaxed
+      atomic adds and never blocks, so it can be done on every message;
+      readers get a snapshot that may be a few values out of date. */
+  class histogram
+  {
+  public:
+    //! Bucket 0 counts zeros, bucket i counts values in [2^(i-1), 2^i)
+    static constexpr const std::size_t buckets = 40;
+
+    struct snapshot
+    {
+      uint64_t count;
+      uint64_t sum;
+      uint64_t max;
+      uint64_t counts[buckets];
+
+      //! \return An upper bound on the `fraction` quantile, at most `max`
+      uint64_t percentile(double fraction) const noexcept;
+    };
+
+    histogram() noexcept;
+
+    void add(uint64_t value) noexcept;
+    snapshot get() const noexcept;
+
+  private:
+    std::atomic<uint64_t> m_count;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_max;
+    std::atomic<uint64_t> m_counts[buckets];
+  };
+
+  //! Message counters, kept both per connection and per levin command
+  struct traffic_metrics
+  {
+    std::atomic<uint64_t> messages_in;
+    std::atomic<uint64_t> bytes_in;
+    std::atomic<uint64_t> messages_out;
+    std::atomic<uint64_t> bytes_out;
+    histogram size_in; //!< bytes per received message
+    histogram size_out; //!< bytes per sent message
+    histogram handler_time; //!< microseconds spent handling a received message
+
+    traffic_metrics() noexcept;
+
+    void received(std::size_t bytes) noexcept;
+    void sent(std::size_t bytes) noexcept;
+  };
+
+  struct connection_metrics: traffic_metrics
+  {
+    histogram send_queue_depth; //!< queued sends, sampled as each is added
+    histogram throttle_time; //!< microseconds blocked each time the rate limiter made us wait
+    std::atomic<uint64_t> send_queue_bytes; //!< queued and not yet written, producers back off when it is large
+
+    connection_metrics() noexcept;
+  };
+
+  /*! Per levin command metrics, shared by all connections. The table has a
+      fixed number of slots claimed with a compare and swap, commands beyond
+      that are not counted. Only commands we send or have a handler for claim
+      a slot, so ids made up by peers cannot fill it. */
+  class command_metrics
+  {
+  public:
+    static constexpr const std::size_t max_commands = 64;
+
+    //! \return Metrics for `command`, claiming a slot if needed, nullptr if the table is full
+    static traffic_metrics* add(uint32_t command) noexcept;
+
+    //! \return Metrics for `command`, nullptr if it has no slot
+    static traffic_metrics* get(uint32_t command) noexcept;
+
+    //! Calls `f` for each command seen so far
+    static void for_each(const std::function<void(uint32_t, const traffic_metrics&)> &f);
+  };
+}
+}
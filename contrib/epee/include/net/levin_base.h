@@ -30,6 +30,7 @@
 #define _LEVIN_BASE_H_
 
 #include <cstdint>
+#include <string>
 
 #include "byte_slice.h"
 #include "net_utils_base.h"
@@ -78,6 +79,7 @@ namespace levin
 #define LEVIN_PACKET_RESPONSE		0x00000002
 #define LEVIN_PACKET_BEGIN		0x00000004
 #define LEVIN_PACKET_END		0x00000008
+#define LEVIN_PACKET_COMPRESSED		0x00000010 // payload is a zlib stream
   
 
 #define LEVIN_PROTOCOL_VER_0         0
@@ -145,6 +147,17 @@ namespace levin
       Otherwise, a levin notification message OR 2+ levin fragment messages.
       Each message is `noise.size()` in length. */
   byte_slice make_fragmented_notify(const byte_slice& noise, int command, epee::span<const std::uint8_t> payload);
+
+  /*! Compress a payload, to be sent with `LEVIN_PACKET_COMPRESSED`.
+
+   \return False if compression failed or did not make the payload smaller. */
+  bool compress_payload(epee::span<const std::uint8_t> payload, std::string& out);
+
+  /*! Decompress a payload received with `LEVIN_PACKET_COMPRESSED`.
+
+   \return False if the payload is not a valid zlib stream, or decompresses
+      to more than `max_size` bytes. */
+  bool decompress_payload(epee::span<const std::uint8_t> payload, std::string& out, std::size_t max_size);
 }
 }
 
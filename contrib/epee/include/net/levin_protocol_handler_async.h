@@ -31,11 +31,13 @@
 #include <boost/interprocess/detail/atomic.hpp>
 #include <boost/smart_ptr/make_shared.hpp>
 
+#include <algorithm>
 #include <atomic>
 #include <deque>
 
 #include "levin_base.h"
 #include "buffer.h"
+#include "net/connection_metrics.h"
 #include "misc_language.h"
 #include "syncobj.h"
 #include "misc_os_dependent.h"
@@ -51,6 +53,14 @@
 #define MIN_BYTES_WANTED	512
 #endif
 
+#ifndef LEVIN_RECV_PREALLOCATE
+#define LEVIN_RECV_PREALLOCATE	(4 * 1024 * 1024)
+#endif
+
+#ifndef LEVIN_RECV_RETAIN
+#define LEVIN_RECV_RETAIN	(4 * 1024 * 1024)
+#endif
+
 namespace epee
 {
 namespace levin
@@ -86,12 +96,15 @@ public:
   typedef t_connection_context connection_context;
   uint64_t m_max_packet_size; 
   uint64_t m_invoke_timeout;
+  //! Largest payload a `LEVIN_PACKET_COMPRESSED` command may inflate to for a connection, 0 refuses it. Compressed packets are refused when unset.
+  std::size_t (*m_max_inflated_size)(const t_connection_context&, int command);
 
   int invoke(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, boost::uuids::uuid connection_id);
   template<class callback_t>
   int invoke_async(int command, const epee::span<const uint8_t> in_buff, boost::uuids::uuid connection_id, const callback_t &cb, size_t timeout = LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED);
 
   int notify(int command, const epee::span<const uint8_t> in_buff, boost::uuids::uuid connection_id);
+  int notify(int command, byte_slice in_buff, boost::uuids::uuid connection_id, uint32_t flags = 0, net_utils::send_priority priority = net_utils::send_priority::normal);
   int send(epee::byte_slice message, const boost::uuids::uuid& connection_id);
   bool close(boost::uuids::uuid connection_id);
   bool update_connection_context(const t_connection_context& contxt);
@@ -105,7 +118,7 @@ public:
   size_t get_in_connections_count();
   void set_handler(levin_commands_handler<t_connection_context>* handler, void (*destroy)(levin_commands_handler<t_connection_context>*) = NULL);
 
-  async_protocol_handler_config():m_pcommands_handler(NULL), m_pcommands_handler_destroy(NULL), m_max_packet_size(LEVIN_DEFAULT_MAX_PACKET_SIZE), m_invoke_timeout(LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED)
+  async_protocol_handler_config():m_pcommands_handler(NULL), m_pcommands_handler_destroy(NULL), m_max_packet_size(LEVIN_DEFAULT_MAX_PACKET_SIZE), m_invoke_timeout(LEVIN_DEFAULT_TIMEOUT_PRECONFIGURED), m_max_inflated_size(NULL)
   {}
   ~async_protocol_handler_config() { set_handler(NULL, NULL); }
   void del_out_connections(size_t count);
@@ -121,11 +134,47 @@ class async_protocol_handler
 {
   std::string m_fragment_buffer;
 
+  //! Per command metrics get a slot only for `known` commands, others are counted if they already have one
+  static net_utils::traffic_metrics* get_command_metrics(uint32_t command, bool known)
+  {
+    return known ? net_utils::command_metrics::add(command) : net_utils::command_metrics::get(command);
+  }
+
+  void count_sent(uint32_t command, std::size_t bytes, bool known = true)
+  {
+    m_connection_context.m_metrics->sent(bytes);
+    if (net_utils::traffic_metrics *metrics = get_command_metrics(command, known))
+      metrics->sent(bytes);
+  }
+
+  void count_handled(uint32_t command, std::size_t bytes, std::chrono::steady_clock::time_point start, bool known)
+  {
+    const uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+    m_connection_context.m_metrics->handler_time.add(us);
+    if (net_utils::traffic_metrics *metrics = get_command_metrics(command, known))
+    {
+      metrics->received(bytes);
+      metrics->handler_time.add(us);
+    }
+  }
+
   bool send_message(uint32_t command, epee::span<const uint8_t> in_buff, uint32_t flags, bool expect_response)
   {
-    const bucket_head2 head = make_header(command, in_buff.size(), flags, expect_response);
-    if(!m_pservice_endpoint->do_send(byte_slice{as_byte_span(head), in_buff}))
+    return send_message(command, byte_slice{in_buff}, flags, expect_response);
+  }
+
+  //! Sends the header and `in_buff` as a gathered write, `in_buff` is not copied.
+  bool send_message(uint32_t command, byte_slice in_buff, uint32_t flags, bool expect_response, net_utils::send_priority priority = net_utils::send_priority::normal)
+  {
+    const std::size_t length = in_buff.size();
+    const bucket_head2 head = make_header(command, length, flags, expect_response);
+    std::vector<byte_slice> message;
+    message.reserve(2);
+    message.emplace_back(std::initializer_list<span<const std::uint8_t>>{as_byte_span(head)});
+    message.push_back(std::move(in_buff));
+    if(!m_pservice_endpoint->do_send(std::move(message), priority))
       return false;
+    count_sent(command, length);
 
     MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
         << ", flags" << head.m_flags
@@ -387,6 +436,177 @@ public:
     m_config.m_pcommands_handler->callback(m_connection_context);
   }
 
+  bool read_head(epee::span<const uint8_t> data)
+  {
+    bucket_head2 phead;
+    std::memcpy(std::addressof(phead), data.data(), sizeof(bucket_head2));
+#if BYTE_ORDER != LITTLE_ENDIAN
+    phead.m_signature = SWAP64LE(phead.m_signature);
+    phead.m_cb = SWAP64LE(phead.m_cb);
+    phead.m_command = SWAP32LE(phead.m_command);
+    phead.m_return_code = SWAP32LE(phead.m_return_code);
+    phead.m_flags = SWAP32LE(phead.m_flags);
+    phead.m_protocol_version = SWAP32LE(phead.m_protocol_version);
+#endif
+    if(LEVIN_SIGNATURE != phead.m_signature)
+    {
+      LOG_ERROR_CC(m_connection_context, "Signature mismatch, connection will be closed");
+      return false;
+    }
+    m_current_head = phead;
+
+    m_state = stream_state_body;
+    m_oponent_protocol_ver = m_current_head.m_protocol_version;
+    if(m_current_head.m_cb > m_config.m_max_packet_size)
+    {
+      LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
+        << ", packet header received " << m_current_head.m_cb 
+        << ", connection will be closed.");
+      return false;
+    }
+    return true;
+  }
+
+  // buff_to_invoke only has to stay valid for the duration of the call, so
+  // it may point straight into the socket read buffer
+  bool handle_body(epee::span<const uint8_t> buff_to_invoke)
+  {
+    std::string temp{};
+    m_state = stream_state_head;
+
+    // abstract_tcp_server2.h manages max bandwidth for a p2p link
+    if (!(m_current_head.m_flags & (LEVIN_PACKET_REQUEST | LEVIN_PACKET_RESPONSE)))
+    {
+      // special noise/fragment command
+      static constexpr const uint32_t both_flags = (LEVIN_PACKET_BEGIN | LEVIN_PACKET_END);
+      if ((m_current_head.m_flags & both_flags) == both_flags)
+        return true; // noise message, skip to next message
+
+      if (m_current_head.m_flags & LEVIN_PACKET_BEGIN)
+        m_fragment_buffer.clear();
+
+      m_fragment_buffer.append(reinterpret_cast<const char*>(buff_to_invoke.data()), buff_to_invoke.size());
+      if (!(m_current_head.m_flags & LEVIN_PACKET_END))
+        return true; // skip to next message
+
+      if (m_fragment_buffer.size() < sizeof(bucket_head2))
+      {
+        MERROR(m_connection_context << "Fragmented data too small for levin header");
+        return false;
+      }
+
+      temp = std::move(m_fragment_buffer);
+      m_fragment_buffer.clear();
+      std::memcpy(std::addressof(m_current_head), std::addressof(temp[0]), sizeof(bucket_head2));
+      buff_to_invoke = {reinterpret_cast<const uint8_t*>(temp.data()) + sizeof(bucket_head2), temp.size() - sizeof(bucket_head2)};
+    }
+
+    const std::size_t received = buff_to_invoke.size();
+    m_connection_context.m_metrics->received(received);
+
+    std::string inflated{};
+    if (m_current_head.m_flags & LEVIN_PACKET_COMPRESSED)
+    {
+      const std::size_t max_inflated = m_config.m_max_inflated_size ? m_config.m_max_inflated_size(m_connection_context, m_current_head.m_command) : 0;
+      if (!max_inflated)
+      {
+        LOG_ERROR_CC(m_connection_context, "Unexpected compressed levin payload, cmd = " << m_current_head.m_command << ", connection will be closed");
+        return false;
+      }
+      if (!decompress_payload(buff_to_invoke, inflated, std::min<uint64_t>(max_inflated, m_config.m_max_packet_size)))
+      {
+        LOG_ERROR_CC(m_connection_context, "Failed to decompress levin payload, cmd = " << m_current_head.m_command << ", connection will be closed");
+        return false;
+      }
+      buff_to_invoke = epee::strspan<uint8_t>(inflated);
+    }
+
+    bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
+
+    MDEBUG(m_connection_context << "LEVIN_PACKET_RECEIVED. [len=" << m_current_head.m_cb
+      << ", flags" << m_current_head.m_flags 
+      << ", r?=" << m_current_head.m_have_to_return_data 
+      <<", cmd = " << m_current_head.m_command 
+      << ", v=" << m_current_head.m_protocol_version);
+
+    const std::chrono::steady_clock::time_point handler_start = std::chrono::steady_clock::now();
+    bool handled = false; // responses are only counted against commands we sent
+    if(is_response)
+    {//response to some invoke 
+
+      epee::critical_region_t<decltype(m_invoke_response_handlers_lock)> invoke_response_handlers_guard(m_invoke_response_handlers_lock);
+      if(!m_invoke_response_handlers.empty())
+      {//async call scenario
+        boost::shared_ptr<invoke_response_handler_base> response_handler = m_invoke_response_handlers.front();
+        bool timer_cancelled = response_handler->cancel_timer();
+         // Don't pop handler, to avoid destroying it
+        if(timer_cancelled)
+          m_invoke_response_handlers.pop_front();
+        invoke_response_handlers_guard.unlock();
+
+        if(timer_cancelled)
+          response_handler->handle(m_current_head.m_return_code, buff_to_invoke, m_connection_context);
+      }
+      else
+      {
+        invoke_response_handlers_guard.unlock();
+        //use sync call scenario
+        if(!boost::interprocess::ipcdetail::atomic_read32(&m_wait_count) && !boost::interprocess::ipcdetail::atomic_read32(&m_close_called))
+        {
+          MERROR(m_connection_context << "no active invoke when response came, wtf?");
+          return false;
+        }else
+        {
+          CRITICAL_REGION_BEGIN(m_local_inv_buff_lock);
+          m_local_inv_buff = std::string((const char*)buff_to_invoke.data(), buff_to_invoke.size());
+          buff_to_invoke = epee::span<const uint8_t>((const uint8_t*)NULL, 0);
+          m_invoke_result_code = m_current_head.m_return_code;
+          CRITICAL_REGION_END();
+          boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 1);
+        }
+      }
+    }else
+    {
+      if(m_current_head.m_have_to_return_data)
+      {
+        std::string return_buff;
+        const int32_t return_code = m_config.m_pcommands_handler->invoke(
+          m_current_head.m_command, buff_to_invoke, return_buff, m_connection_context
+        );
+        handled = return_code != LEVIN_ERROR_CONNECTION_HANDLER_NOT_DEFINED;
+
+        const std::size_t length = return_buff.size();
+        bucket_head2 head = make_header(m_current_head.m_command, length, LEVIN_PACKET_RESPONSE, false);
+        head.m_return_code = SWAP32LE(return_code);
+
+        std::vector<byte_slice> message;
+        message.reserve(2);
+        message.emplace_back(std::initializer_list<span<const std::uint8_t>>{as_byte_span(head)});
+        message.emplace_back(std::move(return_buff));
+        if(!m_pservice_endpoint->do_send(std::move(message)))
+          return false;
+        count_sent(m_current_head.m_command, length, handled);
+
+        MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
+          << ", flags" << head.m_flags
+          << ", r?=" << head.m_have_to_return_data
+          <<", cmd = " << head.m_command
+          << ", ver=" << head.m_protocol_version);
+      }
+      else
+        handled = m_config.m_pcommands_handler->notify(m_current_head.m_command, buff_to_invoke, m_connection_context) != LEVIN_ERROR_CONNECTION_HANDLER_NOT_DEFINED;
+    }
+    count_handled(m_current_head.m_command, received, handler_start, handled);
+    // reuse small buffer
+    if (!temp.empty() && temp.capacity() <= 64 * 1024)
+    {
+      temp.clear();
+      m_fragment_buffer = std::move(temp);
+    }
+
+    return true;
+  }
+
   virtual bool handle_recv(const void* ptr, size_t cb)
   {
     if(boost::interprocess::ipcdetail::atomic_read32(&m_close_called))
@@ -411,7 +631,28 @@ public:
       return false;
     }
 
-    m_cache_in_buffer.append((const char*)ptr, cb);
+    // when nothing is pending, messages wholly contained in this read are
+    // dispatched straight from the read buffer without being copied
+    const uint8_t* data = static_cast<const uint8_t*>(ptr);
+    size_t left = cb;
+    while(m_state == stream_state_head && m_cache_in_buffer.size() == 0 && left >= sizeof(bucket_head2))
+    {
+      if(!read_head({data, sizeof(bucket_head2)}))
+        return false;
+      data += sizeof(bucket_head2);
+      left -= sizeof(bucket_head2);
+      if(left < m_current_head.m_cb)
+        break;
+
+      const size_t body_size = m_current_head.m_cb;
+      if(!handle_body({data, body_size}))
+        return false;
+      data += body_size;
+      left -= body_size;
+    }
+
+    if(left)
+      m_cache_in_buffer.append(data, left);
 
     bool is_continue = true;
     while(is_continue)
@@ -422,6 +663,14 @@ public:
         if(m_cache_in_buffer.size() < m_current_head.m_cb)
         {
           is_continue = false;
+
+          // grow the arena geometrically up to the announced size, so a large
+          // body is not reallocated on every read and a bogus header cannot
+          // make us allocate the whole of it up front
+          const size_t have = m_cache_in_buffer.size();
+          const size_t want = std::min<size_t>(m_current_head.m_cb, std::max<size_t>(LEVIN_RECV_PREALLOCATE, 2 * have));
+          m_cache_in_buffer.reserve(want - have);
+
           if(cb >= MIN_BYTES_WANTED)
           {
             CRITICAL_REGION_LOCAL(m_invoke_response_handlers_lock);
@@ -436,112 +685,8 @@ public:
           break;
         }
 
-        {
-          std::string temp{};
-          epee::span<const uint8_t> buff_to_invoke = m_cache_in_buffer.carve((std::string::size_type)m_current_head.m_cb);
-          m_state = stream_state_head;
-
-          // abstract_tcp_server2.h manages max bandwidth for a p2p link
-          if (!(m_current_head.m_flags & (LEVIN_PACKET_REQUEST | LEVIN_PACKET_RESPONSE)))
-          {
-            // special noise/fragment command
-            static constexpr const uint32_t both_flags = (LEVIN_PACKET_BEGIN | LEVIN_PACKET_END);
-            if ((m_current_head.m_flags & both_flags) == both_flags)
-              break; // noise message, skip to next message
-
-            if (m_current_head.m_flags & LEVIN_PACKET_BEGIN)
-              m_fragment_buffer.clear();
-
-            m_fragment_buffer.append(reinterpret_cast<const char*>(buff_to_invoke.data()), buff_to_invoke.size());
-            if (!(m_current_head.m_flags & LEVIN_PACKET_END))
-              break; // skip to next message
-
-            if (m_fragment_buffer.size() < sizeof(bucket_head2))
-            {
-              MERROR(m_connection_context << "Fragmented data too small for levin header");
-              return false;
-            }
-
-            temp = std::move(m_fragment_buffer);
-            m_fragment_buffer.clear();
-            std::memcpy(std::addressof(m_current_head), std::addressof(temp[0]), sizeof(bucket_head2));
-            buff_to_invoke = {reinterpret_cast<const uint8_t*>(temp.data()) + sizeof(bucket_head2), temp.size() - sizeof(bucket_head2)};
-          }
-
-          bool is_response = (m_oponent_protocol_ver == LEVIN_PROTOCOL_VER_1 && m_current_head.m_flags&LEVIN_PACKET_RESPONSE);
-
-          MDEBUG(m_connection_context << "LEVIN_PACKET_RECEIVED. [len=" << m_current_head.m_cb
-            << ", flags" << m_current_head.m_flags 
-            << ", r?=" << m_current_head.m_have_to_return_data 
-            <<", cmd = " << m_current_head.m_command 
-            << ", v=" << m_current_head.m_protocol_version);
-
-          if(is_response)
-          {//response to some invoke 
-
-            epee::critical_region_t<decltype(m_invoke_response_handlers_lock)> invoke_response_handlers_guard(m_invoke_response_handlers_lock);
-            if(!m_invoke_response_handlers.empty())
-            {//async call scenario
-              boost::shared_ptr<invoke_response_handler_base> response_handler = m_invoke_response_handlers.front();
-              bool timer_cancelled = response_handler->cancel_timer();
-               // Don't pop handler, to avoid destroying it
-              if(timer_cancelled)
-                m_invoke_response_handlers.pop_front();
-              invoke_response_handlers_guard.unlock();
-
-              if(timer_cancelled)
-                response_handler->handle(m_current_head.m_return_code, buff_to_invoke, m_connection_context);
-            }
-            else
-            {
-              invoke_response_handlers_guard.unlock();
-              //use sync call scenario
-              if(!boost::interprocess::ipcdetail::atomic_read32(&m_wait_count) && !boost::interprocess::ipcdetail::atomic_read32(&m_close_called))
-              {
-                MERROR(m_connection_context << "no active invoke when response came, wtf?");
-                return false;
-              }else
-              {
-                CRITICAL_REGION_BEGIN(m_local_inv_buff_lock);
-                m_local_inv_buff = std::string((const char*)buff_to_invoke.data(), buff_to_invoke.size());
-                buff_to_invoke = epee::span<const uint8_t>((const uint8_t*)NULL, 0);
-                m_invoke_result_code = m_current_head.m_return_code;
-                CRITICAL_REGION_END();
-                boost::interprocess::ipcdetail::atomic_write32(&m_invoke_buf_ready, 1);
-              }
-            }
-          }else
-          {
-            if(m_current_head.m_have_to_return_data)
-            {
-              std::string return_buff;
-              const uint32_t return_code = m_config.m_pcommands_handler->invoke(
-                m_current_head.m_command, buff_to_invoke, return_buff, m_connection_context
-              );
-
-              bucket_head2 head = make_header(m_current_head.m_command, return_buff.size(), LEVIN_PACKET_RESPONSE, false);
-              head.m_return_code = SWAP32LE(return_code);
-              return_buff.insert(0, reinterpret_cast<const char*>(&head), sizeof(head));
-
-              if(!m_pservice_endpoint->do_send(byte_slice{std::move(return_buff)}))
-                return false;
-
-              MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << head.m_cb
-                << ", flags" << head.m_flags
-                << ", r?=" << head.m_have_to_return_data
-                <<", cmd = " << head.m_command
-                << ", ver=" << head.m_protocol_version);
-            }
-            else
-              m_config.m_pcommands_handler->notify(m_current_head.m_command, buff_to_invoke, m_connection_context);
-          }
-          // reuse small buffer
-          if (!temp.empty() && temp.capacity() <= 64 * 1024)
-          {
-            temp.clear();
-            m_fragment_buffer = std::move(temp);
-          }
-        }
+        if(!handle_body(m_cache_in_buffer.carve((std::string::size_type)m_current_head.m_cb)))
+          return false;
         break;
       case stream_state_head:
         {
@@ -556,34 +701,9 @@ public:
             break;
           }
 
-#if BYTE_ORDER == LITTLE_ENDIAN
-          bucket_head2& phead = *(bucket_head2*)m_cache_in_buffer.span(sizeof(bucket_head2)).data();
-#else
-          bucket_head2 phead = *(bucket_head2*)m_cache_in_buffer.span(sizeof(bucket_head2)).data();
-          phead.m_signature = SWAP64LE(phead.m_signature);
-          phead.m_cb = SWAP64LE(phead.m_cb);
-          phead.m_command = SWAP32LE(phead.m_command);
-          phead.m_return_code = SWAP32LE(phead.m_return_code);
-          phead.m_flags = SWAP32LE(phead.m_flags);
-          phead.m_protocol_version = SWAP32LE(phead.m_protocol_version);
-#endif
-          if(LEVIN_SIGNATURE != phead.m_signature)
-          {
-            LOG_ERROR_CC(m_connection_context, "Signature mismatch, connection will be closed");
+          if(!read_head(m_cache_in_buffer.span(sizeof(bucket_head2))))
             return false;
-          }
-          m_current_head = phead;
-
           m_cache_in_buffer.erase(sizeof(bucket_head2));
-          m_state = stream_state_body;
-          m_oponent_protocol_ver = m_current_head.m_protocol_version;
-          if(m_current_head.m_cb > m_config.m_max_packet_size)
-          {
-            LOG_ERROR_CC(m_connection_context, "Maximum packet size exceed!, m_max_packet_size = " << m_config.m_max_packet_size 
-              << ", packet header received " << m_current_head.m_cb 
-              << ", connection will be closed.");
-            return false;
-          }
         }
         break;
       default:
@@ -592,6 +712,9 @@ public:
       }
     }
 
+    // keep the arena between messages, but do not hold on to the memory of
+    // an unusually large one
+    m_cache_in_buffer.release(LEVIN_RECV_RETAIN);
     return true;
   }
 
@@ -713,6 +836,12 @@ public:
   }
 
   int notify(int command, const epee::span<const uint8_t> in_buff)
+  {
+    return notify(command, byte_slice{in_buff});
+  }
+
+  //! Same as above, but `in_buff` is sent without being copied, with extra header `flags`, ahead of queued sends if `priority` is high.
+  int notify(int command, byte_slice in_buff, uint32_t flags = 0, net_utils::send_priority priority = net_utils::send_priority::normal)
   {
     misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
                           boost::bind(&async_protocol_handler::finish_outer_call, this));
@@ -725,7 +854,7 @@ public:
     if(m_deletion_initiated)
       return LEVIN_ERROR_CONNECTION_DESTROYED;
 
-    if (!send_message(command, in_buff, LEVIN_PACKET_REQUEST, false))
+    if (!send_message(command, std::move(in_buff), LEVIN_PACKET_REQUEST | flags, false, priority))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to send notify message");
       return -1;
@@ -750,11 +879,20 @@ public:
       return LEVIN_ERROR_CONNECTION_DESTROYED;
 
     const std::size_t length = message.size();
+    uint32_t command = 0;
+    if (length >= sizeof(bucket_head2))
+    {
+      bucket_head2 head;
+      std::memcpy(std::addressof(head), message.data(), sizeof(head));
+      command = SWAP32LE(head.m_command);
+    }
     if (!m_pservice_endpoint->do_send(std::move(message)))
     {
       LOG_ERROR_CC(m_connection_context, "Failed to send message, dropping it");
       return -1;
     }
+    if (command)
+      count_sent(command, length - sizeof(bucket_head2));
 
     MDEBUG(m_connection_context << "LEVIN_PACKET_SENT. [len=" << (length - sizeof(bucket_head2)) << ", r?=0]");
     return 1;
@@ -937,6 +1075,14 @@ int async_protocol_handler_config<t_connection_context>::notify(int command, con
 }
 //------------------------------------------------------------------------------------------
 template<class t_connection_context>
+int async_protocol_handler_config<t_connection_context>::notify(int command, byte_slice in_buff, boost::uuids::uuid connection_id, uint32_t flags, net_utils::send_priority priority)
+{
+  async_protocol_handler<t_connection_context>* aph;
+  int r = find_and_lock_connection(connection_id, aph);
+  return LEVIN_OK == r ? aph->notify(command, std::move(in_buff), flags, priority) : r;
+}
+//------------------------------------------------------------------------------------------
+template<class t_connection_context>
 int async_protocol_handler_config<t_connection_context>::send(byte_slice message, const boost::uuids::uuid& connection_id)
 {
   async_protocol_handler<t_connection_context>* aph;
@@ -32,11 +32,13 @@
 #include <boost/uuid/uuid.hpp>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/address_v6.hpp>
+#include <memory>
 #include <typeinfo>
 #include <type_traits>
 #include "byte_slice.h"
 #include "enums.h"
 #include "misc_log_ex.h"
+#include "net/connection_metrics.h"
 #include "serialization/keyvalue_serialization.h"
 #include "int-util.h"
 
@@ -377,24 +379,16 @@ namespace net_utils
     double m_current_speed_up;
     double m_max_speed_down;
     double m_max_speed_up;
+    //! Shared by copies of the context, as they describe the same connection
+    std::shared_ptr<connection_metrics> m_metrics;
 
     connection_context_base(boost::uuids::uuid connection_id,
                             const network_address &remote_address, bool is_income, bool ssl,
                             time_t last_recv = 0, time_t last_send = 0,
                             uint64_t recv_cnt = 0, uint64_t send_cnt = 0):
-                                            m_connection_id(connection_id),
-                                            m_remote_address(remote_address),
-                                            m_is_income(is_income),
-                                            m_started(time(NULL)),
-                                            m_ssl(ssl),
-                                            m_last_recv(last_recv),
-                                            m_last_send(last_send),
-                                            m_recv_cnt(recv_cnt),
-                                            m_send_cnt(send_cnt),
-                                            m_current_speed_down(0),
-                                            m_current_speed_up(0),
-                                            m_max_speed_down(0),
-                                            m_max_speed_up(0)
+                                            connection_context_base(std::make_shared<connection_metrics>(),
+                                                                    connection_id, remote_address, is_income, ssl,
+                                                                    last_recv, last_send, recv_cnt, send_cnt)
     {}
 
     connection_context_base(): m_connection_id(),
@@ -409,29 +403,62 @@ namespace net_utils
                                m_current_speed_down(0),
                                m_current_speed_up(0),
                                m_max_speed_down(0),
-                               m_max_speed_up(0)
+                               m_max_speed_up(0),
+                               m_metrics(std::make_shared<connection_metrics>())
     {}
 
-    connection_context_base(const connection_context_base& a): connection_context_base()
-    {
-      set_details(a.m_connection_id, a.m_remote_address, a.m_is_income, a.m_ssl);
-    }
+    connection_context_base(const connection_context_base& a):
+      connection_context_base(a.m_metrics, a.m_connection_id, a.m_remote_address, a.m_is_income, a.m_ssl)
+    {}
 
     connection_context_base& operator=(const connection_context_base& a)
     {
-      set_details(a.m_connection_id, a.m_remote_address, a.m_is_income, a.m_ssl);
+      set_details(a.m_connection_id, a.m_remote_address, a.m_is_income, a.m_ssl, a.m_metrics);
       return *this;
     }
     
   private:
     template<class t_protocol_handler>
     friend class connection;
+
+    connection_context_base(std::shared_ptr<connection_metrics> metrics, boost::uuids::uuid connection_id,
+                            const network_address &remote_address, bool is_income, bool ssl,
+                            time_t last_recv = 0, time_t last_send = 0,
+                            uint64_t recv_cnt = 0, uint64_t send_cnt = 0):
+                                            m_connection_id(connection_id),
+                                            m_remote_address(remote_address),
+                                            m_is_income(is_income),
+                                            m_started(time(NULL)),
+                                            m_ssl(ssl),
+                                            m_last_recv(last_recv),
+                                            m_last_send(last_send),
+                                            m_recv_cnt(recv_cnt),
+                                            m_send_cnt(send_cnt),
+                                            m_current_speed_down(0),
+                                            m_current_speed_up(0),
+                                            m_max_speed_down(0),
+                                            m_max_speed_up(0),
+                                            m_metrics(std::move(metrics))
+    {}
+
+    //! Keeps the metrics this context already has, a fresh connection has not used them yet
     void set_details(boost::uuids::uuid connection_id, const network_address &remote_address, bool is_income, bool ssl)
+    {
+      set_details(connection_id, remote_address, is_income, ssl, m_metrics);
+    }
+
+    void set_details(boost::uuids::uuid connection_id, const network_address &remote_address, bool is_income, bool ssl, std::shared_ptr<connection_metrics> metrics)
     {
       this->~connection_context_base();
-      new(this) connection_context_base(connection_id, remote_address, is_income, ssl);
+      new(this) connection_context_base(std::move(metrics), connection_id, remote_address, is_income, ssl);
     }
+	};
 
+	//! Where a message is queued relative to what is already waiting to be written
+	enum class send_priority : std::uint8_t
+	{
+		normal = 0, //!< Behind everything queued
+		high        //!< Ahead of queued normal messages, behind earlier high ones
 	};
 
 	/************************************************************************/
@@ -440,6 +467,26 @@ namespace net_utils
 	struct i_service_endpoint
 	{
 		virtual bool do_send(byte_slice message)=0;
+
+		/*! Sends the slices of `message` back to back. Endpoints that cannot
+			write a buffer sequence get the slices joined into one. */
+		virtual bool do_send(std::vector<byte_slice> message)
+		{
+			if (message.size() == 1)
+				return do_send(std::move(message.front()));
+
+			std::string joined;
+			joined.reserve(get_total_size(message));
+			for (const byte_slice& part : message)
+				joined.append(reinterpret_cast<const char*>(part.data()), part.size());
+			return do_send(byte_slice{std::move(joined)});
+		}
+
+		//! Endpoints without a send queue have nothing to reorder, and ignore `priority`.
+		virtual bool do_send(std::vector<byte_slice> message, send_priority priority)
+		{
+			return do_send(std::move(message));
+		}
     virtual bool close()=0;
     virtual bool send_done()=0;
     virtual bool call_run_once_service_io()=0;
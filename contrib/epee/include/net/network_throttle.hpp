@@ -56,6 +56,7 @@
 #include "syncobj.h"
 
 #include "net/net_utils_base.h" 
+#include "net/token_bucket.h"
 #include "misc_log_ex.h" 
 #include <boost/lambda/bind.hpp>
 #include <boost/lambda/lambda.hpp>
@@ -112,17 +113,16 @@ class network_throttle_manager {
 	//protected:
 	public: // XXX
 
-    static boost::mutex m_lock_get_global_throttle_in;
     static boost::mutex m_lock_get_global_throttle_inreq;
-    static boost::mutex m_lock_get_global_throttle_out;
 
 		friend class connection_basic; // FRIEND - to directly access global throttle-s. !! REMEMBER TO USE LOCKS!
 		friend class connection_basic_pimpl; // ditto
 
 	public:
-		static i_network_throttle & get_global_throttle_in(); ///< singleton ; for friend class ; caller MUST use proper locks! like m_lock_get_global_throttle_in
-		static i_network_throttle & get_global_throttle_inreq(); ///< ditto ; use lock ... use m_lock_get_global_throttle_inreq obviously
-		static i_network_throttle & get_global_throttle_out(); ///< ditto ; use lock ... use m_lock_get_global_throttle_out obviously
+		static i_network_throttle & get_global_throttle_inreq(); ///< singleton ; for friend class ; caller MUST use proper locks! like m_lock_get_global_throttle_inreq
+
+		static token_bucket & get_global_bucket_in(); ///< the limit actually enforced on reads ; lock free, no lock needed
+		static token_bucket & get_global_bucket_out(); ///< ditto for writes
 };
 
 
@@ -0,0 +1,74 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace epee
+{
+namespace net_utils
+{
+  /*! A rate limiter that never blocks or locks. Traffic is charged as it
+      happens and the bucket may go into debt; the caller is told how long to
+      wait for the debt to be paid back at the configured rate. Up to
+      `burst_seconds` worth of unused rate is kept as credit.
+
+      This is a GCRA: the whole state is the time at which the bucket would
+      be empty again, advanced with a single compare and swap per packet. */
+  class token_bucket
+  {
+  public:
+    explicit token_bucket(uint64_t bytes_per_second = 0, double burst_seconds = 1.0);
+
+    //! A rate of 0 disables limiting, traffic is still counted
+    void set_rate(uint64_t bytes_per_second) noexcept;
+    uint64_t get_rate() const noexcept { return m_rate; }
+
+    /*! Charges `bytes` to the bucket.
+
+      \return Seconds to wait before sending (or reading) more, 0 if the
+        bytes were covered by the rate and burst. */
+    double consume(size_t bytes) noexcept;
+
+    //! Counts `bytes` for the stats without charging the bucket
+    void count(size_t bytes) noexcept;
+
+    void get_stats(uint64_t &total_packets, uint64_t &total_bytes) const noexcept;
+
+  private:
+    std::atomic<uint64_t> m_rate;
+    std::atomic<int64_t> m_empty_at; // steady clock, ns
+    const int64_t m_burst_ns;
+    std::atomic<uint64_t> m_total_packets;
+    std::atomic<uint64_t> m_total_bytes;
+  };
+}
+}
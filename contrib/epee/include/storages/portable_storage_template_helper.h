@@ -30,6 +30,8 @@
 
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
+#include "portable_storage_view.h"
+#include "portable_storage_writer.h"
 #include "file_io_utils.h"
 
 namespace epee
@@ -86,7 +88,7 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, const epee::span<const uint8_t> binary_buff)
     {
-      portable_storage ps;
+      binary_storage_t<t_struct> ps;
       bool rs = ps.load_from_binary(binary_buff);
       if(!rs)
         return false;
@@ -111,7 +113,7 @@ namespace epee
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
-    bool store_t_to_binary(t_struct& str_in, std::string& binary_buff, size_t indent = 0)
+    bool store_t_to_binary(t_struct& str_in, std::string& binary_buff, std::false_type)
     {
       portable_storage ps;
       str_in.store(ps);
@@ -119,6 +121,24 @@ namespace epee
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
+    bool store_t_to_binary(t_struct& str_in, std::string& binary_buff, std::true_type)
+    {
+      TRY_ENTRY();
+      portable_storage_writer writer;
+      str_in.store(writer);
+      writer.start_output(binary_buff);
+      str_in.store(writer);
+      return writer.finish();
+      CATCH_ENTRY("store_t_to_binary", false);
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
+    bool store_t_to_binary(t_struct& str_in, std::string& binary_buff, size_t indent = 0)
+    {
+      return store_t_to_binary(str_in, binary_buff, store_to_binary_writer<typename std::remove_const<t_struct>::type>());
+    }
+    //-----------------------------------------------------------------------------------------------------------
+    template<class t_struct>
     std::string store_t_to_binary(t_struct& str_in, size_t indent = 0)
     {
       std::string binary_buff;
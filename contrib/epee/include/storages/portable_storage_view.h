@@ -0,0 +1,482 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstring>
+#include <deque>
+#include <type_traits>
+#include <vector>
+
+#include "misc_log_ex.h"
+#include "portable_storage.h"
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_from_bin.h"
+#include "portable_storage_val_converters.h"
+#include "span.h"
+
+#undef BITTUBE_DEFAULT_LOG_CATEGORY
+#define BITTUBE_DEFAULT_LOG_CATEGORY "serialization"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Read only storage over a binary portable_storage blob. Loading only  */
+    /* indexes where each entry lives in the blob; values are decoded       */
+    /* straight into the target fields when a KV map asks for them. The     */
+    /* blob must outlive the view.                                          */
+    /************************************************************************/
+    class portable_storage_view
+    {
+    public:
+      struct section_ref
+      {
+        size_t first;
+        size_t count;
+      };
+
+      struct array_cursor
+      {
+        uint8_t type;
+        const uint8_t* ptr;
+        size_t left;
+        size_t section;
+      };
+
+      typedef section_ref* hsection;
+      typedef array_cursor* harray;
+      typedef storage_entry meta_entry;
+
+      bool load_from_binary(const epee::span<const uint8_t> source);
+      bool load_from_binary(const std::string& source) { return load_from_binary(epee::strspan<uint8_t>(source)); }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool get_value(const std::string& value_name, t_value& val, hsection hparent_section);
+      bool get_value(const std::string& value_name, storage_entry& val, hsection hparent_section);
+
+      template<class t_value>
+      harray get_first_value(const std::string& value_name, t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool get_next_value(harray hval_array, t_value& target);
+      harray get_first_section(const std::string& section_name, hsection& h_child_section, hsection hparent_section);
+      bool get_next_section(harray hsec_array, hsection& h_child_section);
+
+    private:
+      struct entry_ref
+      {
+        const char* name;
+        size_t name_size;
+        const uint8_t* raw; // type byte
+        uint8_t type;       // element type and SERIALIZE_FLAG_ARRAY for arrays
+        const uint8_t* data;
+        size_t count;       // array elements
+        size_t index;       // first section of an object or object array
+      };
+
+      size_t read_varint();
+      void skip(size_t count);
+      void read_section(size_t index, size_t depth);
+      void read_entry(size_t index, size_t depth);
+      void read_array(size_t index, uint8_t type, size_t depth);
+
+      static size_t read_varint(const uint8_t*& ptr);
+      static size_t get_pod_size(uint8_t type);
+      template<class t_pod_type, class t_value>
+      static const uint8_t* read_pod(const uint8_t* ptr, t_value& target);
+      static const uint8_t* read_string(const uint8_t* ptr, std::string& target);
+      template<class t_value>
+      static const uint8_t* read_string(const uint8_t* ptr, t_value& target);
+      template<class t_value>
+      static const uint8_t* read_value(uint8_t type, const uint8_t* ptr, t_value& target);
+
+      const entry_ref* find_entry(const std::string& name, hsection psection) const;
+
+      std::vector<section_ref> m_sections;
+      std::vector<entry_ref> m_entries;
+      std::deque<array_cursor> m_cursors;
+      const uint8_t* m_ptr = nullptr;
+      const uint8_t* m_end = nullptr;
+    };
+
+    //---------------------------------------------------------------------------------------------------------------
+    // Opt-in for structs that are loaded through portable_storage_view rather
+    // than portable_storage. Specialize for the request/response types whose
+    // whole KV map (including any custom _load) works on a generic storage.
+    template<class t_struct>
+    struct load_from_binary_view: std::false_type {};
+
+    template<class t_struct>
+    using binary_storage_t = typename std::conditional<load_from_binary_view<t_struct>::value, portable_storage_view, portable_storage>::type;
+
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_view::load_from_binary(const epee::span<const uint8_t> source)
+    {
+      m_sections.clear();
+      m_entries.clear();
+      m_cursors.clear();
+
+      static constexpr const size_t header_size = 9; // packed storage_block_header
+      if(source.size() < header_size)
+      {
+        LOG_ERROR("portable_storage: wrong binary format, packet size = " << source.size() << " less than expected sizeof(storage_block_header)=" << header_size);
+        return false;
+      }
+      uint32_t signature_a, signature_b;
+      memcpy(&signature_a, source.data(), sizeof(signature_a));
+      memcpy(&signature_b, source.data() + sizeof(signature_a), sizeof(signature_b));
+      const uint8_t ver = source.data()[header_size - 1];
+      if(signature_a != SWAP32LE(PORTABLE_STORAGE_SIGNATUREA) ||
+        signature_b != SWAP32LE(PORTABLE_STORAGE_SIGNATUREB))
+      {
+        LOG_ERROR("portable_storage: wrong binary format - signature mismatch");
+        return false;
+      }
+      if(ver != PORTABLE_STORAGE_FORMAT_VER)
+      {
+        LOG_ERROR("portable_storage: wrong binary format - unknown format ver = " << ver);
+        return false;
+      }
+      TRY_ENTRY();
+      m_ptr = source.data() + header_size;
+      m_end = source.data() + source.size();
+      CHECK_AND_ASSERT_THROW_MES(m_ptr != m_end, "throwable_buffer_reader: sz==0");
+      m_sections.resize(1);
+      read_section(0, 0);
+      return true;
+      CATCH_ENTRY("portable_storage_view::load_from_binary", false);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_view::read_varint()
+    {
+      CHECK_AND_ASSERT_THROW_MES(m_ptr != m_end, "empty buff, expected place for varint");
+      const size_t bytes = size_t(1) << (*m_ptr & PORTABLE_RAW_SIZE_MARK_MASK);
+      CHECK_AND_ASSERT_THROW_MES(size_t(m_end - m_ptr) >= bytes, " attempt to read " << bytes << " bytes from buffer with " << (m_end - m_ptr) << " bytes remained");
+      return read_varint(m_ptr);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::skip(size_t count)
+    {
+      CHECK_AND_ASSERT_THROW_MES(size_t(m_end - m_ptr) >= count, " attempt to read " << count << " bytes from buffer with " << (m_end - m_ptr) << " bytes remained");
+      m_ptr += count;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::read_section(size_t index, size_t depth)
+    {
+      CHECK_AND_ASSERT_THROW_MES(depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+      const size_t count = read_varint();
+      // every entry takes at least a name length and a type byte
+      CHECK_AND_ASSERT_THROW_MES(count <= size_t(m_end - m_ptr) / 2, "Size sanity check failed");
+      // entries of a section are contiguous, nested sections get theirs after
+      const size_t first = m_entries.size();
+      m_entries.resize(first + count);
+      m_sections[index] = {first, count};
+      for(size_t i = 0; i < count; ++i)
+        read_entry(first + i, depth);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::read_entry(size_t index, size_t depth)
+    {
+      skip(1);
+      const size_t name_size = m_ptr[-1];
+      skip(name_size);
+      m_entries[index].name = reinterpret_cast<const char*>(m_ptr - name_size);
+      m_entries[index].name_size = name_size;
+      m_entries[index].raw = m_ptr;
+
+      skip(1);
+      uint8_t type = m_ptr[-1];
+      if(type == SERIALIZE_TYPE_ARRAY)
+      {
+        // a single entry holding an array
+        skip(1);
+        type = m_ptr[-1];
+        CHECK_AND_ASSERT_THROW_MES(type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+      }
+      if(type & SERIALIZE_FLAG_ARRAY)
+      {
+        read_array(index, type & ~SERIALIZE_FLAG_ARRAY, depth);
+        return;
+      }
+
+      m_entries[index].type = type;
+      m_entries[index].data = m_ptr;
+      m_entries[index].count = 0;
+      m_entries[index].index = 0;
+      switch(type)
+      {
+      case SERIALIZE_TYPE_STRING:
+        {
+          const size_t len = read_varint();
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          CHECK_AND_ASSERT_THROW_MES(size_t(m_end - m_ptr) >= len, "string len count value " << len << " goes out of remain storage len " << (m_end - m_ptr));
+          m_ptr += len;
+        }
+        break;
+      case SERIALIZE_TYPE_OBJECT:
+        {
+          const size_t section = m_sections.size();
+          m_sections.emplace_back();
+          m_entries[index].index = section;
+          read_section(section, depth + 1);
+        }
+        break;
+      default:
+        skip(get_pod_size(type));
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_view::read_array(size_t index, uint8_t type, size_t depth)
+    {
+      const size_t count = read_varint();
+      CHECK_AND_ASSERT_THROW_MES(count <= size_t(m_end - m_ptr), "Size sanity check failed");
+      m_entries[index].type = type | SERIALIZE_FLAG_ARRAY;
+      m_entries[index].data = m_ptr;
+      m_entries[index].count = count;
+      m_entries[index].index = 0;
+      switch(type)
+      {
+      case SERIALIZE_TYPE_STRING:
+        for(size_t i = 0; i < count; ++i)
+        {
+          const size_t len = read_varint();
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          CHECK_AND_ASSERT_THROW_MES(size_t(m_end - m_ptr) >= len, "string len count value " << len << " goes out of remain storage len " << (m_end - m_ptr));
+          m_ptr += len;
+        }
+        break;
+      case SERIALIZE_TYPE_OBJECT:
+        {
+          // elements are contiguous so a cursor can step through them
+          const size_t first = m_sections.size();
+          m_sections.resize(first + count);
+          m_entries[index].index = first;
+          for(size_t i = 0; i < count; ++i)
+            read_section(first + i, depth + 1);
+        }
+        break;
+      case SERIALIZE_TYPE_ARRAY:
+        CHECK_AND_ASSERT_THROW_MES(count == 0, "Reading array entry is not supported");
+        break;
+      default:
+        {
+          const size_t size = get_pod_size(type);
+          CHECK_AND_ASSERT_THROW_MES(count <= size_t(m_end - m_ptr) / size, " attempt to read " << count << " values from buffer with " << (m_end - m_ptr) << " bytes remained");
+          m_ptr += count * size;
+        }
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_view::read_varint(const uint8_t*& ptr)
+    {
+      size_t v = 0;
+      switch(*ptr & PORTABLE_RAW_SIZE_MARK_MASK)
+      {
+      case PORTABLE_RAW_SIZE_MARK_BYTE: { uint8_t t; ptr = read_pod<uint8_t>(ptr, t); v = t; break; }
+      case PORTABLE_RAW_SIZE_MARK_WORD: { uint16_t t; ptr = read_pod<uint16_t>(ptr, t); v = t; break; }
+      case PORTABLE_RAW_SIZE_MARK_DWORD: { uint32_t t; ptr = read_pod<uint32_t>(ptr, t); v = t; break; }
+      default: { uint64_t t; ptr = read_pod<uint64_t>(ptr, t); v = t; break; }
+      }
+      return v >> 2;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_view::get_pod_size(uint8_t type)
+    {
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:
+      case SERIALIZE_TYPE_UINT64:
+      case SERIALIZE_TYPE_DUOBLE: return 8;
+      case SERIALIZE_TYPE_INT32:
+      case SERIALIZE_TYPE_UINT32: return 4;
+      case SERIALIZE_TYPE_INT16:
+      case SERIALIZE_TYPE_UINT16: return 2;
+      case SERIALIZE_TYPE_INT8:
+      case SERIALIZE_TYPE_UINT8:
+      case SERIALIZE_TYPE_BOOL: return 1;
+      default:
+        ASSERT_MES_AND_THROW("unknown entry_type code = " << (unsigned)type);
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_pod_type, class t_value>
+    const uint8_t* portable_storage_view::read_pod(const uint8_t* ptr, t_value& target)
+    {
+      t_pod_type v;
+      memcpy(&v, ptr, sizeof(v));
+      v = CONVERT_POD(v);
+      convert_t(v, target);
+      return ptr + sizeof(v);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const uint8_t* portable_storage_view::read_string(const uint8_t* ptr, std::string& target)
+    {
+      const size_t len = read_varint(ptr);
+      target.assign(reinterpret_cast<const char*>(ptr), len);
+      return ptr + len;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    const uint8_t* portable_storage_view::read_string(const uint8_t* ptr, t_value& target)
+    {
+      std::string str;
+      ptr = read_string(ptr, str);
+      convert_t(str, target);
+      return ptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    const uint8_t* portable_storage_view::read_value(uint8_t type, const uint8_t* ptr, t_value& target)
+    {
+      // bounds were checked when the blob was indexed
+      switch(type)
+      {
+      case SERIALIZE_TYPE_INT64:  return read_pod<int64_t>(ptr, target);
+      case SERIALIZE_TYPE_INT32:  return read_pod<int32_t>(ptr, target);
+      case SERIALIZE_TYPE_INT16:  return read_pod<int16_t>(ptr, target);
+      case SERIALIZE_TYPE_INT8:   return read_pod<int8_t>(ptr, target);
+      case SERIALIZE_TYPE_UINT64: return read_pod<uint64_t>(ptr, target);
+      case SERIALIZE_TYPE_UINT32: return read_pod<uint32_t>(ptr, target);
+      case SERIALIZE_TYPE_UINT16: return read_pod<uint16_t>(ptr, target);
+      case SERIALIZE_TYPE_UINT8:  return read_pod<uint8_t>(ptr, target);
+      case SERIALIZE_TYPE_DUOBLE: return read_pod<double>(ptr, target);
+      case SERIALIZE_TYPE_BOOL:   return read_pod<bool>(ptr, target);
+      case SERIALIZE_TYPE_STRING: return read_string(ptr, target);
+      default:
+        ASSERT_MES_AND_THROW("WRONG DATA CONVERSION: from entry type=" << (unsigned)type << " to type " << typeid(t_value).name());
+      }
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    const portable_storage_view::entry_ref* portable_storage_view::find_entry(const std::string& name, hsection psection) const
+    {
+      CHECK_AND_ASSERT(!m_sections.empty(), nullptr);
+      if(!psection)
+        psection = const_cast<section_ref*>(&m_sections[0]);
+      // the first entry of a given name wins, as with portable_storage
+      for(size_t i = psection->first; i < psection->first + psection->count; ++i)
+      {
+        const entry_ref& e = m_entries[i];
+        if(e.name_size == name.size() && !memcmp(e.name, name.data(), e.name_size))
+          return &e;
+      }
+      return nullptr;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_view::hsection portable_storage_view::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      CHECK_AND_ASSERT_MES(!create_if_notexist, nullptr, "portable_storage_view is read only");
+      const entry_ref* pentry = find_entry(section_name, hparent_section);
+      if(!pentry || pentry->type != SERIALIZE_TYPE_OBJECT)
+        return nullptr;
+      return &m_sections[pentry->index];
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_view::get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+    {
+      const entry_ref* pentry = find_entry(value_name, hparent_section);
+      if(!pentry)
+        return false;
+      read_value(pentry->type, pentry->data, val);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_view::get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+    {
+      const entry_ref* pentry = find_entry(value_name, hparent_section);
+      if(!pentry)
+        return false;
+      throwable_buffer_reader reader(pentry->raw, m_end - pentry->raw);
+      val = reader.load_storage_entry();
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_view::harray portable_storage_view::get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+    {
+      const entry_ref* pentry = find_entry(value_name, hparent_section);
+      if(!pentry || !(pentry->type & SERIALIZE_FLAG_ARRAY) || !pentry->count)
+        return nullptr;
+      m_cursors.push_back({uint8_t(pentry->type & ~SERIALIZE_FLAG_ARRAY), pentry->data, pentry->count, pentry->index});
+      array_cursor& cursor = m_cursors.back();
+      if(!get_next_value(&cursor, target))
+        return nullptr;
+      return &cursor;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_view::get_next_value(harray hval_array, t_value& target)
+    {
+      CHECK_AND_ASSERT(hval_array, false);
+      if(!hval_array->left)
+        return false;
+      hval_array->ptr = read_value(hval_array->type, hval_array->ptr, target);
+      --hval_array->left;
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_view::harray portable_storage_view::get_first_section(const std::string& section_name, hsection& h_child_section, hsection hparent_section)
+    {
+      const entry_ref* pentry = find_entry(section_name, hparent_section);
+      if(!pentry || pentry->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || !pentry->count)
+        return nullptr;
+      m_cursors.push_back({SERIALIZE_TYPE_OBJECT, pentry->data, pentry->count, pentry->index});
+      array_cursor& cursor = m_cursors.back();
+      if(!get_next_section(&cursor, h_child_section))
+        return nullptr;
+      return &cursor;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_view::get_next_section(harray hsec_array, hsection& h_child_section)
+    {
+      CHECK_AND_ASSERT(hsec_array, false);
+      if(hsec_array->type != SERIALIZE_TYPE_OBJECT || !hsec_array->left)
+        return false;
+      h_child_section = &m_sections[hsec_array->section++];
+      --hsec_array->left;
+      return true;
+    }
+  }
+}
@@ -0,0 +1,281 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <deque>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+#include "portable_storage_bin_utils.h"
+#include "portable_storage_to_bin.h"
+
+#undef BITTUBE_DEFAULT_LOG_CATEGORY
+#define BITTUBE_DEFAULT_LOG_CATEGORY "serialization"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Write only storage that packs a KV_SERIALIZE struct straight into    */
+    /* the binary portable_storage format. The struct is stored twice: the  */
+    /* first pass only counts entries and bytes, so the second one can      */
+    /* write into a buffer of exactly the right size.                       */
+    /************************************************************************/
+    class portable_storage_writer
+    {
+    public:
+      struct section_ref { size_t index; };
+      struct array_ref { size_t index; };
+
+      typedef section_ref* hsection;
+      typedef array_ref* harray;
+      typedef storage_entry meta_entry;
+
+      portable_storage_writer();
+
+      // switches from the sizing pass to the writing pass
+      void start_output(std::string& target);
+      // true if the writing pass produced what the sizing pass predicted
+      bool finish() const;
+      // size of the output, valid between the two passes
+      size_t size() const;
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false);
+      template<class t_value>
+      bool set_value(const std::string& value_name, const t_value& v, hsection hparent_section);
+      bool set_value(const std::string& value_name, const storage_entry& v, hsection hparent_section);
+
+      template<class t_value>
+      harray insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section);
+      template<class t_value>
+      bool insert_next_value(harray hval_array, const t_value& target);
+      harray insert_first_section(const std::string& section_name, hsection& hinserted_childsection, hsection hparent_section);
+      bool insert_next_section(harray hsec_array, hsection& hinserted_childsection);
+
+      // stream interface for the pack_* helpers
+      void write(const char* data, size_t size);
+
+    private:
+      void add_entry(const std::string& name, hsection hparent_section);
+      size_t add_count();
+
+      static uint8_t get_type(const uint64_t&) { return SERIALIZE_TYPE_UINT64; }
+      static uint8_t get_type(const uint32_t&) { return SERIALIZE_TYPE_UINT32; }
+      static uint8_t get_type(const uint16_t&) { return SERIALIZE_TYPE_UINT16; }
+      static uint8_t get_type(const uint8_t&)  { return SERIALIZE_TYPE_UINT8; }
+      static uint8_t get_type(const int64_t&)  { return SERIALIZE_TYPE_INT64; }
+      static uint8_t get_type(const int32_t&)  { return SERIALIZE_TYPE_INT32; }
+      static uint8_t get_type(const int16_t&)  { return SERIALIZE_TYPE_INT16; }
+      static uint8_t get_type(const int8_t&)   { return SERIALIZE_TYPE_INT8; }
+      static uint8_t get_type(const double&)   { return SERIALIZE_TYPE_DUOBLE; }
+      static uint8_t get_type(const bool&)     { return SERIALIZE_TYPE_BOOL; }
+      static uint8_t get_type(const std::string&) { return SERIALIZE_TYPE_STRING; }
+
+      template<class t_value>
+      void write_element(const t_value& v);
+      void write_element(const std::string& v) { put_string(*this, v); }
+
+      std::string* m_target;
+      size_t m_size;
+      // entries in each section and elements in each array, in the order
+      // they are opened; both passes open them in the same order
+      std::vector<size_t> m_counts;
+      size_t m_next_count;
+      std::deque<section_ref> m_sections;
+      std::deque<array_ref> m_arrays;
+    };
+
+    //---------------------------------------------------------------------------------------------------------------
+    // Opt-in for structs that are stored through portable_storage_writer
+    // rather than portable_storage, see load_from_binary_view.
+    template<class t_struct>
+    struct store_to_binary_writer: std::false_type {};
+
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::portable_storage_writer():
+      m_target(nullptr), m_size(0), m_counts(1, 0), m_next_count(1)
+    {
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_writer::size() const
+    {
+      // the header, and a varint for every count
+      size_t size = m_size + 9;
+      for(size_t count: m_counts)
+        size += count <= 63 ? 1 : count <= 16383 ? 2 : count <= 1073741823 ? 4 : 8;
+      return size;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_writer::start_output(std::string& target)
+    {
+      CHECK_AND_ASSERT_THROW_MES(!m_target, "portable_storage_writer: output already started");
+      m_size = size();
+      m_target = std::addressof(target);
+      m_target->clear();
+      m_target->reserve(m_size);
+      m_next_count = 1;
+      m_sections.clear();
+      m_arrays.clear();
+
+      const uint32_t signature_a = SWAP32LE(PORTABLE_STORAGE_SIGNATUREA);
+      const uint32_t signature_b = SWAP32LE(PORTABLE_STORAGE_SIGNATUREB);
+      const uint8_t ver = PORTABLE_STORAGE_FORMAT_VER;
+      write((const char*)&signature_a, sizeof(signature_a));
+      write((const char*)&signature_b, sizeof(signature_b));
+      write((const char*)&ver, sizeof(ver));
+      pack_varint(*this, m_counts[0]);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::finish() const
+    {
+      return m_target && m_target->size() == m_size && m_next_count == m_counts.size();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_writer::write(const char* data, size_t size)
+    {
+      if(m_target)
+        m_target->append(data, size);
+      else
+        m_size += size;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    void portable_storage_writer::add_entry(const std::string& name, hsection hparent_section)
+    {
+      CHECK_AND_ASSERT_THROW_MES(name.size() < std::numeric_limits<uint8_t>::max(), "storage_entry_name is too long: " << name.size() << ", val: " << name);
+      if(!m_target)
+        ++m_counts[hparent_section ? hparent_section->index : 0];
+      const uint8_t len = static_cast<uint8_t>(name.size());
+      write((const char*)&len, sizeof(len));
+      write(name.data(), name.size());
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    size_t portable_storage_writer::add_count()
+    {
+      if(!m_target)
+      {
+        m_counts.push_back(0);
+        return m_counts.size() - 1;
+      }
+      CHECK_AND_ASSERT_THROW_MES(m_next_count < m_counts.size(), "portable_storage_writer: struct changed between passes");
+      pack_varint(*this, m_counts[m_next_count]);
+      return m_next_count++;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::hsection portable_storage_writer::open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist)
+    {
+      CHECK_AND_ASSERT_MES(create_if_notexist, nullptr, "portable_storage_writer is write only");
+      add_entry(section_name, hparent_section);
+      const uint8_t type = SERIALIZE_TYPE_OBJECT;
+      write((const char*)&type, 1);
+      m_sections.push_back({add_count()});
+      return &m_sections.back();
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    void portable_storage_writer::write_element(const t_value& v)
+    {
+      const t_value v0 = CONVERT_POD(v);
+      write((const char*)&v0, sizeof(v0));
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_writer::set_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+    {
+      add_entry(value_name, hparent_section);
+      const uint8_t type = get_type(v);
+      write((const char*)&type, 1);
+      write_element(v);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::set_value(const std::string& value_name, const storage_entry& v, hsection hparent_section)
+    {
+      add_entry(value_name, hparent_section);
+      return pack_entry_to_buff(*this, v);
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    portable_storage_writer::harray portable_storage_writer::insert_first_value(const std::string& value_name, const t_value& target, hsection hparent_section)
+    {
+      add_entry(value_name, hparent_section);
+      const uint8_t type = get_type(target) | SERIALIZE_FLAG_ARRAY;
+      write((const char*)&type, 1);
+      m_arrays.push_back({add_count()});
+      harray hval_array = &m_arrays.back();
+      insert_next_value(hval_array, target);
+      return hval_array;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    template<class t_value>
+    bool portable_storage_writer::insert_next_value(harray hval_array, const t_value& target)
+    {
+      CHECK_AND_ASSERT(hval_array, false);
+      if(!m_target)
+        ++m_counts[hval_array->index];
+      write_element(target);
+      return true;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    portable_storage_writer::harray portable_storage_writer::insert_first_section(const std::string& section_name, hsection& hinserted_childsection, hsection hparent_section)
+    {
+      add_entry(section_name, hparent_section);
+      const uint8_t type = SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY;
+      write((const char*)&type, 1);
+      m_arrays.push_back({add_count()});
+      harray hsec_array = &m_arrays.back();
+      insert_next_section(hsec_array, hinserted_childsection);
+      return hsec_array;
+    }
+    //---------------------------------------------------------------------------------------------------------------
+    inline
+    bool portable_storage_writer::insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+    {
+      CHECK_AND_ASSERT(hsec_array, false);
+      if(!m_target)
+        ++m_counts[hsec_array->index];
+      m_sections.push_back({add_count()});
+      hinserted_childsection = &m_sections.back();
+      return true;
+    }
+  }
+}
@@ -26,15 +26,61 @@
 
 
 #pragma once
+#include <string>
 extern "C" { 
-#include "zlib/zlib.h"
+#include <zlib.h>
 }
-#pragma comment(lib, "zlibstat.lib")
+#include "misc_log_ex.h"
 
 namespace epee 
 {
 namespace zlib_helper
 {
+	//! Deflates `size` bytes at `data` into `out` as a zlib stream.
+	inline bool compress(const void* data, size_t size, std::string& out)
+	{
+		uLongf out_size = compressBound(size);
+		out.resize(out_size);
+		if(compress2((Bytef*)&out[0], &out_size, (const Bytef*)data, size, Z_DEFAULT_COMPRESSION) != Z_OK)
+			return false;
+		out.resize(out_size);
+		return true;
+	}
+
+	//! Inflates the zlib stream at `data` into `out`, failing if it would exceed `max_size` bytes.
+	inline bool uncompress(const void* data, size_t size, std::string& out, size_t max_size)
+	{
+		z_stream zstream = {0};
+		if(inflateInit(&zstream) != Z_OK)
+			return false;
+
+		zstream.next_in = (Bytef*)data;
+		zstream.avail_in = (uInt)size;
+		out.clear();
+
+		char chunk[16 * 1024];
+		int ret = Z_OK;
+		while(ret != Z_STREAM_END)
+		{
+			zstream.next_out = (Bytef*)chunk;
+			zstream.avail_out = sizeof(chunk);
+			ret = inflate(&zstream, Z_NO_FLUSH);
+			// Z_BUF_ERROR here means the stream is truncated
+			const size_t produced = sizeof(chunk) - zstream.avail_out;
+			if((ret != Z_OK && ret != Z_STREAM_END) || produced > max_size - out.size())
+			{
+				inflateEnd(&zstream);
+				return false;
+			}
+			out.append(chunk, produced);
+		}
+
+		// trailing bytes after the stream are not allowed
+		const bool consumed = zstream.avail_in == 0;
+		inflateEnd(&zstream);
+		return consumed;
+	}
+
 	inline 
 	bool pack(std::string& target){
 		std::string result_packed_buff;
@@ -94,5 +94,34 @@ void buffer::append(const void *data, size_t sz)
   NET_BUFFER_LOG("storage now " << offset << "/" << storage.size() << "/" << storage.capacity());
 }
 
+void buffer::reserve(size_t sz)
+{
+  const size_t capacity = storage.capacity();
+
+  CHECK_AND_ASSERT_THROW_MES(size() < std::numeric_limits<size_t>::max() - sz, "Too much data to reserve");
+
+  if (sz <= capacity - storage.size())
+    return;
+
+  if (size() + sz <= capacity)
+  {
+    const size_t bytes = storage.size() - offset;
+    NET_BUFFER_LOG("reserving " << sz << " from " << size() << " by moving " << bytes << " from offset " << offset);
+    memmove(storage.data(), storage.data() + offset, bytes);
+    storage.resize(bytes);
+    offset = 0;
+    return;
+  }
+
+  NET_BUFFER_LOG("reserving " << sz << " from " << size() << " by reallocating");
+  std::vector<uint8_t> new_storage;
+  new_storage.reserve(size() + sz);
+  new_storage.resize(size());
+  if (size() > 0)
+    memcpy(new_storage.data(), storage.data() + offset, storage.size() - offset);
+  offset = 0;
+  std::swap(storage, new_storage);
+}
+
 }
 }
@@ -206,4 +206,12 @@ namespace epee
       return {};
     return {storage_.get(), {portion_.begin() + begin, end - begin}};
   }
+
+  std::size_t get_total_size(const std::vector<byte_slice>& chain) noexcept
+  {
+    std::size_t size = 0;
+    for (const byte_slice& part : chain)
+      size += part.size();
+    return size;
+  }
 } // epee
@@ -137,6 +137,7 @@ connection_basic::connection_basic(boost::asio::ip::tcp::socket&& sock, std::sha
 	socket_(GET_IO_SERVICE(sock), get_context(m_state.get())),
 	m_want_close_connection(false),
 	m_was_shutdown(false),
+	m_send_que_priority_end(0),
 	m_is_multithreaded(false),
 	m_ssl_support(ssl_support)
 {
@@ -162,6 +163,7 @@ connection_basic::connection_basic(boost::asio::io_service &io_service, std::sha
 	socket_(io_service, get_context(m_state.get())),
 	m_want_close_connection(false),
 	m_was_shutdown(false),
+	m_send_que_priority_end(0),
 	m_is_multithreaded(false),
 	m_ssl_support(ssl_support)
 {
@@ -186,18 +188,14 @@ connection_basic::~connection_basic() noexcept(false) {
 }
 
 void connection_basic::set_rate_up_limit(uint64_t limit) {
-	{
-		CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-		network_throttle_manager::get_global_throttle_out().set_target_speed(limit);
-	}
+	MINFO("Setting LIMIT: " << limit << " kbps");
+	network_throttle_manager::get_global_bucket_out().set_rate(limit * 1024);
 	save_limit_to_file(limit);
 }
 
 void connection_basic::set_rate_down_limit(uint64_t limit) {
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_in );
-		network_throttle_manager::get_global_throttle_in().set_target_speed(limit);
-	}
+	MINFO("Setting LIMIT: " << limit << " kbps");
+	network_throttle_manager::get_global_bucket_in().set_rate(limit * 1024);
 
 	{
 	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_inreq );
@@ -207,21 +205,11 @@ void connection_basic::set_rate_down_limit(uint64_t limit) {
 }
 
 uint64_t connection_basic::get_rate_up_limit() {
-    uint64_t limit;
-    {
-         CRITICAL_REGION_LOCAL( network_throttle_manager::m_lock_get_global_throttle_out );
-         limit = network_throttle_manager::get_global_throttle_out().get_target_speed();
-	}
-    return limit;
+    return network_throttle_manager::get_global_bucket_out().get_rate() / 1024;
 }
 
 uint64_t connection_basic::get_rate_down_limit() {
-    uint64_t limit;
-    {
-         CRITICAL_REGION_LOCAL( network_throttle_manager::m_lock_get_global_throttle_in );
-         limit = network_throttle_manager::get_global_throttle_in().get_target_speed();
-	}
-    return limit;
+    return network_throttle_manager::get_global_bucket_in().get_rate() / 1024;
 }
 
 void connection_basic::save_limit_to_file(int limit) {
@@ -235,34 +223,20 @@ int connection_basic::get_tos_flag() {
 	return connection_basic_pimpl::m_default_tos;
 }
 
-void connection_basic::sleep_before_packet(size_t packet_size, int phase,  int q_len) {
-	double delay=0; // will be calculated
-	do
-	{ // rate limiting
-		if (m_was_shutdown) { 
-			_dbg2("m_was_shutdown - so abort sleep");
-			return;
-		}
-
-		{ 
-			CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-			delay = network_throttle_manager::get_global_throttle_out().get_sleep_time_after_tick( packet_size );
-		}
-
-		delay *= 0.50;
-		if (delay > 0) {
-            long int ms = (long int)(delay * 1000);
-			MTRACE("Sleeping in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
-			boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
-		}
-	} while(delay > 0);
-
-// XXX LATER XXX
-	{
-	  CRITICAL_REGION_LOCAL(	network_throttle_manager::m_lock_get_global_throttle_out );
-		network_throttle_manager::get_global_throttle_out().handle_trafic_exact( packet_size ); // increase counter - global
+double connection_basic::sleep_before_packet(size_t packet_size, int phase,  int q_len) {
+	// rate limiting: the bucket is charged first, then we wait off any debt
+	const double delay = network_throttle_manager::get_global_bucket_out().consume( packet_size );
+	if (m_was_shutdown) { 
+		_dbg2("m_was_shutdown - so abort sleep");
+		return 0;
 	}
-
+	if (delay > 0) {
+		long int ms = (long int)(delay * 1000);
+		MTRACE("Sleeping in " << __FUNCTION__ << " for " << ms << " ms before packet_size="<<packet_size); // debug sleep
+		boost::this_thread::sleep(boost::posix_time::milliseconds( ms ) );
+		return delay;
+	}
+	return 0;
 }
 
 void connection_basic::do_send_handler_write(const void* ptr , size_t cb ) {
@@ -281,12 +255,6 @@ void connection_basic::logger_handle_net_read(size_t size) { // network data rea
 void connection_basic::logger_handle_net_write(size_t size) {
 }
 
-double connection_basic::get_sleep_time(size_t cb) {
-	CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::network_throttle_manager::m_lock_get_global_throttle_out);
-    auto t = network_throttle_manager::get_global_throttle_out().get_sleep_time(cb);
-    return t;
-}
-
 
 } // namespace
 } // namespace
@@ -0,0 +1,180 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+
+#include "net/connection_metrics.h"
+
+namespace
+{
+  struct command_slot
+  {
+    std::atomic<uint64_t> key; // command + 1, 0 while free
+    epee::net_utils::traffic_metrics metrics;
+
+    command_slot() noexcept: key(0) {}
+  };
+
+  command_slot *command_table() noexcept
+  {
+    static command_slot table[epee::net_utils::command_metrics::max_commands];
+    return table;
+  }
+
+  std::size_t bucket_index(uint64_t value) noexcept
+  {
+    std::size_t index = 0;
+    while (value && index < epee::net_utils::histogram::buckets - 1)
+    {
+      value >>= 1;
+      ++index;
+    }
+    return index;
+  }
+}
+
+namespace epee
+{
+namespace net_utils
+{
+  histogram::histogram() noexcept
+    : m_count(0), m_sum(0), m_max(0)
+  {
+    for (std::atomic<uint64_t> &c: m_counts)
+      c.store(0, std::memory_order_relaxed);
+  }
+
+  void histogram::add(uint64_t value) noexcept
+  {
+    m_counts[bucket_index(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = m_max.load(std::memory_order_relaxed);
+    while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed));
+  }
+
+  histogram::snapshot histogram::get() const noexcept
+  {
+    snapshot s;
+    s.count = 0;
+    for (std::size_t i = 0; i < buckets; ++i)
+    {
+      s.counts[i] = m_counts[i].load(std::memory_order_relaxed);
+      s.count += s.counts[i];
+    }
+    s.sum = m_sum.load(std::memory_order_relaxed);
+    s.max = m_max.load(std::memory_order_relaxed);
+    return s;
+  }
+
+  uint64_t histogram::snapshot::percentile(double fraction) const noexcept
+  {
+    if (count == 0)
+      return 0;
+    const uint64_t rank = std::max<uint64_t>(1, uint64_t(fraction * count + 0.5));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < buckets; ++i)
+    {
+      seen += counts[i];
+      if (seen >= rank)
+        return i == 0 ? 0 : std::min(max, (uint64_t(1) << i) - 1);
+    }
+    return max;
+  }
+
+  traffic_metrics::traffic_metrics() noexcept
+    : messages_in(0), bytes_in(0), messages_out(0), bytes_out(0)
+  {
+  }
+
+  void traffic_metrics::received(std::size_t bytes) noexcept
+  {
+    messages_in.fetch_add(1, std::memory_order_relaxed);
+    bytes_in.fetch_add(bytes, std::memory_order_relaxed);
+    size_in.add(bytes);
+  }
+
+  void traffic_metrics::sent(std::size_t bytes) noexcept
+  {
+    messages_out.fetch_add(1, std::memory_order_relaxed);
+    bytes_out.fetch_add(bytes, std::memory_order_relaxed);
+    size_out.add(bytes);
+  }
+
+  connection_metrics::connection_metrics() noexcept
+    : traffic_metrics(), send_queue_bytes(0)
+  {
+  }
+
+  traffic_metrics* command_metrics::add(uint32_t command) noexcept
+  {
+    command_slot *table = command_table();
+    const uint64_t key = uint64_t(command) + 1;
+    // commands are few and mostly consecutive ids, so linear probing from
+    // the id itself rarely goes past the first slot
+    for (std::size_t i = 0; i < max_commands; ++i)
+    {
+      command_slot &slot = table[(command + i) % max_commands];
+      uint64_t current = slot.key.load(std::memory_order_acquire);
+      if (current == 0 && slot.key.compare_exchange_strong(current, key, std::memory_order_acq_rel))
+        return &slot.metrics;
+      if (current == key)
+        return &slot.metrics;
+    }
+    return nullptr;
+  }
+
+  traffic_metrics* command_metrics::get(uint32_t command) noexcept
+  {
+    command_slot *table = command_table();
+    const uint64_t key = uint64_t(command) + 1;
+    // slots are claimed in probe order and never freed, so a free one ends the search
+    for (std::size_t i = 0; i < max_commands; ++i)
+    {
+      command_slot &slot = table[(command + i) % max_commands];
+      const uint64_t current = slot.key.load(std::memory_order_acquire);
+      if (current == key)
+        return &slot.metrics;
+      if (current == 0)
+        return nullptr;
+    }
+    return nullptr;
+  }
+
+  void command_metrics::for_each(const std::function<void(uint32_t, const traffic_metrics&)> &f)
+  {
+    command_slot *table = command_table();
+    for (std::size_t i = 0; i < max_commands; ++i)
+    {
+      const uint64_t key = table[i].key.load(std::memory_order_acquire);
+      if (key)
+        f(uint32_t(key - 1), table[i].metrics);
+    }
+  }
+}
+}
@@ -29,6 +29,7 @@
 #include "net/levin_base.h"
 
 #include "int-util.h"
+#include "zlib_helper.h"
 
 namespace epee
 {
@@ -124,5 +125,15 @@ namespace levin
 
     return byte_slice{std::move(buffer)};
   }
+
+  bool compress_payload(epee::span<const std::uint8_t> payload, std::string& out)
+  {
+    return zlib_helper::compress(payload.data(), payload.size(), out) && out.size() < payload.size();
+  }
+
+  bool decompress_payload(epee::span<const std::uint8_t> payload, std::string& out, const std::size_t max_size)
+  {
+    return zlib_helper::uncompress(payload.data(), payload.size(), out, max_size);
+  }
 } // levin
 } // epee
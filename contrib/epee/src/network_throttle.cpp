@@ -68,28 +68,25 @@ namespace net_utils
 
 // ================================================================================================
 // static:
-boost::mutex network_throttle_manager::m_lock_get_global_throttle_in;
 boost::mutex network_throttle_manager::m_lock_get_global_throttle_inreq;
-boost::mutex network_throttle_manager::m_lock_get_global_throttle_out;
 
 // ================================================================================================
 // methods:
-i_network_throttle & network_throttle_manager::get_global_throttle_in() { 
-	static network_throttle obj_get_global_throttle_in("in/all","<<< global-IN",10);
-	return obj_get_global_throttle_in;
-}
-
-
-
 i_network_throttle & network_throttle_manager::get_global_throttle_inreq() { 
 	static network_throttle obj_get_global_throttle_inreq("inreq/all", "<== global-IN-REQ",10);
 	return obj_get_global_throttle_inreq;
 }
 
 
-i_network_throttle & network_throttle_manager::get_global_throttle_out() { 
-	static network_throttle obj_get_global_throttle_out("out/all", ">>> global-OUT",10);
-	return obj_get_global_throttle_out;
+token_bucket & network_throttle_manager::get_global_bucket_in() {
+	static token_bucket obj_get_global_bucket_in;
+	return obj_get_global_bucket_in;
+}
+
+
+token_bucket & network_throttle_manager::get_global_bucket_out() {
+	static token_bucket obj_get_global_bucket_out;
+	return obj_get_global_bucket_out;
 }
 
 
@@ -0,0 +1,93 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <chrono>
+
+#include "net/token_bucket.h"
+
+namespace
+{
+  int64_t now_ns() noexcept
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+}
+
+namespace epee
+{
+namespace net_utils
+{
+  token_bucket::token_bucket(uint64_t bytes_per_second, double burst_seconds)
+    : m_rate(bytes_per_second),
+      m_empty_at(0),
+      m_burst_ns(int64_t(burst_seconds * 1e9)),
+      m_total_packets(0),
+      m_total_bytes(0)
+  {
+  }
+
+  void token_bucket::set_rate(uint64_t bytes_per_second) noexcept
+  {
+    m_rate = bytes_per_second;
+    m_empty_at = 0; // forgive any debt taken at the old rate
+  }
+
+  double token_bucket::consume(size_t bytes) noexcept
+  {
+    count(bytes);
+    const uint64_t rate = m_rate;
+    if (rate == 0)
+      return 0;
+
+    const int64_t now = now_ns();
+    const int64_t cost = int64_t(double(bytes) * 1e9 / rate);
+    int64_t empty_at = m_empty_at.load(std::memory_order_relaxed);
+    int64_t next;
+    do
+    {
+      // an idle bucket refills up to the burst, never beyond
+      next = std::max(empty_at, now - m_burst_ns) + cost;
+    } while (!m_empty_at.compare_exchange_weak(empty_at, next, std::memory_order_relaxed));
+
+    return next > now ? (next - now) / 1e9 : 0;
+  }
+
+  void token_bucket::count(size_t bytes) noexcept
+  {
+    m_total_packets.fetch_add(1, std::memory_order_relaxed);
+    m_total_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  }
+
+  void token_bucket::get_stats(uint64_t &total_packets, uint64_t &total_bytes) const noexcept
+  {
+    total_packets = m_total_packets;
+    total_bytes = m_total_bytes;
+  }
+}
+}
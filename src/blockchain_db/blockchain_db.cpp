@@ -374,6 +374,59 @@ transaction BlockchainDB::get_pruned_tx(const crypto::hash& h) const
   return tx;
 }
 
+std::vector<uint64_t> BlockchainDB::get_rct_output_distribution(uint64_t start_height, uint64_t end_height) const
+{
+  if (end_height < start_height)
+    return {};
+  std::vector<uint64_t> heights;
+  heights.reserve(end_height - start_height + 1);
+  for (uint64_t h = start_height; h <= end_height; ++h)
+    heights.push_back(h);
+  return get_block_cumulative_rct_outputs(heights);
+}
+
+bool BlockchainDB::get_block_txs(uint64_t height, crypto::hash *miner_tx_hash, std::vector<std::pair<crypto::hash, cryptonote::blobdata>> &txs, std::vector<crypto::hash> *prunable_hashes, bool pruned) const
+{
+  block b;
+  if (!parse_and_validate_block_from_blob(get_block_blob_from_height(height), b))
+    throw DB_ERROR("Failed to parse block from blob retrieved from the db");
+  if (miner_tx_hash)
+    *miner_tx_hash = get_transaction_hash(b.miner_tx);
+
+  txs.clear();
+  txs.reserve(b.tx_hashes.size());
+  if (prunable_hashes)
+  {
+    prunable_hashes->clear();
+    prunable_hashes->reserve(b.tx_hashes.size());
+  }
+  for (const crypto::hash &tx_hash: b.tx_hashes)
+  {
+    txs.push_back(std::make_pair(tx_hash, cryptonote::blobdata()));
+    cryptonote::blobdata &bd = txs.back().second;
+    crypto::hash prunable_hash = crypto::null_hash;
+    if (!(pruned ? get_pruned_tx_blob(tx_hash, bd) : get_tx_blob(tx_hash, bd)))
+      return false;
+    if (pruned && prunable_hashes)
+    {
+      if (is_v1_tx(bd))
+      {
+        cryptonote::blobdata prunable_blob;
+        if (!get_prunable_tx_blob(tx_hash, prunable_blob))
+          return false;
+        bd.append(prunable_blob);
+      }
+      else if (!get_prunable_tx_hash(tx_hash, prunable_hash))
+      {
+        return false;
+      }
+    }
+    if (prunable_hashes)
+      prunable_hashes->push_back(prunable_hash);
+  }
+  return true;
+}
+
 void BlockchainDB::reset_stats()
 {
   num_calls = 0;
@@ -972,6 +972,47 @@ public:
    */
   virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const = 0;
 
+  /**
+   * @brief fetch the cumulative number of rct outputs for a range of blocks
+   *
+   * Returns the same values as get_block_cumulative_rct_outputs for every
+   * height in [start_height, end_height].  Subclasses which keep a dedicated
+   * distribution index should override this to read the range in one pass;
+   * the default implementation forwards to get_block_cumulative_rct_outputs.
+   *
+   * If any block in the range does not exist, the subclass should throw BLOCK_DNE
+   *
+   * @param start_height the first height requested
+   * @param end_height the last height requested (inclusive)
+   *
+   * @return the cumulative number of rct outputs for each height in the range
+   */
+  virtual std::vector<uint64_t> get_rct_output_distribution(uint64_t start_height, uint64_t end_height) const;
+
+  /**
+   * @brief fetch the transactions of a block without parsing the block
+   *
+   * Returns the hashes and blobs of the block's transactions, in the block's
+   * order and without the miner tx.  Subclasses which index the transaction
+   * hashes of each block should override this to read them, and the blobs,
+   * without deserializing anything; the default implementation parses the block.
+   *
+   * If pruned is set, prunable_hashes, if not NULL, receives the prunable data
+   * hash of each transaction, and v1 transactions, which are not pruned, are
+   * returned whole with a null prunable hash.
+   *
+   * If the block does not exist, the subclass should throw BLOCK_DNE
+   *
+   * @param height the height of the block
+   * @param miner_tx_hash if not NULL, return-by-reference the hash of the miner tx
+   * @param txs return-by-reference the hash and blob of each transaction
+   * @param prunable_hashes if not NULL, return-by-reference the prunable data hashes
+   * @param pruned whether to return pruned transaction blobs
+   *
+   * @return false if some transaction data is missing, true otherwise
+   */
+  virtual bool get_block_txs(uint64_t height, crypto::hash *miner_tx_hash, std::vector<std::pair<crypto::hash, cryptonote::blobdata>> &txs, std::vector<crypto::hash> *prunable_hashes, bool pruned) const;
+
   /**
    * @brief fetch the top block's timestamp
    *
@@ -1561,6 +1602,22 @@ public:
    */
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) = 0;
 
+  /**
+   * @brief prunes a bounded number of transactions
+   *
+   * Starts pruning with the given seed if the blockchain is not pruned yet,
+   * or continues a pruning pass in progress.  Progress is persisted, so a
+   * pass survives restarts.  Does nothing if the blockchain is already
+   * pruned and no pass is in progress.
+   *
+   * @param pruning_seed the seed to use if pruning starts, 0 for default (highly recommended)
+   * @param max_txes the maximum number of transactions to look at
+   * @param finished return-by-reference true iff there is no pass left in progress
+   * @param pruned return-by-reference the number of transactions this step pruned
+   * @return success iff true
+   */
+  virtual bool prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, bool &finished, size_t &pruned) = 0;
+
   /**
    * @brief prunes recent blockchain changes as needed, iff pruning is enabled
    * @return success iff true
@@ -1739,6 +1796,10 @@ public:
   /**
    * @brief sets which hardfork version a height is on
    *
+   * HardFork writes this for every block it accepts, so the table stays in
+   * sync with the chain for tools and older daemons. The daemon itself keeps
+   * an in-memory copy rebuilt from block versions, and does not read it back.
+   *
    * @param height the height
    * @param version the version
    */
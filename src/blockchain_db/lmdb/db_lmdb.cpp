@@ -55,7 +55,7 @@ using epee::string_tools::pod_to_hex;
 using namespace crypto;
 
 // Increase when the DB structure changes
-#define VERSION 4
+#define VERSION 6
 
 namespace
 {
@@ -179,6 +179,8 @@ namespace
  * blocks           block ID     block blob
  * block_heights    block hash   block height
  * block_info       block ID     {block metadata}
+ * rct_distribution block ID     cumulative rct output count
+ * block_txs        block ID     {first txn ID, miner txn hash, [txn hashes]}
  *
  * txs_pruned       txn ID       pruned txn blob
  * txs_prunable     txn ID       prunable txn blob
@@ -208,6 +210,8 @@ namespace
 const char* const LMDB_BLOCKS = "blocks";
 const char* const LMDB_BLOCK_HEIGHTS = "block_heights";
 const char* const LMDB_BLOCK_INFO = "block_info";
+const char* const LMDB_RCT_DISTRIBUTION = "rct_distribution";
+const char* const LMDB_BLOCK_TXS = "block_txs";
 
 const char* const LMDB_TXS = "txs";
 const char* const LMDB_TXS_PRUNED = "txs_pruned";
@@ -308,6 +312,24 @@ typedef struct mdb_block_info_3
 
 typedef mdb_block_info_3 mdb_block_info;
 
+typedef struct mdb_rct_distribution
+{
+  uint64_t rd_height;
+  uint64_t rd_cum_rct;
+} mdb_rct_distribution;
+
+// a block_txs record is the id of the miner tx, followed by the hashes of the
+// miner tx and of the block's other txs, whose ids follow on consecutively
+cryptonote::blobdata make_block_txs_blob(uint64_t first_tx_id, const crypto::hash &miner_tx_hash, const std::vector<crypto::hash> &tx_hashes)
+{
+  cryptonote::blobdata blob;
+  blob.reserve(sizeof(first_tx_id) + (1 + tx_hashes.size()) * sizeof(crypto::hash));
+  blob.append((const char*)&first_tx_id, sizeof(first_tx_id));
+  blob.append((const char*)&miner_tx_hash, sizeof(miner_tx_hash));
+  blob.append((const char*)tx_hashes.data(), tx_hashes.size() * sizeof(crypto::hash));
+  return blob;
+}
+
 typedef struct blk_height {
     crypto::hash bh_hash;
     uint64_t bh_height;
@@ -749,6 +771,16 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
 
   CURSOR(blocks)
   CURSOR(block_info)
+  CURSOR(rct_distribution)
+  CURSOR(block_txs)
+
+  // the block's transactions were added just before it, with consecutive ids
+  const uint64_t first_tx_id = get_tx_count() - 1 - blk.tx_hashes.size();
+  cryptonote::blobdata block_txs_blob = make_block_txs_blob(first_tx_id, get_transaction_hash(blk.miner_tx), blk.tx_hashes);
+  MDB_val_sized(val_block_txs, block_txs_blob);
+  result = mdb_cursor_put(m_cur_block_txs, &key, &val_block_txs, MDB_APPEND);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add block txs to db transaction: ", result).c_str()));
 
   // this call to mdb_cursor_put will change height()
   cryptonote::blobdata block_blob(block_to_blob(blk));
@@ -781,6 +813,12 @@ void BlockchainLMDB::add_block(const block& blk, size_t block_weight, uint64_t l
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block info to db transaction: ", result).c_str()));
 
+  mdb_rct_distribution rd = {m_height, bi.bi_cum_rct};
+  MDB_val_set(val_rd, rd);
+  result = mdb_cursor_put(m_cur_rct_distribution, (MDB_val *)&zerokval, &val_rd, MDB_APPENDDUP);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to add rct distribution to db transaction: ", result).c_str()));
+
   result = mdb_cursor_put(m_cur_block_heights, (MDB_val *)&zerokval, &val_h, 0);
   if (result)
     throw0(DB_ERROR(lmdb_error("Failed to add block height by hash to db transaction: ", result).c_str()));
@@ -806,6 +844,8 @@ void BlockchainLMDB::remove_block()
   CURSOR(block_info)
   CURSOR(block_heights)
   CURSOR(blocks)
+  CURSOR(rct_distribution)
+  CURSOR(block_txs)
   MDB_val_copy<uint64_t> k(m_height - 1);
   MDB_val h = k;
   if ((result = mdb_cursor_get(m_cur_block_info, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
@@ -826,6 +866,19 @@ void BlockchainLMDB::remove_block()
 
   if ((result = mdb_cursor_del(m_cur_block_info, 0)))
       throw1(DB_ERROR(lmdb_error("Failed to add removal of block info to db transaction: ", result).c_str()));
+
+  h = k;
+  if ((result = mdb_cursor_get(m_cur_rct_distribution, (MDB_val *)&zerokval, &h, MDB_GET_BOTH)))
+      throw1(DB_ERROR(lmdb_error("Failed to locate rct distribution for removal: ", result).c_str()));
+  if ((result = mdb_cursor_del(m_cur_rct_distribution, 0)))
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of rct distribution to db transaction: ", result).c_str()));
+
+  h = k;
+  MDB_val v;
+  if ((result = mdb_cursor_get(m_cur_block_txs, &h, &v, MDB_SET)))
+      throw1(DB_ERROR(lmdb_error("Failed to locate block txs for removal: ", result).c_str()));
+  if ((result = mdb_cursor_del(m_cur_block_txs, 0)))
+      throw1(DB_ERROR(lmdb_error("Failed to add removal of block txs to db transaction: ", result).c_str()));
 }
 
 uint64_t BlockchainLMDB::add_transaction_data(const crypto::hash& blk_hash, const std::pair<transaction, blobdata>& txp, const crypto::hash& tx_hash, const crypto::hash& tx_prunable_hash)
@@ -1372,6 +1425,8 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   lmdb_db_open(txn, LMDB_BLOCKS, MDB_INTEGERKEY | MDB_CREATE, m_blocks, "Failed to open db handle for m_blocks");
 
   lmdb_db_open(txn, LMDB_BLOCK_INFO, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_block_info, "Failed to open db handle for m_block_info");
+  lmdb_db_open(txn, LMDB_RCT_DISTRIBUTION, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_rct_distribution, "Failed to open db handle for m_rct_distribution");
+  lmdb_db_open(txn, LMDB_BLOCK_TXS, MDB_INTEGERKEY | MDB_CREATE, m_block_txs, "Failed to open db handle for m_block_txs");
   lmdb_db_open(txn, LMDB_BLOCK_HEIGHTS, MDB_INTEGERKEY | MDB_CREATE | MDB_DUPSORT | MDB_DUPFIXED, m_block_heights, "Failed to open db handle for m_block_heights");
 
   lmdb_db_open(txn, LMDB_TXS, MDB_INTEGERKEY | MDB_CREATE, m_txs, "Failed to open db handle for m_txs");
@@ -1409,6 +1464,7 @@ void BlockchainLMDB::open(const std::string& filename, const int db_flags)
   mdb_set_dupsort(txn, m_output_amounts, compare_uint64);
   mdb_set_dupsort(txn, m_output_txs, compare_uint64);
   mdb_set_dupsort(txn, m_block_info, compare_uint64);
+  mdb_set_dupsort(txn, m_rct_distribution, compare_uint64);
   if (!(mdb_flags & MDB_RDONLY))
     mdb_set_dupsort(txn, m_txs_prunable_tip, compare_uint64);
   mdb_set_compare(txn, m_txs_prunable, compare_uint64);
@@ -1564,6 +1620,10 @@ void BlockchainLMDB::reset()
     throw0(DB_ERROR(lmdb_error("Failed to drop m_blocks: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_block_info, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_block_info: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_rct_distribution, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_rct_distribution: ", result).c_str()));
+  if (auto result = mdb_drop(txn, m_block_txs, 0))
+    throw0(DB_ERROR(lmdb_error("Failed to drop m_block_txs: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_block_heights, 0))
     throw0(DB_ERROR(lmdb_error("Failed to drop m_block_heights: ", result).c_str()));
   if (auto result = mdb_drop(txn, m_txs_pruned, 0))
@@ -1959,7 +2019,7 @@ static bool is_v1_tx(MDB_cursor *c_txs_pruned, MDB_val *tx_id)
 
 enum { prune_mode_prune, prune_mode_update, prune_mode_check };
 
-bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
+bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed, size_t max_records, bool *finished, size_t *pruned)
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
   const uint32_t log_stripes = tools::get_pruning_log_stripes(pruning_seed);
@@ -1974,6 +2034,10 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
 
   size_t n_total_records = 0, n_prunable_records = 0, n_pruned_records = 0, commit_counter = 0;
   uint64_t n_bytes = 0;
+  if (finished)
+    *finished = true;
+  if (pruned)
+    *pruned = 0;
 
   mdb_txn_safe txn;
   auto result = mdb_txn_begin(m_env, NULL, 0, txn);
@@ -2008,6 +2072,12 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     if (result)
       throw0(DB_ERROR("Failed to save pruning seed"));
     prune_tip_table = false;
+    // an empty cursor means the full pass starts from the first transaction
+    MDB_val_str(kc, "pruning_cursor");
+    MDB_val vc = {0, NULL};
+    result = mdb_put(txn, m_properties, &kc, &vc, 0);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to save pruning cursor: ", result).c_str()));
   }
   else if (result == 0)
   {
@@ -2023,6 +2093,23 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       throw0(DB_ERROR("Blockchain already pruned with different base"));
     pruning_seed = tools::make_pruning_seed(pruning_seed, CRYPTONOTE_PRUNING_LOG_STRIPES);
     prune_tip_table = (mode == prune_mode_update);
+
+    // a bounded step only continues a pass already in progress
+    if (mode == prune_mode_prune && max_records)
+    {
+      MDB_val_str(kc, "pruning_cursor");
+      MDB_val vc;
+      result = mdb_get(txn, m_properties, &kc, &vc);
+      if (result == MDB_NOTFOUND)
+      {
+        txn.abort();
+        TIME_MEASURE_FINISH(t);
+        MDEBUG("Blockchain already pruned, nothing to do");
+        return true;
+      }
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning cursor: ", result).c_str()));
+    }
   }
   else
   {
@@ -2031,6 +2118,8 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
 
   if (mode == prune_mode_check)
     MINFO("Checking blockchain pruning...");
+  else if (max_records)
+    MDEBUG("Pruning up to " << max_records << " transactions...");
   else
     MINFO("Pruning blockchain...");
 
@@ -2114,12 +2203,55 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
     if (result)
       throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
     MDB_cursor_op op = MDB_FIRST;
+
+    // resume an interrupted or incremental pass after the last transaction it processed
+    MDB_val_str(kc, "pruning_cursor");
+    MDB_val vc;
+    result = mdb_get(txn, m_properties, &kc, &vc);
+    if (result && result != MDB_NOTFOUND)
+      throw0(DB_ERROR(lmdb_error("Failed to retrieve pruning cursor: ", result).c_str()));
+    bool resume_at_end = false;
+    crypto::hash last_txid = crypto::null_hash;
+    if (mode != prune_mode_check && result == 0 && vc.mv_size == sizeof(crypto::hash))
+    {
+      memcpy(&last_txid, vc.mv_data, sizeof(last_txid));
+      MDB_val_set(vr, last_txid);
+      result = mdb_cursor_get(c_tx_indices, (MDB_val*)&zerokval, &vr, MDB_GET_BOTH_RANGE);
+      if (result == MDB_NOTFOUND)
+        resume_at_end = true;
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to restore pruning cursor: ", result).c_str()));
+      else
+        op = memcmp(vr.mv_data, &last_txid, sizeof(last_txid)) ? MDB_GET_CURRENT : MDB_NEXT;
+      MDEBUG("Resuming blockchain pruning after " << last_txid);
+    }
+
     while (1)
     {
-      int ret = mdb_cursor_get(c_tx_indices, &k, &v, op);
+      if (max_records && n_total_records >= max_records)
+      {
+        // out of budget for this step, remember where we are and let the caller come back
+        MDB_val_set(vl, last_txid);
+        result = mdb_put(txn, m_properties, &kc, &vl, 0);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to save pruning cursor: ", result).c_str()));
+        if (finished)
+          *finished = false;
+        break;
+      }
+
+      int ret = resume_at_end ? MDB_NOTFOUND : mdb_cursor_get(c_tx_indices, &k, &v, op);
       op = MDB_NEXT;
       if (ret == MDB_NOTFOUND)
+      {
+        if (mode != prune_mode_check)
+        {
+          result = mdb_del(txn, m_properties, &kc, NULL);
+          if (result && result != MDB_NOTFOUND)
+            throw0(DB_ERROR(lmdb_error("Failed to delete pruning cursor: ", result).c_str()));
+        }
         break;
+      }
       if (ret)
         throw0(DB_ERROR(lmdb_error("Failed to enumerate transactions: ", ret).c_str()));
 
@@ -2127,6 +2259,7 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
       //const txindex *ti = (const txindex *)v.mv_data;
       txindex ti;
       memcpy(&ti, v.mv_data, sizeof(ti));
+      last_txid = ti.key;
       const uint64_t block_height = ti.data.block_id;
       if (block_height + CRYPTONOTE_PRUNING_TIP_BLOCKS >= blockchain_height)
       {
@@ -2235,10 +2368,12 @@ bool BlockchainLMDB::prune_worker(int mode, uint32_t pruning_seed)
 
   TIME_MEASURE_FINISH(t);
 
-  MINFO((mode == prune_mode_check ? "Checked" : "Pruned") << " blockchain in " <<
+  MCLOG(max_records ? el::Level::Debug : el::Level::Info, BITTUBE_DEFAULT_LOG_CATEGORY, el::Color::Default, (mode == prune_mode_check ? "Checked" : "Pruned") << " blockchain in " <<
       t << " ms: " << (n_bytes/1024.0f/1024.0f) << " MB (" << db_bytes/1024.0f/1024.0f << " MB) pruned in " <<
       n_pruned_records << " records (" << pages0 - pages1 << "/" << pages0 << " " << db_stats.ms_psize << " byte pages), " <<
       n_prunable_records << "/" << n_total_records << " pruned records");
+  if (pruned)
+    *pruned = n_pruned_records;
   return true;
 }
 
@@ -2247,6 +2382,11 @@ bool BlockchainLMDB::prune_blockchain(uint32_t pruning_seed)
   return prune_worker(prune_mode_prune, pruning_seed);
 }
 
+bool BlockchainLMDB::prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, bool &finished, size_t &pruned)
+{
+  return prune_worker(prune_mode_prune, pruning_seed, max_txes, &finished, &pruned);
+}
+
 bool BlockchainLMDB::update_pruning()
 {
   return prune_worker(prune_mode_update, 0);
@@ -2532,6 +2672,141 @@ std::vector<uint64_t> BlockchainLMDB::get_block_cumulative_rct_outputs(const std
   return res;
 }
 
+std::vector<uint64_t> BlockchainLMDB::get_rct_output_distribution(uint64_t start_height, uint64_t end_height) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+  std::vector<uint64_t> res;
+  int result;
+
+  if (end_height < start_height)
+    return {};
+  res.reserve(end_height - start_height + 1);
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(rct_distribution);
+
+  // records are fixed size and keyed by height, so each MDB_GET_MULTIPLE or
+  // MDB_NEXT_MULTIPLE hands back a whole page of the index in place
+  MDB_val k, v;
+  v.mv_size = sizeof(uint64_t);
+  v.mv_data = (void*)&start_height;
+  result = mdb_cursor_get(m_cur_rct_distribution, (MDB_val *)&zerokval, &v, MDB_GET_BOTH);
+  if (result == MDB_NOTFOUND)
+    throw0(BLOCK_DNE(std::string("Attempt to get rct distribution from height " + std::to_string(start_height) + " failed -- block not in db").c_str()));
+  else if (result)
+    throw0(DB_ERROR(lmdb_error("Error attempting to retrieve rct distribution from the db: ", result).c_str()));
+
+  MDB_cursor_op op = MDB_GET_MULTIPLE;
+  uint64_t height = start_height;
+  while (height <= end_height)
+  {
+    result = mdb_cursor_get(m_cur_rct_distribution, &k, &v, op);
+    op = MDB_NEXT_MULTIPLE;
+    if (result == MDB_NOTFOUND)
+      throw0(BLOCK_DNE(std::string("Attempt to get rct distribution from height " + std::to_string(height) + " failed -- block not in db").c_str()));
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve rct distribution from the db: ", result).c_str()));
+
+    const mdb_rct_distribution *rd = (const mdb_rct_distribution*)v.mv_data;
+    const size_t n_records = v.mv_size / sizeof(mdb_rct_distribution);
+    const uint64_t range_begin = rd[0].rd_height;
+    const uint64_t range_end = range_begin + n_records;
+    if (height < range_begin || height >= range_end)
+      throw0(DB_ERROR(("Height " + std::to_string(height) + " not included in multiple record range: " + std::to_string(range_begin) + "-" + std::to_string(range_end)).c_str()));
+    for (; height < range_end && height <= end_height; ++height)
+      res.push_back(rd[height - range_begin].rd_cum_rct);
+  }
+
+  TXN_POSTFIX_RDONLY();
+  return res;
+}
+
+bool BlockchainLMDB::get_block_txs(uint64_t height, crypto::hash *miner_tx_hash, std::vector<std::pair<crypto::hash, cryptonote::blobdata>> &txs, std::vector<crypto::hash> *prunable_hashes, bool pruned) const
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  check_open();
+
+  TXN_PREFIX_RDONLY();
+  RCURSOR(block_txs);
+  RCURSOR(txs_pruned);
+  RCURSOR(txs_prunable);
+  RCURSOR(txs_prunable_hash);
+
+  MDB_val_copy<uint64_t> key(height);
+  MDB_val v;
+  int result = mdb_cursor_get(m_cur_block_txs, &key, &v, MDB_SET);
+  if (result == MDB_NOTFOUND)
+    throw0(BLOCK_DNE(std::string("Attempt to get txs of block at height ").append(boost::lexical_cast<std::string>(height)).append(" failed -- block not in db").c_str()));
+  else if (result)
+    throw0(DB_ERROR(lmdb_error("Error attempting to retrieve block txs from the db: ", result).c_str()));
+  if (v.mv_size < sizeof(uint64_t) + sizeof(crypto::hash) || (v.mv_size - sizeof(uint64_t)) % sizeof(crypto::hash))
+    throw0(DB_ERROR("Unexpected block txs record size"));
+
+  uint64_t miner_tx_id;
+  memcpy(&miner_tx_id, v.mv_data, sizeof(miner_tx_id));
+  const crypto::hash *hashes = (const crypto::hash*)((const char*)v.mv_data + sizeof(miner_tx_id));
+  const size_t n_txs = (v.mv_size - sizeof(miner_tx_id)) / sizeof(crypto::hash) - 1;
+  if (miner_tx_hash)
+    *miner_tx_hash = hashes[0];
+
+  txs.clear();
+  txs.reserve(n_txs);
+  if (prunable_hashes)
+  {
+    prunable_hashes->clear();
+    prunable_hashes->reserve(n_txs);
+  }
+
+  // the block's txs have consecutive ids, so their pruned parts are read in key order
+  for (size_t i = 0; i < n_txs; ++i)
+  {
+    uint64_t tx_id = miner_tx_id + 1 + i;
+    MDB_val_set(k, tx_id);
+    MDB_val pruned_blob;
+    result = mdb_cursor_get(m_cur_txs_pruned, &k, &pruned_blob, i ? MDB_NEXT : MDB_SET);
+    if (result == 0 && *(const uint64_t*)k.mv_data != tx_id)
+      result = MDB_NOTFOUND;
+    if (result == MDB_NOTFOUND)
+      return false;
+    else if (result)
+      throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a pruned tx from the db: ", result).c_str()));
+
+    txs.push_back(std::make_pair(hashes[1 + i], cryptonote::blobdata(reinterpret_cast<const char*>(pruned_blob.mv_data), pruned_blob.mv_size)));
+    cryptonote::blobdata &bd = txs.back().second;
+    crypto::hash prunable_hash = crypto::null_hash;
+
+    // v1 txes aren't pruned, so they are sent whole along with a null prunable hash
+    if (!pruned || (prunable_hashes && cryptonote::is_v1_tx(bd)))
+    {
+      MDB_val_set(val_tx_id, tx_id);
+      MDB_val prunable_blob;
+      result = mdb_cursor_get(m_cur_txs_prunable, &val_tx_id, &prunable_blob, MDB_SET);
+      if (result == MDB_NOTFOUND)
+        return false;
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a prunable tx from the db: ", result).c_str()));
+      bd.append(reinterpret_cast<const char*>(prunable_blob.mv_data), prunable_blob.mv_size);
+    }
+    else if (prunable_hashes)
+    {
+      MDB_val_set(val_tx_id, tx_id);
+      MDB_val val_prunable_hash;
+      result = mdb_cursor_get(m_cur_txs_prunable_hash, &val_tx_id, &val_prunable_hash, MDB_SET);
+      if (result == MDB_NOTFOUND)
+        return false;
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Error attempting to retrieve a tx prunable hash from the db: ", result).c_str()));
+      prunable_hash = *(const crypto::hash*)val_prunable_hash.mv_data;
+    }
+    if (prunable_hashes)
+      prunable_hashes->push_back(prunable_hash);
+  }
+
+  TXN_POSTFIX_RDONLY();
+  return true;
+}
+
 uint64_t BlockchainLMDB::get_top_block_timestamp() const
 {
   LOG_PRINT_L3("BlockchainLMDB::" << __func__);
@@ -5309,6 +5584,188 @@ void BlockchainLMDB::migrate_3_4()
   txn.commit();
 }
 
+void BlockchainLMDB::migrate_4_5()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t i;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val k, v;
+
+  MGINFO_YELLOW("Migrating blockchain from DB version 4 to 5 - this may take a while:");
+
+  do {
+    LOG_PRINT_L1("building rct distribution index:");
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    MDB_stat db_stats;
+    if ((result = mdb_stat(txn, m_blocks, &db_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+    const uint64_t blockchain_height = db_stats.ms_entries;
+    txn.commit();
+
+    MDB_cursor *c_info, *c_cur;
+    i = 0;
+    while(1) {
+      if (!(i % 1000)) {
+        if (i) {
+          LOGIF(el::Level::Info) {
+            std::cout << i << " / " << blockchain_height << "  \r" << std::flush;
+          }
+          txn.commit();
+        }
+        result = mdb_txn_begin(m_env, NULL, 0, txn);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_rct_distribution, &c_cur);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for rct_distribution: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_block_info, &c_info);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for block_info: ", result).c_str()));
+        if (!i) {
+          // resume an interrupted migration where it left off
+          result = mdb_stat(txn, m_rct_distribution, &db_stats);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to query m_rct_distribution: ", result).c_str()));
+          i = db_stats.ms_entries;
+        }
+        if (i)
+        {
+          uint64_t resume_height = i - 1;
+          MDB_val_set(vh, resume_height);
+          result = mdb_cursor_get(c_info, (MDB_val *)&zerokval, &vh, MDB_GET_BOTH);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to locate block info to resume from: ", result).c_str()));
+        }
+      }
+      result = mdb_cursor_get(c_info, &k, &v, i ? MDB_NEXT : MDB_FIRST);
+      if (result == MDB_NOTFOUND) {
+        txn.commit();
+        break;
+      }
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from block_info: ", result).c_str()));
+      const mdb_block_info *bi = (const mdb_block_info*)v.mv_data;
+      mdb_rct_distribution rd = {bi->bi_height, bi->bi_cum_rct};
+      MDB_val_set(nv, rd);
+      result = mdb_cursor_put(c_cur, (MDB_val *)&zerokval, &nv, MDB_APPENDDUP);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into rct_distribution: ", result).c_str()));
+      i++;
+    }
+  } while(0);
+
+  uint32_t version = 5;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_str(vk, "version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
+void BlockchainLMDB::migrate_5_6()
+{
+  LOG_PRINT_L3("BlockchainLMDB::" << __func__);
+  uint64_t i;
+  int result;
+  mdb_txn_safe txn(false);
+  MDB_val v;
+
+  MGINFO_YELLOW("Migrating blockchain from DB version 5 to 6 - this may take a while:");
+
+  do {
+    LOG_PRINT_L1("building block txs index:");
+
+    result = mdb_txn_begin(m_env, NULL, 0, txn);
+    if (result)
+      throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+
+    MDB_stat db_stats;
+    if ((result = mdb_stat(txn, m_blocks, &db_stats)))
+      throw0(DB_ERROR(lmdb_error("Failed to query m_blocks: ", result).c_str()));
+    const uint64_t blockchain_height = db_stats.ms_entries;
+    txn.commit();
+
+    MDB_cursor *c_blocks, *c_tx_indices, *c_cur;
+    i = 0;
+    while(1) {
+      if (!(i % 1000)) {
+        if (i) {
+          LOGIF(el::Level::Info) {
+            std::cout << i << " / " << blockchain_height << "  \r" << std::flush;
+          }
+          txn.commit();
+        }
+        result = mdb_txn_begin(m_env, NULL, 0, txn);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_block_txs, &c_cur);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for block_txs: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_blocks, &c_blocks);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for blocks: ", result).c_str()));
+        result = mdb_cursor_open(txn, m_tx_indices, &c_tx_indices);
+        if (result)
+          throw0(DB_ERROR(lmdb_error("Failed to open a cursor for tx_indices: ", result).c_str()));
+        if (!i) {
+          // resume an interrupted migration where it left off
+          result = mdb_stat(txn, m_block_txs, &db_stats);
+          if (result)
+            throw0(DB_ERROR(lmdb_error("Failed to query m_block_txs: ", result).c_str()));
+          i = db_stats.ms_entries;
+        }
+      }
+      MDB_val_set(k, i);
+      result = mdb_cursor_get(c_blocks, &k, &v, MDB_SET);
+      if (result == MDB_NOTFOUND) {
+        txn.commit();
+        break;
+      }
+      else if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get a record from blocks: ", result).c_str()));
+
+      cryptonote::block b;
+      if (!cryptonote::parse_and_validate_block_from_blob(cryptonote::blobdata(reinterpret_cast<const char*>(v.mv_data), v.mv_size), b))
+        throw0(DB_ERROR(("Failed to parse block at height " + std::to_string(i)).c_str()));
+      const crypto::hash miner_tx_hash = cryptonote::get_transaction_hash(b.miner_tx);
+      MDB_val_set(val_h, miner_tx_hash);
+      result = mdb_cursor_get(c_tx_indices, (MDB_val *)&zerokval, &val_h, MDB_GET_BOTH);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to get miner tx index: ", result).c_str()));
+      const txindex *ti = (const txindex *)val_h.mv_data;
+
+      cryptonote::blobdata block_txs_blob = make_block_txs_blob(ti->data.tx_id, miner_tx_hash, b.tx_hashes);
+      MDB_val_sized(nv, block_txs_blob);
+      result = mdb_cursor_put(c_cur, &k, &nv, MDB_APPEND);
+      if (result)
+        throw0(DB_ERROR(lmdb_error("Failed to put a record into block_txs: ", result).c_str()));
+      i++;
+    }
+  } while(0);
+
+  uint32_t version = 6;
+  v.mv_data = (void *)&version;
+  v.mv_size = sizeof(version);
+  MDB_val_str(vk, "version");
+  result = mdb_txn_begin(m_env, NULL, 0, txn);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to create a transaction for the db: ", result).c_str()));
+  result = mdb_put(txn, m_properties, &vk, &v, 0);
+  if (result)
+    throw0(DB_ERROR(lmdb_error("Failed to update version for the db: ", result).c_str()));
+  txn.commit();
+}
+
 void BlockchainLMDB::migrate(const uint32_t oldversion)
 {
   if (oldversion < 1)
@@ -5319,6 +5776,10 @@ void BlockchainLMDB::migrate(const uint32_t oldversion)
     migrate_2_3();
   if (oldversion < 4)
     migrate_3_4();
+  if (oldversion < 5)
+    migrate_4_5();
+  if (oldversion < 6)
+    migrate_5_6();
 }
 
 }  // namespace cryptonote
@@ -51,6 +51,8 @@ typedef struct mdb_txn_cursors
   MDB_cursor *m_txc_blocks;
   MDB_cursor *m_txc_block_heights;
   MDB_cursor *m_txc_block_info;
+  MDB_cursor *m_txc_rct_distribution;
+  MDB_cursor *m_txc_block_txs;
 
   MDB_cursor *m_txc_output_txs;
   MDB_cursor *m_txc_output_amounts;
@@ -78,6 +80,8 @@ typedef struct mdb_txn_cursors
 #define m_cur_blocks	m_cursors->m_txc_blocks
 #define m_cur_block_heights	m_cursors->m_txc_block_heights
 #define m_cur_block_info	m_cursors->m_txc_block_info
+#define m_cur_rct_distribution	m_cursors->m_txc_rct_distribution
+#define m_cur_block_txs	m_cursors->m_txc_block_txs
 #define m_cur_output_txs	m_cursors->m_txc_output_txs
 #define m_cur_output_amounts	m_cursors->m_txc_output_amounts
 #define m_cur_txs	m_cursors->m_txc_txs
@@ -100,6 +104,8 @@ typedef struct mdb_rflags
   bool m_rf_blocks;
   bool m_rf_block_heights;
   bool m_rf_block_info;
+  bool m_rf_rct_distribution;
+  bool m_rf_block_txs;
   bool m_rf_output_txs;
   bool m_rf_output_amounts;
   bool m_rf_txs;
@@ -218,6 +224,10 @@ public:
 
   virtual std::vector<uint64_t> get_block_cumulative_rct_outputs(const std::vector<uint64_t> &heights) const;
 
+  virtual std::vector<uint64_t> get_rct_output_distribution(uint64_t start_height, uint64_t end_height) const;
+
+  virtual bool get_block_txs(uint64_t height, crypto::hash *miner_tx_hash, std::vector<std::pair<crypto::hash, cryptonote::blobdata>> &txs, std::vector<crypto::hash> *prunable_hashes, bool pruned) const;
+
   virtual uint64_t get_block_timestamp(const uint64_t& height) const;
 
   virtual uint64_t get_top_block_timestamp() const;
@@ -290,6 +300,7 @@ public:
   virtual cryptonote::blobdata get_txpool_tx_blob(const crypto::hash& txid, relay_category tx_category) const;
   virtual uint32_t get_blockchain_pruning_seed() const;
   virtual bool prune_blockchain(uint32_t pruning_seed = 0);
+  virtual bool prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, bool &finished, size_t &pruned);
   virtual bool update_pruning();
   virtual bool check_pruning();
 
@@ -407,7 +418,7 @@ private:
 
   inline void check_open() const;
 
-  bool prune_worker(int mode, uint32_t pruning_seed);
+  bool prune_worker(int mode, uint32_t pruning_seed, size_t max_records = 0, bool *finished = NULL, size_t *pruned = NULL);
 
   virtual bool is_read_only() const;
 
@@ -436,6 +447,12 @@ private:
   // migrate from DB version 3 to 4
   void migrate_3_4();
 
+  // migrate from DB version 4 to 5
+  void migrate_4_5();
+
+  // migrate from DB version 5 to 6
+  void migrate_5_6();
+
   void cleanup_batch();
 
 private:
@@ -444,6 +461,8 @@ private:
   MDB_dbi m_blocks;
   MDB_dbi m_block_heights;
   MDB_dbi m_block_info;
+  MDB_dbi m_rct_distribution;
+  MDB_dbi m_block_txs;
 
   MDB_dbi m_txs;
   MDB_dbi m_txs_pruned;
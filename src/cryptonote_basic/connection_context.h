@@ -32,10 +32,14 @@
 #pragma once
 #include <unordered_set>
 #include <atomic>
+#include <chrono>
+#include <vector>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #include "net/net_utils_base.h"
 #include "copyable_atomic.h"
 #include "crypto/hash.h"
+#include "cryptonote_basic/blobdatatype.h"
+#include "cryptonote_config.h"
 
 namespace cryptonote
 {
@@ -44,7 +48,8 @@ namespace cryptonote
   {
     cryptonote_connection_context(): m_state(state_before_handshake), m_remote_blockchain_height(0), m_last_response_height(0),
         m_last_request_time(boost::date_time::not_a_date_time), m_callback_request_count(0),
-        m_last_known_hash(crypto::null_hash), m_pruning_seed(0), m_rpc_port(0), m_rpc_credits_per_hash(0),  m_anchor(false) {}
+        m_last_known_hash(crypto::null_hash), m_missing_txes_block_hash(crypto::null_hash), m_pruning_seed(0), m_rpc_port(0), m_rpc_credits_per_hash(0),  m_anchor(false),
+        m_tx_reconcile_salt(0), m_tx_reconcile_time(0), m_tx_reconcile_capacity(P2P_TX_RECONCILIATION_MIN_CAPACITY) {}
 
     enum state
     {
@@ -63,11 +68,23 @@ namespace cryptonote
     boost::posix_time::ptime m_last_request_time;
     epee::copyable_atomic m_callback_request_count; //in debug purpose: problem with double callback rise
     crypto::hash m_last_known_hash;
+    crypto::hash m_missing_txes_block_hash; // block we asked this peer for missing txes of, null if none
+    std::vector<uint64_t> m_missing_tx_indices;
     uint32_t m_pruning_seed;
     uint16_t m_rpc_port;
     uint32_t m_rpc_credits_per_hash;
     bool m_anchor;
+    uint64_t m_tx_reconcile_salt; // salt of our request in flight, 0 if none
+    time_t m_tx_reconcile_time;
+    size_t m_tx_reconcile_capacity;
+    std::chrono::steady_clock::time_point m_tx_reconcile_answer_time; // when we last answered a request from this peer
     //size_t m_score;  TODO: add score calculations
+
+    //! \return True if enough is queued to this peer that traffic which can wait should be held back
+    bool is_send_congested() const noexcept
+    {
+      return m_metrics && m_metrics->send_queue_bytes.load(std::memory_order_relaxed) >= P2P_SEND_QUEUE_CONGESTED_BYTES;
+    }
   };
 
   inline std::string get_protocol_state_string(cryptonote_connection_context::state s)
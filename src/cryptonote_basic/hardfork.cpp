@@ -68,7 +68,9 @@ HardFork::HardFork(cryptonote::BlockchainDB &db, uint8_t original_version, uint6
   default_threshold_percent(default_threshold_percent),
   original_version(original_version),
   original_version_till_height(original_version_till_height),
-  current_fork_index(0)
+  current_fork_index(0),
+  version_runs(std::make_shared<const VersionRuns>()),
+  versions_height(0)
 {
   if (window_size == 0)
     throw "window_size needs to be strictly positive";
@@ -147,6 +149,7 @@ bool HardFork::add(uint8_t block_version, uint8_t voting_version, uint64_t heigh
     return false;
 
   db.set_hard_fork_version(height, heights[current_fork_index].version);
+  set_version(height, heights[current_fork_index].version);
 
   voting_version = get_effective_version(voting_version);
 
@@ -186,6 +189,8 @@ void HardFork::init()
     last_versions[n] = 0;
   current_fork_index = 0;
 
+  load_version_runs();
+
   // restore state from DB
   uint64_t height = db.height();
   if (height > window_size)
@@ -206,6 +211,81 @@ uint8_t HardFork::get_block_version(uint64_t height) const
   return ::get_block_version(block);
 }
 
+void HardFork::load_version_runs()
+{
+  db_rtxn_guard rtxn_guard(&db);
+  const uint64_t db_height = db.height();
+  std::shared_ptr<VersionRuns> runs = std::make_shared<VersionRuns>();
+
+  // a block's version is the version in effect at its height, and the
+  // version in effect never decreases along a chain, so each run end
+  // can be found by bisection rather than by reading every block
+  uint64_t start = 0;
+  while (start < db_height)
+  {
+    const uint8_t version = get_block_version(start);
+    runs->push_back({start, version});
+    uint64_t lo = start + 1, hi = db_height;
+    while (lo < hi)
+    {
+      const uint64_t mid = lo + (hi - lo) / 2;
+      if (get_block_version(mid) == version)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+    start = lo;
+  }
+  MDEBUG("Loaded " << runs->size() << " hard fork version runs up to height " << db_height);
+
+  truncate_versions(0);
+  std::atomic_store(&version_runs, std::shared_ptr<const VersionRuns>(runs));
+  versions_height = db_height;
+}
+
+bool HardFork::lookup_version(uint64_t height, uint8_t &version) const
+{
+  // load the height first: writers publish new runs before growing it
+  if (height >= versions_height)
+    return false;
+  const std::shared_ptr<const VersionRuns> runs = std::atomic_load(&version_runs);
+  auto it = std::upper_bound(runs->begin(), runs->end(), height, [](uint64_t h, const VersionRun &run) { return h < run.height; });
+  if (it == runs->begin())
+    return false;
+  version = (--it)->version;
+  return true;
+}
+
+void HardFork::set_version(uint64_t height, uint8_t version)
+{
+  if (height < versions_height)
+    truncate_versions(height);
+  const std::shared_ptr<const VersionRuns> runs = std::atomic_load(&version_runs);
+  if (runs->empty() || runs->back().version != version)
+  {
+    std::shared_ptr<VersionRuns> new_runs = std::make_shared<VersionRuns>(*runs);
+    new_runs->push_back({height, version});
+    std::atomic_store(&version_runs, std::shared_ptr<const VersionRuns>(new_runs));
+  }
+  versions_height = height + 1;
+}
+
+void HardFork::truncate_versions(uint64_t height)
+{
+  if (height >= versions_height)
+    return;
+  // shrink the height first, so readers never see runs that are going away
+  versions_height = height;
+  const std::shared_ptr<const VersionRuns> runs = std::atomic_load(&version_runs);
+  if (!runs->empty() && runs->back().height >= height)
+  {
+    std::shared_ptr<VersionRuns> new_runs = std::make_shared<VersionRuns>(*runs);
+    while (!new_runs->empty() && new_runs->back().height >= height)
+      new_runs->pop_back();
+    std::atomic_store(&version_runs, std::shared_ptr<const VersionRuns>(new_runs));
+  }
+}
+
 bool HardFork::reorganize_from_block_height(uint64_t height)
 {
   CRITICAL_REGION_LOCAL(lock);
@@ -219,7 +299,9 @@ bool HardFork::reorganize_from_block_height(uint64_t height)
   for (size_t n = 0; n < 256; ++n)
     last_versions[n] = 0;
   const uint64_t rescan_height = height >= (window_size - 1) ? height - (window_size  -1) : 0;
-  const uint8_t start_version = height == 0 ? original_version : db.get_hard_fork_version(height);
+  uint8_t start_version = original_version;
+  CHECK_AND_ASSERT_THROW_MES(height == 0 || lookup_version(height, start_version), "No hard fork version known for height " << height);
+  truncate_versions(height + 1);
   while (current_fork_index > 0 && heights[current_fork_index].version > start_version) {
     --current_fork_index;
   }
@@ -271,7 +353,8 @@ bool HardFork::rescan_from_block_height(uint64_t height)
     versions.push_back(v);
   }
 
-  uint8_t lastv = db.get_hard_fork_version(db.height() - 1);
+  uint8_t lastv = 0;
+  CHECK_AND_ASSERT_THROW_MES(lookup_version(db.height() - 1, lastv), "No hard fork version known for height " << db.height() - 1);
   current_fork_index = 0;
   while (current_fork_index + 1 < heights.size() && heights[current_fork_index].version != lastv)
     ++current_fork_index;
@@ -305,10 +388,11 @@ void HardFork::on_block_popped(uint64_t nblocks)
     version = versions.back();
     last_versions[version]--;
     versions.pop_back();
-    version = db.get_hard_fork_version(height);
+    CHECK_AND_ASSERT_THROW_MES(lookup_version(height, version), "No hard fork version known for height " << height);
     versions.push_front(version);
     last_versions[version]++;
   }
+  truncate_versions(new_chain_height);
 
   // does not take voting into account
   for (current_fork_index = heights.size() - 1; current_fork_index > 0; --current_fork_index)
@@ -354,15 +438,17 @@ HardFork::State HardFork::get_state() const
 
 uint8_t HardFork::get(uint64_t height) const
 {
+  uint8_t version;
+  if (lookup_version(height, version))
+    return version;
+
   CRITICAL_REGION_LOCAL(lock);
   if (height > db.height()) {
     assert(false);
     return 255;
   }
-  if (height == db.height()) {
-    return get_current_version();
-  }
-  return db.get_hard_fork_version(height);
+  // the top, or a block whose version is not recorded yet
+  return get_current_version();
 }
 
 uint8_t HardFork::get_current_version() const
@@ -29,6 +29,8 @@
 
 #pragma once
 
+#include <atomic>
+#include <memory>
 #include "syncobj.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/difficulty.h"
@@ -175,6 +177,9 @@ namespace cryptonote
     /**
      * @brief returns the hard fork version for the given block height
      *
+     * Heights below the top are looked up in an in-memory table without
+     * taking the lock or touching the db.
+     *
      * @param height height of the block to check
      */
     uint8_t get(uint64_t height) const;
@@ -255,7 +260,17 @@ namespace cryptonote
 
   private:
 
+    struct VersionRun {
+      uint64_t height; /* first height of the run */
+      uint8_t version;
+    };
+    typedef std::vector<VersionRun> VersionRuns;
+
     uint8_t get_block_version(uint64_t height) const;
+    void load_version_runs();
+    bool lookup_version(uint64_t height, uint8_t &version) const;
+    void set_version(uint64_t height, uint8_t version);
+    void truncate_versions(uint64_t height);
     bool do_check(uint8_t block_version, uint8_t voting_version) const;
     bool do_check_for_height(uint8_t block_version, uint8_t voting_version, uint64_t height) const;
     int get_voted_fork_index(uint64_t height) const;
@@ -283,6 +298,11 @@ namespace cryptonote
     unsigned int last_versions[256]; /* count of the block versions in the last N blocks */
     uint32_t current_fork_index;
 
+    /* run-length table of the versions of heights [0, versions_height),
+     * replaced as a whole by writers so readers need no lock */
+    std::shared_ptr<const VersionRuns> version_runs;
+    std::atomic<uint64_t> versions_height;
+
     mutable epee::critical_section lock;
   };
 
@@ -122,10 +122,13 @@
 
 #define CRYPTONOTE_MAX_FRAGMENTS                        20 // ~20 * NOISE_BYTES max payload size for covert/noise send
 
+#define CRYPTONOTE_FLUFF_DELAY_RANGE                    2000   // milliseconds, txes flooded to a peer within it are sent in one notification
+
 #define COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT           1000
 
 #define P2P_LOCAL_WHITE_PEERLIST_LIMIT                  1000
 #define P2P_LOCAL_GRAY_PEERLIST_LIMIT                   5000
+#define P2P_PEERLIST_JOURNAL_FLUSH_INTERVAL             10           // seconds between appends of peerlist updates to p2pstate.bin
 
 #define P2P_DEFAULT_CONNECTIONS_COUNT                   8
 #define P2P_DEFAULT_HANDSHAKE_INTERVAL                  60           //secondes
@@ -136,6 +139,8 @@
 #define P2P_DEFAULT_PING_CONNECTION_TIMEOUT             2000       //2 seconds
 #define P2P_DEFAULT_INVOKE_TIMEOUT                      60*2*1000  //2 minutes
 #define P2P_DEFAULT_HANDSHAKE_INVOKE_TIMEOUT            5000       //5 seconds
+#define P2P_DEFAULT_CONNECT_PARALLELISM                 4          // outgoing connection attempts in flight at once
+#define P2P_DEFAULT_CONNECT_STAGGER                     250        // ms head start given to an attempt before the next one starts
 #define P2P_DEFAULT_WHITELIST_CONNECTIONS_PERCENT       70
 #define P2P_DEFAULT_ANCHOR_CONNECTIONS_COUNT            2
 #define P2P_DEFAULT_SYNC_SEARCH_CONNECTIONS_COUNT       2
@@ -147,8 +152,31 @@
 #define P2P_IP_FAILS_BEFORE_BLOCK                       10
 #define P2P_IDLE_CONNECTION_KILL_INTERVAL               (5*60) //5 minutes
 
+#define P2P_PEER_SCORE_HALF_LIFE                        (60*60*24)  // 24 hours
+#define P2P_PEER_SCORE_SAMPLE_WEIGHT                    0.25f
+#define P2P_PEER_SCORE_REFERENCE_RTT                    0.25f       // seconds
+#define P2P_PEER_SCORE_REFERENCE_THROUGHPUT             (256*1024)  // bytes per second
+
 #define P2P_SUPPORT_FLAG_FLUFFY_BLOCKS                  0x01
-#define P2P_SUPPORT_FLAGS                               P2P_SUPPORT_FLAG_FLUFFY_BLOCKS
+#define P2P_SUPPORT_FLAG_TX_RECONCILIATION              0x02
+#define P2P_SUPPORT_FLAG_COMPACT_BLOCKS                 0x04
+#define P2P_SUPPORT_FLAG_COMPRESSION                    0x08
+#define P2P_SUPPORT_FLAGS                               (P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_TX_RECONCILIATION | P2P_SUPPORT_FLAG_COMPACT_BLOCKS | P2P_SUPPORT_FLAG_COMPRESSION)
+
+#define P2P_SEND_QUEUE_CONGESTED_BYTES                  (4*1024*1024) // txes and sync requests to a peer with this much queued wait
+#define P2P_SEND_QUEUE_CONGESTED_RETRY                  500          // ms before a batch held back for congestion is retried
+#define P2P_SEND_QUEUE_CONGESTED_MAX_RETRIES            10           // a batch held back this many times is sent anyway
+#define P2P_FLUFF_BATCH_MAX_BYTES                       (1024*1024)  // txes flooded to a peer at once; a congested peer keeps only the newest
+
+#define P2P_COMPRESSION_THRESHOLD                       (16*1024)    // sync responses smaller than this are sent uncompressed
+#define P2P_MAX_INFLATED_GET_OBJECTS_SIZE               P2P_DEFAULT_PACKET_MAX_SIZE // a compressed NOTIFY_RESPONSE_GET_OBJECTS may not inflate past this
+#define P2P_MAX_INFLATED_CHAIN_ENTRY_SIZE               (1024*1024)  // room for BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT ids and weights
+
+#define P2P_TX_RECONCILIATION_INTERVAL                  2          // seconds
+#define P2P_TX_RECONCILIATION_TIMEOUT                   30         // seconds
+#define P2P_TX_RECONCILIATION_MIN_CAPACITY              16
+#define P2P_TX_RECONCILIATION_MAX_CAPACITY              4096
+#define P2P_TX_RECONCILIATION_MAX_SHORT_IDS             65536
 
 #define RPC_IP_FAILS_BEFORE_BLOCK                       3
 
@@ -196,11 +224,16 @@
 
 #define DEFAULT_TXPOOL_MAX_WEIGHT               648000000ull // 3 days at 300000, in bytes
 
+#define OUTPUT_KEY_CACHE_MAX_ENTRIES            262144 // about 30 MB of cached ring members
+#define RECENT_BLOCK_CACHE_MAX_SIZE             (64*1024*1024) // bytes of block and tx blobs kept to serve the top of the chain
+
 #define BULLETPROOF_MAX_OUTPUTS                 16
 
 #define CRYPTONOTE_PRUNING_STRIPE_SIZE          4096 // the smaller, the smoother the increase
 #define CRYPTONOTE_PRUNING_LOG_STRIPES          3 // the higher, the more space saved
 #define CRYPTONOTE_PRUNING_TIP_BLOCKS           5500 // the smaller, the more space saved
+#define CRYPTONOTE_PRUNING_STEP_TXES            4096 // txes looked at per background pruning step
+#define CRYPTONOTE_PRUNING_SYNC_STEP_TXES       512 // same, while syncing
 //#define CRYPTONOTE_PRUNING_DEBUG_SPOOF_SEED
 
 #define RPC_CREDITS_PER_HASH_SCALE ((float)(1<<24))
@@ -0,0 +1,159 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include <string.h>
+#include "misc_log_ex.h"
+#include "common/threadpool.h"
+#include "block_hash_check.h"
+
+#undef BITTUBE_DEFAULT_LOG_CATEGORY
+#define BITTUBE_DEFAULT_LOG_CATEGORY "blockchain"
+
+namespace cryptonote
+{
+
+block_hash_check::block_hash_check(std::vector<std::pair<crypto::hash, crypto::hash>> hash_of_hashes):
+  m_hash_of_hashes(std::move(hash_of_hashes)),
+  m_chunks(new chunk[m_hash_of_hashes.size()])
+{
+}
+
+bool block_hash_check::get_hash(uint64_t height, crypto::hash &hash) const
+{
+  const uint64_t n = height / HASH_OF_HASHES_STEP;
+  if (n >= m_hash_of_hashes.size())
+    return false;
+  const chunk &c = m_chunks[n];
+  if (!(c.state.load(std::memory_order_acquire) & hashes_ready))
+    return false;
+  hash = c.hashes[height % HASH_OF_HASHES_STEP];
+  return true;
+}
+
+bool block_hash_check::get_weight(uint64_t height, uint64_t &weight) const
+{
+  const uint64_t n = height / HASH_OF_HASHES_STEP;
+  if (n >= m_hash_of_hashes.size())
+    return false;
+  const chunk &c = m_chunks[n];
+  if (!(c.state.load(std::memory_order_acquire) & weights_ready))
+    return false;
+  weight = c.weights[height % HASH_OF_HASHES_STEP];
+  return true;
+}
+
+bool block_hash_check::has_weights(uint64_t height, uint64_t nblocks) const
+{
+  CHECK_AND_ASSERT_MES(nblocks > 0, false, "nblocks is 0");
+  const uint64_t last_block_height = height + nblocks - 1;
+  if (last_block_height >= size())
+    return false;
+  for (uint64_t n = height / HASH_OF_HASHES_STEP; n <= last_block_height / HASH_OF_HASHES_STEP; ++n)
+    if (!(m_chunks[n].state.load(std::memory_order_acquire) & weights_ready))
+      return false;
+  return true;
+}
+
+bool block_hash_check::check_chunk(size_t n, const crypto::hash *hashes, const uint64_t *weights) const
+{
+  crypto::hash hash;
+  crypto::cn_fast_hash(hashes, HASH_OF_HASHES_STEP * sizeof(crypto::hash), hash);
+  if (hash != m_hash_of_hashes[n].first)
+    return false;
+  if (weights)
+  {
+    crypto::cn_fast_hash(weights, HASH_OF_HASHES_STEP * sizeof(uint64_t), hash);
+    if (hash != m_hash_of_hashes[n].second)
+      return false;
+  }
+  return true;
+}
+
+void block_hash_check::record_chunk(size_t n, const crypto::hash *hashes, const uint64_t *weights)
+{
+  // a chunk's contents are fixed by its hash, so whichever verifier gets
+  // to a chunk first fills it, and the others have nothing to add
+  chunk &c = m_chunks[n];
+  if (!(c.state.load(std::memory_order_acquire) & (hashes_ready | hashes_busy)) && !(c.state.fetch_or(hashes_busy) & hashes_busy))
+  {
+    memcpy(c.hashes, hashes, sizeof(c.hashes));
+    c.state.fetch_or(hashes_ready, std::memory_order_release);
+  }
+  if (weights && !(c.state.load(std::memory_order_acquire) & (weights_ready | weights_busy)) && !(c.state.fetch_or(weights_busy) & weights_busy))
+  {
+    memcpy(c.weights, weights, sizeof(c.weights));
+    c.state.fetch_or(weights_ready, std::memory_order_release);
+  }
+}
+
+size_t block_hash_check::verify(size_t first_chunk, const std::vector<crypto::hash> &data_hashes, const std::vector<uint64_t> &data_weights, size_t nchunks)
+{
+  CHECK_AND_ASSERT_MES(first_chunk + nchunks <= m_hash_of_hashes.size(), 0, "Chunks out of range");
+  CHECK_AND_ASSERT_MES(data_hashes.size() >= nchunks * HASH_OF_HASHES_STEP, 0, "Not enough hashes");
+  CHECK_AND_ASSERT_MES(data_weights.empty() || data_weights.size() == data_hashes.size(), 0, "Unexpected weights size");
+  if (nchunks == 0)
+    return 0;
+
+  const uint64_t *weights = data_weights.empty() ? NULL : data_weights.data();
+  std::unique_ptr<bool[]> valid(new bool[nchunks]);
+  const auto check_range = [&](size_t start, size_t end) {
+    for (size_t i = start; i < end; ++i)
+      valid[i] = check_chunk(first_chunk + i, data_hashes.data() + i * HASH_OF_HASHES_STEP, weights ? weights + i * HASH_OF_HASHES_STEP : NULL);
+  };
+
+  tools::threadpool& tpool = tools::threadpool::getInstance();
+  const size_t threads = std::min<size_t>(tpool.get_max_concurrency(), nchunks);
+  if (threads > 1)
+  {
+    tools::threadpool::waiter waiter;
+    const size_t per_thread = (nchunks + threads - 1) / threads;
+    for (size_t start = 0; start < nchunks; start += per_thread)
+    {
+      const size_t end = std::min(start + per_thread, nchunks);
+      tpool.submit(&waiter, [&check_range, start, end]() { check_range(start, end); }, true);
+    }
+    waiter.wait(&tpool);
+  }
+  else
+  {
+    check_range(0, nchunks);
+  }
+
+  size_t nvalid = 0;
+  while (nvalid < nchunks && valid[nvalid])
+  {
+    record_chunk(first_chunk + nvalid, data_hashes.data() + nvalid * HASH_OF_HASHES_STEP, weights ? weights + nvalid * HASH_OF_HASHES_STEP : NULL);
+    ++nvalid;
+  }
+  if (nvalid < nchunks)
+    MDEBUG("invalid hash for blocks " << (first_chunk + nvalid) * HASH_OF_HASHES_STEP << " - " << ((first_chunk + nvalid) * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP - 1));
+  return nvalid;
+}
+
+}
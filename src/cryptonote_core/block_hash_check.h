@@ -0,0 +1,124 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <utility>
+#include <vector>
+#include "crypto/hash.h"
+#include "cryptonote_config.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief the block hashes and weights verified against the compiled in hashes of hashes
+   *
+   * Each chunk of HASH_OF_HASHES_STEP blocks is filled once a peer's chain
+   * entry hashes to the compiled in hash for it.  Chunks are written at most
+   * once and published with an atomic flag, so lookups by height are O(1) and
+   * take no lock, and several chain entries may be verified concurrently.
+   */
+  class block_hash_check
+  {
+  public:
+    /**
+     * @brief constructor
+     *
+     * @param hash_of_hashes for each chunk, the hash of its block hashes and the hash of its block weights
+     */
+    block_hash_check(std::vector<std::pair<crypto::hash, crypto::hash>> hash_of_hashes);
+
+    size_t num_chunks() const { return m_hash_of_hashes.size(); }
+
+    /**
+     * @brief the number of heights covered by the compiled in hashes
+     */
+    uint64_t size() const { return m_hash_of_hashes.size() * HASH_OF_HASHES_STEP; }
+
+    /**
+     * @brief gets the verified hash of the block at the given height
+     *
+     * @return false if that height's chunk was not verified yet
+     */
+    bool get_hash(uint64_t height, crypto::hash &hash) const;
+
+    /**
+     * @brief gets the verified weight of the block at the given height
+     *
+     * @return false if that height's chunk was not verified with weights yet
+     */
+    bool get_weight(uint64_t height, uint64_t &weight) const;
+
+    /**
+     * @brief checks whether verified weights are known for a range of blocks
+     */
+    bool has_weights(uint64_t height, uint64_t nblocks) const;
+
+    /**
+     * @brief verifies chunks against the compiled in hashes, and records the valid ones
+     *
+     * The chunks are hashed in parallel.  Only the run of valid chunks from
+     * first_chunk is recorded, as the ones after an invalid chunk cannot be
+     * linked to the chain.
+     *
+     * @param first_chunk the index of the first chunk to verify
+     * @param data_hashes the block hashes, starting at the first height of first_chunk
+     * @param data_weights the block weights matching data_hashes, or empty if unknown
+     * @param nchunks the number of chunks to verify, which must all be complete in data_hashes
+     *
+     * @return the number of consecutive valid chunks from first_chunk
+     */
+    size_t verify(size_t first_chunk, const std::vector<crypto::hash> &data_hashes, const std::vector<uint64_t> &data_weights, size_t nchunks);
+
+  private:
+    enum chunk_state: uint8_t
+    {
+      hashes_busy = 1,
+      hashes_ready = 2,
+      weights_busy = 4,
+      weights_ready = 8,
+    };
+
+    struct chunk
+    {
+      std::atomic<uint8_t> state;
+      crypto::hash hashes[HASH_OF_HASHES_STEP];
+      uint64_t weights[HASH_OF_HASHES_STEP];
+
+      chunk(): state(0) {}
+    };
+
+    bool check_chunk(size_t n, const crypto::hash *hashes, const uint64_t *weights) const;
+    void record_chunk(size_t n, const crypto::hash *hashes, const uint64_t *weights);
+
+    const std::vector<std::pair<crypto::hash, crypto::hash>> m_hash_of_hashes;
+    std::unique_ptr<chunk[]> m_chunks;
+  };
+}
@@ -88,6 +88,22 @@ DISABLE_VS_WARNINGS(4267)
 // used to overestimate the block reward when estimating a per kB to use
 #define BLOCK_REWARD_OVERESTIMATE (10 * 1000000000000)
 
+// the pruned form of a tx is the leading unprunable_size bytes of its blob,
+// which is only known when the tx was parsed from that blob
+static bool make_recent_block_cache_txs(const std::vector<std::pair<transaction, blobdata>> &txs, std::vector<recent_block_cache::tx_entry> &entries)
+{
+  entries.clear();
+  entries.reserve(txs.size());
+  for (const auto &tx: txs)
+  {
+    const size_t unprunable_size = tx.first.unprunable_size;
+    if (unprunable_size == 0 || unprunable_size > tx.second.size())
+      return false;
+    entries.push_back({get_transaction_hash(tx.first), tx.second, unprunable_size, get_transaction_prunable_hash(tx.first, &tx.second), tx.first.version == 1});
+  }
+  return true;
+}
+
 static const struct {
   uint8_t version;
   uint64_t height;
@@ -163,13 +179,16 @@ static const struct {
 //------------------------------------------------------------------
 Blockchain::Blockchain(tx_memory_pool& tx_pool) :
   m_db(), m_tx_pool(tx_pool), m_hardfork(NULL), m_timestamps_and_difficulties_height(0), m_current_block_cumul_weight_limit(0), m_current_block_cumul_weight_median(0),
-  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_sync_on_blocks(true), m_db_sync_threshold(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_bytes_to_sync(0), m_cancel(false),
+  m_enforce_dns_checkpoints(false), m_max_prepare_blocks_threads(4), m_db_sync_on_blocks(true), m_db_sync_threshold(1), m_db_sync_mode(db_async), m_db_default_sync(false), m_fast_sync(true), m_show_time_stats(false), m_sync_counter(0), m_bytes_to_sync(0), m_cancel(false), m_pruning_in_progress(false), m_pruning_pass_pruned(0),
   m_long_term_block_weights_window(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_long_term_effective_median_block_weight(0),
   m_long_term_block_weights_cache_tip_hash(crypto::null_hash),
   m_long_term_block_weights_cache_rolling_median(CRYPTONOTE_LONG_TERM_BLOCK_WEIGHT_WINDOW_SIZE),
   m_difficulty_for_next_block_top_hash(crypto::null_hash),
   m_difficulty_for_next_block(1),
+  m_output_key_cache(OUTPUT_KEY_CACHE_MAX_ENTRIES),
+  m_recent_block_cache(RECENT_BLOCK_CACHE_MAX_SIZE),
+  m_compiled_block_hash_area(0),
   m_btc_valid(false),
   m_batch_success(true),
   m_prepare_height(0)
@@ -241,7 +260,7 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
   {
     try
     {
-      m_db->get_output_key(epee::span<const uint64_t>(&tx_in_to_key.amount, 1), absolute_offsets, outputs, true);
+      get_output_keys(epee::span<const uint64_t>(&tx_in_to_key.amount, 1), absolute_offsets, outputs, true);
       if (absolute_offsets.size() != outputs.size())
       {
         MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
@@ -267,7 +286,7 @@ bool Blockchain::scan_outputkeys_for_indexes(size_t tx_version, const txin_to_ke
         add_offsets.push_back(absolute_offsets[i]);
       try
       {
-        m_db->get_output_key(epee::span<const uint64_t>(&tx_in_to_key.amount, 1), add_offsets, add_outputs, true);
+        get_output_keys(epee::span<const uint64_t>(&tx_in_to_key.amount, 1), add_offsets, add_outputs, true);
         if (add_offsets.size() != add_outputs.size())
         {
           MERROR_VER("Output does not exist! amount = " << tx_in_to_key.amount);
@@ -520,6 +539,10 @@ bool Blockchain::init(BlockchainDB* db, const network_type nettype, bool offline
     if (!update_next_cumulative_weight_limit())
       return false;
   }
+
+  // a pass interrupted by a restart is picked up by the first step
+  m_pruning_in_progress = !m_db->is_read_only() && m_db->get_blockchain_pruning_seed();
+  m_pruning_pass_pruned = 0;
   return true;
 }
 //------------------------------------------------------------------
@@ -605,33 +628,40 @@ bool Blockchain::deinit()
 // It starts a batch and calls private method pop_block_from_blockchain().
 void Blockchain::pop_blocks(uint64_t nblocks)
 {
-  uint64_t i = 0;
   CRITICAL_REGION_LOCAL(m_tx_pool);
   CRITICAL_REGION_LOCAL1(m_blockchain_lock);
 
+  // the genesis block always stays
+  const uint64_t blockchain_height = m_db->height();
+  nblocks = blockchain_height > 0 ? std::min(nblocks, blockchain_height - 1) : 0;
+  if (nblocks == 0)
+    return;
+
   bool stop_batch = m_db->batch_start();
 
   try
   {
-    const uint64_t blockchain_height = m_db->height();
-    if (blockchain_height > 0)
-      nblocks = std::min(nblocks, blockchain_height - 1);
-    while (i < nblocks)
-    {
-      pop_block_from_blockchain();
-      ++i;
-    }
+    std::list<block> popped_blocks;
+    disconnect_blocks(blockchain_height - nblocks, popped_blocks);
   }
   catch (const std::exception& e)
   {
-    LOG_ERROR("Error when popping blocks after processing " << i << " blocks: " << e.what());
+    LOG_ERROR("Error when popping " << nblocks << " blocks: " << e.what());
     if (stop_batch)
+    {
       m_db->batch_abort();
+      m_recent_block_cache.rollback();
+      // the popped txes went back to the pool in the aborted batch
+      m_tx_pool.reload();
+    }
     return;
   }
 
   if (stop_batch)
+  {
     m_db->batch_stop();
+    m_recent_block_cache.commit();
+  }
 }
 //------------------------------------------------------------------
 // This function tells BlockchainDB to remove the top block from the
@@ -642,16 +672,40 @@ block Blockchain::pop_block_from_blockchain()
   LOG_PRINT_L3("Blockchain::" << __func__);
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  m_timestamps_and_difficulties_height = 0;
+  CHECK_AND_ASSERT_THROW_MES(m_db->height() > 1, "Cannot pop the genesis block");
 
-  block popped_block;
-  std::vector<transaction> popped_txs;
+  std::list<block> popped_blocks;
+  disconnect_blocks(m_db->height() - 1, popped_blocks);
+  return popped_blocks.front();
+}
+//------------------------------------------------------------------
+// This function removes blocks from the top of the blockchain until it
+// reaches new_height. Every block is popped from the db before the hard fork
+// state, the caches and the tx_pool are brought up to date, so a deep reorg
+// pays for those once instead of once per block.
+void Blockchain::disconnect_blocks(uint64_t new_height, std::list<block>& disconnected_chain)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  CHECK_AND_ASSERT_THROW_MES(m_db->height() > 1, "Cannot pop the genesis block");
+  CHECK_AND_ASSERT_THROW_MES(new_height > 0, "Cannot pop the genesis block");
+  const uint64_t old_height = m_db->height();
+  if (new_height >= old_height)
+    return;
+
+  m_timestamps_and_difficulties_height = 0;
 
+  std::vector<transaction> popped_txs;
   try
   {
-    m_db->pop_block(popped_block, popped_txs);
+    while (m_db->height() > new_height)
+    {
+      block popped_block;
+      std::vector<transaction> block_txs;
+      m_db->pop_block(popped_block, block_txs);
+      disconnected_chain.push_front(std::move(popped_block));
+      popped_txs.insert(popped_txs.end(), std::make_move_iterator(block_txs.begin()), std::make_move_iterator(block_txs.end()));
+    }
   }
   // anything that could cause this to throw is likely catastrophic,
   // so we re-throw
@@ -667,11 +721,34 @@ block Blockchain::pop_block_from_blockchain()
   }
 
   // make sure the hard fork object updates its current version
-  m_hardfork->on_block_popped(1);
+  m_hardfork->on_block_popped(old_height - new_height);
+
+  m_blocks_longhash_table.clear();
+  m_scan_table.clear();
+  m_blocks_txs_check.clear();
+  m_output_key_cache.invalidate_from_height(new_height);
+  m_recent_block_cache.invalidate_from_height(new_height);
+
+  return_txs_to_pool(popped_txs);
+
+  CHECK_AND_ASSERT_THROW_MES(update_next_cumulative_weight_limit(), "Error updating next cumulative weight limit");
+  uint64_t top_block_height;
+  crypto::hash top_block_hash = get_tail_id(top_block_height);
+  m_tx_pool.on_blockchain_dec(top_block_height, top_block_hash);
+  invalidate_block_template_cache();
+}
+//------------------------------------------------------------------
+void Blockchain::return_txs_to_pool(std::vector<transaction>& txs)
+{
+  LOG_PRINT_L3("Blockchain::" << __func__);
+
+  // FIXME: HardFork
+  // Besides the below, popping a block should also remove the last entry
+  // in hf_versions.
+  const uint8_t version = get_ideal_hard_fork_version(m_db->height());
 
-  // return transactions from popped block to the tx_pool
   size_t pruned = 0;
-  for (transaction& tx : popped_txs)
+  for (transaction& tx : txs)
   {
     if (tx.pruned)
     {
@@ -682,11 +759,6 @@ block Blockchain::pop_block_from_blockchain()
     {
       cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
 
-      // FIXME: HardFork
-      // Besides the below, popping a block should also remove the last entry
-      // in hf_versions.
-      uint8_t version = get_ideal_hard_fork_version(m_db->height());
-
       // We assume that if they were in a block, the transactions are already
       // known to the network as a whole. However, if we had mined that block,
       // that might not be always true. Unlikely though, and always relaying
@@ -701,18 +773,6 @@ block Blockchain::pop_block_from_blockchain()
   }
   if (pruned)
     MWARNING(pruned << " pruned txes could not be added back to the txpool");
-
-  m_blocks_longhash_table.clear();
-  m_scan_table.clear();
-  m_blocks_txs_check.clear();
-
-  CHECK_AND_ASSERT_THROW_MES(update_next_cumulative_weight_limit(), "Error updating next cumulative weight limit");
-  uint64_t top_block_height;
-  crypto::hash top_block_hash = get_tail_id(top_block_height);
-  m_tx_pool.on_blockchain_dec(top_block_height, top_block_hash);
-  invalidate_block_template_cache();
-
-  return popped_block;
 }
 //------------------------------------------------------------------
 bool Blockchain::reset_and_set_genesis_block(const block& b)
@@ -724,6 +784,8 @@ bool Blockchain::reset_and_set_genesis_block(const block& b)
   m_db->reset();
   m_db->drop_alt_blocks();
   m_hardfork->init();
+  m_output_key_cache.clear();
+  m_recent_block_cache.clear();
 
   db_wtxn_guard wtxn_guard(m_db);
   block_verification_context bvc = {};
@@ -996,13 +1058,8 @@ bool Blockchain::rollback_blockchain_switching(std::list<block>& original_chain,
   m_timestamps_and_difficulties_height = 0;
 
   // remove blocks from blockchain until we get back to where we should be.
-  while (m_db->height() != rollback_height)
-  {
-    pop_block_from_blockchain();
-  }
-
-  // make sure the hard fork object updates its current version
-  m_hardfork->reorganize_from_chain_height(rollback_height);
+  std::list<block> popped_blocks;
+  disconnect_blocks(rollback_height, popped_blocks);
 
   //return back original chain
   for (auto& bl : original_chain)
@@ -1012,6 +1069,7 @@ bool Blockchain::rollback_blockchain_switching(std::list<block>& original_chain,
     CHECK_AND_ASSERT_MES(r && bvc.m_added_to_main_chain, false, "PANIC! failed to add (again) block while chain switching during the rollback!");
   }
 
+  // make sure the hard fork object updates its current version
   m_hardfork->reorganize_from_chain_height(rollback_height);
 
   MINFO("Rollback to height " << rollback_height << " was successful.");
@@ -1023,7 +1081,8 @@ bool Blockchain::rollback_blockchain_switching(std::list<block>& original_chain,
 }
 //------------------------------------------------------------------
 // This function attempts to switch to an alternate chain, returning
-// boolean based on success therein.
+// boolean based on success therein. The whole disconnect/connect runs in
+// a single db batch transaction.
 bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>& alt_chain, bool discard_disconnected_chain)
 {
   LOG_PRINT_L3("Blockchain::" << __func__);
@@ -1041,90 +1100,117 @@ bool Blockchain::switch_to_alternative_blockchain(std::list<block_extended_info>
     return false;
   }
 
-  // pop blocks from the blockchain until the top block is the parent
-  // of the front block of the alt chain.
-  std::list<block> disconnected_chain;
-  while (m_db->top_block_hash() != alt_chain.front().bl.prev_id)
-  {
-    block b = pop_block_from_blockchain();
-    disconnected_chain.push_front(b);
-  }
-
-  auto split_height = m_db->height();
-  
-  //connecting new alternative chain
-  for(auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++)
+  const bool stop_batch = m_db->batch_start(alt_chain.size(), 0);
+  try
   {
-    const auto &bei = *alt_ch_iter;
-    block_verification_context bvc = boost::value_initialized<block_verification_context>();
-
-    // add block to main chain
-    bool r = handle_block_to_main_chain(bei.bl, bvc);
+    // pop blocks from the blockchain until the top block is the parent
+    // of the front block of the alt chain.
+    std::list<block> disconnected_chain;
+    const uint64_t split_height = m_db->get_block_height(alt_chain.front().bl.prev_id) + 1;
+    disconnect_blocks(split_height, disconnected_chain);
 
-    // if adding block to main chain failed, rollback to previous state and
-    // return false
-    if(!r || !bvc.m_added_to_main_chain)
+    //connecting new alternative chain
+    for(auto alt_ch_iter = alt_chain.begin(); alt_ch_iter != alt_chain.end(); alt_ch_iter++)
     {
-      MERROR("Failed to switch to alternative blockchain");
-
-      // rollback_blockchain_switching should be moved to two different
-      // functions: rollback and apply_chain, but for now we pretend it is
-      // just the latter (because the rollback was done above).
-      rollback_blockchain_switching(disconnected_chain, split_height);
+      const auto &bei = *alt_ch_iter;
+      block_verification_context bvc = boost::value_initialized<block_verification_context>();
 
-      // FIXME: Why do we keep invalid blocks around?  Possibly in case we hear
-      // about them again so we can immediately dismiss them, but needs some
-      // looking into.
-      const crypto::hash blkid = cryptonote::get_block_hash(bei.bl);
-      add_block_as_invalid(bei, blkid);
-      MERROR("The block was inserted as invalid while connecting new alternative chain, block_id: " << blkid);
-      m_db->remove_alt_block(blkid);
-      alt_ch_iter++;
+      // add block to main chain
+      bool r = handle_block_to_main_chain(bei.bl, bvc);
 
-      for(auto alt_ch_to_orph_iter = alt_ch_iter; alt_ch_to_orph_iter != alt_chain.end(); )
+      // if adding block to main chain failed, rollback to previous state and
+      // return false
+      if(!r || !bvc.m_added_to_main_chain)
       {
-        const auto &bei = *alt_ch_to_orph_iter++;
+        MERROR("Failed to switch to alternative blockchain");
+
+        // rollback_blockchain_switching should be moved to two different
+        // functions: rollback and apply_chain, but for now we pretend it is
+        // just the latter (because the rollback was done above).
+        rollback_blockchain_switching(disconnected_chain, split_height);
+
+        // FIXME: Why do we keep invalid blocks around?  Possibly in case we hear
+        // about them again so we can immediately dismiss them, but needs some
+        // looking into.
         const crypto::hash blkid = cryptonote::get_block_hash(bei.bl);
         add_block_as_invalid(bei, blkid);
+        MERROR("The block was inserted as invalid while connecting new alternative chain, block_id: " << blkid);
         m_db->remove_alt_block(blkid);
+        alt_ch_iter++;
+
+        for(auto alt_ch_to_orph_iter = alt_ch_iter; alt_ch_to_orph_iter != alt_chain.end(); )
+        {
+          const auto &bei = *alt_ch_to_orph_iter++;
+          const crypto::hash blkid = cryptonote::get_block_hash(bei.bl);
+          add_block_as_invalid(bei, blkid);
+          m_db->remove_alt_block(blkid);
+        }
+        if (stop_batch)
+        {
+          m_db->batch_stop();
+          m_recent_block_cache.commit();
+        }
+        return false;
       }
-      return false;
     }
-  }
 
-  // if we're to keep the disconnected blocks, add them as alternates
-  const size_t discarded_blocks = disconnected_chain.size();
-  if(!discard_disconnected_chain)
-  {
-    //pushing old chain as alternative chain
-    for (auto& old_ch_ent : disconnected_chain)
+    // if we're to keep the disconnected blocks, add them as alternates
+    const size_t discarded_blocks = disconnected_chain.size();
+    if(!discard_disconnected_chain)
     {
-      block_verification_context bvc = {};
-      bool r = handle_alternative_block(old_ch_ent, get_block_hash(old_ch_ent), bvc);
-      if(!r)
+      //pushing old chain as alternative chain
+      for (auto& old_ch_ent : disconnected_chain)
       {
-        MERROR("Failed to push ex-main chain blocks to alternative chain ");
-        // previously this would fail the blockchain switching, but I don't
-        // think this is bad enough to warrant that.
+        block_verification_context bvc = {};
+        bool r = handle_alternative_block(old_ch_ent, get_block_hash(old_ch_ent), bvc);
+        if(!r)
+        {
+          MERROR("Failed to push ex-main chain blocks to alternative chain ");
+          // previously this would fail the blockchain switching, but I don't
+          // think this is bad enough to warrant that.
+        }
       }
     }
-  }
 
-  //removing alt_chain entries from alternative chains container
-  for (const auto &bei: alt_chain)
-  {
-    m_db->remove_alt_block(cryptonote::get_block_hash(bei.bl));
-  }
+    //removing alt_chain entries from alternative chains container
+    for (const auto &bei: alt_chain)
+    {
+      m_db->remove_alt_block(cryptonote::get_block_hash(bei.bl));
+    }
 
-  m_hardfork->reorganize_from_chain_height(split_height);
-  get_block_longhash_reorg(split_height);
+    m_hardfork->reorganize_from_chain_height(split_height);
+    get_block_longhash_reorg(split_height);
 
-  std::shared_ptr<tools::Notify> reorg_notify = m_reorg_notify;
-  if (reorg_notify)
-    reorg_notify->notify("%s", std::to_string(split_height).c_str(), "%h", std::to_string(m_db->height()).c_str(),
-        "%n", std::to_string(m_db->height() - split_height).c_str(), "%d", std::to_string(discarded_blocks).c_str(), NULL);
+    if (stop_batch)
+    {
+      m_db->batch_stop();
+      m_recent_block_cache.commit();
+    }
+
+    std::shared_ptr<tools::Notify> reorg_notify = m_reorg_notify;
+    if (reorg_notify)
+      reorg_notify->notify("%s", std::to_string(split_height).c_str(), "%h", std::to_string(m_db->height()).c_str(),
+          "%n", std::to_string(m_db->height() - split_height).c_str(), "%d", std::to_string(discarded_blocks).c_str(), NULL);
 
-  MGINFO_GREEN("REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_db->height());
+    MGINFO_GREEN("REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_db->height());
+  }
+  catch (const std::exception &e)
+  {
+    MERROR("Exception while switching to alternative blockchain: " << e.what());
+    if (stop_batch)
+    {
+      m_db->batch_abort();
+      // the db is back to where it was, bring the hard fork state and the
+      // output cache along, they may have seen blocks from the alt chain
+      m_hardfork->init();
+      m_output_key_cache.clear();
+      m_recent_block_cache.rollback();
+      // the pool changes made while switching were rolled back with the batch
+      m_tx_pool.reload();
+      invalidate_block_template_cache();
+    }
+    throw;
+  }
   return true;
 }
 //------------------------------------------------------------------
@@ -2059,44 +2145,56 @@ bool Blockchain::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request& arg, NO
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   db_rtxn_guard rtxn_guard (m_db);
   rsp.current_blockchain_height = get_current_blockchain_height();
-  std::vector<std::pair<cryptonote::blobdata,block>> blocks;
-  get_blocks(arg.blocks, blocks, rsp.missed_ids);
 
-  for (size_t i = 0; i < blocks.size(); ++i)
+  // blocks and their txes are sent as stored, without being parsed
+  std::vector<std::pair<crypto::hash, cryptonote::blobdata>> txs;
+  std::vector<crypto::hash> prunable_hashes;
+  rsp.blocks.reserve(arg.blocks.size());
+  for (const crypto::hash &block_hash: arg.blocks)
   {
-    auto& bl = blocks[i];
-    std::vector<crypto::hash> missed_tx_ids;
+    try
+    {
+      block_complete_entry cached;
+      if (m_recent_block_cache.get(block_hash, arg.prune, cached))
+      {
+        rsp.blocks.push_back(std::move(cached));
+        continue;
+      }
 
-    rsp.blocks.push_back(block_complete_entry());
-    block_complete_entry& e = rsp.blocks.back();
+      uint64_t height = 0;
+      if (!m_db->block_exists(block_hash, &height))
+      {
+        rsp.missed_ids.push_back(block_hash);
+        continue;
+      }
 
-    // FIXME: s/rsp.missed_ids/missed_tx_id/ ?  Seems like rsp.missed_ids
-    //        is for missed blocks, not missed transactions as well.
-    e.pruned = arg.prune;
-    get_transactions_blobs(bl.second.tx_hashes, e.txs, missed_tx_ids, arg.prune);
-    if (missed_tx_ids.size() != 0)
-    {
-      // do not display an error if the peer asked for an unpruned block which we are not meant to have
-      if (tools::has_unpruned_block(get_block_height(bl.second), get_current_blockchain_height(), get_blockchain_pruning_seed()))
+      if (!m_db->get_block_txs(height, NULL, txs, arg.prune ? &prunable_hashes : NULL, arg.prune))
       {
-        LOG_ERROR("Error retrieving blocks, missed " << missed_tx_ids.size()
-            << " transactions for block with hash: " << get_block_hash(bl.second)
-            << std::endl
-        );
+        // do not display an error if the peer asked for an unpruned block which we are not meant to have
+        if (tools::has_unpruned_block(height, get_current_blockchain_height(), get_blockchain_pruning_seed()))
+        {
+          LOG_ERROR("Error retrieving blocks, missed transactions for block with hash: " << block_hash);
+        }
+        return false;
       }
 
-      // append missed transaction hashes to response missed_ids field,
-      // as done below if any standalone transactions were requested
-      // and missed.
-      rsp.missed_ids.insert(rsp.missed_ids.end(), missed_tx_ids.begin(), missed_tx_ids.end());
+      rsp.blocks.push_back(block_complete_entry());
+      block_complete_entry& e = rsp.blocks.back();
+      e.pruned = arg.prune;
+      e.block = m_db->get_block_blob_from_height(height);
+      e.block_weight = arg.prune ? m_db->get_block_weight(height) : 0;
+      e.txs.resize(txs.size());
+      for (size_t i = 0; i < txs.size(); ++i)
+      {
+        e.txs[i].blob = std::move(txs[i].second);
+        if (arg.prune)
+          e.txs[i].prunable_hash = prunable_hashes[i];
+      }
+    }
+    catch (const std::exception& e)
+    {
       return false;
     }
-
-    //pack block
-    e.block = std::move(bl.first);
-    e.block_weight = 0;
-    if (arg.prune && m_db->block_exists(arg.blocks[i]))
-      e.block_weight = m_db->get_block_weight(m_db->get_block_height(arg.blocks[i]));
   }
 
   return true;
@@ -2177,7 +2275,7 @@ bool Blockchain::get_outs(const COMMAND_RPC_GET_OUTPUTS_BIN::request& req, COMMA
       amounts.push_back(i.amount);
       offsets.push_back(i.index);
     }
-    m_db->get_output_key(epee::span<const uint64_t>(amounts.data(), amounts.size()), offsets, data);
+    get_output_keys(epee::span<const uint64_t>(amounts.data(), amounts.size()), offsets, data);
     if (data.size() != req.outputs.size())
     {
       MERROR("Unexpected output data size: expected " << req.outputs.size() << ", got " << data.size());
@@ -2204,11 +2302,46 @@ bool Blockchain::get_outs(const COMMAND_RPC_GET_OUTPUTS_BIN::request& req, COMMA
 //------------------------------------------------------------------
 void Blockchain::get_output_key_mask_unlocked(const uint64_t& amount, const uint64_t& index, crypto::public_key& key, rct::key& mask, bool& unlocked) const
 {
-  const auto o_data = m_db->get_output_key(amount, index);
-  key = o_data.pubkey;
-  mask = o_data.commitment;
-  tx_out_index toi = m_db->get_output_tx_and_index(amount, index);
-  unlocked = is_tx_spendtime_unlocked(m_db->get_tx_unlock_time(toi.first));
+  std::vector<output_data_t> o_data;
+  get_output_keys(epee::span<const uint64_t>(&amount, 1), {index}, o_data);
+  key = o_data[0].pubkey;
+  mask = o_data[0].commitment;
+  // the output's unlock time is its transaction's unlock time
+  unlocked = is_tx_spendtime_unlocked(o_data[0].unlock_time);
+}
+//------------------------------------------------------------------
+void Blockchain::get_output_keys(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial) const
+{
+  if (amounts.size() != 1 && amounts.size() != offsets.size())
+    throw DB_ERROR("Invalid sizes of amounts and offets");
+
+  outputs.resize(offsets.size());
+  std::vector<size_t> missed;
+  std::vector<uint64_t> missed_amounts, missed_offsets;
+  for (size_t i = 0; i < offsets.size(); ++i)
+  {
+    const uint64_t amount = amounts.size() == 1 ? amounts[0] : amounts[i];
+    if (!m_output_key_cache.get(amount, offsets[i], outputs[i]))
+    {
+      missed.push_back(i);
+      missed_amounts.push_back(amount);
+      missed_offsets.push_back(offsets[i]);
+    }
+  }
+  if (missed.empty())
+    return;
+
+  std::vector<output_data_t> missed_outputs;
+  m_db->get_output_key(epee::span<const uint64_t>(missed_amounts.data(), missed_amounts.size()), missed_offsets, missed_outputs, allow_partial);
+  for (size_t i = 0; i < missed_outputs.size(); ++i)
+  {
+    outputs[missed[i]] = missed_outputs[i];
+    m_output_key_cache.add(missed_amounts[i], missed_offsets[i], missed_outputs[i]);
+  }
+
+  // a partial db result stops at the first missing output, so must we
+  if (missed_outputs.size() < missed.size())
+    outputs.resize(missed[missed_outputs.size()]);
 }
 //------------------------------------------------------------------
 bool Blockchain::get_output_distribution(uint64_t amount, uint64_t from_height, uint64_t to_height, uint64_t &start_height, std::vector<uint64_t> &distribution, uint64_t &base) const
@@ -2243,12 +2376,8 @@ bool Blockchain::get_output_distribution(uint64_t amount, uint64_t from_height,
     return false;
   if (amount == 0)
   {
-    std::vector<uint64_t> heights;
-    heights.reserve(to_height + 1 - start_height);
     const uint64_t real_start_height = start_height > 0 ? start_height-1 : start_height;
-    for (uint64_t h = real_start_height; h <= to_height; ++h)
-      heights.push_back(h);
-    distribution = m_db->get_block_cumulative_rct_outputs(heights);
+    distribution = m_db->get_rct_output_distribution(real_start_height, to_height);
     if (start_height > 0)
     {
       base = distribution[0];
@@ -2641,24 +2770,16 @@ bool Blockchain::find_blockchain_supplement(const uint64_t req_start_block, cons
   for(uint64_t i = start_height; i < total_height && count < max_count && (size < FIND_BLOCKCHAIN_SUPPLEMENT_MAX_SIZE || count < 3); i++, count++)
   {
     blocks.resize(blocks.size()+1);
-    blocks.back().first.first = m_db->get_block_blob_from_height(i);
-    block b;
-    CHECK_AND_ASSERT_MES(parse_and_validate_block_from_blob(blocks.back().first.first, b), false, "internal error, invalid block");
-    blocks.back().first.second = get_miner_tx_hash ? cryptonote::get_transaction_hash(b.miner_tx) : crypto::null_hash;
-    std::vector<crypto::hash> mis;
-    std::vector<cryptonote::blobdata> txs;
-    get_transactions_blobs(b.tx_hashes, txs, mis, pruned);
-    CHECK_AND_ASSERT_MES(!mis.size(), false, "internal error, transaction from block not found");
-    size += blocks.back().first.first.size();
-    for (const auto &t: txs)
-      size += t.size();
-
-    CHECK_AND_ASSERT_MES(txs.size() == b.tx_hashes.size(), false, "mismatched sizes of b.tx_hashes and txs");
-    blocks.back().second.reserve(txs.size());
-    for (size_t i = 0; i < txs.size(); ++i)
+    crypto::hash miner_tx_hash;
+    if (!m_recent_block_cache.get(i, pruned, blocks.back().first.first, miner_tx_hash, blocks.back().second))
     {
-      blocks.back().second.push_back(std::make_pair(b.tx_hashes[i], std::move(txs[i])));
+      blocks.back().first.first = m_db->get_block_blob_from_height(i);
+      CHECK_AND_ASSERT_MES(m_db->get_block_txs(i, &miner_tx_hash, blocks.back().second, NULL, pruned), false, "internal error, transaction from block not found");
     }
+    blocks.back().first.second = get_miner_tx_hash ? miner_tx_hash : crypto::null_hash;
+    size += blocks.back().first.first.size();
+    for (const auto &t: blocks.back().second)
+      size += t.second.size();
   }
   return true;
 }
@@ -2826,7 +2947,8 @@ void Blockchain::on_new_tx_from_block(const cryptonote::transaction &tx)
 {
 #if defined(PER_BLOCK_CHECKPOINT)
   // check if we're doing per-block checkpointing
-  if (m_db->height() < m_blocks_hash_check.size())
+  const std::shared_ptr<block_hash_check> check = std::atomic_load(&m_blocks_hash_check);
+  if (check && m_db->height() < check->size())
   {
     TIME_MEASURE_START(a);
     m_blocks_txs_check.push_back(get_transaction_hash(tx));
@@ -2855,7 +2977,8 @@ bool Blockchain::check_tx_inputs(transaction& tx, uint64_t& max_used_block_heigh
 
 #if defined(PER_BLOCK_CHECKPOINT)
   // check if we're doing per-block checkpointing
-  if (m_db->height() < m_blocks_hash_check.size() && kept_by_block)
+  const std::shared_ptr<block_hash_check> check = std::atomic_load(&m_blocks_hash_check);
+  if (check && m_db->height() < check->size() && kept_by_block)
   {
     max_used_block_id = null_hash;
     max_used_block_height = 0;
@@ -3926,11 +4049,12 @@ leave:
   // validate proof_of_work versus difficulty target
   bool precomputed = false;
   bool fast_check = false;
+  const std::shared_ptr<block_hash_check> check = std::atomic_load(&m_blocks_hash_check);
 #if defined(PER_BLOCK_CHECKPOINT)
-  if (blockchain_height < m_blocks_hash_check.size())
+  if (check && blockchain_height < check->size())
   {
-    const auto &expected_hash = m_blocks_hash_check[blockchain_height].first;
-    if (expected_hash != crypto::null_hash)
+    crypto::hash expected_hash;
+    if (check->get_hash(blockchain_height, expected_hash))
     {
       if (memcmp(&id, &expected_hash, sizeof(hash)) != 0)
       {
@@ -4126,12 +4250,13 @@ leave:
   // if we were syncing pruned blocks
   if (n_pruned > 0)
   {
-    if (blockchain_height >= m_blocks_hash_check.size() || m_blocks_hash_check[blockchain_height].second == 0)
+    uint64_t weight = 0;
+    if (!check || !check->get_weight(blockchain_height, weight) || weight == 0)
     {
       MERROR("Block at " << blockchain_height << " is pruned, but we do not have a weight for it");
       goto leave;
     }
-    cumulative_block_weight = m_blocks_hash_check[blockchain_height].second;
+    cumulative_block_weight = weight;
   }
 
   m_blocks_txs_check.clear();
@@ -4180,7 +4305,15 @@ leave:
     {
       uint64_t long_term_block_weight = get_next_long_term_block_weight(block_weight);
       cryptonote::blobdata bd = cryptonote::block_to_blob(bl);
+      cryptonote::blobdata cached_bd = bd;
+      const crypto::hash miner_tx_hash = get_transaction_hash(bl.miner_tx);
       new_height = m_db->add_block(std::make_pair(std::move(bl), std::move(bd)), block_weight, long_term_block_weight, cumulative_difficulty, already_generated_coins, txs);
+
+      std::vector<recent_block_cache::tx_entry> cached_txs;
+      if (make_recent_block_cache_txs(txs, cached_txs))
+        m_recent_block_cache.add(new_height - 1, id, std::move(cached_bd), block_weight, miner_tx_hash, std::move(cached_txs));
+      else
+        m_recent_block_cache.invalidate_from_height(new_height - 1);
     }
     catch (const KEY_IMAGE_EXISTS& e)
     {
@@ -4246,7 +4379,48 @@ bool Blockchain::prune_blockchain(uint32_t pruning_seed)
   epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
-  return m_db->prune_blockchain(pruning_seed);
+  // only the first step runs here, the rest of the pass runs in the background
+  bool finished = false;
+  size_t pruned = 0;
+  if (!m_db->prune_blockchain_step(pruning_seed, CRYPTONOTE_PRUNING_STEP_TXES, finished, pruned))
+    return false;
+  m_pruning_pass_pruned = pruned;
+  m_pruning_in_progress = !finished;
+  return true;
+}
+//------------------------------------------------------------------
+bool Blockchain::prune_blockchain_step(size_t max_txes)
+{
+  if (!m_pruning_in_progress)
+    return true;
+
+  // yield to block processing and RPC rather than waiting for the locks
+  if (!m_tx_pool.try_lock())
+    return true;
+  epee::misc_utils::auto_scope_leave_caller unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_tx_pool.unlock();});
+  if (!m_blockchain_lock.tryLock())
+  {
+    MDEBUG("Blockchain busy, skipping pruning step");
+    return true;
+  }
+  epee::misc_utils::auto_scope_leave_caller blockchain_unlocker = epee::misc_utils::create_scope_leave_handler([&](){m_blockchain_lock.unlock();});
+
+  bool finished = false;
+  size_t pruned = 0;
+  if (!m_db->prune_blockchain_step(0, max_txes, finished, pruned))
+    return false;
+  m_pruning_pass_pruned += pruned;
+  if (finished)
+  {
+    // an already pruned node gets here on its first step after every restart
+    if (m_pruning_pass_pruned)
+      MGINFO("Blockchain pruning complete, " << m_pruning_pass_pruned << " transactions pruned");
+    else
+      MDEBUG("Blockchain pruning had nothing to do");
+    m_pruning_pass_pruned = 0;
+    m_pruning_in_progress = false;
+  }
+  return true;
 }
 //------------------------------------------------------------------
 bool Blockchain::update_blockchain_pruning()
@@ -4426,7 +4600,10 @@ void Blockchain::check_against_checkpoints(const checkpoints& points, bool enfor
     }
   }
   if (stop_batch)
+  {
     m_db->batch_stop();
+    m_recent_block_cache.commit();
+  }
 }
 //------------------------------------------------------------------
 // returns false if any of the checkpoints loading returns false.
@@ -4514,9 +4691,17 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   try
   {
     if (m_batch_success)
+    {
       m_db->batch_stop();
+      m_recent_block_cache.commit();
+    }
     else
+    {
       m_db->batch_abort();
+      m_recent_block_cache.rollback();
+      // outputs of the aborted blocks may have been cached while verifying later ones
+      m_output_key_cache.invalidate_from_height(m_db->height());
+    }
     success = true;
   }
   catch (const std::exception &e)
@@ -4558,11 +4743,12 @@ bool Blockchain::cleanup_handle_incoming_blocks(bool force_sync)
   m_blocks_txs_check.clear();
 
   // when we're well clear of the precomputed hashes, free the memory
-  if (!m_blocks_hash_check.empty() && m_db->height() > m_blocks_hash_check.size() + 4096)
+  // (a reader still holding it keeps its own reference until done)
+  const std::shared_ptr<block_hash_check> check = std::atomic_load(&m_blocks_hash_check);
+  if (check && m_db->height() > check->size() + 4096)
   {
-    MINFO("Dumping block hashes, we're now 4k past " << m_blocks_hash_check.size());
-    m_blocks_hash_check.clear();
-    m_blocks_hash_check.shrink_to_fit();
+    MINFO("Dumping block hashes, we're now 4k past " << check->size());
+    std::atomic_store(&m_blocks_hash_check, std::shared_ptr<block_hash_check>());
   }
 
   CRITICAL_REGION_END();
@@ -4598,11 +4784,12 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
   CHECK_AND_ASSERT_MES(weights.empty() || weights.size() == hashes.size(), 0, "Unexpected weights size");
 
   // easy case: height >= hashes
-  if (height >= m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP)
+  if (height >= m_compiled_block_hash_area)
     return hashes.size();
 
   // if we're getting old blocks, we might have jettisoned the hashes already
-  if (m_blocks_hash_check.empty())
+  const std::shared_ptr<block_hash_check> check = std::atomic_load(&m_blocks_hash_check);
+  if (!check)
     return hashes.size();
 
   // find hashes encompassing those block
@@ -4654,50 +4841,18 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
     }
   }
 
-  // hash and check
+  // hash and check, the chunks covered by the compiled in hashes in parallel
   uint64_t usable = first_index * HASH_OF_HASHES_STEP - height; // may start negative, but unsigned under/overflow is not UB
-  for (size_t n = first_index; n <= last_index; ++n)
+  const size_t compiled_chunks = first_index <= last_index && first_index < check->num_chunks() ? std::min<size_t>(last_index + 1, check->num_chunks()) - first_index : 0;
+  // if the last index isn't fully filled, we can't tell if valid
+  const size_t nchunks = std::min<size_t>(compiled_chunks, data_hashes.size() / HASH_OF_HASHES_STEP);
+  const size_t valid = check->verify(first_index, data_hashes, data_weights, nchunks);
+  usable += valid * HASH_OF_HASHES_STEP;
+  if (valid == compiled_chunks)
   {
-    if (n < m_blocks_hash_of_hashes.size())
-    {
-      // if the last index isn't fully filled, we can't tell if valid
-      if (data_hashes.size() < (n - first_index) * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP)
-        break;
-
-      crypto::hash hash;
-      cn_fast_hash(data_hashes.data() + (n - first_index) * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP * sizeof(crypto::hash), hash);
-      bool valid = hash == m_blocks_hash_of_hashes[n].first;
-      if (valid && !weights.empty())
-      {
-        cn_fast_hash(data_weights.data() + (n - first_index) * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP * sizeof(uint64_t), hash);
-        valid &= hash == m_blocks_hash_of_hashes[n].second;
-      }
-
-      // add to the known hashes array
-      if (!valid)
-      {
-        MDEBUG("invalid hash for blocks " << n * HASH_OF_HASHES_STEP << " - " << (n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP - 1));
-        break;
-      }
-
-      size_t end = n * HASH_OF_HASHES_STEP + HASH_OF_HASHES_STEP;
-      for (size_t i = n * HASH_OF_HASHES_STEP; i < end; ++i)
-      {
-        CHECK_AND_ASSERT_MES(m_blocks_hash_check[i].first == crypto::null_hash || m_blocks_hash_check[i].first == data_hashes[i - first_index * HASH_OF_HASHES_STEP],
-            0, "Consistency failure in m_blocks_hash_check construction");
-        m_blocks_hash_check[i].first = data_hashes[i - first_index * HASH_OF_HASHES_STEP];
-        if (!weights.empty())
-        {
-          CHECK_AND_ASSERT_MES(m_blocks_hash_check[i].second == 0 || m_blocks_hash_check[i].second == data_weights[i - first_index * HASH_OF_HASHES_STEP],
-              0, "Consistency failure in m_blocks_hash_check construction");
-          m_blocks_hash_check[i].second = data_weights[i - first_index * HASH_OF_HASHES_STEP];
-        }
-      }
-      usable += HASH_OF_HASHES_STEP;
-    }
-    else
+    // if after the end of the precomputed blocks, accept anything
+    for (size_t n = first_index + compiled_chunks; n <= last_index; ++n)
     {
-      // if after the end of the precomputed blocks, accept anything
       usable += HASH_OF_HASHES_STEP;
       if (usable > hashes.size())
         usable = hashes.size();
@@ -4711,13 +4866,8 @@ uint64_t Blockchain::prevalidate_block_hashes(uint64_t height, const std::vector
 bool Blockchain::has_block_weights(uint64_t height, uint64_t nblocks) const
 {
   CHECK_AND_ASSERT_MES(nblocks > 0, false, "nblocks is 0");
-  uint64_t last_block_height = height + nblocks - 1;
-  if (last_block_height >= m_blocks_hash_check.size())
-    return false;
-  for (uint64_t h = height; h <= last_block_height; ++h)
-    if (m_blocks_hash_check[h].second == 0)
-      return false;
-  return true;
+  const std::shared_ptr<block_hash_check> check = std::atomic_load(&m_blocks_hash_check);
+  return check && check->has_weights(height, nblocks);
 }
 
 //------------------------------------------------------------------
@@ -4776,7 +4926,8 @@ bool Blockchain::prepare_handle_incoming_blocks(const std::vector<block_complete
   m_batch_success = true;
 
   const uint64_t height = m_db->height();
-  if ((height + blocks_entry.size()) < m_blocks_hash_check.size())
+  const std::shared_ptr<block_hash_check> check = std::atomic_load(&m_blocks_hash_check);
+  if (check && (height + blocks_entry.size()) < check->size())
     return true;
 
   bool blocks_exist = false;
@@ -5303,7 +5454,8 @@ void Blockchain::load_compiled_in_block_hashes(const GetCheckpointsCallback& get
       if(nblocks > 0 && nblocks > (m_db->height() + HASH_OF_HASHES_STEP - 1) / HASH_OF_HASHES_STEP && checkpoints.size() >= size_needed)
       {
         p += sizeof(uint32_t);
-        m_blocks_hash_of_hashes.reserve(nblocks);
+        std::vector<std::pair<crypto::hash, crypto::hash>> hash_of_hashes;
+        hash_of_hashes.reserve(nblocks);
         for (uint32_t i = 0; i < nblocks; i++)
         {
           crypto::hash hash_hashes, hash_weights;
@@ -5311,9 +5463,10 @@ void Blockchain::load_compiled_in_block_hashes(const GetCheckpointsCallback& get
           p += sizeof(hash_hashes.data);
           memcpy(hash_weights.data, p, sizeof(hash_weights.data));
           p += sizeof(hash_weights.data);
-          m_blocks_hash_of_hashes.push_back(std::make_pair(hash_hashes, hash_weights));
+          hash_of_hashes.push_back(std::make_pair(hash_hashes, hash_weights));
         }
-        m_blocks_hash_check.resize(m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP, std::make_pair(crypto::null_hash, 0));
+        m_compiled_block_hash_area = hash_of_hashes.size() * HASH_OF_HASHES_STEP;
+        std::atomic_store(&m_blocks_hash_check, std::make_shared<block_hash_check>(std::move(hash_of_hashes)));
         MINFO(nblocks << " block hashes loaded");
 
         // FIXME: clear tx_pool because the process might have been
@@ -5345,7 +5498,7 @@ void Blockchain::load_compiled_in_block_hashes(const GetCheckpointsCallback& get
 bool Blockchain::is_within_compiled_block_hash_area(uint64_t height) const
 {
 #if defined(PER_BLOCK_CHECKPOINT)
-  return height < m_blocks_hash_of_hashes.size() * HASH_OF_HASHES_STEP;
+  return height < m_compiled_block_hash_area;
 #else
   return false;
 #endif
@@ -58,6 +58,9 @@
 #include "checkpoints/checkpoints.h"
 #include "cryptonote_basic/hardfork.h"
 #include "blockchain_db/blockchain_db.h"
+#include "output_key_cache.h"
+#include "recent_block_cache.h"
+#include "block_hash_check.h"
 
 namespace tools { class Notify; }
 
@@ -510,6 +513,45 @@ namespace cryptonote
      */
     void get_output_key_mask_unlocked(const uint64_t& amount, const uint64_t& index, crypto::public_key& key, rct::key& mask, bool& unlocked) const;
 
+    /**
+     * @brief gets output data, going through the shared output key cache
+     *
+     * Same semantics as BlockchainDB::get_output_key, but outputs found in
+     * the cache are not looked up in the db, and outputs read from the db
+     * are added to the cache.
+     *
+     * @param amounts the output amounts, either one for all offsets or one per offset
+     * @param offsets the output global amount indices
+     * @param outputs return-by-reference the output data
+     * @param allow_partial whether to stop at the first missing output instead of throwing
+     */
+    void get_output_keys(const epee::span<const uint64_t> &amounts, const std::vector<uint64_t> &offsets, std::vector<output_data_t> &outputs, bool allow_partial = false) const;
+
+    /**
+     * @brief gets the output key cache hit/miss counters and size
+     *
+     * @return the output key cache stats
+     */
+    output_key_cache::stats get_output_key_cache_stats() const { return m_output_key_cache.get_stats(); }
+
+    /**
+     * @brief gets a block near the top of the chain as sent to peers, if cached
+     *
+     * @param h the hash of the block
+     * @param pruned whether to prune the block's txes
+     * @param e return-by-reference the block entry
+     *
+     * @return true if the block was found in the recent block cache, false otherwise
+     */
+    bool get_recent_block(const crypto::hash &h, bool pruned, block_complete_entry &e) const { return m_recent_block_cache.get(h, pruned, e); }
+
+    /**
+     * @brief gets the recent block cache hit/miss counters and size
+     *
+     * @return the recent block cache stats
+     */
+    recent_block_cache::stats get_recent_block_cache_stats() const { return m_recent_block_cache.get_stats(); }
+
     /**
      * @brief gets per block distribution of outputs of a given amount
      *
@@ -983,6 +1025,19 @@ namespace cryptonote
     uint64_t prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes, const std::vector<uint64_t> &weights);
     uint32_t get_blockchain_pruning_seed() const { return m_db->get_blockchain_pruning_seed(); }
     bool prune_blockchain(uint32_t pruning_seed = 0);
+
+    /**
+     * @brief continues a pruning pass in progress, if any
+     *
+     * Looks at no more than max_txes transactions.  If the txpool or the
+     * blockchain is busy, the step is skipped and retried on a later call.
+     *
+     * @param max_txes the maximum number of transactions to look at
+     *
+     * @return false on error, true otherwise
+     */
+    bool prune_blockchain_step(size_t max_txes);
+    bool is_pruning_in_progress() const { return m_pruning_in_progress; }
     bool update_blockchain_pruning();
     bool check_blockchain_pruning();
 
@@ -1050,10 +1105,14 @@ namespace cryptonote
     // metadata containers
     std::unordered_map<crypto::hash, std::unordered_map<crypto::key_image, std::vector<output_data_t>>> m_scan_table;
     std::unordered_map<crypto::hash, crypto::hash> m_blocks_longhash_table;
+    mutable output_key_cache m_output_key_cache;
+    mutable recent_block_cache m_recent_block_cache;
 
     // Keccak hashes for each block and for fast pow checking
-    std::vector<std::pair<crypto::hash, crypto::hash>> m_blocks_hash_of_hashes;
-    std::vector<std::pair<crypto::hash, uint64_t>> m_blocks_hash_check;
+    // only ever accessed through std::atomic_load/std::atomic_store, as it
+    // is filled by prevalidate_block_hashes without the blockchain lock
+    std::shared_ptr<block_hash_check> m_blocks_hash_check;
+    uint64_t m_compiled_block_hash_area;
     std::vector<crypto::hash> m_blocks_txs_check;
 
     blockchain_db_sync_mode m_db_sync_mode;
@@ -1097,6 +1156,9 @@ namespace cryptonote
 
     std::atomic<bool> m_cancel;
 
+    std::atomic<bool> m_pruning_in_progress;
+    uint64_t m_pruning_pass_pruned; // txes pruned so far by the pass in progress
+
     // block template cache
     block m_btc;
     account_public_address m_btc_address;
@@ -1205,6 +1267,28 @@ namespace cryptonote
      */
     block pop_block_from_blockchain();
 
+    /**
+     * @brief removes blocks from the top of the blockchain down to a given height
+     *
+     * All blocks are popped from the database first, then the hard fork
+     * state, the cached weight limit and the tx pool are updated once for
+     * the whole range rather than once per block.  The caller is expected
+     * to hold a batch transaction so the whole disconnect is atomic.
+     *
+     * @param new_height the chain height to stop at
+     * @param disconnected_chain return-by-reference the popped blocks, oldest first
+     */
+    void disconnect_blocks(uint64_t new_height, std::list<block>& disconnected_chain);
+
+    /**
+     * @brief returns transactions from disconnected blocks to the tx pool
+     *
+     * Miner and pruned transactions are skipped.
+     *
+     * @param txs the transactions to return
+     */
+    void return_txs_to_pool(std::vector<transaction>& txs);
+
     /**
      * @brief validate and add a new block to the end of the blockchain
      *
@@ -697,7 +697,7 @@ namespace cryptonote
       // display a message if the blockchain is not pruned yet
       if (!m_blockchain_storage.get_blockchain_pruning_seed())
       {
-        MGINFO("Pruning blockchain...");
+        MGINFO("Pruning blockchain in the background...");
         CHECK_AND_ASSERT_MES(m_blockchain_storage.prune_blockchain(), false, "Failed to prune blockchain");
       }
       else
@@ -1680,6 +1680,11 @@ namespace cryptonote
     return m_blockchain_storage.get_block_by_hash(h, blk, orphan);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::get_recent_block(const crypto::hash &h, bool pruned, block_complete_entry &e) const
+  {
+    return m_blockchain_storage.get_recent_block(h, pruned, e);
+  }
+  //-----------------------------------------------------------------------------------------------
   std::string core::print_pool(bool short_format) const
   {
     return m_mempool.print_pool(short_format);
@@ -1718,6 +1723,7 @@ namespace cryptonote
     m_check_disk_space_interval.do_call(boost::bind(&core::check_disk_space, this));
     m_block_rate_interval.do_call(boost::bind(&core::check_block_rate, this));
     m_blockchain_pruning_interval.do_call(boost::bind(&core::update_blockchain_pruning, this));
+    m_blockchain_pruning_step_interval.do_call(boost::bind(&core::prune_blockchain_step, this));
     m_miner.on_idle();
     m_mempool.on_idle();
     return true;
@@ -1993,6 +1999,15 @@ namespace cryptonote
     return m_blockchain_storage.update_blockchain_pruning();
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::prune_blockchain_step()
+  {
+    if (!m_blockchain_storage.is_pruning_in_progress())
+      return true;
+    // keep steps short while syncing so block processing is not held up
+    const bool syncing = get_current_blockchain_height() < get_target_blockchain_height();
+    return m_blockchain_storage.prune_blockchain_step(syncing ? CRYPTONOTE_PRUNING_SYNC_STEP_TXES : CRYPTONOTE_PRUNING_STEP_TXES);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::check_blockchain_pruning()
   {
     return m_blockchain_storage.check_blockchain_pruning();
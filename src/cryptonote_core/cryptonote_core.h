@@ -405,6 +405,13 @@ namespace cryptonote
       */
      bool get_block_by_hash(const crypto::hash &h, block &blk, bool *orphan = NULL) const;
 
+     /**
+      * @copydoc Blockchain::get_recent_block
+      *
+      * @note see Blockchain::get_recent_block
+      */
+     bool get_recent_block(const crypto::hash &h, bool pruned, block_complete_entry &e) const;
+
      /**
       * @copydoc Blockchain::get_alternative_blocks
       *
@@ -843,6 +850,13 @@ namespace cryptonote
       */
      bool update_blockchain_pruning();
 
+     /**
+      * @brief runs one bounded step of a pruning pass in progress
+      *
+      * @return true on success, false otherwise
+      */
+     bool prune_blockchain_step();
+
      /**
       * @brief checks the blockchain pruning if enabled
       *
@@ -1067,6 +1081,7 @@ namespace cryptonote
      epee::math_helper::once_a_time_seconds<60*10, true> m_check_disk_space_interval; //!< interval for checking for disk space
      epee::math_helper::once_a_time_seconds<90, false> m_block_rate_interval; //!< interval for checking block rate
      epee::math_helper::once_a_time_seconds<60*60*5, true> m_blockchain_pruning_interval; //!< interval for incremental blockchain pruning
+     epee::math_helper::once_a_time_seconds<5, true> m_blockchain_pruning_step_interval; //!< interval for background pruning steps
 
      std::atomic<bool> m_starter_message_showed; //!< has the "daemon will sync now" message been shown?
 
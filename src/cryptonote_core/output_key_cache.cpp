@@ -0,0 +1,146 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "output_key_cache.h"
+
+#undef BITTUBE_DEFAULT_LOG_CATEGORY
+#define BITTUBE_DEFAULT_LOG_CATEGORY "blockchain"
+
+namespace cryptonote
+{
+
+constexpr size_t output_key_cache::NUM_SHARDS;
+
+output_key_cache::output_key_cache(size_t max_entries):
+  m_max_entries_per_shard((max_entries + NUM_SHARDS - 1) / NUM_SHARDS),
+  m_hits(0),
+  m_misses(0)
+{
+}
+
+bool output_key_cache::get(uint64_t amount, uint64_t index, output_data_t &data)
+{
+  const key_t k(amount, index);
+  shard &s = get_shard(k);
+  boost::lock_guard<boost::mutex> lock(s.lock);
+  const auto i = s.entries.find(k);
+  if (i == s.entries.end())
+  {
+    ++m_misses;
+    return false;
+  }
+  s.lru.splice(s.lru.begin(), s.lru, i->second);
+  data = i->second->second;
+  ++m_hits;
+  return true;
+}
+
+void output_key_cache::add(uint64_t amount, uint64_t index, const output_data_t &data)
+{
+  const size_t max_entries = m_max_entries_per_shard;
+  if (max_entries == 0)
+    return;
+
+  const key_t k(amount, index);
+  shard &s = get_shard(k);
+  boost::lock_guard<boost::mutex> lock(s.lock);
+  const auto i = s.entries.find(k);
+  if (i != s.entries.end())
+  {
+    i->second->second = data;
+    s.lru.splice(s.lru.begin(), s.lru, i->second);
+    return;
+  }
+  s.lru.emplace_front(k, data);
+  s.entries.emplace(k, s.lru.begin());
+  trim(s, max_entries);
+}
+
+void output_key_cache::invalidate_from_height(uint64_t height)
+{
+  for (shard &s: m_shards)
+  {
+    boost::lock_guard<boost::mutex> lock(s.lock);
+    for (auto i = s.lru.begin(); i != s.lru.end(); )
+    {
+      if (i->second.height >= height)
+      {
+        s.entries.erase(i->first);
+        i = s.lru.erase(i);
+      }
+      else
+        ++i;
+    }
+  }
+}
+
+void output_key_cache::clear()
+{
+  for (shard &s: m_shards)
+  {
+    boost::lock_guard<boost::mutex> lock(s.lock);
+    s.entries.clear();
+    s.lru.clear();
+  }
+}
+
+void output_key_cache::set_max_entries(size_t max_entries)
+{
+  const size_t max_entries_per_shard = (max_entries + NUM_SHARDS - 1) / NUM_SHARDS;
+  m_max_entries_per_shard = max_entries_per_shard;
+  for (shard &s: m_shards)
+  {
+    boost::lock_guard<boost::mutex> lock(s.lock);
+    trim(s, max_entries_per_shard);
+  }
+}
+
+output_key_cache::stats output_key_cache::get_stats() const
+{
+  stats st;
+  st.hits = m_hits;
+  st.misses = m_misses;
+  st.entries = 0;
+  for (const shard &s: m_shards)
+  {
+    boost::lock_guard<boost::mutex> lock(s.lock);
+    st.entries += s.entries.size();
+  }
+  return st;
+}
+
+void output_key_cache::trim(shard &s, size_t max_entries)
+{
+  while (s.entries.size() > max_entries)
+  {
+    s.entries.erase(s.lru.back().first);
+    s.lru.pop_back();
+  }
+}
+
+}
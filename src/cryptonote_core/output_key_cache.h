@@ -0,0 +1,122 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
+#include <utility>
+#include <boost/thread/mutex.hpp>
+#include "blockchain_db/blockchain_db.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief a bounded LRU cache of output data, keyed by amount and global index
+   *
+   * The cache is split into shards, each with its own lock and LRU list, so
+   * that concurrent lookups from the verification and RPC paths seldom
+   * contend.  Outputs are immutable while their block is in the chain, so
+   * the only invalidation needed is dropping outputs created at or above a
+   * height when blocks are popped.
+   */
+  class output_key_cache
+  {
+  public:
+    struct stats
+    {
+      uint64_t hits;
+      uint64_t misses;
+      uint64_t entries;
+    };
+
+    /**
+     * @brief constructor
+     *
+     * @param max_entries the maximum number of outputs kept, 0 disables the cache
+     */
+    output_key_cache(size_t max_entries);
+
+    /**
+     * @brief looks up an output, marking it as recently used
+     *
+     * @return true if the output was found, and data was set
+     */
+    bool get(uint64_t amount, uint64_t index, output_data_t &data);
+
+    /**
+     * @brief adds an output, evicting the least recently used one in its shard if full
+     */
+    void add(uint64_t amount, uint64_t index, const output_data_t &data);
+
+    /**
+     * @brief drops all outputs created at or above the given height
+     */
+    void invalidate_from_height(uint64_t height);
+
+    /**
+     * @brief drops all outputs
+     */
+    void clear();
+
+    /**
+     * @brief sets the maximum number of outputs kept, evicting as needed
+     */
+    void set_max_entries(size_t max_entries);
+
+    stats get_stats() const;
+
+  private:
+    typedef std::pair<uint64_t, uint64_t> key_t; // amount, global index
+
+    struct key_hash
+    {
+      size_t operator()(const key_t &k) const { return std::hash<uint64_t>()(k.first * 0x9e3779b97f4a7c15ull ^ k.second); }
+    };
+
+    typedef std::list<std::pair<key_t, output_data_t>> lru_list_t;
+
+    struct shard
+    {
+      mutable boost::mutex lock;
+      lru_list_t lru;
+      std::unordered_map<key_t, lru_list_t::iterator, key_hash> entries;
+    };
+
+    static constexpr size_t NUM_SHARDS = 16;
+
+    shard &get_shard(const key_t &k) { return m_shards[key_hash()(k) % NUM_SHARDS]; }
+    void trim(shard &s, size_t max_entries);
+
+    shard m_shards[NUM_SHARDS];
+    std::atomic<size_t> m_max_entries_per_shard;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+  };
+}
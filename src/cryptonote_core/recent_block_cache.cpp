@@ -0,0 +1,177 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "recent_block_cache.h"
+
+#undef BITTUBE_DEFAULT_LOG_CATEGORY
+#define BITTUBE_DEFAULT_LOG_CATEGORY "blockchain"
+
+namespace cryptonote
+{
+
+recent_block_cache::recent_block_cache(size_t max_size):
+  m_committed_end(0),
+  m_max_size(max_size),
+  m_size(0),
+  m_hits(0),
+  m_misses(0)
+{
+}
+
+void recent_block_cache::add(uint64_t height, const crypto::hash &block_hash, cryptonote::blobdata block_blob, uint64_t block_weight, const crypto::hash &miner_tx_hash, std::vector<tx_entry> txs)
+{
+  if (m_max_size == 0)
+    return;
+
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  if (!m_blocks.empty() && height > m_blocks.rbegin()->first + 1)
+  {
+    m_blocks.clear();
+    m_heights.clear();
+    m_size = 0;
+  }
+  erase_from_height(height);
+
+  block_entry &e = m_blocks[height];
+  e.hash = block_hash;
+  e.blob = std::move(block_blob);
+  e.weight = block_weight;
+  e.miner_tx_hash = miner_tx_hash;
+  e.txs = std::move(txs);
+  e.size = e.blob.size();
+  for (const tx_entry &tx: e.txs)
+    e.size += tx.blob.size();
+  m_heights[block_hash] = height;
+  m_size += e.size;
+
+  while (m_size > m_max_size && !m_blocks.empty())
+    erase(m_blocks.begin());
+}
+
+bool recent_block_cache::get(const crypto::hash &block_hash, bool pruned, block_complete_entry &e, uint64_t *height)
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  const auto i = m_heights.find(block_hash);
+  if (i == m_heights.end() || i->second >= m_committed_end)
+  {
+    ++m_misses;
+    return false;
+  }
+  const block_entry &b = m_blocks.find(i->second)->second;
+  e.pruned = pruned;
+  e.block = b.blob;
+  e.block_weight = pruned ? b.weight : 0;
+  e.txs.clear();
+  e.txs.reserve(b.txs.size());
+  for (const tx_entry &tx: b.txs)
+  {
+    if (pruned && !tx.v1)
+      e.txs.push_back({get_tx_blob(tx, true), tx.prunable_hash});
+    else
+      e.txs.push_back({tx.blob, crypto::null_hash});
+  }
+  if (height)
+    *height = i->second;
+  ++m_hits;
+  return true;
+}
+
+bool recent_block_cache::get(uint64_t height, bool pruned, cryptonote::blobdata &block_blob, crypto::hash &miner_tx_hash, std::vector<std::pair<crypto::hash, cryptonote::blobdata>> &txs)
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  const auto i = m_blocks.find(height);
+  if (i == m_blocks.end() || height >= m_committed_end)
+  {
+    ++m_misses;
+    return false;
+  }
+  const block_entry &b = i->second;
+  block_blob = b.blob;
+  miner_tx_hash = b.miner_tx_hash;
+  txs.clear();
+  txs.reserve(b.txs.size());
+  for (const tx_entry &tx: b.txs)
+    txs.push_back(std::make_pair(tx.hash, get_tx_blob(tx, pruned)));
+  ++m_hits;
+  return true;
+}
+
+void recent_block_cache::commit()
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  m_committed_end = m_blocks.empty() ? 0 : m_blocks.rbegin()->first + 1;
+}
+
+void recent_block_cache::rollback()
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  erase_from_height(m_committed_end);
+}
+
+void recent_block_cache::invalidate_from_height(uint64_t height)
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  erase_from_height(height);
+}
+
+void recent_block_cache::clear()
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  m_blocks.clear();
+  m_heights.clear();
+  m_size = 0;
+  m_committed_end = 0;
+}
+
+recent_block_cache::stats recent_block_cache::get_stats() const
+{
+  boost::lock_guard<boost::mutex> lock(m_lock);
+  stats st;
+  st.hits = m_hits;
+  st.misses = m_misses;
+  st.blocks = m_blocks.size();
+  st.size = m_size;
+  return st;
+}
+
+void recent_block_cache::erase(std::map<uint64_t, block_entry>::iterator i)
+{
+  m_heights.erase(i->second.hash);
+  m_size -= i->second.size;
+  m_blocks.erase(i);
+}
+
+void recent_block_cache::erase_from_height(uint64_t height)
+{
+  while (!m_blocks.empty() && m_blocks.rbegin()->first >= height)
+    erase(std::prev(m_blocks.end()));
+  m_committed_end = std::min(m_committed_end, height);
+}
+
+}
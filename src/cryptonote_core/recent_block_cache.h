@@ -0,0 +1,161 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "crypto/hash.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+
+namespace cryptonote
+{
+  /**
+   * @brief a size bounded cache of the blobs of the last blocks of the chain
+   *
+   * Most block requests from peers and wallets are for the tip of the chain,
+   * so the block and tx blobs of the last blocks are kept as they were added,
+   * and the pruned or unpruned forms served from them without touching the
+   * database.  The cached heights are always a contiguous run ending at the
+   * top of the chain: the lowest ones are evicted when the cache is full, and
+   * the highest ones invalidated when blocks are popped.
+   *
+   * Blocks are added while the db transaction adding them is still open, so
+   * they are only served once commit() is called after it is committed, and
+   * rollback() drops them if it is aborted instead.
+   */
+  class recent_block_cache
+  {
+  public:
+    struct tx_entry
+    {
+      crypto::hash hash;
+      cryptonote::blobdata blob;
+      size_t unprunable_size; // the pruned blob is the first unprunable_size bytes of blob
+      crypto::hash prunable_hash;
+      bool v1; // v1 txes are never pruned when sent to peers
+    };
+
+    struct stats
+    {
+      uint64_t hits;
+      uint64_t misses;
+      uint64_t blocks;
+      uint64_t size;
+    };
+
+    /**
+     * @brief constructor
+     *
+     * @param max_size the maximum size of the cached blobs, 0 disables the cache
+     */
+    recent_block_cache(size_t max_size);
+
+    /**
+     * @brief adds a block at the top of the cached run, not served until commit()
+     *
+     * If the height does not follow the highest cached one, blocks at or
+     * above it are dropped, or the whole cache if it would leave a gap.
+     */
+    void add(uint64_t height, const crypto::hash &block_hash, cryptonote::blobdata block_blob, uint64_t block_weight, const crypto::hash &miner_tx_hash, std::vector<tx_entry> txs);
+
+    /**
+     * @brief gets a block as sent in NOTIFY_RESPONSE_GET_OBJECTS
+     *
+     * @param block_hash the hash of the block
+     * @param pruned whether to prune the txes, adding their prunable hashes
+     * @param e return-by-reference the block entry
+     * @param height if not NULL, return-by-pointer the height of the block
+     *
+     * @return true if the block was found, and e was set
+     */
+    bool get(const crypto::hash &block_hash, bool pruned, block_complete_entry &e, uint64_t *height = NULL);
+
+    /**
+     * @brief gets a block as sent in get_blocks.bin
+     *
+     * @param height the height of the block
+     * @param pruned whether to strip the prunable part of the txes
+     * @param block_blob return-by-reference the block blob
+     * @param miner_tx_hash return-by-reference the hash of the miner tx
+     * @param txs return-by-reference the hashes and blobs of the txes
+     *
+     * @return true if the block was found, and the outputs were set
+     */
+    bool get(uint64_t height, bool pruned, cryptonote::blobdata &block_blob, crypto::hash &miner_tx_hash, std::vector<std::pair<crypto::hash, cryptonote::blobdata>> &txs);
+
+    /**
+     * @brief makes the blocks added so far available to get()
+     */
+    void commit();
+
+    /**
+     * @brief drops the blocks added since the last commit()
+     */
+    void rollback();
+
+    /**
+     * @brief drops all blocks at or above the given height
+     */
+    void invalidate_from_height(uint64_t height);
+
+    /**
+     * @brief drops all blocks
+     */
+    void clear();
+
+    stats get_stats() const;
+
+  private:
+    struct block_entry
+    {
+      crypto::hash hash;
+      cryptonote::blobdata blob;
+      uint64_t weight;
+      crypto::hash miner_tx_hash;
+      std::vector<tx_entry> txs;
+      size_t size;
+    };
+
+    static cryptonote::blobdata get_tx_blob(const tx_entry &tx, bool pruned) { return pruned ? tx.blob.substr(0, tx.unprunable_size) : tx.blob; }
+    void erase(std::map<uint64_t, block_entry>::iterator i);
+    void erase_from_height(uint64_t height);
+
+    mutable boost::mutex m_lock;
+    std::map<uint64_t, block_entry> m_blocks;
+    std::unordered_map<crypto::hash, uint64_t> m_heights;
+    uint64_t m_committed_end; // blocks at or above this height are not committed yet
+    const size_t m_max_size;
+    size_t m_size;
+    uint64_t m_hits;
+    uint64_t m_misses;
+  };
+}
@@ -1069,6 +1069,11 @@ namespace cryptonote
     m_transactions_lock.lock();
   }
   //---------------------------------------------------------------------------------
+  bool tx_memory_pool::try_lock() const
+  {
+    return m_transactions_lock.tryLock();
+  }
+  //---------------------------------------------------------------------------------
   void tx_memory_pool::unlock() const
   {
     m_transactions_lock.unlock();
@@ -1459,9 +1464,22 @@ namespace cryptonote
   bool tx_memory_pool::init(size_t max_txpool_weight)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
-    CRITICAL_REGION_LOCAL1(m_blockchain);
 
     m_txpool_max_weight = max_txpool_weight ? max_txpool_weight : DEFAULT_TXPOOL_MAX_WEIGHT;
+    if (!reload())
+      return false;
+
+    m_cookie = 0;
+
+    // Ignore deserialization error
+    return true;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::reload()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    CRITICAL_REGION_LOCAL1(m_blockchain);
+
     m_txs_by_fee_and_receive_time.clear();
     m_spent_key_images.clear();
     m_txpool_weight = 0;
@@ -1512,9 +1530,7 @@ namespace cryptonote
       lock.commit();
     }
 
-    m_cookie = 0;
-
-    // Ignore deserialization error
+    ++m_cookie;
     return true;
   }
 
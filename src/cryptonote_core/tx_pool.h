@@ -195,6 +195,13 @@ namespace cryptonote
      */
     void lock() const;
 
+    /**
+     * @brief locks the transaction pool if it is not already locked
+     *
+     * @return true if the lock was acquired
+     */
+    bool try_lock() const;
+
     /**
      * @brief unlocks the transaction pool
      */
@@ -211,6 +218,15 @@ namespace cryptonote
      */
     bool init(size_t max_txpool_weight = 0);
 
+    /**
+     * @brief rebuilds the in-memory indexes from the pool stored in the db
+     *
+     * Needed when a db batch which changed the pool was aborted.
+     *
+     * @return true on success, false if a pool tx's key images conflict
+     */
+    bool reload();
+
     /**
      * @brief attempts to save the transaction pool state to disk
      *
@@ -41,6 +41,11 @@
 #undef BITTUBE_DEFAULT_LOG_CATEGORY
 #define BITTUBE_DEFAULT_LOG_CATEGORY "cn.block_queue"
 
+#define SPAN_TARGET_TIME 5.0 // seconds we'd like a span to take to download
+#define THROUGHPUT_SMOOTHING 0.25 // weight of the latest span in the throughput estimates
+#define SLOW_PEER_RELATIVE_THROUGHPUT 0.5f // below this fraction of the best peer, keep critical spans short
+#define SPAN_MAX_MULTIPLIER 8 // fast peers may get spans up to N times the nominal size
+
 namespace std {
   static_assert(sizeof(size_t) <= sizeof(boost::uuids::uuid), "boost::uuids::uuid too small");
   template<> struct hash<boost::uuids::uuid> {
@@ -58,6 +63,7 @@ void block_queue::add_blocks(uint64_t height, std::vector<cryptonote::block_comp
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
   std::vector<crypto::hash> hashes;
   bool has_hashes = remove_span(height, &hashes);
+  update_peer_throughput(connection_id, bcel.size(), size, rate);
   blocks.insert(span(height, std::move(bcel), connection_id, rate, size));
   if (has_hashes)
   {
@@ -114,6 +120,13 @@ void block_queue::flush_stale_spans(const std::set<boost::uuids::uuid> &live_con
       erase_block(j);
     }
   }
+  for (auto i = peer_throughputs.begin(); i != peer_throughputs.end(); )
+  {
+    if (live_connections.find(i->first) == live_connections.end())
+      i = peer_throughputs.erase(i);
+    else
+      ++i;
+  }
 }
 
 bool block_queue::remove_span(uint64_t start_block_height, std::vector<crypto::hash> *hashes)
@@ -530,6 +543,110 @@ float block_queue::get_download_rate(const boost::uuids::uuid &connection_id) co
   return conn_rate;
 }
 
+void block_queue::update_peer_throughput(const boost::uuids::uuid &connection_id, uint64_t nblocks, size_t size, float rate)
+{
+  if (nblocks == 0 || size == 0 || rate <= 0.0f)
+    return;
+
+  const double a = THROUGHPUT_SMOOTHING;
+  const double block_size = size / (double)nblocks;
+  average_block_size = average_block_size > 0.0 ? average_block_size + a * (block_size - average_block_size) : block_size;
+
+  // the rate we're given is size over the whole request time, latency included
+  const double t = size / (double)rate;
+  peer_throughput &pt = peer_throughputs[connection_id];
+  if (pt.nspans == 0)
+  {
+    pt.mean_size = size;
+    pt.mean_time = t;
+  }
+  else
+  {
+    const double dsize = size - pt.mean_size, dtime = t - pt.mean_time;
+    pt.mean_size += a * dsize;
+    pt.mean_time += a * dtime;
+    pt.var_size = (1.0 - a) * (pt.var_size + a * dsize * dsize);
+    pt.cov_size_time = (1.0 - a) * (pt.cov_size_time + a * dsize * dtime);
+  }
+  ++pt.nspans;
+
+  // fit time = latency + size / bandwidth, which needs spans of different sizes,
+  // otherwise we can only tell the overall rate
+  const double spread = 0.1 * pt.mean_size;
+  const double slope = pt.var_size > spread * spread ? pt.cov_size_time / pt.var_size : 0.0;
+  const double latency = pt.mean_time - slope * pt.mean_size;
+  if (slope > 0.0 && latency >= 0.0)
+  {
+    pt.bandwidth = 1.0 / slope;
+    pt.latency = latency;
+  }
+  else
+  {
+    pt.bandwidth = pt.mean_size / pt.mean_time;
+    pt.latency = 0.0f;
+  }
+  MTRACE("Throughput for " << connection_id << ": " << pt.bandwidth / 1024.f << " kB/s, latency " << pt.latency << " s over " << pt.nspans << " spans");
+}
+
+bool block_queue::get_peer_throughput(const boost::uuids::uuid &connection_id, peer_throughput &throughput) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peer_throughputs.find(connection_id);
+  if (i == peer_throughputs.end())
+    return false;
+  throughput = i->second;
+  return true;
+}
+
+float block_queue::get_relative_throughput(const boost::uuids::uuid &connection_id) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  float conn_bandwidth = -1.0f, best_bandwidth = 0.0f;
+  for (const auto &i: peer_throughputs)
+  {
+    if (i.first == connection_id)
+      conn_bandwidth = i.second.bandwidth;
+    best_bandwidth = std::max(best_bandwidth, i.second.bandwidth);
+  }
+  if (conn_bandwidth < 0.0f || best_bandwidth <= 0.0f)
+    return 1.0f; // not measured yet, assume good speed
+  return conn_bandwidth / best_bandwidth;
+}
+
+float block_queue::get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const auto i = peer_throughputs.find(connection_id);
+  if (i == peer_throughputs.end() || i->second.bandwidth <= 0.0f || average_block_size <= 0.0)
+    return -1.0f;
+  return i->second.latency + nblocks * average_block_size / i->second.bandwidth;
+}
+
+uint64_t block_queue::get_span_size(const boost::uuids::uuid &connection_id, uint64_t nominal_blocks, bool critical) const
+{
+  boost::unique_lock<boost::recursive_mutex> lock(mutex);
+  const uint64_t min_blocks = std::max<uint64_t>(1, nominal_blocks / 10);
+  // peers drop requests for more objects than this, however fast they are
+  const uint64_t max_blocks = std::min<uint64_t>(CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT,
+      std::max<uint64_t>(nominal_blocks, std::min<uint64_t>(BLOCKS_SYNCHRONIZING_MAX_COUNT, nominal_blocks * SPAN_MAX_MULTIPLIER)));
+  const auto i = peer_throughputs.find(connection_id);
+  if (i == peer_throughputs.end() || i->second.bandwidth <= 0.0f || average_block_size <= 0.0)
+    return std::min(nominal_blocks, max_blocks);
+
+  // a slow peer holding the span the chain is waiting on holds everyone up
+  if (critical && get_relative_throughput(connection_id) < SLOW_PEER_RELATIVE_THROUGHPUT)
+  {
+    MDEBUG("Keeping critical span short for slow peer " << connection_id);
+    return std::min(min_blocks, max_blocks);
+  }
+
+  // size the span so it downloads in about SPAN_TARGET_TIME, but don't let
+  // latency eat up most of the budget
+  const double budget = std::max(SPAN_TARGET_TIME - i->second.latency, SPAN_TARGET_TIME / 4);
+  const uint64_t nblocks = i->second.bandwidth * budget / average_block_size;
+  return std::min(std::max(nblocks, min_blocks), max_blocks);
+}
+
 bool block_queue::foreach(std::function<bool(const span&)> f) const
 {
   boost::unique_lock<boost::recursive_mutex> lock(mutex);
@@ -33,6 +33,7 @@
 
 #include <string>
 #include <vector>
+#include <map>
 #include <set>
 #include <unordered_set>
 #include <boost/thread/recursive_mutex.hpp>
@@ -68,6 +69,22 @@ namespace cryptonote
     };
     typedef std::set<span> block_map;
 
+    struct peer_throughput
+    {
+      float bandwidth; // bytes per second
+      float latency; // seconds per request
+      uint64_t nspans;
+
+      // exponentially weighted moments of span size vs download time,
+      // from which bandwidth and latency are fitted
+      double mean_size;
+      double mean_time;
+      double var_size;
+      double cov_size_time;
+
+      peer_throughput(): bandwidth(0.0f), latency(0.0f), nspans(0), mean_size(0.0), mean_time(0.0), var_size(0.0), cov_size_time(0.0) {}
+    };
+
   public:
     void add_blocks(uint64_t height, std::vector<cryptonote::block_complete_entry> bcel, const boost::uuids::uuid &connection_id, float rate, size_t size);
     void add_blocks(uint64_t height, uint64_t nblocks, const boost::uuids::uuid &connection_id, boost::posix_time::ptime time = boost::date_time::min_date_time);
@@ -94,6 +111,10 @@ namespace cryptonote
     bool has_spans(const boost::uuids::uuid &connection_id) const;
     float get_speed(const boost::uuids::uuid &connection_id) const;
     float get_download_rate(const boost::uuids::uuid &connection_id) const;
+    bool get_peer_throughput(const boost::uuids::uuid &connection_id, peer_throughput &throughput) const;
+    float get_relative_throughput(const boost::uuids::uuid &connection_id) const;
+    float get_expected_span_time(const boost::uuids::uuid &connection_id, uint64_t nblocks) const;
+    uint64_t get_span_size(const boost::uuids::uuid &connection_id, uint64_t nominal_blocks, bool critical) const;
     bool foreach(std::function<bool(const span&)> f) const;
     bool requested(const crypto::hash &hash) const;
     bool have(const crypto::hash &hash) const;
@@ -101,11 +122,14 @@ namespace cryptonote
   private:
     void erase_block(block_map::iterator j);
     inline bool requested_internal(const crypto::hash &hash) const;
+    void update_peer_throughput(const boost::uuids::uuid &connection_id, uint64_t nblocks, size_t size, float rate);
 
   private:
     block_map blocks;
     mutable boost::recursive_mutex mutex;
     std::unordered_set<crypto::hash> requested_hashes;
     std::unordered_set<crypto::hash> have_blocks;
+    std::map<boost::uuids::uuid, peer_throughput> peer_throughputs;
+    double average_block_size = 0.0;
   };
 }
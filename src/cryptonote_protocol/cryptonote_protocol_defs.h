@@ -33,6 +33,8 @@
 
 #include <list>
 #include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_view.h"
+#include "storages/portable_storage_writer.h"
 #include "cryptonote_basic/cryptonote_basic.h"
 #include "cryptonote_basic/blobdatatype.h"
 namespace cryptonote
@@ -40,6 +42,7 @@ namespace cryptonote
 
 
 #define BC_COMMANDS_POOL_BASE 2000
+#define CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT 500
 
   /************************************************************************/
   /* P2P connection info, serializable to json                            */
@@ -343,5 +346,109 @@ namespace cryptonote
     };
     typedef epee::misc_utils::struct_init<request_t> request;
   }; 
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TX_RECONCILE
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 10;
+
+    struct request_t
+    {
+      uint64_t salt;
+      uint64_t capacity;
+      std::string sketch;                 // tx_sketch of the salted short ids of our pool
+      std::vector<uint64_t> short_ids;    // the whole set, sent instead when sketches fail to decode
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(capacity)
+        KV_SERIALIZE(sketch)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(short_ids)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_RESPONSE_TX_RECONCILE
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 11;
+
+    struct request_t
+    {
+      uint64_t salt;
+      bool decoded;
+      std::vector<uint64_t> missing_short_ids; // requester's txes we do not have
+      std::vector<crypto::hash> txids;         // our txes the requester does not have
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE(decoded)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(missing_short_ids)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txids)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_REQUEST_TXS
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 12;
+
+    struct request_t
+    {
+      std::vector<crypto::hash> txids;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(txids)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  struct NOTIFY_NEW_COMPACT_BLOCK
+  {
+    const static int ID = BC_COMMANDS_POOL_BASE + 13;
+
+    struct request_t
+    {
+      blobdata block;                     // block blob with its tx_hashes left out
+      crypto::hash block_hash;
+      uint64_t salt;
+      std::vector<uint64_t> short_ids;    // salted short ids of the block's tx_hashes, in order
+      std::vector<blobdata> txs;          // txes the receiver is not expected to have yet
+      uint64_t current_blockchain_height;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(block)
+        KV_SERIALIZE_VAL_POD_AS_BLOB(block_hash)
+        KV_SERIALIZE(salt)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(short_ids)
+        KV_SERIALIZE(txs)
+        KV_SERIALIZE(current_blockchain_height)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+  };
     
 }
+
+namespace epee
+{
+  namespace serialization
+  {
+    // block responses are the bulk of sync traffic, (de)serialize them without building a storage tree
+    template<> struct load_from_binary_view<cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request>: std::true_type {};
+    template<> struct store_to_binary_writer<cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request>: std::true_type {};
+  }
+}
@@ -44,6 +44,7 @@
 #include "profile_tools.h"
 #include "net/network_throttle-detail.hpp"
 #include "common/pruning.h"
+#include "cryptonote_protocol/tx_reconciliation.h"
 
 #undef BITTUBE_DEFAULT_LOG_CATEGORY
 #define BITTUBE_DEFAULT_LOG_CATEGORY "net.cn"
@@ -518,6 +519,25 @@ namespace cryptonote
     transaction miner_tx;
     if(parse_and_validate_block_from_blob(arg.b.block, new_block))
     {
+      // the block hash commits to the tx hashes, so once the block we asked
+      // about is back we know which txes the peer has to send
+      if(context.m_missing_txes_block_hash != crypto::null_hash && get_block_hash(new_block) == context.m_missing_txes_block_hash)
+      {
+        if(arg.b.txs.size() != context.m_missing_tx_indices.size())
+        {
+          LOG_ERROR_CCONTEXT("NOTIFY_NEW_FLUFFY_BLOCK -> request/response mismatch, requested = " << context.m_missing_tx_indices.size()
+              << ", received = " << arg.b.txs.size() << ", dropping connection");
+          drop_connection(context, false, false);
+          m_core.resume_mine();
+          return 1;
+        }
+        for(uint64_t tx_idx: context.m_missing_tx_indices)
+          if(tx_idx < new_block.tx_hashes.size())
+            context.m_requested_objects.insert(new_block.tx_hashes[tx_idx]);
+        context.m_missing_txes_block_hash = crypto::null_hash;
+        context.m_missing_tx_indices.clear();
+      }
+
       // This is a second notification, we must have asked for some missing tx
       if(!context.m_requested_objects.empty())
       {
@@ -540,6 +560,7 @@ namespace cryptonote
       }      
 
       std::vector<tx_blob_entry> have_tx;
+      std::unordered_set<crypto::hash> unrelayed_txs;
 
       // Instead of requesting missing transactions by hash like BTC, 
       // we do it by index (thanks to a suggestion from moneromooo) because
@@ -617,6 +638,7 @@ namespace cryptonote
           if(!m_core.pool_has_tx(tx_hash))
           {
             MDEBUG("Incoming tx " << tx_hash << " not in pool, adding");
+            unrelayed_txs.insert(tx_hash);
             cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);                        
             if(!m_core.handle_incoming_tx(tx_blob, tvc, relay_method::block, true) || tvc.m_verifivation_failed)
             {
@@ -715,6 +737,8 @@ namespace cryptonote
         missing_tx_req.block_hash = get_block_hash(new_block);
         missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
         missing_tx_req.missing_tx_indices = std::move(need_tx_indices);
+        context.m_missing_txes_block_hash = missing_tx_req.block_hash;
+        context.m_missing_tx_indices = missing_tx_req.missing_tx_indices;
         
         m_core.resume_mine();
         MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_FLUFFY_MISSING_TX: missing_tx_indices.size()=" << missing_tx_req.missing_tx_indices.size() );
@@ -760,7 +784,7 @@ namespace cryptonote
           NOTIFY_NEW_BLOCK::request reg_arg = AUTO_VAL_INIT(reg_arg);
           reg_arg.current_blockchain_height = arg.current_blockchain_height;
           reg_arg.b = b;
-          relay_block(reg_arg, context);
+          relay_block(reg_arg, context, unrelayed_txs);
         }
         else if( bvc.m_marked_as_orphaned )
         {
@@ -802,38 +826,46 @@ namespace cryptonote
     std::vector<std::pair<cryptonote::blobdata, block>> local_blocks;
     std::vector<cryptonote::blobdata> local_txs;
 
+    // blocks near the top of the chain are served from the recent block cache, as stored
+    block_complete_entry cached;
+    const bool is_cached = m_core.get_recent_block(arg.block_hash, false, cached);
     block b;
-    if (!m_core.get_block_by_hash(arg.block_hash, b))
+    if (!is_cached && !m_core.get_block_by_hash(arg.block_hash, b))
     {
       LOG_ERROR_CCONTEXT("failed to find block: " << arg.block_hash << ", dropping connection");
       drop_connection(context, false, false);
       return 1;
     }
+    const size_t n_txes = is_cached ? cached.txs.size() : b.tx_hashes.size();
 
     std::vector<crypto::hash> txids;
     NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_response;
-    fluffy_response.b.block = t_serializable_object_to_blob(b);
+    fluffy_response.b.block = is_cached ? std::move(cached.block) : t_serializable_object_to_blob(b);
     fluffy_response.current_blockchain_height = arg.current_blockchain_height;
-    std::vector<bool> seen(b.tx_hashes.size(), false);
+    std::vector<bool> seen(n_txes, false);
     for(auto& tx_idx: arg.missing_tx_indices)
     {
-      if(tx_idx < b.tx_hashes.size())
+      if(tx_idx < n_txes)
       {
-        MDEBUG("  tx " << b.tx_hashes[tx_idx]);
+        if (!is_cached)
+          MDEBUG("  tx " << b.tx_hashes[tx_idx]);
         if (seen[tx_idx])
         {
           LOG_ERROR_CCONTEXT
           (
             "Failed to handle request NOTIFY_REQUEST_FLUFFY_MISSING_TX"
             << ", request is asking for duplicate tx "
-            << ", tx index = " << tx_idx << ", block tx count " << b.tx_hashes.size()
+            << ", tx index = " << tx_idx << ", block tx count " << n_txes
             << ", block_height = " << arg.current_blockchain_height
             << ", dropping connection"
           );
           drop_connection(context, true, false);
           return 1;
         }
-        txids.push_back(b.tx_hashes[tx_idx]);
+        if (is_cached)
+          fluffy_response.b.txs.push_back({std::move(cached.txs[tx_idx].blob), crypto::null_hash});
+        else
+          txids.push_back(b.tx_hashes[tx_idx]);
         seen[tx_idx] = true;
       }
       else
@@ -842,7 +874,7 @@ namespace cryptonote
         (
           "Failed to handle request NOTIFY_REQUEST_FLUFFY_MISSING_TX"
           << ", request is asking for a tx whose index is out of bounds "
-          << ", tx index = " << tx_idx << ", block tx count " << b.tx_hashes.size()
+          << ", tx index = " << tx_idx << ", block tx count " << n_txes
           << ", block_height = " << arg.current_blockchain_height
           << ", dropping connection"
         );
@@ -854,7 +886,7 @@ namespace cryptonote
 
     std::vector<cryptonote::transaction> txs;
     std::vector<crypto::hash> missed;
-    if (!m_core.get_transactions(txids, txs, missed))
+    if (!txids.empty() && !m_core.get_transactions(txids, txs, missed))
     {
       LOG_ERROR_CCONTEXT("Failed to handle request NOTIFY_REQUEST_FLUFFY_MISSING_TX, "
         << "failed to get requested transactions");
@@ -886,6 +918,90 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_notify_new_compact_block(int command, NOTIFY_NEW_COMPACT_BLOCK::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_NEW_COMPACT_BLOCK " << arg.block_hash << " (height " << arg.current_blockchain_height << ", " << arg.short_ids.size() << " short ids, " << arg.txs.size() << " txes)");
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+    if(!is_synchronized() || m_no_sync)
+    {
+      LOG_DEBUG_CC(context, "Received new block while syncing, ignored");
+      return 1;
+    }
+    if(m_core.have_block(arg.block_hash))
+      return 1;
+
+    block new_block;
+    if(!parse_and_validate_block_from_blob(arg.block, new_block) || !new_block.tx_hashes.empty())
+    {
+      LOG_ERROR_CCONTEXT("sent wrong compact block: failed to parse and validate block, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
+    fluffy_arg.current_blockchain_height = arg.current_blockchain_height;
+    fluffy_arg.b.txs.reserve(arg.txs.size());
+
+    // the txes sent along are resolved the same way as the ones from our pool
+    std::vector<crypto::hash> candidates;
+    for(auto& tx_blob: arg.txs)
+    {
+      transaction tx;
+      crypto::hash tx_hash;
+      if(!parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash))
+      {
+        LOG_ERROR_CCONTEXT("sent wrong tx: failed to parse and validate transaction, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      candidates.push_back(tx_hash);
+      fluffy_arg.b.txs.push_back({std::move(tx_blob), crypto::null_hash});
+    }
+    m_core.get_pool_transaction_hashes(candidates);
+
+    std::vector<uint64_t> need_tx_indices;
+    new_block.tx_hashes = resolve_tx_short_ids(arg.short_ids, arg.salt, candidates, need_tx_indices);
+    new_block.invalidate_hashes();
+
+    if(need_tx_indices.empty() && get_block_hash(new_block) == arg.block_hash)
+    {
+      MDEBUG("Resolved all " << arg.short_ids.size() << " short ids for compact block " << arg.block_hash);
+      fluffy_arg.b.block = block_to_blob(new_block);
+      return handle_notify_new_fluffy_block(NOTIFY_NEW_FLUFFY_BLOCK::ID, fluffy_arg, context);
+    }
+
+    // keep what we were sent so the response only needs to carry the rest
+    for(size_t i = 0; i < fluffy_arg.b.txs.size(); ++i)
+    {
+      if(m_core.pool_has_tx(candidates[i]))
+        continue;
+      cryptonote::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if(!m_core.handle_incoming_tx(fluffy_arg.b.txs[i], tvc, relay_method::block, true) || tvc.m_verifivation_failed)
+      {
+        LOG_PRINT_CCONTEXT_L1("Block verification failed: transaction verification failed, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+    }
+
+    // a short id collision can yield the wrong hash without any id missing,
+    // get the full block then and let the fluffy path ask for its txes
+    if(need_tx_indices.empty())
+      MDEBUG("Compact block " << arg.block_hash << " does not match its resolved txes, requesting the full block");
+
+    NOTIFY_REQUEST_FLUFFY_MISSING_TX::request missing_tx_req;
+    missing_tx_req.block_hash = arg.block_hash;
+    missing_tx_req.current_blockchain_height = arg.current_blockchain_height;
+    missing_tx_req.missing_tx_indices = std::move(need_tx_indices);
+    context.m_missing_txes_block_hash = missing_tx_req.block_hash;
+    context.m_missing_tx_indices = missing_tx_req.missing_tx_indices;
+    MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_FLUFFY_MISSING_TX: missing_tx_indices.size()=" << missing_tx_req.missing_tx_indices.size() );
+    post_notify<NOTIFY_REQUEST_FLUFFY_MISSING_TX>(missing_tx_req, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_notify_new_transactions(int command, NOTIFY_NEW_TRANSACTIONS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_NEW_TRANSACTIONS (" << arg.txs.size() << " txes)");
@@ -931,6 +1047,195 @@ namespace cryptonote
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_tx_reconcile(int command, NOTIFY_REQUEST_TX_RECONCILE::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TX_RECONCILE (capacity " << arg.capacity << ", " << arg.short_ids.size() << " short ids)");
+
+    if(context.m_state != cryptonote_connection_context::state_normal)
+      return 1;
+
+    if (arg.capacity > P2P_TX_RECONCILIATION_MAX_CAPACITY || arg.short_ids.size() > P2P_TX_RECONCILIATION_MAX_SHORT_IDS ||
+        (arg.capacity == 0 && !arg.sketch.empty()) || (arg.capacity != 0 && !arg.short_ids.empty()))
+    {
+      LOG_ERROR_CCONTEXT("Invalid NOTIFY_REQUEST_TX_RECONCILE, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    // peers ask once per interval at most, half a second of slack covers network jitter
+    const auto now = std::chrono::steady_clock::now();
+    if (now - context.m_tx_reconcile_answer_time < std::chrono::seconds(P2P_TX_RECONCILIATION_INTERVAL) - std::chrono::milliseconds(500))
+    {
+      LOG_DEBUG_CC(context, "Ignoring NOTIFY_REQUEST_TX_RECONCILE sent too soon after the previous one");
+      return 1;
+    }
+    context.m_tx_reconcile_answer_time = now;
+
+    NOTIFY_RESPONSE_TX_RECONCILE::request rsp;
+    rsp.salt = arg.salt;
+    rsp.decoded = true;
+
+    // while syncing, our pool is no use to the peer, an empty answer lets it go on
+    if(!is_synchronized() || m_no_sync)
+    {
+      post_notify<NOTIFY_RESPONSE_TX_RECONCILE>(rsp, context);
+      return 1;
+    }
+
+    std::vector<crypto::hash> txids;
+    m_core.get_pool_transaction_hashes(txids, false);
+    std::unordered_map<uint64_t, crypto::hash> ours;
+    ours.reserve(txids.size());
+    for (const crypto::hash &txid: txids)
+      ours.emplace(get_tx_short_id(txid, arg.salt), txid);
+
+    std::vector<uint64_t> only_ours, only_theirs;
+    if (arg.capacity == 0)
+    {
+      const std::unordered_set<uint64_t> theirs(arg.short_ids.begin(), arg.short_ids.end());
+      for (const auto &e: ours)
+        if (theirs.find(e.first) == theirs.end())
+          only_ours.push_back(e.first);
+      for (uint64_t short_id: theirs)
+        if (ours.find(short_id) == ours.end())
+          only_theirs.push_back(short_id);
+    }
+    else
+    {
+      tx_sketch remote;
+      if (!remote.deserialize(arg.sketch, arg.capacity))
+      {
+        LOG_ERROR_CCONTEXT("Invalid sketch in NOTIFY_REQUEST_TX_RECONCILE, dropping connection");
+        drop_connection(context, false, false);
+        return 1;
+      }
+      tx_sketch local(arg.capacity);
+      for (const auto &e: ours)
+        local.add(e.first);
+      local.subtract(remote);
+      rsp.decoded = local.decode(only_ours, only_theirs);
+
+      // a peeled id we do not have, or one we have on the wrong side, means the decode went astray
+      for (size_t i = 0; rsp.decoded && i < only_ours.size(); ++i)
+        rsp.decoded = ours.find(only_ours[i]) != ours.end();
+      for (size_t i = 0; rsp.decoded && i < only_theirs.size(); ++i)
+        rsp.decoded = ours.find(only_theirs[i]) == ours.end();
+    }
+
+    if (rsp.decoded)
+    {
+      rsp.missing_short_ids = std::move(only_theirs);
+      rsp.txids.reserve(only_ours.size());
+      for (uint64_t short_id: only_ours)
+        rsp.txids.push_back(ours[short_id]);
+    }
+
+    MLOG_P2P_MESSAGE("-->>NOTIFY_RESPONSE_TX_RECONCILE: decoded " << rsp.decoded << ", " << rsp.missing_short_ids.size()
+        << " missing, " << rsp.txids.size() << " announced");
+    post_notify<NOTIFY_RESPONSE_TX_RECONCILE>(rsp, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_response_tx_reconcile(int command, NOTIFY_RESPONSE_TX_RECONCILE::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_RESPONSE_TX_RECONCILE (decoded " << arg.decoded << ", " << arg.missing_short_ids.size()
+        << " missing, " << arg.txids.size() << " announced)");
+
+    if (arg.salt == 0 || arg.salt != context.m_tx_reconcile_salt)
+    {
+      LOG_DEBUG_CC(context, "Ignoring stale or unrequested tx reconciliation response");
+      return 1;
+    }
+    context.m_tx_reconcile_salt = 0;
+
+    if (arg.missing_short_ids.size() > P2P_TX_RECONCILIATION_MAX_SHORT_IDS || arg.txids.size() > P2P_TX_RECONCILIATION_MAX_SHORT_IDS)
+    {
+      LOG_ERROR_CCONTEXT("Too many ids in NOTIFY_RESPONSE_TX_RECONCILE, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    if (!arg.decoded)
+    {
+      // past the max capacity, the next request carries the whole set instead
+      context.m_tx_reconcile_capacity *= 2;
+      LOG_DEBUG_CC(context, "Tx reconciliation failed to decode, capacity now " << context.m_tx_reconcile_capacity);
+      return 1;
+    }
+
+    // size the next sketch for about twice the difference we just saw
+    const size_t difference = arg.missing_short_ids.size() + arg.txids.size();
+    context.m_tx_reconcile_capacity = std::max<size_t>(P2P_TX_RECONCILIATION_MIN_CAPACITY,
+        std::min<size_t>(P2P_TX_RECONCILIATION_MAX_CAPACITY, (std::min<size_t>(context.m_tx_reconcile_capacity, P2P_TX_RECONCILIATION_MAX_CAPACITY) + 2 * difference) / 2));
+
+    if(!is_synchronized() || m_no_sync)
+      return 1;
+
+    if (!arg.missing_short_ids.empty())
+    {
+      const std::unordered_set<uint64_t> missing(arg.missing_short_ids.begin(), arg.missing_short_ids.end());
+      std::vector<crypto::hash> txids;
+      m_core.get_pool_transaction_hashes(txids, false);
+      NOTIFY_NEW_TRANSACTIONS::request txs_arg;
+      for (const crypto::hash &txid: txids)
+      {
+        cryptonote::blobdata blob;
+        if (missing.find(get_tx_short_id(txid, arg.salt)) != missing.end() && m_core.get_pool_transaction(txid, blob, relay_category::broadcasted))
+          txs_arg.txs.push_back(std::move(blob));
+      }
+      if (!txs_arg.txs.empty())
+        post_notify<NOTIFY_NEW_TRANSACTIONS>(txs_arg, context);
+    }
+
+    NOTIFY_REQUEST_TXS::request req;
+    const time_t now = time(NULL);
+    {
+      boost::unique_lock<boost::mutex> lock(m_requested_txs_lock);
+      for (const crypto::hash &txid: arg.txids)
+      {
+        if (m_core.pool_has_tx(txid))
+          continue;
+        auto it = m_requested_txs.find(txid);
+        if (it != m_requested_txs.end() && now - it->second < P2P_TX_RECONCILIATION_TIMEOUT)
+          continue;
+        m_requested_txs[txid] = now;
+        req.txids.push_back(txid);
+      }
+    }
+    if (!req.txids.empty())
+    {
+      MLOG_P2P_MESSAGE("-->>NOTIFY_REQUEST_TXS: " << req.txids.size() << " txes");
+      post_notify<NOTIFY_REQUEST_TXS>(req, context);
+    }
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  int t_cryptonote_protocol_handler<t_core>::handle_request_txs(int command, NOTIFY_REQUEST_TXS::request& arg, cryptonote_connection_context& context)
+  {
+    MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_TXS (" << arg.txids.size() << " txes)");
+    if (arg.txids.size() > P2P_TX_RECONCILIATION_MAX_SHORT_IDS)
+    {
+      LOG_ERROR_CCONTEXT("Too many txes requested in NOTIFY_REQUEST_TXS, dropping connection");
+      drop_connection(context, false, false);
+      return 1;
+    }
+
+    // only txes already broadcast are handed out, so stem txes stay private
+    NOTIFY_NEW_TRANSACTIONS::request rsp;
+    for (const crypto::hash &txid: arg.txids)
+    {
+      cryptonote::blobdata blob;
+      if (m_core.get_pool_transaction(txid, blob, relay_category::broadcasted))
+        rsp.txs.push_back(std::move(blob));
+    }
+    if (!rsp.txs.empty())
+      post_notify<NOTIFY_NEW_TRANSACTIONS>(rsp, context);
+    return 1;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   int t_cryptonote_protocol_handler<t_core>::handle_request_get_objects(int command, NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote_connection_context& context)
   {
     MLOG_P2P_MESSAGE("Received NOTIFY_REQUEST_GET_OBJECTS (" << arg.blocks.size() << " blocks)");
@@ -954,7 +1259,7 @@ namespace cryptonote
     MLOG_P2P_MESSAGE("-->>NOTIFY_RESPONSE_GET_OBJECTS: blocks.size()="
                      << rsp.blocks.size() << ", rsp.m_current_blockchain_height=" << rsp.current_blockchain_height
                      << ", missed_ids.size()=" << rsp.missed_ids.size());
-    post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, context);
+    post_notify<NOTIFY_RESPONSE_GET_OBJECTS>(rsp, context, true);
     //handler_response_blocks_now(sizeof(rsp)); // XXX
     //handler_response_blocks_now(200);
     return 1;
@@ -1146,6 +1451,7 @@ namespace cryptonote
       const float rate = size * 1e6 / (dt.total_microseconds() + 1);
       MDEBUG(context << " adding span: " << arg.blocks.size() << " at height " << start_height << ", " << dt.total_microseconds()/1e6 << " seconds, " << (rate/1024) << " kB/s, size now " << (m_block_queue.get_data_size() + blocks_size) / 1048576.f << " MB");
       m_block_queue.add_blocks(start_height, arg.blocks, context.m_connection_id, rate, blocks_size);
+      m_p2p->record_peer_throughput(context, rate);
 
       const crypto::hash last_block_hash = cryptonote::get_block_hash(b);
       context.m_last_known_hash = last_block_hash;
@@ -1513,6 +1819,7 @@ skip:
     m_idle_peer_kicker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::kick_idle_peers, this));
     m_standby_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::check_standby_peers, this));
     m_sync_search_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::update_sync_search, this));
+    m_tx_reconcile_checker.do_call(boost::bind(&t_cryptonote_protocol_handler<t_core>::reconcile_txs, this));
     return m_core.on_idle();
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -1542,6 +1849,69 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::reconcile_txs()
+  {
+    if (!is_synchronized() || m_no_sync)
+      return true;
+
+    const time_t now = time(NULL);
+    {
+      boost::unique_lock<boost::mutex> lock(m_requested_txs_lock);
+      for (auto it = m_requested_txs.begin(); it != m_requested_txs.end(); )
+      {
+        if (now - it->second >= P2P_TX_RECONCILIATION_TIMEOUT)
+          it = m_requested_txs.erase(it);
+        else
+          ++it;
+      }
+    }
+
+    // we reconcile with our outgoing peers, incoming ones reconcile with us
+    MTRACE("Reconciling txes with outgoing peers...");
+    std::vector<crypto::hash> txids;
+    bool got_txids = false;
+    m_p2p->for_each_connection([&](cryptonote_connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)->bool
+    {
+      if (!peer_id || context.m_is_income || context.m_state != cryptonote_connection_context::state_normal)
+        return true;
+      if (context.m_remote_address.get_zone() != epee::net_utils::zone::public_ || !(support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION))
+        return true;
+      if (context.m_tx_reconcile_salt && now - context.m_tx_reconcile_time < P2P_TX_RECONCILIATION_TIMEOUT)
+        return true;
+
+      if (!got_txids)
+      {
+        m_core.get_pool_transaction_hashes(txids, false);
+        got_txids = true;
+      }
+
+      NOTIFY_REQUEST_TX_RECONCILE::request req;
+      req.salt = crypto::rand<uint64_t>() | 1;
+      if (context.m_tx_reconcile_capacity <= P2P_TX_RECONCILIATION_MAX_CAPACITY)
+      {
+        tx_sketch sketch(context.m_tx_reconcile_capacity);
+        for (const crypto::hash &txid: txids)
+          sketch.add(get_tx_short_id(txid, req.salt));
+        req.capacity = context.m_tx_reconcile_capacity;
+        req.sketch = sketch.serialize();
+      }
+      else
+      {
+        req.capacity = 0;
+        req.short_ids.reserve(std::min<size_t>(txids.size(), P2P_TX_RECONCILIATION_MAX_SHORT_IDS));
+        for (size_t i = 0; i < txids.size() && i < P2P_TX_RECONCILIATION_MAX_SHORT_IDS; ++i)
+          req.short_ids.push_back(get_tx_short_id(txids[i], req.salt));
+      }
+
+      context.m_tx_reconcile_salt = req.salt;
+      context.m_tx_reconcile_time = now;
+      post_notify<NOTIFY_REQUEST_TX_RECONCILE>(req, context);
+      return true;
+    });
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::update_sync_search()
   {
     const uint64_t target = m_core.get_target_blockchain_height();
@@ -1610,7 +1980,7 @@ skip:
       return 1;
     }
     MLOG_P2P_MESSAGE("-->>NOTIFY_RESPONSE_CHAIN_ENTRY: m_start_height=" << r.start_height << ", m_total_height=" << r.total_height << ", m_block_ids.size()=" << r.m_block_ids.size());
-    post_notify<NOTIFY_RESPONSE_CHAIN_ENTRY>(r, context);
+    post_notify<NOTIFY_RESPONSE_CHAIN_ENTRY>(r, context, true);
     return 1;
   }
   //------------------------------------------------------------------------------------------------------------------------
@@ -1645,6 +2015,24 @@ skip:
           return true;
         }
 
+        // race the peer holding the span if it's well past what its measured throughput
+        // says it needs, and we'd be expected to deliver it sooner
+        if (connection_id != context.m_connection_id)
+        {
+          span = m_block_queue.get_next_span_if_scheduled(hashes, span_connection_id, request_time);
+          const float expected = span.second > 0 ? m_block_queue.get_expected_span_time(connection_id, span.second) : -1.0f;
+          if (expected > 0.0f && dt/1e6 > 2 * expected + LAST_ACTIVITY_STALL_THRESHOLD)
+          {
+            const float our_expected = m_block_queue.get_expected_span_time(context.m_connection_id, span.second);
+            if (our_expected > 0.0f && our_expected < expected)
+            {
+              MDEBUG(context << " we should download it as it's overdue after " << dt/1e6 << " seconds (expected " << expected
+                  << "), and we expect to get it in " << our_expected << " seconds");
+              return true;
+            }
+          }
+        }
+
         // in standby, be ready to double download early since we're idling anyway
         // let the fastest peer trigger first
         long threshold;
@@ -1838,7 +2226,9 @@ skip:
           next_block_height = context.m_last_response_height - context.m_needed_objects.size() + 1;
         bool stripe_proceed_main = ((m_sync_pruned_blocks && local_stripe && add_stripe != local_stripe) || add_stripe == 0 || peer_stripe == 0 || add_stripe == peer_stripe) && (next_block_height < bc_height + BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS || next_needed_height < bc_height + BLOCK_QUEUE_FORCE_DOWNLOAD_NEAR_BLOCKS);
         bool stripe_proceed_secondary = tools::has_unpruned_block(next_block_height, context.m_remote_blockchain_height, context.m_pruning_seed);
-        bool proceed = stripe_proceed_main || (queue_proceed && stripe_proceed_secondary);
+        // a peer we still have a backlog of data to send to would only see our request after it
+        const bool send_proceed = !context.is_send_congested();
+        bool proceed = send_proceed && (stripe_proceed_main || (queue_proceed && stripe_proceed_secondary));
         if (!stripe_proceed_main && !stripe_proceed_secondary && should_drop_connection(context, tools::get_pruning_stripe(next_block_height, context.m_remote_blockchain_height, CRYPTONOTE_PRUNING_LOG_STRIPES)))
         {
           if (!context.m_is_income)
@@ -1846,7 +2236,7 @@ skip:
           return false; // drop outgoing connections
         }
 
-        MDEBUG(context << "proceed " << proceed << " (queue " << queue_proceed << ", stripe " << stripe_proceed_main << "/" <<
+        MDEBUG(context << "proceed " << proceed << " (queue " << queue_proceed << ", send " << send_proceed << ", stripe " << stripe_proceed_main << "/" <<
           stripe_proceed_secondary << "), " << next_needed_pruning_stripe.first << "-" << next_needed_pruning_stripe.second <<
           " needed, bc add stripe " << add_stripe << ", we have " << peer_stripe << "), bc_height " << bc_height);
         MDEBUG(context << "  - next_block_height " << next_block_height << ", seed " << epee::string_tools::to_string_hex(context.m_pruning_seed) <<
@@ -1855,7 +2245,7 @@ skip:
 
         // if we're waiting for next span, try to get it before unblocking threads below,
         // or a runaway downloading of future spans might happen
-        if (stripe_proceed_main && should_download_next_span(context, true))
+        if (send_proceed && stripe_proceed_main && should_download_next_span(context, true))
         {
           MDEBUG(context << " we should try for that next span too, we think we could get it faster, resuming");
           force_next_span = true;
@@ -1911,7 +2301,9 @@ skip:
 
         if (context.m_state != cryptonote_connection_context::state_standby)
         {
-          if (!queue_proceed)
+          if (!send_proceed)
+            LOG_DEBUG_CC(context, "Send queue is congested, pausing");
+          else if (!queue_proceed)
             LOG_DEBUG_CC(context, "Block queue is " << nspans << " and " << size << ", pausing");
           else if (!stripe_proceed_main && !stripe_proceed_secondary)
             LOG_DEBUG_CC(context, "We do not have the stripe required to download another block, pausing");
@@ -1969,7 +2361,17 @@ skip:
 
         const uint64_t first_block_height = context.m_last_response_height - context.m_needed_objects.size() + 1;
         bool sync_pruned_blocks = m_sync_pruned_blocks && m_core.get_blockchain_pruning_seed();
-        span = m_block_queue.reserve_span(first_block_height, context.m_last_response_height, count_limit, context.m_connection_id, sync_pruned_blocks, m_core.get_blockchain_pruning_seed(), context.m_pruning_seed, context.m_remote_blockchain_height, context.m_needed_objects);
+
+        // size the span to this peer's measured throughput, and keep it short if this peer is slow
+        // and the span is one the chain will be waiting on: the next one needed, or the tail of the sync
+        const uint64_t next_needed_height = m_block_queue.get_next_needed_height(m_core.get_current_blockchain_height());
+        bool critical = first_block_height + count_limit >= m_core.get_target_blockchain_height();
+        if (!critical && next_needed_height >= first_block_height && next_needed_height <= context.m_last_response_height)
+          critical = !m_block_queue.requested(context.m_needed_objects[next_needed_height - first_block_height].first);
+        const uint64_t span_limit = m_block_queue.get_span_size(context.m_connection_id, count_limit, critical);
+        MDEBUG(context << " span limit " << span_limit << " (nominal " << count_limit << (critical ? ", critical" : "") << ")");
+
+        span = m_block_queue.reserve_span(first_block_height, context.m_last_response_height, span_limit, context.m_connection_id, sync_pruned_blocks, m_core.get_blockchain_pruning_seed(), context.m_pruning_seed, context.m_remote_blockchain_height, context.m_needed_objects);
         MDEBUG(context << " span from " << first_block_height << ": " << span.first << "/" << span.second);
         if (span.second > 0)
         {
@@ -2298,6 +2700,12 @@ skip:
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
   bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context)
+  {
+    return relay_block(arg, exclude_context, {});
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_cryptonote_protocol_handler<t_core>::relay_block(NOTIFY_NEW_BLOCK::request& arg, cryptonote_connection_context& exclude_context, const std::unordered_set<crypto::hash>& unrelayed_txs)
   {
     NOTIFY_NEW_FLUFFY_BLOCK::request fluffy_arg = AUTO_VAL_INIT(fluffy_arg);
     fluffy_arg.current_blockchain_height = arg.current_blockchain_height;    
@@ -2305,13 +2713,18 @@ skip:
     fluffy_arg.b = arg.b;
     fluffy_arg.b.txs = fluffy_txs;
 
-    // sort peers between fluffy ones and others
-    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections;
-    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
+    // sort peers between compact, fluffy and full ones
+    std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> fullConnections, fluffyConnections, compactConnections;
+    m_p2p->for_each_connection([this, &exclude_context, &fullConnections, &fluffyConnections, &compactConnections](connection_context& context, nodetool::peerid_type peer_id, uint32_t support_flags)
     {
       if (peer_id && exclude_context.m_connection_id != context.m_connection_id && context.m_remote_address.get_zone() == epee::net_utils::zone::public_)
       {
-        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
+        if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS) && (support_flags & P2P_SUPPORT_FLAG_COMPACT_BLOCKS))
+        {
+          LOG_DEBUG_CC(context, "PEER SUPPORTS COMPACT BLOCKS - RELAYING SHORT TX IDS");
+          compactConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
+        }
+        else if(m_core.fluffy_blocks_enabled() && (support_flags & P2P_SUPPORT_FLAG_FLUFFY_BLOCKS))
         {
           LOG_DEBUG_CC(context, "PEER SUPPORTS FLUFFY BLOCKS - RELAYING THIN/COMPACT WHATEVER BLOCK");
           fluffyConnections.push_back({context.m_remote_address.get_zone(), context.m_connection_id});
@@ -2325,7 +2738,39 @@ skip:
       return true;
     });
 
-    // send fluffy ones first, we want to encourage people to run that
+    // send compact and fluffy ones first, we want to encourage people to run that
+    if (!compactConnections.empty())
+    {
+      NOTIFY_NEW_COMPACT_BLOCK::request compact_arg = AUTO_VAL_INIT(compact_arg);
+      block b;
+      if (parse_and_validate_block_from_blob(arg.b.block, b, compact_arg.block_hash))
+      {
+        // the salt is picked per block so that short id collisions cannot be
+        // lined up in advance by whoever crafts the transactions
+        compact_arg.salt = crypto::rand<uint64_t>();
+        compact_arg.current_blockchain_height = arg.current_blockchain_height;
+        compact_arg.short_ids.reserve(b.tx_hashes.size());
+        for (size_t i = 0; i < b.tx_hashes.size(); ++i)
+        {
+          compact_arg.short_ids.push_back(get_tx_short_id(b.tx_hashes[i], compact_arg.salt));
+          // txes we only got along with the block were never flooded, so peers
+          // are unlikely to have them either: send those up front
+          if (unrelayed_txs.count(b.tx_hashes[i]) && arg.b.txs.size() == b.tx_hashes.size())
+            compact_arg.txs.push_back(arg.b.txs[i].blob);
+        }
+        b.tx_hashes.clear();
+        compact_arg.block = block_to_blob(b);
+
+        std::string compactBlob;
+        epee::serialization::store_t_to_binary(compact_arg, compactBlob);
+        m_p2p->relay_notify_to_list(NOTIFY_NEW_COMPACT_BLOCK::ID, epee::strspan<uint8_t>(compactBlob), std::move(compactConnections));
+      }
+      else
+      {
+        MERROR("Failed to parse block to relay as a compact block, relaying fluffy block instead");
+        fluffyConnections.insert(fluffyConnections.end(), compactConnections.begin(), compactConnections.end());
+      }
+    }
     if (!fluffyConnections.empty())
     {
       std::string fluffyBlob;
@@ -2428,6 +2873,18 @@ skip:
   }
   //------------------------------------------------------------------------------------------------------------------------
   template<class t_core>
+  size_t t_cryptonote_protocol_handler<t_core>::get_max_inflated_size(int command)
+  {
+    // only sync responses are ever sent compressed
+    switch (command)
+    {
+      case NOTIFY_RESPONSE_GET_OBJECTS::ID: return P2P_MAX_INFLATED_GET_OBJECTS_SIZE;
+      case NOTIFY_RESPONSE_CHAIN_ENTRY::ID: return P2P_MAX_INFLATED_CHAIN_ENTRY_SIZE;
+      default: return 0;
+    }
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
   void t_cryptonote_protocol_handler<t_core>::drop_connection_with_score(cryptonote_connection_context &context, unsigned score, bool flush_all_spans)
   {
     LOG_DEBUG_CC(context, "dropping connection id " << context.m_connection_id << " (pruning seed " <<
@@ -32,7 +32,9 @@
 #include <boost/system/system_error.hpp>
 #include <chrono>
 #include <deque>
+#include <map>
 #include <stdexcept>
+#include <utility>
 
 #include "common/expect.h"
 #include "common/varint.h"
@@ -57,6 +59,9 @@ namespace levin
     constexpr const std::chrono::seconds noise_min_delay{CRYPTONOTE_NOISE_MIN_DELAY};
     constexpr const std::chrono::seconds noise_delay_range{CRYPTONOTE_NOISE_DELAY_RANGE};
 
+    constexpr const std::chrono::milliseconds fluff_delay_range{CRYPTONOTE_FLUFF_DELAY_RANGE};
+    constexpr const std::chrono::milliseconds congested_retry{P2P_SEND_QUEUE_CONGESTED_RETRY};
+
     /*! Select a randomized duration from 0 to `range`. The precision will be to
         the systems `steady_clock`. As an example, supplying 3 seconds to this
         function will select a duration from [0, 3] seconds, and the increments
@@ -185,15 +190,68 @@ namespace levin
 
   namespace detail
   {
+    //! Txes from one `notify::send_txs` call, shared by the batches of every connection they are flooded to
+    struct fluff_round
+    {
+      fluff_round(std::vector<blobdata> txs_in, const std::uint64_t id)
+        : txs(std::move(txs_in)), queued(std::chrono::steady_clock::now()), id(id), bytes(0)
+      {
+        for (const blobdata& tx : txs)
+          bytes += tx.size();
+      }
+
+      const std::vector<blobdata> txs;
+      const std::chrono::steady_clock::time_point queued;
+      const std::uint64_t id; //!< Unique within a zone, identifies the round in `zone::fluff_payloads`
+      std::size_t bytes;
+    };
+
+    //! Rounds batched for the next flood notification of one connection
+    struct fluff_batch
+    {
+      fluff_batch()
+        : rounds(), bytes(0), flush_time(std::chrono::steady_clock::time_point::max()), retries(0), pad(false)
+      {}
+
+      //! Drops the oldest rounds until `P2P_FLUFF_BATCH_MAX_BYTES` fit, always keeps the newest
+      void trim()
+      {
+        while (P2P_FLUFF_BATCH_MAX_BYTES < bytes && 1 < rounds.size())
+        {
+          bytes -= rounds.front()->bytes;
+          rounds.pop_front();
+        }
+      }
+
+      std::deque<std::shared_ptr<const fluff_round>> rounds;
+      std::size_t bytes; //!< Tx bytes in `rounds`
+      std::chrono::steady_clock::time_point flush_time;
+      unsigned retries; //!< Times held back for congestion
+      bool pad;
+    };
+
+    //! A serialized flood notification, sent to every connection with the same batch
+    struct fluff_payload
+    {
+      epee::byte_slice message;
+      std::chrono::steady_clock::time_point expires; //!< No batch with these rounds is due after this, barring congestion
+    };
+
     struct zone
     {
       explicit zone(boost::asio::io_service& io_service, std::shared_ptr<connections> p2p, epee::byte_slice noise_in, bool is_public)
         : p2p(std::move(p2p)),
           noise(std::move(noise_in)),
           next_epoch(io_service),
+          flush_txs(io_service),
           strand(io_service),
           map(),
           channels(),
+          fluff_batches(),
+          fluff_payloads(),
+          flush_time(std::chrono::steady_clock::time_point::max()),
+          next_fluff_round(0),
+          fluff_payload_count(0),
           connection_count(0),
           is_public(is_public)
       {
@@ -204,9 +262,15 @@ namespace levin
       const std::shared_ptr<connections> p2p;
       const epee::byte_slice noise; //!< `!empty()` means zone is using noise channels
       boost::asio::steady_timer next_epoch;
+      boost::asio::steady_timer flush_txs; //!< Single timer for the batched flood notifications of every connection
       boost::asio::io_service::strand strand;
       net::dandelionpp::connection_map map;//!< Tracks outgoing uuid's for noise channels or Dandelion++ stems
       std::deque<noise_channel> channels;  //!< Never touch after init; only update elements on `noise_channel.strand`
+      std::map<boost::uuids::uuid, fluff_batch> fluff_batches; //!< Pending flood notifications by connection; only use in `strand`
+      std::map<std::pair<std::vector<std::uint64_t>, bool>, fluff_payload> fluff_payloads; //!< By round ids and padding; only use in `strand`
+      std::chrono::steady_clock::time_point flush_time; //!< Expiry of `flush_txs`, `max()` if not set; only use in `strand`
+      std::atomic<std::uint64_t> next_fluff_round;
+      std::atomic<std::uint64_t> fluff_payload_count; //!< Flood notifications serialized, can be read at any time
       std::atomic<std::size_t> connection_count; //!< Only update in strand, can be read at any time
       const bool is_public;                      //!< Zone is public ipv4/ipv6 connections
     };
@@ -245,23 +309,154 @@ namespace levin
       }
     };
 
-    //! Sends a message to every active connection
+    //! Sends the txes batched for each connection once its flush time is reached
+    struct fluff_flush
+    {
+      std::shared_ptr<detail::zone> zone_;
+      std::chrono::steady_clock::time_point flush_time_;
+
+      //! \pre Called within `zone->strand`.
+      static void queue(std::shared_ptr<detail::zone> zone, const std::chrono::steady_clock::time_point flush_time)
+      {
+        assert(zone->strand.running_in_this_thread());
+
+        detail::zone& alias = *zone;
+        alias.flush_time = flush_time;
+        alias.flush_txs.expires_at(flush_time);
+        alias.flush_txs.async_wait(alias.strand.wrap(fluff_flush{std::move(zone), flush_time}));
+      }
+
+      //! \pre Called within `zone_->strand`.
+      void operator()(const boost::system::error_code error)
+      {
+        if (!zone_ || !zone_->p2p)
+          return;
+
+        if (error && error != boost::system::errc::operation_canceled)
+          throw boost::system::system_error{error, "fluff_flush timer failed"};
+
+        assert(zone_->strand.running_in_this_thread());
+
+        /* The wait was superseded by an earlier flush time, which will handle
+           this one too. Otherwise a cancel is a request to flush everything
+           now, see `notify::run_fluff`. */
+        if (zone_->flush_time != flush_time_)
+          return;
+        const bool flush_all = bool(error);
+
+        struct batch
+        {
+          boost::uuids::uuid connection;
+          std::deque<std::shared_ptr<const detail::fluff_round>> rounds;
+          bool pad;
+        };
+        std::vector<batch> batches;
+
+        const auto now = std::chrono::steady_clock::now();
+        for (auto it = zone_->fluff_payloads.begin(); it != zone_->fluff_payloads.end(); )
+        {
+          if (it->second.expires < now)
+            it = zone_->fluff_payloads.erase(it);
+          else
+            ++it;
+        }
+
+        auto next_flush = std::chrono::steady_clock::time_point::max();
+        for (auto it = zone_->fluff_batches.begin(); it != zone_->fluff_batches.end(); )
+        {
+          detail::fluff_batch& pending = it->second;
+          if (!flush_all && now < pending.flush_time)
+          {
+            next_flush = std::min(next_flush, pending.flush_time);
+            ++it;
+            continue;
+          }
+
+          /* A peer still working through a backlog gets its txes later, in one
+             batch, instead of adding to a queue that gets it dropped when full.
+             The batch is capped in size, and sent anyway if the peer stays
+             congested, so it cannot grow past what the peer accepts. */
+          bool congested = false;
+          const bool connected = zone_->p2p->for_connection(it->first, [flush_all, &congested, &pending] (detail::p2p_context& context) {
+            congested = !flush_all && context.is_send_congested() && pending.retries < P2P_SEND_QUEUE_CONGESTED_MAX_RETRIES;
+            if (congested)
+              MDEBUG(context << "Send queue congested, holding back " << pending.rounds.size() << " tx batches");
+            return true;
+          });
+
+          if (congested)
+          {
+            ++pending.retries;
+            pending.trim();
+            pending.flush_time = now + congested_retry;
+            next_flush = std::min(next_flush, pending.flush_time);
+            ++it;
+            continue;
+          }
+
+          if (connected)
+            batches.push_back({it->first, std::move(pending.rounds), pending.pad});
+          it = zone_->fluff_batches.erase(it);
+        }
+
+        /* Serialize outside of the connections lock. Peers which were sent the
+           same rounds share one notification, whether due now or later in the
+           same flush window. */
+        for (batch& b : batches)
+        {
+          std::pair<std::vector<std::uint64_t>, bool> key{{}, b.pad};
+          key.first.reserve(b.rounds.size());
+          for (const auto& round : b.rounds)
+            key.first.push_back(round->id);
+
+          auto payload = zone_->fluff_payloads.find(key);
+          if (payload == zone_->fluff_payloads.end())
+          {
+            std::vector<blobdata> txs;
+            for (const auto& round : b.rounds)
+              txs.insert(txs.end(), round->txs.begin(), round->txs.end());
+
+            const std::string blob = make_tx_payload(std::move(txs), b.pad);
+            ++zone_->fluff_payload_count;
+            payload = zone_->fluff_payloads.emplace(
+              std::move(key),
+              detail::fluff_payload{
+                epee::levin::make_notify(NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<std::uint8_t>(blob)),
+                b.rounds.front()->queued + fluff_delay_range
+              }
+            ).first;
+          }
+          zone_->p2p->send(payload->second.message.clone(), b.connection);
+        }
+
+        if (zone_->fluff_batches.empty())
+          zone_->fluff_payloads.clear();
+
+        if (next_flush == std::chrono::steady_clock::time_point::max())
+          zone_->flush_time = next_flush;
+        else
+          queue(std::move(zone_), next_flush);
+      }
+    };
+
+    /*! Queues txs for every active connection. Each connection sends its
+        queued txs in one notification after a random delay from the first,
+        so a burst of txs costs one message and one timer wakeup per peer, and
+        peers do not all receive a tx at the same time. The txs are shared by
+        every batch, not copied into each. */
     class flood_notify
     {
       std::shared_ptr<detail::zone> zone_;
-      epee::byte_slice message_; // Requires manual copy
+      std::shared_ptr<const detail::fluff_round> round_;
       boost::uuids::uuid source_;
+      bool pad_txs_;
 
     public:
-      explicit flood_notify(std::shared_ptr<detail::zone> zone, epee::byte_slice message, const boost::uuids::uuid& source)
-        : zone_(std::move(zone)), message_(message.clone()), source_(source)
-      {}
-
-      flood_notify(flood_notify&&) = default;
-      flood_notify(const flood_notify& source)
-        : zone_(source.zone_), message_(source.message_.clone()), source_(source.source_)
+      explicit flood_notify(std::shared_ptr<detail::zone> zone, std::shared_ptr<const detail::fluff_round> round, const boost::uuids::uuid& source, const bool pad_txs)
+        : zone_(std::move(zone)), round_(std::move(round)), source_(source), pad_txs_(pad_txs)
       {}
 
+      //! \pre Called within `zone_->strand`.
       void operator()() const
       {
         if (!zone_ || !zone_->p2p)
@@ -275,19 +470,46 @@ namespace levin
            algorithm changes or the locking strategy within the levin config
            class changes. */
 
-        std::vector<boost::uuids::uuid> connections;
-        connections.reserve(connection_id_reserve_size);
-        zone_->p2p->foreach_connection([this, &connections] (detail::p2p_context& context) {
+        const auto now = std::chrono::steady_clock::now();
+        auto next_flush = std::chrono::steady_clock::time_point::max();
+        zone_->p2p->foreach_connection([this, now, &next_flush] (detail::p2p_context& context) {
           /* Only send to outgoing connections when "flooding" over i2p/tor.
              Otherwise this makes the tx linkable to a hidden service address,
              making things linkable across connections. */
-          if (this->source_ != context.m_connection_id && (this->zone_->is_public || !context.m_is_income))
-            connections.emplace_back(context.m_connection_id);
+          if (this->source_ == context.m_connection_id || !(this->zone_->is_public || !context.m_is_income))
+            return true;
+
+          /* Incoming public peers which support reconciliation pull txs from
+             us periodically, so flooding them too would only duplicate the
+             transfer. */
+          if (this->zone_->is_public && context.m_is_income && (context.support_flags & P2P_SUPPORT_FLAG_TX_RECONCILIATION))
+            return true;
+
+          detail::fluff_batch& pending = this->zone_->fluff_batches[context.m_connection_id];
+          if (pending.rounds.empty())
+          {
+            pending.flush_time = now + random_duration(fluff_delay_range);
+            next_flush = std::min(next_flush, pending.flush_time);
+          }
+          pending.rounds.push_back(this->round_);
+          pending.bytes += this->round_->bytes;
+          if (P2P_FLUFF_BATCH_MAX_BYTES < pending.bytes)
+          {
+            // a held back peer can fetch the dropped txes by reconciliation
+            if (pending.retries)
+              pending.trim();
+            else
+            {
+              pending.flush_time = now;
+              next_flush = now;
+            }
+          }
+          pending.pad = pending.pad || this->pad_txs_;
           return true;
         });
 
-        for (const boost::uuids::uuid& connection : connections)
-          zone_->p2p->send(message_.clone(), connection);
+        if (next_flush < zone_->flush_time)
+          fluff_flush::queue(zone_, next_flush);
       }
     };
 
@@ -533,6 +755,20 @@ namespace levin
       channel.next_noise.cancel();
   }
 
+  void notify::run_fluff()
+  {
+    if (!zone_)
+      return;
+    zone_->flush_txs.cancel();
+  }
+
+  std::uint64_t notify::fluff_payloads() const noexcept
+  {
+    if (!zone_)
+      return 0;
+    return zone_->fluff_payload_count;
+  }
+
   bool notify::send_txs(std::vector<blobdata> txs, const boost::uuids::uuid& source, const bool pad_txs)
   {
     if (!zone_)
@@ -565,12 +801,9 @@ namespace levin
     }
     else
     {
-      const std::string payload = make_tx_payload(std::move(txs), pad_txs);
-      epee::byte_slice message =
-        epee::levin::make_notify(NOTIFY_NEW_TRANSACTIONS::ID, epee::strspan<std::uint8_t>(payload));
-
-      // traditional monero send technique
-      zone_->strand.dispatch(flood_notify{zone_, std::move(message), source});
+      // traditional monero send technique, batched per connection
+      auto round = std::make_shared<detail::fluff_round>(std::move(txs), zone_->next_fluff_round++);
+      zone_->strand.dispatch(flood_notify{zone_, std::move(round), source, pad_txs});
     }
 
     return true;
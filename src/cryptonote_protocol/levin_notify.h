@@ -30,6 +30,7 @@
 
 #include <boost/asio/io_service.hpp>
 #include <boost/uuid/uuid.hpp>
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -104,11 +105,18 @@ namespace levin
     //! Run the logic for the next stem timeout imemdiately. Only use in  testing.
     void run_stems();
 
+    //! Send all batched flood notifications immediately. Only use in testing.
+    void run_fluff();
+
+    //! \return Number of flood notifications serialized so far. Only use in testing.
+    std::uint64_t fluff_payloads() const noexcept;
+
     /*! Send txs using `cryptonote_protocol_defs.h` payload format wrapped in a
         levin header. The message will be sent in a "discreet" manner if
         enabled - if `!noise.empty()` then the `command`/`payload` will be
         queued to send at the next available noise interval. Otherwise, a
-        standard Monero flood notification will be used.
+        standard Monero flood notification will be used, batched with the
+        other txs sent to each connection within a short random delay.
 
         \note Eventually Dandelion++ stem sending will be used here when
           enabled.
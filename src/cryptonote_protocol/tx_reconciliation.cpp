@@ -0,0 +1,222 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <cstring>
+#include <deque>
+#include <unordered_map>
+
+#include "int-util.h"
+#include "tx_reconciliation.h"
+
+#define TX_SKETCH_HASHES 3
+#define TX_SKETCH_CELL_SIZE (4 + 8 + 8)
+
+namespace
+{
+  uint64_t mix(uint64_t x)
+  {
+    // splitmix64 finalizer, the short ids are uniform already
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+  }
+
+  uint64_t get_check(uint64_t short_id)
+  {
+    return mix(short_id ^ 0xc3a5c85c97cb3127ull);
+  }
+
+  size_t get_partition_size(size_t capacity)
+  {
+    // ~1.5 cells per difference, plus slack so tiny sketches still peel
+    return capacity / 2 + 2;
+  }
+}
+
+namespace cryptonote
+{
+  //---------------------------------------------------------------------------
+  uint64_t get_tx_short_id(const crypto::hash &txid, uint64_t salt)
+  {
+    char data[sizeof(salt) + sizeof(txid)];
+    const uint64_t salt_le = SWAP64LE(salt);
+    memcpy(data, &salt_le, sizeof(salt_le));
+    memcpy(data + sizeof(salt_le), &txid, sizeof(txid));
+    const crypto::hash h = crypto::cn_fast_hash(data, sizeof(data));
+    uint64_t short_id;
+    memcpy(&short_id, &h, sizeof(short_id));
+    return SWAP64LE(short_id);
+  }
+  //---------------------------------------------------------------------------
+  std::vector<crypto::hash> resolve_tx_short_ids(const std::vector<uint64_t> &short_ids, uint64_t salt, const std::vector<crypto::hash> &candidates, std::vector<uint64_t> &missing)
+  {
+    std::unordered_map<uint64_t, crypto::hash> by_id;
+    by_id.reserve(candidates.size());
+    for (const crypto::hash &txid: candidates)
+    {
+      auto ins = by_id.emplace(get_tx_short_id(txid, salt), txid);
+      if (!ins.second && ins.first->second != txid)
+        ins.first->second = crypto::null_hash; // ambiguous, ask for it instead
+    }
+
+    std::vector<crypto::hash> txids;
+    txids.reserve(short_ids.size());
+    for (size_t i = 0; i < short_ids.size(); ++i)
+    {
+      const auto it = by_id.find(short_ids[i]);
+      txids.push_back(it == by_id.end() ? crypto::null_hash : it->second);
+      if (txids.back() == crypto::null_hash)
+        missing.push_back(i);
+    }
+    return txids;
+  }
+  //---------------------------------------------------------------------------
+  tx_sketch::tx_sketch(size_t capacity):
+    m_capacity(capacity),
+    m_cells(TX_SKETCH_HASHES * get_partition_size(capacity), cell{0, 0, 0})
+  {
+  }
+  //---------------------------------------------------------------------------
+  bool tx_sketch::empty() const
+  {
+    for (const cell &c: m_cells)
+      if (c.count || c.id_sum || c.check_sum)
+        return false;
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  void tx_sketch::toggle(uint64_t short_id, int32_t sign)
+  {
+    const size_t partition_size = m_cells.size() / TX_SKETCH_HASHES;
+    const uint64_t check = get_check(short_id);
+    for (size_t i = 0; i < TX_SKETCH_HASHES; ++i)
+    {
+      cell &c = m_cells[i * partition_size + mix(short_id + i * 0x9e3779b97f4a7c15ull) % partition_size];
+      c.count += sign;
+      c.id_sum ^= short_id;
+      c.check_sum ^= check;
+    }
+  }
+  //---------------------------------------------------------------------------
+  void tx_sketch::add(uint64_t short_id)
+  {
+    toggle(short_id, 1);
+  }
+  //---------------------------------------------------------------------------
+  bool tx_sketch::subtract(const tx_sketch &other)
+  {
+    if (other.m_cells.size() != m_cells.size())
+      return false;
+    for (size_t i = 0; i < m_cells.size(); ++i)
+    {
+      m_cells[i].count -= other.m_cells[i].count;
+      m_cells[i].id_sum ^= other.m_cells[i].id_sum;
+      m_cells[i].check_sum ^= other.m_cells[i].check_sum;
+    }
+    return true;
+  }
+  //---------------------------------------------------------------------------
+  bool tx_sketch::decode(std::vector<uint64_t> &ours, std::vector<uint64_t> &theirs) const
+  {
+    ours.clear();
+    theirs.clear();
+    if (m_cells.empty())
+      return true;
+
+    tx_sketch work(*this);
+    auto is_pure = [](const cell &c) {
+      return (c.count == 1 || c.count == -1) && c.check_sum == get_check(c.id_sum);
+    };
+
+    std::deque<size_t> pure;
+    for (size_t i = 0; i < work.m_cells.size(); ++i)
+      if (is_pure(work.m_cells[i]))
+        pure.push_back(i);
+
+    const size_t partition_size = work.m_cells.size() / TX_SKETCH_HASHES;
+    while (!pure.empty())
+    {
+      const cell c = work.m_cells[pure.front()];
+      pure.pop_front();
+      if (!is_pure(c))
+        continue;
+      (c.count > 0 ? ours : theirs).push_back(c.id_sum);
+      work.toggle(c.id_sum, -c.count);
+      if (ours.size() + theirs.size() > work.m_cells.size())
+        return false;
+      for (size_t i = 0; i < TX_SKETCH_HASHES; ++i)
+      {
+        const size_t idx = i * partition_size + mix(c.id_sum + i * 0x9e3779b97f4a7c15ull) % partition_size;
+        if (is_pure(work.m_cells[idx]))
+          pure.push_back(idx);
+      }
+    }
+    return work.empty();
+  }
+  //---------------------------------------------------------------------------
+  std::string tx_sketch::serialize() const
+  {
+    std::string blob(m_cells.size() * TX_SKETCH_CELL_SIZE, '\0');
+    char *ptr = &blob[0];
+    for (const cell &c: m_cells)
+    {
+      const uint32_t count = SWAP32LE((uint32_t)c.count);
+      const uint64_t id_sum = SWAP64LE(c.id_sum), check_sum = SWAP64LE(c.check_sum);
+      memcpy(ptr, &count, 4);
+      memcpy(ptr + 4, &id_sum, 8);
+      memcpy(ptr + 12, &check_sum, 8);
+      ptr += TX_SKETCH_CELL_SIZE;
+    }
+    return blob;
+  }
+  //---------------------------------------------------------------------------
+  bool tx_sketch::deserialize(const std::string &blob, size_t capacity)
+  {
+    const size_t ncells = TX_SKETCH_HASHES * get_partition_size(capacity);
+    if (blob.size() != ncells * TX_SKETCH_CELL_SIZE)
+      return false;
+    m_capacity = capacity;
+    m_cells.resize(ncells);
+    const char *ptr = blob.data();
+    for (cell &c: m_cells)
+    {
+      uint32_t count;
+      memcpy(&count, ptr, 4);
+      memcpy(&c.id_sum, ptr + 4, 8);
+      memcpy(&c.check_sum, ptr + 12, 8);
+      c.count = (int32_t)SWAP32LE(count);
+      c.id_sum = SWAP64LE(c.id_sum);
+      c.check_sum = SWAP64LE(c.check_sum);
+      ptr += TX_SKETCH_CELL_SIZE;
+    }
+    return true;
+  }
+}
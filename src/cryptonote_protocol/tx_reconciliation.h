@@ -0,0 +1,87 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "crypto/hash.h"
+
+namespace cryptonote
+{
+  //! \return A salted 64 bit identifier for `txid`, as used in reconciliation
+  uint64_t get_tx_short_id(const crypto::hash &txid, uint64_t salt);
+
+  /*! Maps each of `short_ids` back to the hash in `candidates` it was built
+      from with `salt`. Ids matching no candidate, or more than one, are left
+      as null hashes and their indices are appended to `missing`. */
+  std::vector<crypto::hash> resolve_tx_short_ids(const std::vector<uint64_t> &short_ids, uint64_t salt, const std::vector<crypto::hash> &candidates, std::vector<uint64_t> &missing);
+
+  /*! An invertible bloom lookup table over short tx ids. A sketch built by a
+      peer can be subtracted from one built locally over the same number of
+      cells, and the result decoded to recover the symmetric difference of the
+      two sets, as long as that difference is not much larger than the
+      capacity the sketches were built for. */
+  class tx_sketch
+  {
+  public:
+    explicit tx_sketch(size_t capacity = 0);
+
+    //! \return The number of differences the sketch was sized for
+    size_t get_capacity() const { return m_capacity; }
+    size_t get_cells() const { return m_cells.size(); }
+    bool empty() const;
+
+    void add(uint64_t short_id);
+    bool subtract(const tx_sketch &other);
+
+    /*! Peels a subtracted sketch. Ids that were only in this sketch go to
+        `ours`, ids that were only in the subtracted one go to `theirs`.
+
+      \return True iff the whole difference was recovered. */
+    bool decode(std::vector<uint64_t> &ours, std::vector<uint64_t> &theirs) const;
+
+    std::string serialize() const;
+    bool deserialize(const std::string &blob, size_t capacity);
+
+  private:
+    struct cell
+    {
+      int32_t count;
+      uint64_t id_sum;
+      uint64_t check_sum;
+    };
+
+    void toggle(uint64_t short_id, int32_t sign);
+
+    size_t m_capacity;
+    std::vector<cell> m_cells;
+  };
+}
@@ -133,9 +133,11 @@ bool t_command_parser_executor::show_status(const std::vector<std::string>& args
 
 bool t_command_parser_executor::print_connections(const std::vector<std::string>& args)
 {
-  if (!args.empty()) return false;
-
-  return m_executor.print_connections();
+  if (args.empty())
+    return m_executor.print_connections();
+  if (args.size() == 1 && args[0] == "metrics")
+    return m_executor.print_connection_metrics();
+  return false;
 }
 
 bool t_command_parser_executor::print_net_stats(const std::vector<std::string>& args)
@@ -77,7 +77,8 @@ t_command_server::t_command_server(
   m_command_lookup.set_handler(
       "print_cn"
     , std::bind(&t_command_parser_executor::print_connections, &m_parser, p::_1)
-    , "Print the current connections."
+    , "print_cn [metrics]"
+    , "Print the current connections, or their traffic and per command metrics."
     );
   m_command_lookup.set_handler(
       "print_net_stats"
@@ -661,6 +661,77 @@ bool t_rpc_command_executor::print_connections() {
   return true;
 }
 
+static std::string format_histogram(const cryptonote::COMMAND_RPC_GET_CONNECTION_METRICS::histogram &h)
+{
+  return std::to_string(h.p50) + "/" + std::to_string(h.p99) + "/" + std::to_string(h.max);
+}
+
+bool t_rpc_command_executor::print_connection_metrics() {
+  cryptonote::COMMAND_RPC_GET_CONNECTION_METRICS::request req;
+  cryptonote::COMMAND_RPC_GET_CONNECTION_METRICS::response res;
+  epee::json_rpc::error error_resp;
+
+  std::string fail_message = "Unsuccessful";
+
+  if (m_is_rpc)
+  {
+    if (!m_rpc_client->json_rpc_request(req, res, "get_connection_metrics", fail_message.c_str()))
+    {
+      return true;
+    }
+  }
+  else
+  {
+    if (!m_rpc_server->on_get_connection_metrics(req, res, error_resp) || res.status != CORE_RPC_STATUS_OK)
+    {
+      tools::fail_msg_writer() << make_error(fail_message, res.status);
+      return true;
+    }
+  }
+
+  tools::msg_writer() << std::setw(40) << std::left << "Command"
+      << std::setw(12) << "Msgs in"
+      << std::setw(12) << "Bytes in"
+      << std::setw(12) << "Msgs out"
+      << std::setw(12) << "Bytes out"
+      << std::setw(24) << "Handler us p50/p99/max"
+      << std::endl;
+  for (const auto &c: res.commands)
+  {
+    tools::msg_writer() << std::setw(40) << std::left << (c.name.empty() ? std::to_string(c.id) : c.name)
+        << std::setw(12) << c.totals.messages_in
+        << std::setw(12) << tools::get_human_readable_bytes(c.totals.bytes_in)
+        << std::setw(12) << c.totals.messages_out
+        << std::setw(12) << tools::get_human_readable_bytes(c.totals.bytes_out)
+        << std::setw(24) << format_histogram(c.totals.handler_time);
+  }
+
+  tools::msg_writer() << "\n" << std::setw(30) << std::left << "Remote Host"
+      << std::setw(12) << "Msgs in"
+      << std::setw(12) << "Bytes in"
+      << std::setw(12) << "Msgs out"
+      << std::setw(12) << "Bytes out"
+      << std::setw(24) << "Handler us p50/p99/max"
+      << std::setw(20) << "Queue p50/p99/max"
+      << std::setw(12) << "Queued"
+      << std::setw(16) << "Throttled (ms)"
+      << std::endl;
+  for (const auto &c: res.connections)
+  {
+    tools::msg_writer() << std::setw(30) << std::left << std::string(c.incoming ? "INC " : "OUT ") + c.address
+        << std::setw(12) << c.totals.messages_in
+        << std::setw(12) << tools::get_human_readable_bytes(c.totals.bytes_in)
+        << std::setw(12) << c.totals.messages_out
+        << std::setw(12) << tools::get_human_readable_bytes(c.totals.bytes_out)
+        << std::setw(24) << format_histogram(c.totals.handler_time)
+        << std::setw(20) << format_histogram(c.send_queue_depth)
+        << std::setw(12) << tools::get_human_readable_bytes(c.send_queue_bytes)
+        << std::setw(16) << c.throttle_time.sum / 1000;
+  }
+
+  return true;
+}
+
 bool t_rpc_command_executor::print_net_stats()
 {
   cryptonote::COMMAND_RPC_GET_NET_STATS::request net_stats_req;
@@ -2198,7 +2269,8 @@ bool t_rpc_command_executor::sync_info()
       tools::success_msg_writer() << address << "  " << epee::string_tools::pad_string(p.info.peer_id, 16, '0', true) << "  " <<
           epee::string_tools::pad_string(p.info.state, 16) << "  " <<
           epee::string_tools::pad_string(epee::string_tools::to_string_hex(p.info.pruning_seed), 8) << "  " << p.info.height << "  "  <<
-          p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued";
+          p.info.current_download << " kB/s, " << nblocks << " blocks / " << size/1e6 << " MB queued" <<
+          (p.throughput ? ", " + std::to_string(p.throughput/1000) + " kB/s measured, " + std::to_string(p.latency) + " ms latency, spans of " + std::to_string(p.span_size) : std::string());
     }
 
     uint64_t total_size = 0;
@@ -86,6 +86,8 @@ public:
 
   bool print_connections();
 
+  bool print_connection_metrics();
+
   bool print_blockchain_info(uint64_t start_block_index, uint64_t end_block_index);
 
   bool set_log_level(int8_t level);
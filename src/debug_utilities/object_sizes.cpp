@@ -96,7 +96,7 @@ int main(int argc, char* argv[])
   SL(nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<cryptonote::core>>);
   SL(nodetool::p2p_connection_context_t<cryptonote::t_cryptonote_protocol_handler<cryptonote::core>::connection_context>);
   SL(nodetool::network_address_old);
-  SL(nodetool::peerlist_entry_base<nodetool::network_address_old>);
+  SL(nodetool::peerlist_entry_old);
 
   SL(nodetool::network_config);
   SL(nodetool::basic_node_data);
@@ -154,6 +154,7 @@ namespace nodetool
     const command_line::arg_descriptor<std::string> arg_igd = {"igd", "UPnP port mapping (disabled, enabled, delayed)", "delayed"};
     const command_line::arg_descriptor<bool>        arg_p2p_use_ipv6  = {"p2p-use-ipv6", "Enable IPv6 for p2p", false};
     const command_line::arg_descriptor<bool>        arg_p2p_ignore_ipv4  = {"p2p-ignore-ipv4", "Ignore unsuccessful IPv4 bind for p2p", false};
+    const command_line::arg_descriptor<bool>        arg_p2p_io_service_per_thread  = {"p2p-io-service-per-thread", "Run each p2p thread on its own io_service and listening socket", false};
     const command_line::arg_descriptor<int64_t>     arg_out_peers = {"out-peers", "set max number of out peers", -1};
     const command_line::arg_descriptor<int64_t>     arg_in_peers = {"in-peers", "set max number of in peers", -1};
     const command_line::arg_descriptor<int> arg_tos_flag = {"tos-flag", "set TOS flag", -1};
@@ -371,4 +372,72 @@ namespace nodetool
 
         return boost::none;
     }
+
+    connect_race::connect_race(size_t wanted, size_t parallelism)
+      : m_wanted(wanted), m_parallelism(std::max<size_t>(parallelism, 1)), m_claimed(0), m_running(0), m_events(0)
+    {
+    }
+
+    bool connect_race::wait_to_start(unsigned stagger_ms)
+    {
+        boost::unique_lock<boost::mutex> lock(m_lock);
+
+        // give the running attempts a head start, unless one of them connects or fails first
+        const uint64_t events = m_events;
+        const boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(stagger_ms);
+        while (m_claimed < m_wanted && m_running > 0 && m_events == events)
+        {
+            if (m_cond.wait_until(lock, deadline) == boost::cv_status::timeout)
+                break;
+        }
+
+        while (m_claimed < m_wanted && m_running >= m_parallelism)
+            m_cond.wait(lock);
+
+        if (m_claimed >= m_wanted)
+            return false;
+        ++m_running;
+        return true;
+    }
+
+    bool connect_race::claim()
+    {
+        boost::unique_lock<boost::mutex> lock(m_lock);
+        if (m_claimed >= m_wanted)
+            return false;
+        ++m_claimed;
+        ++m_events;
+        m_cond.notify_all();
+        return true;
+    }
+
+    void connect_race::release()
+    {
+        boost::unique_lock<boost::mutex> lock(m_lock);
+        if (m_claimed > 0)
+            --m_claimed;
+        ++m_events;
+        m_cond.notify_all();
+    }
+
+    void connect_race::finish()
+    {
+        boost::unique_lock<boost::mutex> lock(m_lock);
+        if (m_running > 0)
+            --m_running;
+        ++m_events;
+        m_cond.notify_all();
+    }
+
+    bool connect_race::full() const
+    {
+        boost::unique_lock<boost::mutex> lock(m_lock);
+        return m_claimed >= m_wanted;
+    }
+
+    size_t connect_race::won() const
+    {
+        boost::unique_lock<boost::mutex> lock(m_lock);
+        return m_claimed;
+    }
 }
@@ -32,6 +32,7 @@
 #pragma once
 #include <array>
 #include <atomic>
+#include <deque>
 #include <boost/asio/io_service.hpp>
 #include <boost/asio/ip/tcp.hpp>
 #include <boost/thread.hpp>
@@ -106,6 +107,35 @@ namespace nodetool
   boost::optional<boost::asio::ip::tcp::socket>
   socks_connect_internal(const std::atomic<bool>& stop_signal, boost::asio::io_service& service, const boost::asio::ip::tcp::endpoint& proxy, const epee::net_utils::network_address& remote);
 
+  // Coordinates the concurrent outgoing connection attempts of one pass of
+  // the connections maker: attempts start staggered, the first peers to
+  // connect take the wanted slots and later ones are closed
+  class connect_race
+  {
+  public:
+    connect_race(size_t wanted, size_t parallelism);
+
+    //! blocks until another attempt may start, false once all slots are taken
+    bool wait_to_start(unsigned stagger_ms);
+    //! takes a slot for a newly connected peer, false if none is left
+    bool claim();
+    //! gives a slot back after a failed handshake
+    void release();
+    //! marks the end of an attempt allowed by wait_to_start
+    void finish();
+    bool full() const;
+    size_t won() const;
+
+  private:
+    mutable boost::mutex m_lock;
+    boost::condition_variable m_cond;
+    const size_t m_wanted;
+    const size_t m_parallelism;
+    size_t m_claimed;
+    size_t m_running;
+    uint64_t m_events;
+  };
+
 
   template<class base_type>
   struct p2p_connection_context_t: base_type //t_payload_net_handler::connection_context //public net_utils::connection_context_base
@@ -280,6 +310,7 @@ namespace nodetool
     virtual void add_used_stripe_peer(const typename t_payload_net_handler::connection_context &context);
     virtual void remove_used_stripe_peer(const typename t_payload_net_handler::connection_context &context);
     virtual void clear_used_stripe_peers();
+    virtual void record_peer_throughput(const typename t_payload_net_handler::connection_context &context, float bytes_per_second);
 
   private:
     const std::vector<std::string> m_seed_nodes_list =
@@ -315,6 +346,14 @@ namespace nodetool
 
     enum PeerType { anchor = 0, white, gray };
 
+    struct connect_candidate
+    {
+      epee::net_utils::network_address adr;
+      uint64_t last_seen;
+      uint64_t first_seen;
+      PeerType peer_type;
+    };
+
     //----------------- commands handlers ----------------------------------------------
     int handle_handshake(int command, typename COMMAND_HANDSHAKE::request& arg, typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context);
     int handle_timed_sync(int command, typename COMMAND_TIMED_SYNC::request& arg, typename COMMAND_TIMED_SYNC::response& rsp, p2p_connection_context& context);
@@ -330,6 +369,7 @@ namespace nodetool
     bool make_default_config();
     bool store_config();
     bool check_trust(const proof_of_trust& tr, epee::net_utils::zone zone_type);
+    static size_t get_max_inflated_size(const p2p_connection_context& context, int command);
 
 
     //----------------- levin_commands_handler -------------------------------------------------------------
@@ -340,7 +380,7 @@ namespace nodetool
     virtual bool relay_notify_to_list(int command, const epee::span<const uint8_t> data_buff, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections);
     virtual epee::net_utils::zone send_txs(std::vector<cryptonote::blobdata> txs, const epee::net_utils::zone origin, const boost::uuids::uuid& source, cryptonote::i_core_events& core, bool pad_txs);
     virtual bool invoke_command_to_peer(int command, const epee::span<const uint8_t> req_buff, std::string& resp_buff, const epee::net_utils::connection_context_base& context);
-    virtual bool invoke_notify_to_peer(int command, const epee::span<const uint8_t> req_buff, const epee::net_utils::connection_context_base& context);
+    virtual bool invoke_notify_to_peer(int command, epee::byte_slice message, const epee::net_utils::connection_context_base& context, bool compress);
     virtual bool drop_connection(const epee::net_utils::connection_context_base& context);
     virtual void request_callback(const epee::net_utils::connection_context_base& context);
     virtual void for_each_connection(std::function<bool(typename t_payload_net_handler::connection_context&, peerid_type, uint32_t)> f);
@@ -365,10 +405,11 @@ namespace nodetool
     bool do_handshake_with_peer(peerid_type& pi, p2p_connection_context& context, bool just_take_peerlist = false);
     bool do_peer_timed_sync(const epee::net_utils::connection_context_base& context, peerid_type peer_id);
 
-    bool make_new_connection_from_anchor_peerlist(const std::vector<anchor_peerlist_entry>& anchor_peerlist);
-    bool make_new_connection_from_peerlist(network_zone& zone, bool use_white_list);
-    bool try_to_connect_and_handshake_with_new_peer(const epee::net_utils::network_address& na, bool just_take_peerlist = false, uint64_t last_seen_stamp = 0, PeerType peer_type = white, uint64_t first_seen_stamp = 0);
-    size_t get_random_index_with_fixed_probability(size_t max_index);
+    bool make_new_connection_from_anchor_peerlist(network_zone& zone, const std::vector<anchor_peerlist_entry>& anchor_peerlist, size_t wanted = 1);
+    bool make_new_connection_from_peerlist(network_zone& zone, bool use_white_list, size_t wanted = 1);
+    bool try_to_connect_and_handshake_with_new_peer(const epee::net_utils::network_address& na, bool just_take_peerlist = false, uint64_t last_seen_stamp = 0, PeerType peer_type = white, uint64_t first_seen_stamp = 0, connect_race *race = nullptr);
+    size_t try_to_connect_and_handshake_with_new_peers(network_zone& zone, const std::vector<connect_candidate>& candidates, size_t wanted);
+    size_t get_random_index_with_weights(const std::deque<float>& weights);
     bool is_peer_used(const peerlist_entry& peer);
     bool is_peer_used(const anchor_peerlist_entry& peer);
     bool is_addr_connected(const epee::net_utils::network_address& peer);
@@ -462,6 +503,7 @@ namespace nodetool
 
     t_payload_net_handler& m_payload_handler;
     peerlist_storage m_peerlist_storage;
+    peerlist_journal m_peerlist_journal;
 
     epee::math_helper::once_a_time_seconds<P2P_DEFAULT_HANDSHAKE_INTERVAL> m_peer_handshake_idle_maker_interval;
     epee::math_helper::once_a_time_seconds<1> m_connections_maker_interval;
@@ -520,6 +562,7 @@ namespace nodetool
     extern const command_line::arg_descriptor<std::string, false, true, 2> arg_p2p_bind_port_ipv6;
     extern const command_line::arg_descriptor<bool>        arg_p2p_use_ipv6;
     extern const command_line::arg_descriptor<bool>        arg_p2p_ignore_ipv4;
+    extern const command_line::arg_descriptor<bool>        arg_p2p_io_service_per_thread;
     extern const command_line::arg_descriptor<uint32_t>    arg_p2p_external_port;
     extern const command_line::arg_descriptor<bool>        arg_p2p_allow_local_ip;
     extern const command_line::arg_descriptor<std::vector<std::string> > arg_p2p_add_peer;
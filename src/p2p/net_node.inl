@@ -42,6 +42,7 @@
 #include <functional>
 #include <limits>
 #include <memory>
+#include <numeric>
 #include <tuple>
 #include <vector>
 
@@ -99,6 +100,7 @@ namespace nodetool
     command_line::add_arg(desc, arg_p2p_bind_port_ipv6, false);
     command_line::add_arg(desc, arg_p2p_use_ipv6);
     command_line::add_arg(desc, arg_p2p_ignore_ipv4);
+    command_line::add_arg(desc, arg_p2p_io_service_per_thread);
     command_line::add_arg(desc, arg_p2p_external_port);
     command_line::add_arg(desc, arg_p2p_allow_local_ip);
     command_line::add_arg(desc, arg_p2p_add_peer);
@@ -127,6 +129,23 @@ namespace nodetool
     if (storage)
       m_peerlist_storage = std::move(*storage);
 
+    const time_t now = time(nullptr);
+    CRITICAL_REGION_BEGIN(m_blocked_hosts_lock);
+    for (const auto& host : m_peerlist_storage.take_blocked())
+    {
+      if (host.second <= now)
+        continue;
+      if (host.first.find('/') == std::string::npos)
+      {
+        m_blocked_hosts[host.first] = host.second;
+        continue;
+      }
+      const expect<epee::net_utils::ipv4_network_subnet> subnet = net::get_ipv4_subnet_address(host.first);
+      if (subnet)
+        m_blocked_subnets[*subnet] = host.second;
+    }
+    CRITICAL_REGION_END();
+
     m_network_zones[epee::net_utils::zone::public_].m_config.m_support_flags = P2P_SUPPORT_FLAGS;
     m_first_connection_maker_call = true;
 
@@ -226,6 +245,7 @@ namespace nodetool
     else
       limit = now + seconds;
     m_blocked_hosts[addr.host_str()] = limit;
+    m_peerlist_journal.block(addr.host_str(), limit);
 
     // drop any connection to that address. This should only have to look into
     // the zone related to the connection, but really make sure everything is
@@ -259,6 +279,7 @@ namespace nodetool
     if (i == m_blocked_hosts.end())
       return false;
     m_blocked_hosts.erase(i);
+    m_peerlist_journal.unblock(address.host_str());
     MCLOG_CYAN(el::Level::Info, "global", "Host " << address.host_str() << " unblocked.");
     return true;
   }
@@ -275,6 +296,7 @@ namespace nodetool
     else
       limit = now + seconds;
     m_blocked_subnets[subnet] = limit;
+    m_peerlist_journal.block(subnet.host_str(), limit);
 
     // drop any connection to that subnet. This should only have to look into
     // the zone related to the connection, but really make sure everything is
@@ -311,6 +333,7 @@ namespace nodetool
     if (i == m_blocked_subnets.end())
       return false;
     m_blocked_subnets.erase(i);
+    m_peerlist_journal.unblock(subnet.host_str());
     MCLOG_CYAN(el::Level::Info, "global", "Subnet " << subnet.host_str() << " unblocked.");
     return true;
   }
@@ -384,6 +407,7 @@ namespace nodetool
     m_offline = command_line::get_arg(vm, cryptonote::arg_offline);
     m_use_ipv6 = command_line::get_arg(vm, arg_p2p_use_ipv6);
     m_require_ipv4 = !command_line::get_arg(vm, arg_p2p_ignore_ipv4);
+    public_zone.m_net_server.set_io_service_per_thread(command_line::get_arg(vm, arg_p2p_io_service_per_thread));
     public_zone.m_notifier = cryptonote::levin::notify{
       public_zone.m_net_server.get_io_service(), public_zone.m_net_server.get_config_shared(), nullptr, true
     };
@@ -798,6 +822,13 @@ namespace nodetool
     }
 #endif
 
+    // write the state file once in the compact format, from then on updates are appended to it
+    if (store_config() && m_peerlist_journal.open(m_config_folder + "/" + P2P_NET_DATA_FILENAME))
+    {
+      for (auto& zone : m_network_zones)
+        zone.second.m_peerlist.set_journal(std::addressof(m_peerlist_journal));
+    }
+
     //only in case if we really sure that we have external visible ip
     m_have_address = true;
     m_last_stat_request_time = 0;
@@ -816,6 +847,7 @@ namespace nodetool
     {
       zone.second.m_net_server.get_config_object().set_handler(this);
       zone.second.m_net_server.get_config_object().m_invoke_timeout = P2P_DEFAULT_INVOKE_TIMEOUT;
+      zone.second.m_net_server.get_config_object().m_max_inflated_size = &node_server<t_payload_net_handler>::get_max_inflated_size;
 
       if (!zone.second.m_bind_ip.empty())
       {
@@ -948,6 +980,14 @@ namespace nodetool
       if(m_igd == igd)
         delete_upnp_port_mapping(m_listening_port);
     }
+
+    // the journal already holds every update, so there is no need to rewrite the whole file
+    if (m_peerlist_journal.is_open())
+    {
+      for (auto& zone : m_network_zones)
+        zone.second.m_peerlist.set_journal(nullptr);
+      return m_peerlist_journal.close();
+    }
     return store_config();
   }
   //-----------------------------------------------------------------------------------
@@ -962,12 +1002,38 @@ namespace nodetool
       return false;
     }
 
-    peerlist_types active{};
-    for (auto& zone : m_network_zones)
-      zone.second.m_peerlist.get_peerlist(active);
+    const auto get_state = [this](peerlist_types& active, std::map<std::string, time_t>& blocked)
+    {
+      for (auto& zone : m_network_zones)
+        zone.second.m_peerlist.get_peerlist(active);
+
+      CRITICAL_REGION_LOCAL(m_blocked_hosts_lock);
+      blocked.insert(m_blocked_hosts.begin(), m_blocked_hosts.end());
+      for (const auto& subnet : m_blocked_subnets)
+        blocked[subnet.first.host_str()] = subnet.second;
+    };
 
     const std::string state_file_path = m_config_folder + "/" + P2P_NET_DATA_FILENAME;
-    if (!m_peerlist_storage.store(state_file_path, active))
+    bool stored = false;
+    if (m_peerlist_journal.is_open())
+    {
+      // compacts the appended updates into a fresh snapshot
+      stored = m_peerlist_journal.rewrite([this, &get_state](std::ostream& dest)
+      {
+        peerlist_types active{};
+        std::map<std::string, time_t> blocked{};
+        get_state(active, blocked);
+        return m_peerlist_storage.store(dest, active, blocked);
+      });
+    }
+    else
+    {
+      peerlist_types active{};
+      std::map<std::string, time_t> blocked{};
+      get_state(active, blocked);
+      stored = m_peerlist_storage.store(state_file_path, active, blocked);
+    }
+    if (!stored)
     {
       MWARNING("Failed to save config to file " << state_file_path);
       return false;
@@ -1010,9 +1076,10 @@ namespace nodetool
 
     epee::simple_event ev;
     std::atomic<bool> hsh_result(false);
+    const boost::posix_time::ptime request_time = boost::posix_time::microsec_clock::universal_time();
 
     bool r = epee::net_utils::async_invoke_remote_command2<typename COMMAND_HANDSHAKE::response>(context_.m_connection_id, COMMAND_HANDSHAKE::ID, arg, zone.m_net_server.get_config_object(),
-      [this, &pi, &ev, &hsh_result, &just_take_peerlist, &context_](int code, const typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context)
+      [this, &pi, &ev, &hsh_result, &just_take_peerlist, &context_, request_time](int code, const typename COMMAND_HANDSHAKE::response& rsp, p2p_connection_context& context)
     {
       epee::misc_utils::auto_scope_leave_caller scope_exit_handler = epee::misc_utils::create_scope_leave_handler([&](){ev.raise();});
 
@@ -1047,7 +1114,10 @@ namespace nodetool
         pi = context.peer_id = rsp.node_data.peer_id;
         context.m_rpc_port = rsp.node_data.rpc_port;
         context.m_rpc_credits_per_hash = rsp.node_data.rpc_credits_per_hash;
+        context.support_flags = rsp.node_data.support_flags;
         m_network_zones.at(context.m_remote_address.get_zone()).m_peerlist.set_peer_just_seen(rsp.node_data.peer_id, context.m_remote_address, context.m_pruning_seed, context.m_rpc_port, context.m_rpc_credits_per_hash);
+        const boost::posix_time::time_duration rtt = boost::posix_time::microsec_clock::universal_time() - request_time;
+        m_network_zones.at(context.m_remote_address.get_zone()).m_peerlist.record_peer_rtt(context.m_remote_address, rtt.total_microseconds() / 1e6f);
 
         // move
         for (auto const& zone : m_network_zones)
@@ -1131,15 +1201,17 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  size_t node_server<t_payload_net_handler>::get_random_index_with_fixed_probability(size_t max_index)
+  size_t node_server<t_payload_net_handler>::get_random_index_with_weights(const std::deque<float>& weights)
   {
-    //divide by zero workaround
-    if(!max_index)
-      return 0;
+    const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    if(weights.empty() || !(total > 0.0))
+      return weights.empty() ? 0 : crypto::rand_idx(weights.size());
 
-    size_t x = crypto::rand<size_t>()%(max_index+1);
-    size_t res = (x*x*x)/(max_index*max_index); //parabola \/
-    MDEBUG("Random connection index=" << res << "(x="<< x << ", max_index=" << max_index << ")");
+    double x = crypto::rand<uint64_t>() / (double)std::numeric_limits<uint64_t>::max() * total;
+    size_t res = 0;
+    while(res + 1 < weights.size() && x >= weights[res])
+      x -= weights[res++];
+    MDEBUG("Random connection index=" << res << " (weight " << weights[res] << " of " << total << ")");
     return res;
   }
   //-----------------------------------------------------------------------------------
@@ -1223,7 +1295,7 @@ namespace nodetool
   } while(0)
 
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::try_to_connect_and_handshake_with_new_peer(const epee::net_utils::network_address& na, bool just_take_peerlist, uint64_t last_seen_stamp, PeerType peer_type, uint64_t first_seen_stamp)
+  bool node_server<t_payload_net_handler>::try_to_connect_and_handshake_with_new_peer(const epee::net_utils::network_address& na, bool just_take_peerlist, uint64_t last_seen_stamp, PeerType peer_type, uint64_t first_seen_stamp, connect_race *race)
   {
     network_zone& zone = m_network_zones.at(na.get_zone());
     if (zone.m_connect == nullptr) // outgoing connections in zone not possible
@@ -1251,7 +1323,14 @@ namespace nodetool
       bool is_priority = is_priority_node(na);
       LOG_PRINT_CC_PRIORITY_NODE(is_priority, bool(con), "Connect failed to " << na.str()
         /*<< ", try " << try_count*/);
-      //m_peerlist.set_peer_unreachable(pe);
+      zone.m_peerlist.record_peer_failure(na);
+      return false;
+    }
+
+    if(race && !race->claim())
+    {
+      LOG_DEBUG_CC(*con, "Connected, but enough peers were connected in the meantime, closing");
+      zone.m_net_server.get_config_object().close(con->m_connection_id);
       return false;
     }
 
@@ -1261,10 +1340,13 @@ namespace nodetool
 
     if(!res)
     {
+      if(race)
+        race->release();
       bool is_priority = is_priority_node(na);
       LOG_PRINT_CC_PRIORITY_NODE(is_priority, *con, "Failed to HANDSHAKE with peer "
         << na.str()
         /*<< ", try " << try_count*/);
+      zone.m_peerlist.record_peer_failure(na);
       zone.m_net_server.get_config_object().close(con->m_connection_id);
       return false;
     }
@@ -1356,8 +1438,9 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::make_new_connection_from_anchor_peerlist(const std::vector<anchor_peerlist_entry>& anchor_peerlist)
+  bool node_server<t_payload_net_handler>::make_new_connection_from_anchor_peerlist(network_zone& zone, const std::vector<anchor_peerlist_entry>& anchor_peerlist, size_t wanted)
   {
+    std::vector<connect_candidate> candidates;
     for (const auto& pe: anchor_peerlist) {
       _note("Considering connecting (out) to anchor peer: " << peerid_type(pe.id) << " " << pe.adr.str());
 
@@ -1378,34 +1461,34 @@ namespace nodetool
                                << "[peer_type=" << anchor
                                << "] first_seen: " << epee::misc_utils::get_time_interval_string(time(NULL) - pe.first_seen));
 
-      if(!try_to_connect_and_handshake_with_new_peer(pe.adr, false, 0, anchor, pe.first_seen)) {
-        _note("Handshake failed");
-        continue;
-      }
-
-      return true;
+      candidates.push_back({pe.adr, 0, static_cast<uint64_t>(pe.first_seen), anchor});
     }
 
-    return false;
+    return try_to_connect_and_handshake_with_new_peers(zone, candidates, wanted) > 0;
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::make_new_connection_from_peerlist(network_zone& zone, bool use_white_list)
+  bool node_server<t_payload_net_handler>::make_new_connection_from_peerlist(network_zone& zone, bool use_white_list, size_t wanted)
   {
     size_t max_random_index = 0;
 
     std::set<size_t> tried_peers;
 
+    // a few more candidates than slots, so dead entries do not hold up the others
+    const size_t max_candidates = wanted + P2P_DEFAULT_CONNECT_PARALLELISM - 1;
+    std::vector<connect_candidate> candidates;
+    std::set<uint32_t> candidates_classB;
+
     size_t try_count = 0;
     size_t rand_count = 0;
-    while(rand_count < (max_random_index+1)*3 &&  try_count < 10 && !zone.m_net_server.is_stop_signal_sent())
+    while(candidates.size() < max_candidates && rand_count < (max_random_index+1)*3*max_candidates && try_count < 10 + max_candidates && !zone.m_net_server.is_stop_signal_sent())
     {
       ++rand_count;
       size_t random_index;
       const uint32_t next_needed_pruning_stripe = m_payload_handler.get_next_needed_pruning_stripe().second;
 
-      // build a set of all the /16 we're connected to, and prefer a peer that's not in that set
-      std::set<uint32_t> classB;
+      // build a set of all the /16 we're connected (or about to connect) to, and prefer a peer that's not in that set
+      std::set<uint32_t> classB = candidates_classB;
       if (&zone == &m_network_zones.at(epee::net_utils::zone::public_)) // at returns reference, not copy
       {
         zone.m_net_server.get_config_object().foreach_connection([&](const p2p_connection_context& cntxt)
@@ -1422,12 +1505,14 @@ namespace nodetool
       }
 
       std::deque<size_t> filtered;
+      std::deque<float> weights;
       const size_t limit = use_white_list ? 20 : std::numeric_limits<size_t>::max();
+      const int64_t now = time(NULL);
       size_t idx = 0, skipped = 0;
       for (int step = 0; step < 2; ++step)
       {
         bool skip_duplicate_class_B = step == 0;
-        zone.m_peerlist.foreach (use_white_list, [&classB, &filtered, &idx, &skipped, skip_duplicate_class_B, limit, next_needed_pruning_stripe](const peerlist_entry &pe){
+        zone.m_peerlist.foreach (use_white_list, [&classB, &filtered, &weights, &idx, &skipped, skip_duplicate_class_B, limit, next_needed_pruning_stripe, now](const peerlist_entry &pe){
           if (filtered.size() >= limit)
             return false;
           bool skip = false;
@@ -1437,12 +1522,20 @@ namespace nodetool
             uint32_t actual_ip = na.as<const epee::net_utils::ipv4_network_address>().ip();
             skip = classB.find(actual_ip & 0x0000ffff) != classB.end();
           }
+          const float score = peerlist_manager::get_peer_score(pe, now);
           if (skip)
             ++skipped;
           else if (next_needed_pruning_stripe == 0 || pe.pruning_seed == 0)
+          {
             filtered.push_back(idx);
+            weights.push_back(score);
+          }
           else if (next_needed_pruning_stripe == tools::get_pruning_stripe(pe.pruning_seed))
+          {
+            // peers having the stripe we need next stay preferred
             filtered.push_front(idx);
+            weights.push_front(score * 4.0f);
+          }
           ++idx;
           return true;
         });
@@ -1454,12 +1547,13 @@ namespace nodetool
       if (filtered.empty())
       {
         MDEBUG("No available peer in " << (use_white_list ? "white" : "gray") << " list filtered by " << next_needed_pruning_stripe);
-        return false;
+        break;
       }
+      // pick by score, so peers which answered fast and served blocks well are tried first
+      random_index = get_random_index_with_weights(weights);
       if (use_white_list)
       {
         // if using the white list, we first pick in the set of peers we've already been using earlier
-        random_index = get_random_index_with_fixed_probability(std::min<uint64_t>(filtered.size() - 1, 20));
         CRITICAL_REGION_LOCAL(m_used_stripe_peers_mutex);
         if (next_needed_pruning_stripe > 0 && next_needed_pruning_stripe <= (1ul << CRYPTONOTE_PRUNING_LOG_STRIPES) && !m_used_stripe_peers[next_needed_pruning_stripe-1].empty())
         {
@@ -1467,7 +1561,7 @@ namespace nodetool
           m_used_stripe_peers[next_needed_pruning_stripe-1].pop_front();
           for (size_t i = 0; i < filtered.size(); ++i)
           {
-            peerlist_entry pe;
+            peerlist_entry pe = AUTO_VAL_INIT(pe);
             if (zone.m_peerlist.get_white_peer_by_index(pe, filtered[i]) && pe.adr == na)
             {
               MDEBUG("Reusing stripe " << next_needed_pruning_stripe << " peer " << pe.adr.str());
@@ -1477,8 +1571,6 @@ namespace nodetool
           }
         }
       }
-      else
-        random_index = crypto::rand_idx(filtered.size());
 
       CHECK_AND_ASSERT_MES(random_index < filtered.size(), false, "random_index < filtered.size() failed!!");
       random_index = filtered[random_index];
@@ -1515,14 +1607,53 @@ namespace nodetool
                     << "[peer_list=" << (use_white_list ? white : gray)
                     << "] last_seen: " << (pe.last_seen ? epee::misc_utils::get_time_interval_string(time(NULL) - pe.last_seen) : "never"));
 
-      if(!try_to_connect_and_handshake_with_new_peer(pe.adr, false, pe.last_seen, use_white_list ? white : gray)) {
-        _note("Handshake failed");
-        continue;
-      }
+      candidates.push_back({pe.adr, static_cast<uint64_t>(pe.last_seen), 0, use_white_list ? white : gray});
+      if (pe.adr.get_type_id() == epee::net_utils::ipv4_network_address::get_type_id())
+        candidates_classB.insert(pe.adr.as<const epee::net_utils::ipv4_network_address>().ip() & 0x0000ffff);
+    }
+    return try_to_connect_and_handshake_with_new_peers(zone, candidates, wanted) > 0;
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
+  size_t node_server<t_payload_net_handler>::try_to_connect_and_handshake_with_new_peers(network_zone& zone, const std::vector<connect_candidate>& candidates, size_t wanted)
+  {
+    if (candidates.empty() || wanted == 0)
+      return 0;
 
-      return true;
+    // a single attempt needs no coordination
+    if (candidates.size() == 1)
+    {
+      const connect_candidate &c = candidates.front();
+      if (try_to_connect_and_handshake_with_new_peer(c.adr, false, c.last_seen, c.peer_type, c.first_seen))
+        return 1;
+      _note("Handshake failed");
+      return 0;
     }
-    return false;
+
+    // the handshake runs deep enough to need more than the default stack on e.g. musl
+    boost::thread::attributes attrs;
+    attrs.set_stack_size(THREAD_STACK_SIZE);
+
+    connect_race race(wanted, P2P_DEFAULT_CONNECT_PARALLELISM);
+    std::vector<boost::thread> attempts;
+    attempts.reserve(candidates.size());
+    for (const connect_candidate &c: candidates)
+    {
+      if (zone.m_net_server.is_stop_signal_sent() || !race.wait_to_start(P2P_DEFAULT_CONNECT_STAGGER))
+        break;
+      attempts.emplace_back(attrs, [this, &race, c]()
+      {
+        if (!try_to_connect_and_handshake_with_new_peer(c.adr, false, c.last_seen, c.peer_type, c.first_seen, &race))
+          _note("Handshake failed");
+        race.finish();
+      });
+    }
+    for (boost::thread &attempt: attempts)
+      attempt.join();
+
+    const size_t won = race.won();
+    MDEBUG("Made " << won << "/" << wanted << " outgoing connections from " << attempts.size() << " attempts");
+    return won;
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
@@ -1666,15 +1797,17 @@ namespace nodetool
 
       MDEBUG("Making expected connection, type " << peer_type << ", " << conn_count << "/" << expected_connections << " connections");
 
-      if (peer_type == anchor && !make_new_connection_from_anchor_peerlist(apl)) {
+      const size_t wanted = expected_connections - conn_count;
+
+      if (peer_type == anchor && !make_new_connection_from_anchor_peerlist(zone, apl, wanted)) {
         return false;
       }
 
-      if (peer_type == white && !make_new_connection_from_peerlist(zone, true)) {
+      if (peer_type == white && !make_new_connection_from_peerlist(zone, true, wanted)) {
         return false;
       }
 
-      if (peer_type == gray && !make_new_connection_from_peerlist(zone, false)) {
+      if (peer_type == gray && !make_new_connection_from_peerlist(zone, false, wanted)) {
         return false;
       }
     }
@@ -1917,6 +2050,7 @@ namespace nodetool
     node_data.rpc_port = zone.m_can_pingback ? m_rpc_port : 0;
     node_data.rpc_credits_per_hash = zone.m_can_pingback ? m_rpc_credits_per_hash : 0;
     node_data.network_id = m_network_id;
+    node_data.support_flags = zone.m_config.m_support_flags;
     return true;
   }
   //-----------------------------------------------------------------------------------
@@ -2021,6 +2155,9 @@ namespace nodetool
   template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::relay_notify_to_list(int command, const epee::span<const uint8_t> data_buff, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections)
   {
+    // only new blocks are relayed here, they overtake whatever is queued to each peer (e.g. sync responses),
+    // and all the peers share one copy of the data
+    const epee::byte_slice data{data_buff};
     std::sort(connections.begin(), connections.end());
     auto zone = m_network_zones.begin();
     for(const auto& c_id: connections)
@@ -2038,7 +2175,7 @@ namespace nodetool
         ++zone;
       }
       if (zone->first == c_id.first)
-        zone->second.m_net_server.get_config_object().notify(command, data_buff, c_id.second);
+        zone->second.m_net_server.get_config_object().notify(command, data.clone(), c_id.second, 0, epee::net_utils::send_priority::high);
     }
     return true;
   }
@@ -2110,17 +2247,45 @@ namespace nodetool
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
-  bool node_server<t_payload_net_handler>::invoke_notify_to_peer(int command, const epee::span<const uint8_t> req_buff, const epee::net_utils::connection_context_base& context)
+  bool node_server<t_payload_net_handler>::invoke_notify_to_peer(int command, epee::byte_slice message, const epee::net_utils::connection_context_base& context, const bool compress)
   {
     if(is_filtered_command(context.m_remote_address, command))
       return false;
 
     network_zone& zone = m_network_zones.at(context.m_remote_address.get_zone());
-    int res = zone.m_net_server.get_config_object().notify(command, req_buff, context.m_connection_id);
+
+    // compress large payloads for peers which negotiated it, if it saves anything
+    uint32_t flags = 0;
+    if (compress && message.size() >= P2P_COMPRESSION_THRESHOLD)
+    {
+      uint32_t support_flags = 0;
+      zone.m_net_server.get_config_object().for_connection(context.m_connection_id, [&support_flags](p2p_connection_context& cntx){
+        support_flags = cntx.support_flags;
+        return true;
+      });
+      std::string packed;
+      if ((support_flags & P2P_SUPPORT_FLAG_COMPRESSION) && epee::levin::compress_payload({message.data(), message.size()}, packed))
+      {
+        MDEBUG(context << "Compressed notification " << command << " from " << message.size() << " to " << packed.size() << " bytes");
+        message = epee::byte_slice{std::move(packed)};
+        flags = LEVIN_PACKET_COMPRESSED;
+      }
+    }
+
+    int res = zone.m_net_server.get_config_object().notify(command, std::move(message), context.m_connection_id, flags);
     return res > 0;
   }
   //-----------------------------------------------------------------------------------
   template<class t_payload_net_handler>
+  size_t node_server<t_payload_net_handler>::get_max_inflated_size(const p2p_connection_context& context, int command)
+  {
+    // peers which did not negotiate compression have no business sending it
+    if (!(context.support_flags & P2P_SUPPORT_FLAG_COMPRESSION))
+      return 0;
+    return t_payload_net_handler::get_max_inflated_size(command);
+  }
+  //-----------------------------------------------------------------------------------
+  template<class t_payload_net_handler>
   bool node_server<t_payload_net_handler>::invoke_command_to_peer(int command, const epee::span<const uint8_t> req_buff, std::string& resp_buff, const epee::net_utils::connection_context_base& context)
   {
     if(is_filtered_command(context.m_remote_address, command))
@@ -2366,6 +2531,7 @@ namespace nodetool
     context.m_in_timedsync = false;
     context.m_rpc_port = arg.node_data.rpc_port;
     context.m_rpc_credits_per_hash = arg.node_data.rpc_credits_per_hash;
+    context.support_flags = arg.node_data.support_flags;
 
     if(arg.node_data.my_port && zone.m_can_pingback)
     {
@@ -2377,7 +2543,7 @@ namespace nodetool
         CHECK_AND_ASSERT_MES((context.m_remote_address.get_type_id() == epee::net_utils::ipv4_network_address::get_type_id() || context.m_remote_address.get_type_id() == epee::net_utils::ipv6_network_address::get_type_id()), void(),
             "Only IPv4 or IPv6 addresses are supported here");
         //called only(!) if success pinged, update local peerlist
-        peerlist_entry pe;
+        peerlist_entry pe = AUTO_VAL_INIT(pe);
         const epee::net_utils::network_address na = context.m_remote_address;
         if (context.m_remote_address.get_type_id() == epee::net_utils::ipv4_network_address::get_type_id())
         {
@@ -2702,7 +2868,7 @@ namespace nodetool
       if (zone.second.m_connect == nullptr)
         continue;
 
-      peerlist_entry pe{};
+      peerlist_entry pe = AUTO_VAL_INIT(pe);
       if (!zone.second.m_peerlist.get_random_gray_peer(pe))
         continue;
 
@@ -2756,6 +2922,17 @@ namespace nodetool
       e.clear();
   }
 
+  template<class t_payload_net_handler>
+  void node_server<t_payload_net_handler>::record_peer_throughput(const typename t_payload_net_handler::connection_context &context, float bytes_per_second)
+  {
+    // incoming connections come from ephemeral ports, which are not in the peerlist
+    if (context.m_is_income)
+      return;
+    const auto zone = m_network_zones.find(context.m_remote_address.get_zone());
+    if (zone != m_network_zones.end())
+      zone->second.m_peerlist.record_peer_throughput(context.m_remote_address, bytes_per_second);
+  }
+
   template<class t_payload_net_handler>
   void node_server<t_payload_net_handler>::add_upnp_port_mapping_impl(uint32_t port, bool ipv6) // if ipv6 false, do ipv4
   {
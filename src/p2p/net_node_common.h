@@ -53,7 +53,7 @@ namespace nodetool
     virtual bool relay_notify_to_list(int command, const epee::span<const uint8_t> data_buff, std::vector<std::pair<epee::net_utils::zone, boost::uuids::uuid>> connections)=0;
     virtual epee::net_utils::zone send_txs(std::vector<cryptonote::blobdata> txs, const epee::net_utils::zone origin, const boost::uuids::uuid& source, cryptonote::i_core_events& core, bool pad_txs)=0;
     virtual bool invoke_command_to_peer(int command, const epee::span<const uint8_t> req_buff, std::string& resp_buff, const epee::net_utils::connection_context_base& context)=0;
-    virtual bool invoke_notify_to_peer(int command, const epee::span<const uint8_t> req_buff, const epee::net_utils::connection_context_base& context)=0;
+    virtual bool invoke_notify_to_peer(int command, epee::byte_slice message, const epee::net_utils::connection_context_base& context, bool compress = false)=0;
     virtual bool drop_connection(const epee::net_utils::connection_context_base& context)=0;
     virtual void request_callback(const epee::net_utils::connection_context_base& context)=0;
     virtual uint64_t get_public_connections_count()=0;
@@ -67,6 +67,7 @@ namespace nodetool
     virtual void add_used_stripe_peer(const t_connection_context &context)=0;
     virtual void remove_used_stripe_peer(const t_connection_context &context)=0;
     virtual void clear_used_stripe_peers()=0;
+    virtual void record_peer_throughput(const t_connection_context &context, float bytes_per_second)=0;
   };
 
   template<class t_connection_context>
@@ -84,7 +85,7 @@ namespace nodetool
     {
       return false;
     }
-    virtual bool invoke_notify_to_peer(int command, const epee::span<const uint8_t> req_buff, const epee::net_utils::connection_context_base& context)
+    virtual bool invoke_notify_to_peer(int command, epee::byte_slice message, const epee::net_utils::connection_context_base& context, bool compress)
     {
       return true;
     }
@@ -138,5 +139,8 @@ namespace nodetool
     virtual void clear_used_stripe_peers()
     {
     }
+    virtual void record_peer_throughput(const t_connection_context &context, float bytes_per_second)
+    {
+    }
   };
 }
@@ -29,18 +29,26 @@
 #include "net_peerlist.h"
 
 #include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <functional>
 #include <fstream>
 #include <iterator>
+#include <sstream>
+#include <unordered_map>
 
 #include <boost/archive/binary_iarchive.hpp>
-#include <boost/archive/portable_binary_oarchive.hpp>
 #include <boost/archive/portable_binary_iarchive.hpp>
 #include <boost/filesystem/operations.hpp>
 #include <boost/range/join.hpp>
 #include <boost/serialization/version.hpp>
 
+#include "common/util.h"
 #include "net_peerlist_boost_serialization.h"
+#include "span.h"
+
+#undef BITTUBE_DEFAULT_LOG_CATEGORY
+#define BITTUBE_DEFAULT_LOG_CATEGORY "net.p2p"
 
 
 namespace nodetool
@@ -48,6 +56,430 @@ namespace nodetool
   namespace
   {
     constexpr unsigned CURRENT_PEERLIST_STORAGE_ARCHIVE_VER = 6;
+
+    /* The compact format is a header followed by a flat sequence of records,
+      so loading is a single pass over the file, and the journal can append
+      updates to it without rewriting what is already there. Records after
+      the snapshot replace or remove earlier ones for the same address. */
+    constexpr const char PEERLIST_COMPACT_MAGIC[8] = {'B', 'T', 'P', '2', 'P', 'S', 'T', 0};
+    constexpr std::uint32_t CURRENT_PEERLIST_COMPACT_VER = 1;
+
+    enum class record : std::uint8_t
+    {
+      white = 1,
+      gray,
+      anchor,
+      remove_white,
+      remove_gray,
+      remove_anchor,
+      block,
+      unblock,
+      updates //!< end of the snapshot, later records update it
+    };
+
+    template<typename T>
+    void write_int(std::string& out, const T value)
+    {
+      static_assert(std::is_unsigned<T>::value, "unsigned integers only");
+      for (unsigned i = 0; i < sizeof(T); ++i)
+        out.push_back(char(std::uint8_t(value >> (i * 8))));
+    }
+
+    void write_string(std::string& out, const std::string& value)
+    {
+      const std::uint8_t length = std::min<std::size_t>(value.size(), 255);
+      write_int(out, length);
+      out.append(value.data(), length);
+    }
+
+    bool write_address(std::string& out, const epee::net_utils::network_address& adr)
+    {
+      write_int(out, std::uint8_t(adr.get_type_id()));
+      switch (adr.get_type_id())
+      {
+        case epee::net_utils::ipv4_network_address::get_type_id():
+        {
+          const auto& ipv4 = adr.as<epee::net_utils::ipv4_network_address>();
+          write_int(out, ipv4.ip());
+          write_int(out, ipv4.port());
+          return true;
+        }
+        case epee::net_utils::ipv6_network_address::get_type_id():
+        {
+          const auto& ipv6 = adr.as<epee::net_utils::ipv6_network_address>();
+          const auto bytes = ipv6.ip().to_bytes();
+          out.append(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+          write_int(out, ipv6.port());
+          return true;
+        }
+        case net::tor_address::get_type_id():
+          write_int(out, adr.as<net::tor_address>().port());
+          write_string(out, adr.as<net::tor_address>().host_str());
+          return true;
+        case net::i2p_address::get_type_id():
+          write_int(out, adr.as<net::i2p_address>().port());
+          write_string(out, adr.as<net::i2p_address>().host_str());
+          return true;
+        default:
+          return false;
+      }
+    }
+
+    bool write_peer(std::string& out, const record type, const peerlist_entry& pe)
+    {
+      const std::size_t start = out.size();
+      write_int(out, std::uint8_t(type));
+      if (!write_address(out, pe.adr))
+      {
+        out.resize(start);
+        return false;
+      }
+      write_int(out, std::uint64_t(pe.id));
+      write_int(out, std::uint64_t(pe.last_seen));
+      write_int(out, pe.pruning_seed);
+      write_int(out, pe.rpc_port);
+      write_int(out, pe.rpc_credits_per_hash);
+      write_int(out, std::uint32_t(pe.rtt * 1e6f));
+      write_int(out, std::uint64_t(pe.throughput));
+      write_int(out, std::uint32_t(pe.failures * 1e3f));
+      write_int(out, std::uint64_t(pe.score_time));
+      return true;
+    }
+
+    bool write_anchor(std::string& out, const anchor_peerlist_entry& ape)
+    {
+      const std::size_t start = out.size();
+      write_int(out, std::uint8_t(record::anchor));
+      if (!write_address(out, ape.adr))
+      {
+        out.resize(start);
+        return false;
+      }
+      write_int(out, std::uint64_t(ape.id));
+      write_int(out, std::uint64_t(ape.first_seen));
+      return true;
+    }
+
+    bool write_removal(std::string& out, const record type, const epee::net_utils::network_address& adr)
+    {
+      const std::size_t start = out.size();
+      write_int(out, std::uint8_t(type));
+      if (!write_address(out, adr))
+      {
+        out.resize(start);
+        return false;
+      }
+      return true;
+    }
+
+    void write_block(std::string& out, const std::string& host, const time_t until)
+    {
+      write_int(out, std::uint8_t(record::block));
+      write_string(out, host);
+      write_int(out, std::uint64_t(until));
+    }
+
+    struct compact_reader
+    {
+      epee::span<const std::uint8_t> src;
+
+      template<typename T>
+      bool read(T& value)
+      {
+        static_assert(std::is_unsigned<T>::value, "unsigned integers only");
+        if (src.size() < sizeof(T))
+          return false;
+        value = 0;
+        for (unsigned i = 0; i < sizeof(T); ++i)
+          value |= T(T(src[i]) << (i * 8));
+        src.remove_prefix(sizeof(T));
+        return true;
+      }
+
+      bool read(std::string& value)
+      {
+        std::uint8_t length = 0;
+        if (!read(length) || src.size() < length)
+          return false;
+        value.assign(reinterpret_cast<const char*>(src.data()), length);
+        src.remove_prefix(length);
+        return true;
+      }
+
+      template<typename T>
+      bool read_host(epee::net_utils::network_address& adr)
+      {
+        std::uint16_t port = 0;
+        std::string host;
+        if (!read(port) || !read(host))
+          return false;
+        if (host == T::unknown_str())
+        {
+          adr = T::unknown();
+          return true;
+        }
+        auto address = T::make(host, port);
+        if (!address)
+          return false;
+        adr = std::move(*address);
+        return true;
+      }
+
+      //! Read an address, and its encoding into `key`.
+      bool read(epee::net_utils::network_address& adr, std::string& key)
+      {
+        const std::uint8_t* const start = src.data();
+        std::uint8_t type = 0;
+        if (!read(type))
+          return false;
+        bool ok = false;
+        switch (epee::net_utils::address_type(type))
+        {
+          case epee::net_utils::ipv4_network_address::get_type_id():
+          {
+            std::uint32_t ip = 0;
+            std::uint16_t port = 0;
+            ok = read(ip) && read(port);
+            if (ok)
+              adr = epee::net_utils::ipv4_network_address{ip, port};
+            break;
+          }
+          case epee::net_utils::ipv6_network_address::get_type_id():
+          {
+            boost::asio::ip::address_v6::bytes_type bytes;
+            std::uint16_t port = 0;
+            if (src.size() < bytes.size())
+              return false;
+            std::memcpy(bytes.data(), src.data(), bytes.size());
+            src.remove_prefix(bytes.size());
+            ok = read(port);
+            if (ok)
+              adr = epee::net_utils::ipv6_network_address{boost::asio::ip::address_v6{bytes}, port};
+            break;
+          }
+          case net::tor_address::get_type_id():
+            ok = read_host<net::tor_address>(adr);
+            break;
+          case net::i2p_address::get_type_id():
+            ok = read_host<net::i2p_address>(adr);
+            break;
+          default:
+            break;
+        }
+        if (ok)
+          key.assign(reinterpret_cast<const char*>(start), src.data() - start);
+        return ok;
+      }
+
+      bool read(peerlist_entry& pe, std::string& key)
+      {
+        std::uint64_t id = 0, last_seen = 0, throughput = 0, score_time = 0;
+        std::uint32_t rtt_us = 0, failures_milli = 0;
+        if (!read(pe.adr, key) || !read(id) || !read(last_seen) || !read(pe.pruning_seed) ||
+            !read(pe.rpc_port) || !read(pe.rpc_credits_per_hash) || !read(rtt_us) ||
+            !read(throughput) || !read(failures_milli) || !read(score_time))
+          return false;
+        pe.id = id;
+        pe.last_seen = last_seen;
+        pe.rtt = rtt_us / 1e6f;
+        pe.throughput = throughput;
+        pe.failures = failures_milli / 1e3f;
+        pe.score_time = score_time;
+        return true;
+      }
+
+      bool read(anchor_peerlist_entry& ape, std::string& key)
+      {
+        std::uint64_t id = 0, first_seen = 0;
+        if (!read(ape.adr, key) || !read(id) || !read(first_seen))
+          return false;
+        ape.id = id;
+        ape.first_seen = first_seen;
+        return true;
+      }
+    };
+
+    bool is_compact(const std::string& src)
+    {
+      return src.size() >= sizeof(PEERLIST_COMPACT_MAGIC) &&
+        std::memcmp(src.data(), PEERLIST_COMPACT_MAGIC, sizeof(PEERLIST_COMPACT_MAGIC)) == 0;
+    }
+
+    //! Peers of one list while replaying records, indexed by address once updates start
+    template<typename T>
+    struct replay_list
+    {
+      std::vector<T>& entries;
+      std::vector<std::string> keys;
+      std::vector<bool> removed;
+      std::unordered_map<std::string, std::size_t> index;
+
+      void add(std::string key, T entry, const bool update)
+      {
+        if (update)
+        {
+          const auto existing = index.find(key);
+          if (existing != index.end())
+          {
+            entries[existing->second] = std::move(entry);
+            removed[existing->second] = false;
+            return;
+          }
+          index.emplace(key, entries.size());
+        }
+        entries.push_back(std::move(entry));
+        keys.push_back(std::move(key));
+        removed.push_back(false);
+      }
+
+      void remove(const std::string& key)
+      {
+        const auto existing = index.find(key);
+        if (existing != index.end())
+          removed[existing->second] = true;
+      }
+
+      void start_updates()
+      {
+        index.reserve(keys.size());
+        for (std::size_t i = 0; i < keys.size(); ++i)
+          index[keys[i]] = i;
+      }
+
+      void finish()
+      {
+        std::size_t out = 0;
+        for (std::size_t i = 0; i < entries.size(); ++i)
+        {
+          if (removed[i])
+            continue;
+          if (out != i)
+            entries[out] = std::move(entries[i]);
+          ++out;
+        }
+        entries.resize(out);
+      }
+    };
+
+    /*! The snapshot is appended to `types` as is. Updates after it replace or
+      remove peers by address, and the index this needs is only built then. */
+    bool load_compact(const std::string& src, peerlist_types& types, std::map<std::string, time_t>& blocked)
+    {
+      if (!is_compact(src))
+        return false;
+
+      compact_reader in{epee::strspan<std::uint8_t>(src)};
+      in.src.remove_prefix(sizeof(PEERLIST_COMPACT_MAGIC));
+      std::uint32_t version = 0;
+      if (!in.read(version) || version > CURRENT_PEERLIST_COMPACT_VER)
+        return false;
+
+      replay_list<peerlist_entry> white{types.white}, gray{types.gray};
+      replay_list<anchor_peerlist_entry> anchor{types.anchor};
+      bool updates = false;
+      std::string key;
+      while (!in.src.empty())
+      {
+        std::uint8_t type = 0;
+        in.read(type);
+        bool ok = false;
+        switch (record(type))
+        {
+          case record::white:
+          case record::gray:
+          {
+            peerlist_entry pe = AUTO_VAL_INIT(pe);
+            ok = in.read(pe, key);
+            if (ok)
+              (record(type) == record::white ? white : gray).add(std::move(key), std::move(pe), updates);
+            break;
+          }
+          case record::anchor:
+          {
+            anchor_peerlist_entry ape = AUTO_VAL_INIT(ape);
+            ok = in.read(ape, key);
+            if (ok)
+              anchor.add(std::move(key), std::move(ape), updates);
+            break;
+          }
+          case record::remove_white:
+          case record::remove_gray:
+          case record::remove_anchor:
+          {
+            epee::net_utils::network_address adr;
+            ok = updates && in.read(adr, key);
+            if (ok && record(type) == record::remove_white)
+              white.remove(key);
+            else if (ok && record(type) == record::remove_gray)
+              gray.remove(key);
+            else if (ok)
+              anchor.remove(key);
+            break;
+          }
+          case record::block:
+          {
+            std::uint64_t until = 0;
+            ok = in.read(key) && in.read(until);
+            if (ok)
+              blocked[key] = until;
+            break;
+          }
+          case record::unblock:
+            ok = in.read(key);
+            if (ok)
+              blocked.erase(key);
+            break;
+          case record::updates:
+            ok = !updates;
+            updates = true;
+            white.start_updates();
+            gray.start_updates();
+            anchor.start_updates();
+            break;
+          default:
+            break;
+        }
+        if (!ok)
+        {
+          // a crash while appending leaves a partial record at the end, nothing valid follows it
+          MWARNING("Ignoring " << in.src.size() << " bytes of invalid or truncated peerlist records");
+          break;
+        }
+      }
+
+      white.finish();
+      gray.finish();
+      anchor.finish();
+      return true;
+    }
+
+    template<typename Range>
+    void save_compact(std::string& out, const record type, const Range& elems)
+    {
+      for (const auto& elem : elems)
+        write_peer(out, type, elem);
+    }
+
+    bool write_file(const std::string& path, const std::string& data)
+    {
+      const std::string tmp_path = path + ".tmp";
+      {
+        std::ofstream dest_file{};
+        dest_file.open(tmp_path, std::ios_base::binary | std::ios_base::out | std::ios::trunc);
+        if (dest_file.fail())
+          return false;
+        dest_file.write(data.data(), data.size());
+        if (!dest_file.good())
+          return false;
+      }
+      const std::error_code e = tools::replace_file(tmp_path, path);
+      if (e)
+      {
+        MWARNING("Failed to replace " << path << ": " << e.message());
+        return false;
+      }
+      return true;
+    }
  
     struct by_zone
     {
@@ -95,14 +527,6 @@ namespace nodetool
       return elems;
     }
 
-    template<typename Archive, typename Range>
-    void save_peers(Archive& a, const Range& elems)
-    {
-      const uint64_t size = elems.size();
-      a & size;
-      for (const auto& elem : elems)
-        a & elem;
-    }
  
     template<typename T>
     std::vector<T> do_take_zone(std::vector<T>& src, epee::net_utils::zone zone)
@@ -119,7 +543,11 @@ namespace nodetool
     template<typename Container, typename T>
     void add_peers(Container& dest, std::vector<T>&& src)
     {
-      dest.insert(std::make_move_iterator(src.begin()), std::make_move_iterator(src.end()));
+      // inserting in address order lets the address index append with a hint
+      // instead of searching the tree for every entry
+      std::sort(src.begin(), src.end(), [](const T& a, const T& b) { return a.adr < b.adr; });
+      for (T& elem : src)
+        dest.insert(dest.end(), std::move(elem));
     }
 
     template<typename Container, typename Range>
@@ -129,12 +557,6 @@ namespace nodetool
     }
   } // anonymous
 
-  struct peerlist_join
-  {
-    const peerlist_types& ours;
-    const peerlist_types& other;
-  };
-
   template<typename Archive>
   void serialize(Archive& a, peerlist_types& elem, unsigned ver)
   {
@@ -150,31 +572,34 @@ namespace nodetool
     }
   }
  
-  template<typename Archive>
-  void serialize(Archive& a, peerlist_join elem, unsigned ver)
-  {
-    save_peers(a, boost::range::join(elem.ours.white, elem.other.white));
-    save_peers(a, boost::range::join(elem.ours.gray, elem.other.gray));
-    save_peers(a, boost::range::join(elem.ours.anchor, elem.other.anchor));
-  }
 
   boost::optional<peerlist_storage> peerlist_storage::open(std::istream& src, const bool new_format)
   {
     try
     {
       peerlist_storage out{};
+      bool good = false;
       if (new_format)
       {
-        boost::archive::portable_binary_iarchive a{src};
-        a >> out.m_types;
+        const std::string buffer{std::istreambuf_iterator<char>{src}, std::istreambuf_iterator<char>{}};
+        if (is_compact(buffer))
+          good = load_compact(buffer, out.m_types, out.m_blocked);
+        else
+        {
+          std::istringstream archive{buffer};
+          boost::archive::portable_binary_iarchive a{archive};
+          a >> out.m_types;
+          good = archive.good();
+        }
       }
       else
       {
         boost::archive::binary_iarchive a{src};
         a >> out.m_types;
+        good = src.good();
       }
 
-      if (src.good())
+      if (good)
       {
         std::sort(out.m_types.white.begin(), out.m_types.white.end(), by_zone{});
         std::sort(out.m_types.gray.begin(), out.m_types.gray.end(), by_zone{});
@@ -222,29 +647,29 @@ namespace nodetool
   peerlist_storage::~peerlist_storage() noexcept
   {}
 
-  bool peerlist_storage::store(std::ostream& dest, const peerlist_types& other) const
+  bool peerlist_storage::store(std::ostream& dest, const peerlist_types& other, const std::map<std::string, time_t>& blocked) const
   {
-    try
-    {
-      boost::archive::portable_binary_oarchive a{dest};
-      const peerlist_join pj{std::cref(m_types), std::cref(other)};
-      a << pj;
-      return dest.good();
-    }
-    catch (const boost::archive::archive_exception& e)
-    {}
-
-    return false;
+    std::string out{PEERLIST_COMPACT_MAGIC, sizeof(PEERLIST_COMPACT_MAGIC)};
+    write_int(out, CURRENT_PEERLIST_COMPACT_VER);
+    save_compact(out, record::white, boost::range::join(m_types.white, other.white));
+    save_compact(out, record::gray, boost::range::join(m_types.gray, other.gray));
+    for (const auto& ape : boost::range::join(m_types.anchor, other.anchor))
+      write_anchor(out, ape);
+    for (const auto& host : m_blocked)
+      if (blocked.find(host.first) == blocked.end())
+        write_block(out, host.first, host.second);
+    for (const auto& host : blocked)
+      write_block(out, host.first, host.second);
+    write_int(out, std::uint8_t(record::updates));
+
+    dest.write(out.data(), out.size());
+    return dest.good();
   }
 
-  bool peerlist_storage::store(const std::string& path, const peerlist_types& other) const
+  bool peerlist_storage::store(const std::string& path, const peerlist_types& other, const std::map<std::string, time_t>& blocked) const
   {
-    std::ofstream dest_file{};
-    dest_file.open( path , std::ios_base::binary | std::ios_base::out| std::ios::trunc);
-    if(dest_file.fail())
-      return false;
-
-    return store(dest_file, other);
+    std::ostringstream dest{};
+    return store(dest, other, blocked) && write_file(path, dest.str());
   }
 
   peerlist_types peerlist_storage::take_zone(epee::net_utils::zone zone)
@@ -256,6 +681,173 @@ namespace nodetool
     return out;
   }
 
+  std::map<std::string, time_t> peerlist_storage::take_blocked()
+  {
+    return std::move(m_blocked);
+  }
+
+  peerlist_journal::peerlist_journal()
+    : m_path(), m_queue(), m_open(false), m_stop(false), m_failed(false), m_lock(), m_io_lock(), m_cond(), m_writer()
+  {}
+
+  peerlist_journal::~peerlist_journal() noexcept
+  {
+    try { close(); }
+    catch (...) {}
+  }
+
+  bool peerlist_journal::open(const std::string& path)
+  {
+    close();
+    if (!boost::filesystem::exists(path))
+      return false;
+
+    boost::lock_guard<boost::mutex> lock{m_lock};
+    m_path = path;
+    m_queue.clear();
+    m_open = true;
+    m_stop = false;
+    m_failed = false;
+    m_writer = boost::thread{[this]{ run(); }};
+    return true;
+  }
+
+  bool peerlist_journal::close()
+  {
+    if (!m_writer.joinable())
+      return true;
+    {
+      boost::lock_guard<boost::mutex> lock{m_lock};
+      m_stop = true;
+    }
+    m_cond.notify_one();
+    m_writer.join();
+    {
+      boost::lock_guard<boost::mutex> lock{m_lock};
+      m_open = false;
+    }
+    flush();
+    return !m_failed;
+  }
+
+  bool peerlist_journal::is_open() const
+  {
+    boost::lock_guard<boost::mutex> lock{m_lock};
+    return m_open;
+  }
+
+  void peerlist_journal::add_peer(const bool white, const peerlist_entry& pe)
+  {
+    std::string out;
+    if (write_peer(out, white ? record::white : record::gray, pe))
+      queue(out);
+  }
+
+  void peerlist_journal::remove_peer(const bool white, const epee::net_utils::network_address& adr)
+  {
+    std::string out;
+    if (write_removal(out, white ? record::remove_white : record::remove_gray, adr))
+      queue(out);
+  }
+
+  void peerlist_journal::add_anchor(const anchor_peerlist_entry& ape)
+  {
+    std::string out;
+    if (write_anchor(out, ape))
+      queue(out);
+  }
+
+  void peerlist_journal::remove_anchor(const epee::net_utils::network_address& adr)
+  {
+    std::string out;
+    if (write_removal(out, record::remove_anchor, adr))
+      queue(out);
+  }
+
+  void peerlist_journal::block(const std::string& host, const time_t until)
+  {
+    std::string out;
+    write_block(out, host, until);
+    queue(out);
+  }
+
+  void peerlist_journal::unblock(const std::string& host)
+  {
+    std::string out;
+    write_int(out, std::uint8_t(record::unblock));
+    write_string(out, host);
+    queue(out);
+  }
+
+  bool peerlist_journal::rewrite(const std::function<bool(std::ostream&)>& snapshot)
+  {
+    boost::lock_guard<boost::mutex> io_lock{m_io_lock};
+    std::size_t included = 0;
+    {
+      boost::lock_guard<boost::mutex> lock{m_lock};
+      if (!m_open)
+        return false;
+      included = m_queue.size();
+    }
+
+    // updates queued before the snapshot was taken are part of it, the
+    // others might not be, and are replayed on top of it
+    std::ostringstream dest{};
+    if (!snapshot(dest))
+      return false;
+    std::string out = dest.str();
+    {
+      boost::lock_guard<boost::mutex> lock{m_lock};
+      out.append(m_queue, included, std::string::npos);
+      m_queue.clear();
+    }
+    return write_file(m_path, out);
+  }
+
+  void peerlist_journal::queue(const std::string& record)
+  {
+    boost::lock_guard<boost::mutex> lock{m_lock};
+    if (m_open)
+      m_queue.append(record);
+  }
+
+  void peerlist_journal::flush()
+  {
+    boost::lock_guard<boost::mutex> io_lock{m_io_lock};
+    std::string pending;
+    {
+      boost::lock_guard<boost::mutex> lock{m_lock};
+      pending.swap(m_queue);
+    }
+    if (pending.empty())
+      return;
+
+    std::ofstream dest_file{};
+    dest_file.open(m_path, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+    dest_file.write(pending.data(), pending.size());
+    if (!dest_file.good())
+    {
+      MWARNING("Failed to append peerlist updates to " << m_path);
+      m_failed = true;
+    }
+  }
+
+  void peerlist_journal::run()
+  {
+    boost::unique_lock<boost::mutex> lock{m_lock};
+    for (;;)
+    {
+      if (!m_stop)
+        m_cond.wait_for(lock, boost::chrono::seconds{P2P_PEERLIST_JOURNAL_FLUSH_INTERVAL});
+      const bool stop = m_stop;
+      lock.unlock();
+      flush();
+      if (stop)
+        return;
+      lock.lock();
+    }
+  }
+
   bool peerlist_manager::init(peerlist_types&& peers, bool allow_local_ip)
   {
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
@@ -270,6 +862,12 @@ namespace nodetool
     return true;
   }
 
+  void peerlist_manager::set_journal(peerlist_journal* journal)
+  {
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    m_journal = journal;
+  }
+
   void peerlist_manager::get_peerlist(std::vector<peerlist_entry>& pl_gray, std::vector<peerlist_entry>& pl_white)
   {
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
@@ -288,8 +886,44 @@ namespace nodetool
     copy_peers(peers.gray, m_peers_gray.get<by_addr>());
     copy_peers(peers.anchor, m_peers_anchor.get<by_addr>());
   }
+
+  float peerlist_manager::get_peer_score(const peerlist_entry& pe, int64_t now)
+  {
+    peerlist_entry decayed = pe;
+    decay_peer_score(decayed, now);
+    const float rtt = decayed.rtt > 0.0f ? decayed.rtt : P2P_PEER_SCORE_REFERENCE_RTT;
+    return (1.0f + decayed.throughput / P2P_PEER_SCORE_REFERENCE_THROUGHPUT) /
+        ((1.0f + rtt / P2P_PEER_SCORE_REFERENCE_RTT) * (1.0f + decayed.failures));
+  }
+
+  void peerlist_manager::decay_peer_score(peerlist_entry& pe, int64_t now)
+  {
+    // throughput and failures fade with a fixed half life, so a peer which was slow or
+    // unreachable a while ago gets another chance, and a fast one must keep proving itself
+    if (pe.score_time > 0 && now > pe.score_time)
+    {
+      const float factor = std::exp2(-(now - pe.score_time) / (float)P2P_PEER_SCORE_HALF_LIFE);
+      pe.throughput *= factor;
+      pe.failures *= factor;
+    }
+    pe.score_time = std::max(pe.score_time, now);
+  }
+
+  void peerlist_manager::copy_peer_score(peerlist_entry& dst, const peerlist_entry& src)
+  {
+    dst.rtt = src.rtt;
+    dst.throughput = src.throughput;
+    dst.failures = src.failures;
+    dst.score_time = src.score_time;
+  }
+
+  bool peerlist_manager::same_peer(const peerlist_entry& a, const peerlist_entry& b)
+  {
+    return a.id == b.id && a.last_seen == b.last_seen && a.pruning_seed == b.pruning_seed &&
+      a.rpc_port == b.rpc_port && a.rpc_credits_per_hash == b.rpc_credits_per_hash &&
+      a.rtt == b.rtt && a.throughput == b.throughput && a.failures == b.failures && a.score_time == b.score_time;
+  }
 }
 
 BOOST_CLASS_VERSION(nodetool::peerlist_types, nodetool::CURRENT_PEERLIST_STORAGE_ARCHIVE_VER);
-BOOST_CLASS_VERSION(nodetool::peerlist_join, nodetool::CURRENT_PEERLIST_STORAGE_ARCHIVE_VER);
 
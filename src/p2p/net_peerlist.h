@@ -31,8 +31,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <ctime>
+#include <functional>
 #include <iosfwd>
 #include <list>
+#include <map>
 #include <string>
 #include <vector>
 
@@ -42,6 +47,9 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/optional/optional.hpp>
 #include <boost/range/adaptor/reversed.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
 
 
 #include "cryptonote_config.h"
@@ -59,14 +67,59 @@ namespace nodetool
     std::vector<anchor_peerlist_entry> anchor;
   };
 
+  //! Appends peerlist and ban updates to a compact p2pstate file from a background thread.
+  class peerlist_journal
+  {
+  public:
+    peerlist_journal();
+    ~peerlist_journal() noexcept;
+
+    peerlist_journal(const peerlist_journal&) = delete;
+    peerlist_journal& operator=(const peerlist_journal&) = delete;
+
+    //! Start appending updates to the compact p2pstate file at `path`.
+    bool open(const std::string& path);
+
+    //! Write queued updates and stop the writer thread. \return False if any write failed.
+    bool close();
+
+    bool is_open() const;
+
+    void add_peer(bool white, const peerlist_entry& pe);
+    void remove_peer(bool white, const epee::net_utils::network_address& adr);
+    void add_anchor(const anchor_peerlist_entry& ape);
+    void remove_anchor(const epee::net_utils::network_address& adr);
+    void block(const std::string& host, time_t until);
+    void unblock(const std::string& host);
+
+    /*! Replace the file with the output of `snapshot`, followed by any update
+      queued while it ran. Queued updates are not written in the meantime. */
+    bool rewrite(const std::function<bool(std::ostream&)>& snapshot);
+
+  private:
+    void queue(const std::string& record);
+    void flush();
+    void run();
+
+    std::string m_path;
+    std::string m_queue;
+    bool m_open;
+    bool m_stop;
+    std::atomic<bool> m_failed;
+    mutable boost::mutex m_lock; //!< protects the queue and flags
+    boost::mutex m_io_lock; //!< serializes writes to the file
+    boost::condition_variable m_cond;
+    boost::thread m_writer;
+  };
+
   class peerlist_storage
   {
   public:
     peerlist_storage()
-      : m_types{}
+      : m_types{}, m_blocked{}
     {}
 
-    //! \return Peers stored in stream `src` in `new_format` (portable archive or older non-portable).
+    //! \return Peers stored in stream `src` in `new_format` (compact or portable archive, else older non-portable).
     static boost::optional<peerlist_storage> open(std::istream& src, const bool new_format);
 
     //! \return Peers stored in file at `path`
@@ -80,17 +133,21 @@ namespace nodetool
     peerlist_storage& operator=(peerlist_storage&&) = default;
     peerlist_storage& operator=(const peerlist_storage&) = delete;
 
-    //! Save peers from `this` and `other` in stream `dest`.
-    bool store(std::ostream& dest, const peerlist_types& other) const;
+    //! Save peers from `this` and `other`, and `blocked` hosts, in stream `dest`.
+    bool store(std::ostream& dest, const peerlist_types& other, const std::map<std::string, time_t>& blocked = {}) const;
 
-    //! Save peers from `this` and `other` in one file at `path`.
-    bool store(const std::string& path, const peerlist_types& other) const;
+    //! Save peers from `this` and `other`, and `blocked` hosts, in one file at `path`.
+    bool store(const std::string& path, const peerlist_types& other, const std::map<std::string, time_t>& blocked = {}) const;
 
     //! \return Peers in `zone` and from remove from `this`.
     peerlist_types take_zone(epee::net_utils::zone zone);
 
+    //! \return Blocked hosts and subnets with their expiry time, and remove from `this`.
+    std::map<std::string, time_t> take_blocked();
+
   private:
     peerlist_types m_types;
+    std::map<std::string, time_t> m_blocked;
   };
 
   /************************************************************************/
@@ -100,6 +157,7 @@ namespace nodetool
   {
   public: 
     bool init(peerlist_types&& peers, bool allow_local_ip);
+    void set_journal(peerlist_journal* journal);
     size_t get_white_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_white.size();}
     size_t get_gray_peers_count(){CRITICAL_REGION_LOCAL(m_peerlist_lock); return m_peers_gray.size();}
     bool merge_peerlist(const std::vector<peerlist_entry>& outer_bs);
@@ -120,6 +178,12 @@ namespace nodetool
     bool get_and_empty_anchor_peerlist(std::vector<anchor_peerlist_entry>& apl);
     bool remove_from_peer_anchor(const epee::net_utils::network_address& addr);
     bool remove_from_peer_white(const peerlist_entry& pe);
+    bool record_peer_rtt(const epee::net_utils::network_address& addr, float rtt);
+    bool record_peer_throughput(const epee::net_utils::network_address& addr, float bytes_per_second);
+    bool record_peer_failure(const epee::net_utils::network_address& addr);
+
+    //! \return Connection preference for `pe` at time `now`, 0.5 for a peer without any measurements.
+    static float get_peer_score(const peerlist_entry& pe, int64_t now);
     
   private:
     struct by_time{};
@@ -183,11 +247,16 @@ namespace nodetool
   private: 
     void trim_white_peerlist();
     void trim_gray_peerlist();
+    template<typename F> bool update_peer_score(const epee::net_utils::network_address& addr, const F &f);
+    static void decay_peer_score(peerlist_entry& pe, int64_t now);
+    static void copy_peer_score(peerlist_entry& dst, const peerlist_entry& src);
+    static bool same_peer(const peerlist_entry& a, const peerlist_entry& b);
 
     friend class boost::serialization::access;
     epee::critical_section m_peerlist_lock;
     std::string m_config_folder;
     bool m_allow_local_ip;
+    peerlist_journal* m_journal = nullptr;
 
 
     peers_indexed m_peers_gray;
@@ -200,6 +269,8 @@ namespace nodetool
     while(m_peers_gray.size() > P2P_LOCAL_GRAY_PEERLIST_LIMIT)
     {
       peers_indexed::index<by_time>::type& sorted_index=m_peers_gray.get<by_time>();
+      if (m_journal)
+        m_journal->remove_peer(false, sorted_index.begin()->adr);
       sorted_index.erase(sorted_index.begin());
     }
   }
@@ -209,6 +280,8 @@ namespace nodetool
     while(m_peers_white.size() > P2P_LOCAL_WHITE_PEERLIST_LIMIT)
     {
       peers_indexed::index<by_time>::type& sorted_index=m_peers_white.get<by_time>();
+      if (m_journal)
+        m_journal->remove_peer(true, sorted_index.begin()->adr);
       sorted_index.erase(sorted_index.begin());
     }
   }
@@ -321,7 +394,7 @@ namespace nodetool
     TRY_ENTRY();
     CRITICAL_REGION_LOCAL(m_peerlist_lock);
     //find in white list
-    peerlist_entry ple;
+    peerlist_entry ple = AUTO_VAL_INIT(ple);
     ple.adr = addr;
     ple.id = peer;
     ple.last_seen = time(NULL);
@@ -344,8 +417,14 @@ namespace nodetool
     auto by_addr_it_wt = m_peers_white.get<by_addr>().find(ple.adr);
     if(by_addr_it_wt == m_peers_white.get<by_addr>().end())
     {
-      //put new record into white list
-      m_peers_white.insert(ple);
+      //put new record into white list, keeping what we measured while it was gray
+      peerlist_entry new_ple = ple;
+      auto by_addr_it_gr = m_peers_gray.get<by_addr>().find(ple.adr);
+      if(by_addr_it_gr != m_peers_gray.get<by_addr>().end())
+        copy_peer_score(new_ple, *by_addr_it_gr);
+      m_peers_white.insert(new_ple);
+      if (m_journal)
+        m_journal->add_peer(true, new_ple);
       trim_white_peerlist();
     }else
     {
@@ -356,6 +435,9 @@ namespace nodetool
       if (by_addr_it_wt->rpc_port && ple.rpc_port == 0) // guard against older nodes not passing RPC port around
         new_ple.rpc_port = by_addr_it_wt->rpc_port;
       new_ple.last_seen = by_addr_it_wt->last_seen; // do not overwrite the last seen timestamp, incoming peer list are untrusted
+      copy_peer_score(new_ple, *by_addr_it_wt);
+      if (m_journal && !same_peer(new_ple, *by_addr_it_wt))
+        m_journal->add_peer(true, new_ple);
       m_peers_white.replace(by_addr_it_wt, new_ple);
     }
     //remove from gray list, if need
@@ -363,6 +445,8 @@ namespace nodetool
     if(by_addr_it_gr != m_peers_gray.get<by_addr>().end())
     {
       m_peers_gray.erase(by_addr_it_gr);
+      if (m_journal)
+        m_journal->remove_peer(false, ple.adr);
     }
     return true;
     CATCH_ENTRY_L0("peerlist_manager::append_with_peer_white()", false);
@@ -387,6 +471,8 @@ namespace nodetool
     {
       //put new record into white list
       m_peers_gray.insert(ple);
+      if (m_journal)
+        m_journal->add_peer(false, ple);
       trim_gray_peerlist();    
     }else
     {
@@ -397,6 +483,9 @@ namespace nodetool
       if (by_addr_it_gr->rpc_port && ple.rpc_port == 0) // guard against older nodes not passing RPC port around
         new_ple.rpc_port = by_addr_it_gr->rpc_port;
       new_ple.last_seen = by_addr_it_gr->last_seen; // do not overwrite the last seen timestamp, incoming peer list are untrusted
+      copy_peer_score(new_ple, *by_addr_it_gr);
+      if (m_journal && !same_peer(new_ple, *by_addr_it_gr))
+        m_journal->add_peer(false, new_ple);
       m_peers_gray.replace(by_addr_it_gr, new_ple);
     }
     return true;
@@ -414,6 +503,8 @@ namespace nodetool
 
     if(by_addr_it_anchor == m_peers_anchor.get<by_addr>().end()) {
       m_peers_anchor.insert(ple);
+      if (m_journal)
+        m_journal->add_anchor(ple);
     }
 
     return true;
@@ -453,6 +544,8 @@ namespace nodetool
 
     if (iterator != m_peers_white.get<by_addr>().end()) {
       m_peers_white.erase(iterator);
+      if (m_journal)
+        m_journal->remove_peer(true, pe.adr);
     }
 
     return true;
@@ -471,6 +564,8 @@ namespace nodetool
 
     if (iterator != m_peers_gray.get<by_addr>().end()) {
       m_peers_gray.erase(iterator);
+      if (m_journal)
+        m_journal->remove_peer(false, pe.adr);
     }
 
     return true;
@@ -488,8 +583,10 @@ namespace nodetool
     auto begin = m_peers_anchor.get<by_time>().begin();
     auto end = m_peers_anchor.get<by_time>().end();
 
-    std::for_each(begin, end, [&apl](const anchor_peerlist_entry &a) {
+    std::for_each(begin, end, [this, &apl](const anchor_peerlist_entry &a) {
       apl.push_back(a);
+      if (m_journal)
+        m_journal->remove_anchor(a.adr);
     });
 
     m_peers_anchor.get<by_time>().clear();
@@ -510,6 +607,8 @@ namespace nodetool
 
     if (iterator != m_peers_anchor.get<by_addr>().end()) {
       m_peers_anchor.erase(iterator);
+      if (m_journal)
+        m_journal->remove_anchor(addr);
     }
 
     return true;
@@ -517,5 +616,58 @@ namespace nodetool
     CATCH_ENTRY_L0("peerlist_manager::remove_from_peer_anchor()", false);
   }
   //--------------------------------------------------------------------------------------------------
+  template<typename F> inline
+  bool peerlist_manager::update_peer_score(const epee::net_utils::network_address& addr, const F &f)
+  {
+    const int64_t now = time(NULL);
+    CRITICAL_REGION_LOCAL(m_peerlist_lock);
+    for (peers_indexed *peers: {&m_peers_white, &m_peers_gray})
+    {
+      auto it = peers->get<by_addr>().find(addr);
+      if (it != peers->get<by_addr>().end())
+      {
+        if (!peers->get<by_addr>().modify(it, [now, &f](peerlist_entry& e){
+          decay_peer_score(e, now);
+          f(e);
+        }))
+          return false;
+        if (m_journal)
+          m_journal->add_peer(peers == &m_peers_white, *it);
+        return true;
+      }
+    }
+    return false;
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::record_peer_rtt(const epee::net_utils::network_address& addr, float rtt)
+  {
+    TRY_ENTRY();
+    return update_peer_score(addr, [rtt](peerlist_entry& e){
+      e.rtt = e.rtt > 0.0f ? e.rtt + P2P_PEER_SCORE_SAMPLE_WEIGHT * (rtt - e.rtt) : rtt;
+    });
+    CATCH_ENTRY_L0("peerlist_manager::record_peer_rtt()", false);
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::record_peer_throughput(const epee::net_utils::network_address& addr, float bytes_per_second)
+  {
+    TRY_ENTRY();
+    return update_peer_score(addr, [bytes_per_second](peerlist_entry& e){
+      e.throughput = e.throughput > 0.0f ? e.throughput + P2P_PEER_SCORE_SAMPLE_WEIGHT * (bytes_per_second - e.throughput) : bytes_per_second;
+    });
+    CATCH_ENTRY_L0("peerlist_manager::record_peer_throughput()", false);
+  }
+  //--------------------------------------------------------------------------------------------------
+  inline
+  bool peerlist_manager::record_peer_failure(const epee::net_utils::network_address& addr)
+  {
+    TRY_ENTRY();
+    return update_peer_score(addr, [](peerlist_entry& e){
+      e.failures += 1.0f;
+    });
+    CATCH_ENTRY_L0("peerlist_manager::record_peer_failure()", false);
+  }
+  //--------------------------------------------------------------------------------------------------
 }
 
@@ -43,7 +43,7 @@
 #include "common/pruning.h"
 #endif
 
-BOOST_CLASS_VERSION(nodetool::peerlist_entry, 3)
+BOOST_CLASS_VERSION(nodetool::peerlist_entry, 4)
 
 namespace boost
 {
@@ -249,6 +249,31 @@ namespace boost
         return;
       }
       a & pl.rpc_credits_per_hash;
+      if (ver < 4)
+      {
+        if (!typename Archive::is_saving())
+        {
+          pl.rtt = 0.0f;
+          pl.throughput = 0.0f;
+          pl.failures = 0.0f;
+          pl.score_time = 0;
+        }
+        return;
+      }
+      // the portable archive has no floating point support, so these are stored in fixed point
+      uint32_t rtt_us = pl.rtt * 1e6f;
+      uint64_t throughput = pl.throughput;
+      uint32_t failures_milli = pl.failures * 1e3f;
+      a & rtt_us;
+      a & throughput;
+      a & failures_milli;
+      a & pl.score_time;
+      if (!typename Archive::is_saving())
+      {
+        pl.rtt = rtt_us / 1e6f;
+        pl.throughput = throughput;
+        pl.failures = failures_milli / 1e3f;
+      }
     }
 
     template <class Archive, class ver_type>
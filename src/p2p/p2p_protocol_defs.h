@@ -80,6 +80,12 @@ namespace nodetool
     uint16_t rpc_port;
     uint32_t rpc_credits_per_hash;
 
+    // local measurements, kept in p2pstate.bin but never sent to peers
+    float rtt; // handshake round trip time, seconds
+    float throughput; // block download rate, bytes per second
+    float failures; // failed connection attempts, decays over time
+    int64_t score_time; // when throughput and failures were last decayed
+
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE(adr)
       KV_SERIALIZE(id)
@@ -92,6 +98,17 @@ namespace nodetool
   };
   typedef peerlist_entry_base<epee::net_utils::network_address> peerlist_entry;
 
+  // the legacy peer list is sent as a raw blob of these, so the layout must not change
+  struct peerlist_entry_old
+  {
+    network_address_old adr;
+    peerid_type id;
+    int64_t last_seen;
+    uint32_t pruning_seed;
+    uint16_t rpc_port;
+    uint32_t rpc_credits_per_hash;
+  };
+
   template<typename AddressType>
   struct anchor_peerlist_entry_base
   {
@@ -172,6 +189,7 @@ namespace nodetool
     uint16_t rpc_port;
     uint32_t rpc_credits_per_hash;
     peerid_type peer_id;
+    uint32_t support_flags;
 
     BEGIN_KV_SERIALIZE_MAP()
       KV_SERIALIZE_VAL_POD_AS_BLOB(network_id)
@@ -180,6 +198,7 @@ namespace nodetool
       KV_SERIALIZE(my_port)
       KV_SERIALIZE_OPT(rpc_port, (uint16_t)(0))
       KV_SERIALIZE_OPT(rpc_credits_per_hash, (uint32_t)0)
+      KV_SERIALIZE_OPT(support_flags, (uint32_t)0)
     END_KV_SERIALIZE_MAP()
   };
   
@@ -219,14 +238,14 @@ namespace nodetool
         {
           // saving: save both, so old and new peers can understand it
           KV_SERIALIZE(local_peerlist_new)
-          std::vector<peerlist_entry_base<network_address_old>> local_peerlist;
+          std::vector<peerlist_entry_old> local_peerlist;
           for (const auto &p: this_ref.local_peerlist_new)
           {
             if (p.adr.get_type_id() == epee::net_utils::ipv4_network_address::get_type_id())
             {
               const epee::net_utils::network_address  &na = p.adr;
               const epee::net_utils::ipv4_network_address &ipv4 = na.as<const epee::net_utils::ipv4_network_address>();
-              local_peerlist.push_back(peerlist_entry_base<network_address_old>({{ipv4.ip(), ipv4.port()}, p.id, p.last_seen, p.pruning_seed, p.rpc_port, p.rpc_credits_per_hash}));
+              local_peerlist.push_back(peerlist_entry_old({{ipv4.ip(), ipv4.port()}, p.id, p.last_seen, p.pruning_seed, p.rpc_port, p.rpc_credits_per_hash}));
             }
             else
               MDEBUG("Not including in legacy peer list: " << p.adr.str());
@@ -238,7 +257,7 @@ namespace nodetool
           // loading: load old list only if there is no new one
           if (!epee::serialization::selector<is_store>::serialize(this_ref.local_peerlist_new, stg, hparent_section, "local_peerlist_new"))
           {
-            std::vector<peerlist_entry_base<network_address_old>> local_peerlist;
+            std::vector<peerlist_entry_old> local_peerlist;
             epee::serialization::selector<is_store>::serialize_stl_container_pod_val_as_blob(local_peerlist, stg, hparent_section, "local_peerlist");
             for (const auto &p: local_peerlist)
               ((response&)this_ref).local_peerlist_new.push_back(peerlist_entry({epee::net_utils::ipv4_network_address(p.adr.ip, p.adr.port), p.id, p.last_seen, p.pruning_seed, p.rpc_port, p.rpc_credits_per_hash}));
@@ -280,14 +299,14 @@ namespace nodetool
         {
           // saving: save both, so old and new peers can understand it
           KV_SERIALIZE(local_peerlist_new)
-          std::vector<peerlist_entry_base<network_address_old>> local_peerlist;
+          std::vector<peerlist_entry_old> local_peerlist;
           for (const auto &p: this_ref.local_peerlist_new)
           {
             if (p.adr.get_type_id() == epee::net_utils::ipv4_network_address::get_type_id())
             {
               const epee::net_utils::network_address  &na = p.adr;
               const epee::net_utils::ipv4_network_address &ipv4 = na.as<const epee::net_utils::ipv4_network_address>();
-              local_peerlist.push_back(peerlist_entry_base<network_address_old>({{ipv4.ip(), ipv4.port()}, p.id, p.last_seen}));
+              local_peerlist.push_back(peerlist_entry_old({{ipv4.ip(), ipv4.port()}, p.id, p.last_seen}));
             }
             else
               MDEBUG("Not including in legacy peer list: " << p.adr.str());
@@ -299,7 +318,7 @@ namespace nodetool
           // loading: load old list only if there is no new one
           if (!epee::serialization::selector<is_store>::serialize(this_ref.local_peerlist_new, stg, hparent_section, "local_peerlist_new"))
           {
-            std::vector<peerlist_entry_base<network_address_old>> local_peerlist;
+            std::vector<peerlist_entry_old> local_peerlist;
             epee::serialization::selector<is_store>::serialize_stl_container_pod_val_as_blob(local_peerlist, stg, hparent_section, "local_peerlist");
             for (const auto &p: local_peerlist)
               ((response&)this_ref).local_peerlist_new.push_back(peerlist_entry({epee::net_utils::ipv4_network_address(p.adr.ip, p.adr.port), p.id, p.last_seen}));
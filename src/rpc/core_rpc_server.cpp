@@ -121,6 +121,54 @@ namespace
   {
     return (value + quantum - 1) / quantum * quantum;
   }
+
+  void fill_histogram(cryptonote::COMMAND_RPC_GET_CONNECTION_METRICS::histogram &h, const epee::net_utils::histogram &metrics)
+  {
+    const epee::net_utils::histogram::snapshot snapshot = metrics.get();
+    h.count = snapshot.count;
+    h.sum = snapshot.sum;
+    h.max = snapshot.max;
+    h.p50 = snapshot.percentile(0.5);
+    h.p90 = snapshot.percentile(0.9);
+    h.p99 = snapshot.percentile(0.99);
+  }
+
+  void fill_traffic(cryptonote::COMMAND_RPC_GET_CONNECTION_METRICS::traffic &t, const epee::net_utils::traffic_metrics &metrics)
+  {
+    t.messages_in = metrics.messages_in;
+    t.bytes_in = metrics.bytes_in;
+    t.messages_out = metrics.messages_out;
+    t.bytes_out = metrics.bytes_out;
+    fill_histogram(t.size_in, metrics.size_in);
+    fill_histogram(t.size_out, metrics.size_out);
+    fill_histogram(t.handler_time, metrics.handler_time);
+  }
+
+  const char *get_command_name(uint32_t command)
+  {
+#define COMMAND_NAME(c) case c::ID: return #c
+    switch (command)
+    {
+      COMMAND_NAME(nodetool::COMMAND_HANDSHAKE_T<cryptonote::CORE_SYNC_DATA>);
+      COMMAND_NAME(nodetool::COMMAND_TIMED_SYNC_T<cryptonote::CORE_SYNC_DATA>);
+      COMMAND_NAME(nodetool::COMMAND_PING);
+      COMMAND_NAME(nodetool::COMMAND_REQUEST_SUPPORT_FLAGS);
+      COMMAND_NAME(cryptonote::NOTIFY_NEW_BLOCK);
+      COMMAND_NAME(cryptonote::NOTIFY_NEW_TRANSACTIONS);
+      COMMAND_NAME(cryptonote::NOTIFY_REQUEST_GET_OBJECTS);
+      COMMAND_NAME(cryptonote::NOTIFY_RESPONSE_GET_OBJECTS);
+      COMMAND_NAME(cryptonote::NOTIFY_REQUEST_CHAIN);
+      COMMAND_NAME(cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY);
+      COMMAND_NAME(cryptonote::NOTIFY_NEW_FLUFFY_BLOCK);
+      COMMAND_NAME(cryptonote::NOTIFY_REQUEST_FLUFFY_MISSING_TX);
+      COMMAND_NAME(cryptonote::NOTIFY_REQUEST_TX_RECONCILE);
+      COMMAND_NAME(cryptonote::NOTIFY_RESPONSE_TX_RECONCILE);
+      COMMAND_NAME(cryptonote::NOTIFY_REQUEST_TXS);
+      COMMAND_NAME(cryptonote::NOTIFY_NEW_COMPACT_BLOCK);
+      default: return "";
+    }
+#undef COMMAND_NAME
+  }
 }
 
 namespace cryptonote
@@ -290,6 +338,8 @@ namespace cryptonote
     if (m_rpc_payment)
       m_net_server.add_idle_handler([this](){ return m_rpc_payment->on_idle(); }, 60 * 1000);
 
+    m_net_server.set_io_service_per_thread(rpc_config->io_service_per_thread);
+
     auto rng = [](size_t len, uint8_t *ptr){ return crypto::rand(len, ptr); };
     return epee::http_server_impl_base<core_rpc_server, connection_context>::init(
       rng, std::move(port), std::move(rpc_config->bind_ip),
@@ -453,6 +503,10 @@ namespace cryptonote
       res.database_size = round_up(res.database_size, 5ull* 1024 * 1024 * 1024);
     res.update_available = restricted ? false : m_core.is_update_available();
     res.version = restricted ? "" : BITTUBE_VERSION_FULL;
+    const output_key_cache::stats cache_stats = m_core.get_blockchain_storage().get_output_key_cache_stats();
+    res.output_key_cache_hits = restricted ? 0 : cache_stats.hits;
+    res.output_key_cache_misses = restricted ? 0 : cache_stats.misses;
+    res.output_key_cache_size = restricted ? 0 : cache_stats.entries;
 
     res.status = CORE_RPC_STATUS_OK;
     return true;
@@ -463,14 +517,8 @@ namespace cryptonote
     RPC_TRACKER(get_net_stats);
     // No bootstrap daemon check: Only ever get stats about local server
     res.start_time = (uint64_t)m_core.get_start_time();
-    {
-      CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_in);
-      epee::net_utils::network_throttle_manager::get_global_throttle_in().get_stats(res.total_packets_in, res.total_bytes_in);
-    }
-    {
-      CRITICAL_REGION_LOCAL(epee::net_utils::network_throttle_manager::m_lock_get_global_throttle_out);
-      epee::net_utils::network_throttle_manager::get_global_throttle_out().get_stats(res.total_packets_out, res.total_bytes_out);
-    }
+    epee::net_utils::network_throttle_manager::get_global_bucket_in().get_stats(res.total_packets_in, res.total_bytes_in);
+    epee::net_utils::network_throttle_manager::get_global_bucket_out().get_stats(res.total_packets_out, res.total_bytes_out);
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -2211,6 +2259,40 @@ namespace cryptonote
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_connection_metrics(const COMMAND_RPC_GET_CONNECTION_METRICS::request& req, COMMAND_RPC_GET_CONNECTION_METRICS::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
+  {
+    RPC_TRACKER(get_connection_metrics);
+
+    nodetool::i_p2p_endpoint<cryptonote_connection_context> &p2p = m_p2p;
+    p2p.for_each_connection([&res](const cryptonote_connection_context &cntxt, nodetool::peerid_type peer_id, uint32_t support_flags) {
+      res.connections.emplace_back();
+      COMMAND_RPC_GET_CONNECTION_METRICS::connection &c = res.connections.back();
+      c.connection_id = epee::string_tools::pod_to_hex(cntxt.m_connection_id);
+      c.address = cntxt.m_remote_address.str();
+      std::ostringstream peer_id_str;
+      peer_id_str << std::hex << std::setw(16) << std::setfill('0') << peer_id;
+      c.peer_id = peer_id_str.str();
+      c.incoming = cntxt.m_is_income;
+      fill_traffic(c.totals, *cntxt.m_metrics);
+      fill_histogram(c.send_queue_depth, cntxt.m_metrics->send_queue_depth);
+      fill_histogram(c.throttle_time, cntxt.m_metrics->throttle_time);
+      c.send_queue_bytes = cntxt.m_metrics->send_queue_bytes.load(std::memory_order_relaxed);
+      return true;
+    });
+
+    epee::net_utils::command_metrics::for_each([&res](uint32_t command, const epee::net_utils::traffic_metrics &metrics) {
+      res.commands.emplace_back();
+      COMMAND_RPC_GET_CONNECTION_METRICS::command &c = res.commands.back();
+      c.id = command;
+      c.name = get_command_name(command);
+      fill_traffic(c.totals, metrics);
+    });
+    std::sort(res.commands.begin(), res.commands.end(), [](const COMMAND_RPC_GET_CONNECTION_METRICS::command &a, const COMMAND_RPC_GET_CONNECTION_METRICS::command &b) { return a.id < b.id; });
+
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_get_info_json(const COMMAND_RPC_GET_INFO::request& req, COMMAND_RPC_GET_INFO::response& res, epee::json_rpc::error& error_resp, const connection_context *ctx)
   {
     on_get_info(req, res, ctx);
@@ -2772,9 +2854,21 @@ namespace cryptonote
     res.target_height = m_core.get_target_blockchain_height();
     res.next_needed_pruning_seed = m_p2p.get_payload_object().get_next_needed_pruning_stripe().second;
 
+    const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
+    const size_t nominal_span_size = m_core.get_block_sync_size(res.height);
     for (const auto &c: m_p2p.get_payload_object().get_connections())
+    {
       res.peers.push_back({c});
-    const cryptonote::block_queue &block_queue = m_p2p.get_payload_object().get_block_queue();
+      boost::uuids::uuid connection_id;
+      cryptonote::block_queue::peer_throughput throughput;
+      if (epee::string_tools::hex_to_pod(c.connection_id, connection_id) && block_queue.get_peer_throughput(connection_id, throughput))
+      {
+        COMMAND_RPC_SYNC_INFO::peer &p = res.peers.back();
+        p.throughput = (uint32_t)(throughput.bandwidth + 0.5f);
+        p.latency = (uint32_t)(throughput.latency * 1000.0f + 0.5f);
+        p.span_size = block_queue.get_span_size(connection_id, nominal_span_size, false);
+      }
+    }
     block_queue.foreach([&](const cryptonote::block_queue::span &span) {
       const std::string span_connection_id = epee::string_tools::pod_to_hex(span.connection_id);
       uint32_t speed = (uint32_t)(100.0f * block_queue.get_speed(span.connection_id) + 0.5f);
@@ -89,7 +89,7 @@ namespace cryptonote
 // advance which version they will stop working with
 // Don't go over 32767 for any of these
 #define CORE_RPC_VERSION_MAJOR 3
-#define CORE_RPC_VERSION_MINOR 0
+#define CORE_RPC_VERSION_MINOR 3
 #define MAKE_CORE_RPC_VERSION(major,minor) (((major)<<16)|(minor))
 #define CORE_RPC_VERSION MAKE_CORE_RPC_VERSION(CORE_RPC_VERSION_MAJOR, CORE_RPC_VERSION_MINOR)
 
@@ -681,6 +681,9 @@ namespace cryptonote
       uint64_t database_size;
       bool update_available;
       std::string version;
+      uint64_t output_key_cache_hits;
+      uint64_t output_key_cache_misses;
+      uint64_t output_key_cache_size;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_PARENT(rpc_access_response_base)
@@ -715,6 +718,9 @@ namespace cryptonote
         KV_SERIALIZE(database_size)
         KV_SERIALIZE(update_available)
         KV_SERIALIZE(version)
+        KV_SERIALIZE_OPT(output_key_cache_hits, (uint64_t)0)
+        KV_SERIALIZE_OPT(output_key_cache_misses, (uint64_t)0)
+        KV_SERIALIZE_OPT(output_key_cache_size, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
     typedef epee::misc_utils::struct_init<response_t> response;
@@ -1548,6 +1554,106 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
+  struct COMMAND_RPC_GET_CONNECTION_METRICS
+  {
+    struct histogram
+    {
+      uint64_t count;
+      uint64_t sum;
+      uint64_t max;
+      uint64_t p50;
+      uint64_t p90;
+      uint64_t p99;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(count)
+        KV_SERIALIZE(sum)
+        KV_SERIALIZE(max)
+        KV_SERIALIZE(p50)
+        KV_SERIALIZE(p90)
+        KV_SERIALIZE(p99)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct traffic
+    {
+      uint64_t messages_in;
+      uint64_t bytes_in;
+      uint64_t messages_out;
+      uint64_t bytes_out;
+      histogram size_in;
+      histogram size_out;
+      histogram handler_time; // microseconds
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(messages_in)
+        KV_SERIALIZE(bytes_in)
+        KV_SERIALIZE(messages_out)
+        KV_SERIALIZE(bytes_out)
+        KV_SERIALIZE(size_in)
+        KV_SERIALIZE(size_out)
+        KV_SERIALIZE(handler_time)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct connection
+    {
+      std::string connection_id;
+      std::string address;
+      std::string peer_id;
+      bool incoming;
+      traffic totals;
+      histogram send_queue_depth;
+      histogram throttle_time; // microseconds
+      uint64_t send_queue_bytes; // queued right now
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(connection_id)
+        KV_SERIALIZE(address)
+        KV_SERIALIZE(peer_id)
+        KV_SERIALIZE(incoming)
+        KV_SERIALIZE(totals)
+        KV_SERIALIZE(send_queue_depth)
+        KV_SERIALIZE(throttle_time)
+        KV_SERIALIZE(send_queue_bytes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct command
+    {
+      uint32_t id;
+      std::string name;
+      traffic totals;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(id)
+        KV_SERIALIZE(name)
+        KV_SERIALIZE(totals)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct request_t: public rpc_request_base
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_request_base)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<request_t> request;
+
+    struct response_t: public rpc_response_base
+    {
+      std::vector<connection> connections;
+      std::vector<command> commands;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_PARENT(rpc_response_base)
+        KV_SERIALIZE(connections)
+        KV_SERIALIZE(commands)
+      END_KV_SERIALIZE_MAP()
+    };
+    typedef epee::misc_utils::struct_init<response_t> response;
+  };
+
   struct COMMAND_RPC_GET_BLOCK_HEADERS_RANGE
   {
     struct request_t: public rpc_access_request_base
@@ -2153,9 +2259,15 @@ namespace cryptonote
     struct peer
     {
       connection_info info;
+      uint32_t throughput;
+      uint32_t latency;
+      uint64_t span_size;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(info)
+        KV_SERIALIZE_OPT(throughput, (uint32_t)0)
+        KV_SERIALIZE_OPT(latency, (uint32_t)0)
+        KV_SERIALIZE_OPT(span_size, (uint64_t)0)
       END_KV_SERIALIZE_MAP()
     };
 
@@ -2553,4 +2665,13 @@ namespace cryptonote
     typedef epee::misc_utils::struct_init<response_t> response;
   };
 
-}
\ No newline at end of file
+}
+
+namespace epee
+{
+  namespace serialization
+  {
+    template<> struct load_from_binary_view<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response>: std::true_type {};
+    template<> struct store_to_binary_writer<cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response>: std::true_type {};
+  }
+}
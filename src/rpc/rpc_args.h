@@ -56,6 +56,7 @@ namespace cryptonote
       const command_line::arg_descriptor<std::string> rpc_bind_ipv6_address;
       const command_line::arg_descriptor<bool> rpc_use_ipv6;
       const command_line::arg_descriptor<bool> rpc_ignore_ipv4;
+      const command_line::arg_descriptor<bool> rpc_io_service_per_thread;
       const command_line::arg_descriptor<std::string> rpc_login;
       const command_line::arg_descriptor<bool> confirm_external_bind;
       const command_line::arg_descriptor<std::string> rpc_access_control_origins;
@@ -83,6 +84,7 @@ namespace cryptonote
     std::string bind_ipv6_address;
     bool use_ipv6;
     bool require_ipv4;
+    bool io_service_per_thread;
     std::vector<std::string> access_control_origins;
     boost::optional<tools::login> login; // currently `boost::none` if unspecified by user
     epee::net_utils::ssl_options_t ssl_options = epee::net_utils::ssl_support_t::e_ssl_support_enabled;
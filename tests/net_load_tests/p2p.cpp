@@ -0,0 +1,821 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <thread>
+
+#include <boost/algorithm/string/classification.hpp>
+#include <boost/algorithm/string/split.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
+#if defined(__linux__)
+#include <unistd.h>
+#include <sys/resource.h>
+#endif
+
+#include "include_base_utils.h"
+#include "misc_log_ex.h"
+#include "storages/levin_abstract_invoke2.h"
+#include "storages/portable_storage_template_helper.h"
+#include "common/command_line.h"
+#include "common/util.h"
+#include "cryptonote_basic/cryptonote_format_utils.h"
+#include "cryptonote_core/cryptonote_core.h"
+#include "p2p/net_node.h"
+#include "p2p/net_node.inl"
+#include "cryptonote_core/i_core_events.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.h"
+#include "cryptonote_protocol/cryptonote_protocol_handler.inl"
+
+#include "net_load_tests.h"
+
+using namespace net_load_tests;
+
+namespace po = boost::program_options;
+
+namespace cryptonote {
+  class blockchain_storage;
+}
+
+#define EXIT_ON_ERROR(cond) { if (!(cond)) { LOG_PRINT_L0("ERROR: " << #cond); exit(1); } else {} }
+
+namespace
+{
+  const size_t CONNECTION_TIMEOUT = 10000;
+  const size_t DEFAULT_OPERATION_TIMEOUT = 30000;
+
+  typedef std::chrono::steady_clock clock_type;
+
+  template<typename t_predicate>
+  bool busy_wait_for(size_t timeout_ms, const t_predicate& predicate, size_t sleep_ms = 10)
+  {
+    for (size_t i = 0; i < timeout_ms / sleep_ms; ++i)
+    {
+      if (predicate())
+        return true;
+      epee::misc_utils::sleep_no_w(static_cast<long>(sleep_ms));
+    }
+    return false;
+  }
+
+  // Core stand-in for the node under test: accepts everything, counts what
+  // the protocol handler passes down and serves canned blocks for GET_OBJECTS
+  class load_core : public cryptonote::i_core_events
+  {
+  public:
+    load_core(): m_txs(0), m_blocks(0), m_get_objects(0) {}
+
+    void on_synchronized(){}
+    void safesyncmode(const bool){}
+    uint64_t get_current_blockchain_height() const {return 1;}
+    void set_target_blockchain_height(uint64_t) {}
+    bool init(const boost::program_options::variables_map& vm) {return true ;}
+    bool deinit(){return true;}
+    bool get_short_chain_history(std::list<crypto::hash>& ids) const { return true; }
+    bool get_stat_info(cryptonote::core_stat_info& st_inf) const {return true;}
+    bool have_block(const crypto::hash& id) const {return true;}
+    void get_blockchain_top(uint64_t& height, crypto::hash& top_id)const{height=0;top_id=crypto::null_hash;}
+    bool handle_incoming_tx(const cryptonote::tx_blob_entry& tx_blob, cryptonote::tx_verification_context& tvc, cryptonote::relay_method tx_relay, bool relayed) { ++m_txs; return true; }
+    bool handle_incoming_txs(const std::vector<cryptonote::tx_blob_entry>& tx_blob, std::vector<cryptonote::tx_verification_context>& tvc, cryptonote::relay_method tx_relay, bool relayed) { m_txs += tx_blob.size(); return true; }
+    bool handle_incoming_block(const cryptonote::blobdata& block_blob, const cryptonote::block *block, cryptonote::block_verification_context& bvc, bool update_miner_blocktemplate = true) { ++m_blocks; return true; }
+    void pause_mine(){}
+    void resume_mine(){}
+    bool on_idle(){return true;}
+    bool find_blockchain_supplement(const std::list<crypto::hash>& qblock_ids, bool clip_pruned, cryptonote::NOTIFY_RESPONSE_CHAIN_ENTRY::request& resp){return true;}
+    bool handle_get_objects(cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request& arg, cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request& rsp, cryptonote::cryptonote_connection_context& context)
+    {
+      ++m_get_objects;
+      rsp.current_blockchain_height = 1;
+      rsp.blocks.resize(arg.blocks.size());
+      for (cryptonote::block_complete_entry &e: rsp.blocks)
+      {
+        e.pruned = false;
+        e.block = m_block_blob;
+        e.block_weight = 0;
+      }
+      return true;
+    }
+    cryptonote::blockchain_storage &get_blockchain_storage() { throw std::runtime_error("Called invalid member function: please never call get_blockchain_storage on the TESTING class load_core."); }
+    bool get_test_drop_download() const {return true;}
+    bool get_test_drop_download_height() const {return true;}
+    bool prepare_handle_incoming_blocks(const std::vector<cryptonote::block_complete_entry>  &blocks_entry, std::vector<cryptonote::block> &blocks) { return true; }
+    bool cleanup_handle_incoming_blocks(bool force_sync = false) { return true; }
+    uint64_t get_target_blockchain_height() const { return 1; }
+    size_t get_block_sync_size(uint64_t height) const { return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT; }
+    virtual void on_transactions_relayed(epee::span<const cryptonote::blobdata> tx_blobs, cryptonote::relay_method tx_relay) {}
+    cryptonote::network_type get_nettype() const { return cryptonote::MAINNET; }
+    bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx_blob, cryptonote::relay_category tx_category) const { return false; }
+    bool pool_has_tx(const crypto::hash &txid) const { return false; }
+    bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_sensitive_txes = false) const { return false; }
+    bool get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata, cryptonote::block>>& blocks, std::vector<cryptonote::blobdata>& txs) const { return false; }
+    bool get_transactions(const std::vector<crypto::hash>& txs_ids, std::vector<cryptonote::transaction>& txs, std::vector<crypto::hash>& missed_txs) const { return false; }
+    bool get_block_by_hash(const crypto::hash &h, cryptonote::block &blk, bool *orphan = NULL) const { return false; }
+    bool get_recent_block(const crypto::hash &h, bool pruned, cryptonote::block_complete_entry &e) const { return false; }
+    uint8_t get_ideal_hard_fork_version() const { return 0; }
+    uint8_t get_ideal_hard_fork_version(uint64_t height) const { return 0; }
+    uint8_t get_hard_fork_version(uint64_t height) const { return 0; }
+    uint64_t get_earliest_ideal_height_for_version(uint8_t version) const { return 0; }
+    cryptonote::difficulty_type get_block_cumulative_difficulty(uint64_t height) const { return 0; }
+    bool fluffy_blocks_enabled() const { return false; }
+    uint64_t prevalidate_block_hashes(uint64_t height, const std::vector<crypto::hash> &hashes, const std::vector<uint64_t> &weights) { return 0; }
+    bool pad_transactions() { return false; }
+    uint32_t get_blockchain_pruning_seed() const { return 0; }
+    bool prune_blockchain(uint32_t pruning_seed = 0) { return true; }
+    bool is_within_compiled_block_hash_area(uint64_t height) const { return false; }
+    bool has_block_weights(uint64_t height, uint64_t nblocks) const { return false; }
+    void stop() {}
+
+    void set_block_blob(const cryptonote::blobdata &blob) { m_block_blob = blob; }
+    uint64_t txs() const { return m_txs; }
+    uint64_t blocks() const { return m_blocks; }
+    uint64_t get_objects() const { return m_get_objects; }
+    void reset_counters() { m_txs = 0; m_blocks = 0; m_get_objects = 0; }
+
+  private:
+    cryptonote::blobdata m_block_blob;
+    std::atomic<uint64_t> m_txs;
+    std::atomic<uint64_t> m_blocks;
+    std::atomic<uint64_t> m_get_objects;
+  };
+
+  typedef nodetool::node_server<cryptonote::t_cryptonote_protocol_handler<load_core>> Server;
+  typedef nodetool::COMMAND_HANDSHAKE_T<cryptonote::CORE_SYNC_DATA> COMMAND_HANDSHAKE;
+  typedef nodetool::COMMAND_TIMED_SYNC_T<cryptonote::CORE_SYNC_DATA> COMMAND_TIMED_SYNC;
+
+  enum request_type
+  {
+    req_handshake,
+    req_timed_sync,
+    req_get_objects,
+    req_type_count
+  };
+
+  const char *const request_type_names[req_type_count] = { "handshake", "timed_sync", "get_objects" };
+
+  class latency_stats
+  {
+  public:
+    void add(double ms)
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      m_samples.push_back(ms);
+    }
+
+    void clear()
+    {
+      boost::unique_lock<boost::mutex> lock(m_mutex);
+      m_samples.clear();
+    }
+
+    // returns the number of samples, and fills the requested percentiles (in ms)
+    size_t get(double &p50, double &p99) const
+    {
+      std::vector<double> samples;
+      {
+        boost::unique_lock<boost::mutex> lock(m_mutex);
+        samples = m_samples;
+      }
+      p50 = p99 = 0.0;
+      if (samples.empty())
+        return 0;
+      std::sort(samples.begin(), samples.end());
+      p50 = samples[(samples.size() - 1) * 50 / 100];
+      p99 = samples[(samples.size() - 1) * 99 / 100];
+      return samples.size();
+    }
+
+  private:
+    mutable boost::mutex m_mutex;
+    std::vector<double> m_samples;
+  };
+
+  double elapsed_ms(clock_type::time_point since)
+  {
+    return std::chrono::duration<double, std::milli>(clock_type::now() - since).count();
+  }
+
+  // one simulated peer: at most one timed sync and one GET_OBJECTS span in flight
+  struct load_peer
+  {
+    boost::uuids::uuid connection_id;
+    std::atomic<bool> handshaked;
+    std::atomic<bool> sync_pending;
+    std::atomic<bool> objects_pending;
+    std::atomic<int64_t> objects_sent; // clock ticks
+
+    load_peer(): connection_id(boost::uuids::nil_uuid()), handshaked(false), sync_pending(false), objects_pending(false), objects_sent(0) {}
+  };
+
+  struct load_stats
+  {
+    std::atomic<uint64_t> sent;
+    std::atomic<uint64_t> received;
+    latency_stats latency[req_type_count];
+
+    load_stats(): sent(0), received(0) {}
+
+    void reset()
+    {
+      sent = 0;
+      received = 0;
+      for (size_t i = 0; i < req_type_count; ++i)
+        latency[i].clear();
+    }
+  };
+
+  cryptonote::CORE_SYNC_DATA make_sync_data()
+  {
+    cryptonote::CORE_SYNC_DATA data = AUTO_VAL_INIT(data);
+    data.current_height = 1;
+    data.cumulative_difficulty = 1;
+    data.top_id = crypto::null_hash;
+    data.top_version = 0;
+    data.pruning_seed = 0;
+    return data;
+  }
+
+  // client side of the simulated peers: answers the node's timed syncs and
+  // times GET_OBJECTS spans until the matching response arrives
+  struct p2p_load_commands_handler : public test_levin_commands_handler
+  {
+    p2p_load_commands_handler(load_stats &stats)
+      : m_stats(stats)
+    {
+    }
+
+    virtual int invoke(int command, const epee::span<const uint8_t> in_buff, std::string& buff_out, test_connection_context& context)
+    {
+      ++m_stats.received;
+      if (command != COMMAND_TIMED_SYNC::ID)
+        return LEVIN_ERROR_CONNECTION_HANDLER_NOT_DEFINED;
+
+      COMMAND_TIMED_SYNC::response rsp;
+      rsp.local_time = time(NULL);
+      rsp.payload_data = make_sync_data();
+      if (!epee::serialization::store_t_to_binary(rsp, buff_out))
+        return LEVIN_ERROR_FORMAT;
+      return 1;
+    }
+
+    virtual int notify(int command, const epee::span<const uint8_t> in_buff, test_connection_context& context)
+    {
+      ++m_stats.received;
+      if (command == cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::ID)
+      {
+        load_peer *peer = find_peer(context.m_connection_id);
+        if (peer && peer->objects_pending)
+        {
+          const clock_type::time_point sent{clock_type::duration{peer->objects_sent.load()}};
+          m_stats.latency[req_get_objects].add(elapsed_ms(sent));
+          peer->objects_pending = false;
+        }
+      }
+      return 1;
+    }
+
+    virtual void on_connection_new(test_connection_context& context)
+    {
+      test_levin_commands_handler::on_connection_new(context);
+      context.m_closed = false;
+    }
+
+    virtual void on_connection_close(test_connection_context& context)
+    {
+      test_levin_commands_handler::on_connection_close(context);
+      context.m_closed = true;
+    }
+
+    void set_peers(std::map<boost::uuids::uuid, load_peer*> peers)
+    {
+      boost::unique_lock<boost::mutex> lock(m_peers_mutex);
+      m_peers = std::move(peers);
+    }
+
+  private:
+    load_peer *find_peer(const boost::uuids::uuid &connection_id)
+    {
+      boost::unique_lock<boost::mutex> lock(m_peers_mutex);
+      const auto i = m_peers.find(connection_id);
+      return i == m_peers.end() ? NULL : i->second;
+    }
+
+  private:
+    load_stats &m_stats;
+    boost::mutex m_peers_mutex;
+    std::map<boost::uuids::uuid, load_peer*> m_peers;
+  };
+
+  struct load_params
+  {
+    std::string port;
+    unsigned duration;
+    double rate;
+    size_t threads;
+    size_t tx_size;
+    size_t block_size;
+    size_t span_blocks;
+  };
+
+  uint64_t get_rss()
+  {
+#if defined(__linux__)
+    std::ifstream statm("/proc/self/statm");
+    uint64_t size = 0, resident = 0;
+    if (statm >> size >> resident)
+      return resident * sysconf(_SC_PAGESIZE);
+#endif
+    return 0;
+  }
+
+  void raise_fd_limit()
+  {
+#if defined(__linux__)
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max)
+    {
+      rl.rlim_cur = rl.rlim_max;
+      if (setrlimit(RLIMIT_NOFILE, &rl) != 0)
+        LOG_PRINT_L0("Failed to raise the open file limit, large connection counts may fail");
+    }
+#endif
+  }
+
+  // each simulated peer connects from its own loopback address, since the
+  // node only accepts one incoming connection per host
+  std::string peer_bind_ip(size_t idx)
+  {
+    return "127." + std::to_string(1 + idx / 65536) + "." + std::to_string((idx / 256) % 256) + "." + std::to_string(idx % 256);
+  }
+
+  cryptonote::blobdata make_block_blob(size_t size)
+  {
+    cryptonote::block b = AUTO_VAL_INIT(b);
+    b.major_version = 1;
+    b.minor_version = 0;
+    b.timestamp = time(NULL);
+    b.prev_id = crypto::null_hash;
+    b.nonce = 0;
+    b.miner_tx.version = 1;
+    b.miner_tx.unlock_time = 0;
+    cryptonote::txin_gen in;
+    in.height = 0;
+    b.miner_tx.vin.push_back(in);
+    b.miner_tx.extra.resize(size);
+    crypto::rand(b.miner_tx.extra.size(), b.miner_tx.extra.data());
+    return cryptonote::block_to_blob(b);
+  }
+
+  class p2p_load_test
+  {
+  public:
+    p2p_load_test(Server &server, load_core &core, const load_params &params)
+      : m_server(server)
+      , m_core(core)
+      , m_params(params)
+      , m_tcp_server(epee::net_utils::e_connection_type_RPC) // RPC disables network limit for unit tests
+      , m_commands_handler(NULL)
+    {
+    }
+
+    bool init()
+    {
+      m_commands_handler = new p2p_load_commands_handler(m_stats);
+      m_tcp_server.get_config_object().set_handler(m_commands_handler, [](epee::levin::levin_commands_handler<test_connection_context> *handler) { delete handler; });
+      m_tcp_server.get_config_object().m_invoke_timeout = CONNECTION_TIMEOUT;
+      // the peers advertise compression, so accept what the node compresses, within its own limits
+      m_tcp_server.get_config_object().m_max_inflated_size = [](const test_connection_context&, int command) {
+        return cryptonote::t_cryptonote_protocol_handler<load_core>::get_max_inflated_size(command);
+      };
+      if (!m_tcp_server.init_server(clt_port, "127.0.0.1"))
+        return false;
+      if (!m_tcp_server.run_server(m_params.threads, false))
+        return false;
+
+      m_block_blob = make_block_blob(m_params.block_size);
+      m_core.set_block_blob(m_block_blob);
+      m_tx_blob.resize(m_params.tx_size);
+      crypto::rand(m_tx_blob.size(), (uint8_t*)&m_tx_blob[0]);
+      return true;
+    }
+
+    void deinit()
+    {
+      m_tcp_server.send_stop_signal();
+      m_tcp_server.timed_wait_server_stop(DEFAULT_OPERATION_TIMEOUT);
+      m_tcp_server.deinit_server();
+    }
+
+    bool run_level(size_t connection_count)
+    {
+      m_stats.reset();
+      m_core.reset_counters();
+      const uint64_t rss_before = get_rss();
+      const size_t closed_before = m_commands_handler->close_connection_counter();
+
+      // the previous level's peers are only released here, once all their
+      // connections are closed and no callback can refer to them anymore
+      std::vector<std::unique_ptr<load_peer>> &peers = m_peers;
+      peers.clear();
+      peers.resize(connection_count);
+      for (auto &peer: peers)
+        peer.reset(new load_peer());
+
+      const clock_type::time_point connect_start = clock_type::now();
+      for_each_peer(peers, [this](size_t idx, load_peer &peer) { connect_peer(idx, peer); });
+
+      std::map<boost::uuids::uuid, load_peer*> peer_map;
+      for (auto &peer: peers)
+        if (!peer->connection_id.is_nil())
+          peer_map[peer->connection_id] = peer.get();
+      m_commands_handler->set_peers(peer_map);
+
+      const bool all_handshaked = busy_wait_for(DEFAULT_OPERATION_TIMEOUT, [&]() { return count_handshaked(peers) == connection_count; });
+      const size_t handshaked = count_handshaked(peers);
+      const double connect_ms = elapsed_ms(connect_start);
+      const uint64_t rss_after = get_rss();
+      if (!all_handshaked)
+        LOG_PRINT_L0("Only " << handshaked << "/" << connection_count << " peers completed the handshake");
+
+      const clock_type::time_point traffic_start = clock_type::now();
+      const clock_type::time_point deadline = traffic_start + std::chrono::seconds(m_params.duration);
+      for_each_peer_thread(peers, [this, deadline](std::vector<load_peer*> &own) { send_traffic(own, deadline); });
+      const double traffic_s = elapsed_ms(traffic_start) / 1000.0;
+      const uint64_t sent = m_stats.sent, received = m_stats.received;
+      const size_t dropped = m_commands_handler->close_connection_counter() - closed_before;
+
+      std::cout << "connections: " << connection_count << " (" << handshaked << " handshaked in " << connect_ms << " ms, " << dropped << " dropped)" << std::endl;
+      std::cout << "  messages/sec: " << (sent + received) / traffic_s << " (" << sent << " sent, " << received << " received)" << std::endl;
+      std::cout << "  node handled: " << m_core.txs() << " txs, " << m_core.blocks() << " fluffy blocks, " << m_core.get_objects() << " GET_OBJECTS" << std::endl;
+      size_t get_objects_samples = 0;
+      for (size_t i = 0; i < req_type_count; ++i)
+      {
+        double p50, p99;
+        const size_t n = m_stats.latency[i].get(p50, p99);
+        std::cout << "  " << request_type_names[i] << " latency: p50 " << p50 << " ms, p99 " << p99 << " ms (" << n << " samples)" << std::endl;
+        if (i == req_get_objects)
+          get_objects_samples = n;
+      }
+      if (rss_before && handshaked)
+        std::cout << "  memory/connection: " << (rss_after > rss_before ? (rss_after - rss_before) / handshaked : 0) << " bytes (both ends, RSS delta)" << std::endl;
+      // a broken exchange shows up as dropped peers or unanswered spans, not as slow ones
+      if (dropped)
+        LOG_PRINT_L0(dropped << " peers were dropped during the run");
+      if (!get_objects_samples)
+        LOG_PRINT_L0("No GET_OBJECTS span was answered");
+
+      m_commands_handler->set_peers({});
+      size_t opened = 0;
+      for (auto &peer: peers)
+      {
+        if (!peer->connection_id.is_nil())
+        {
+          m_tcp_server.get_config_object().close(peer->connection_id);
+          ++opened;
+        }
+      }
+      const size_t closed_target = closed_before + opened;
+      const bool closed = busy_wait_for(DEFAULT_OPERATION_TIMEOUT, [&]() {
+        return m_commands_handler->close_connection_counter() >= closed_target && m_server.get_public_connections_count() == 0;
+      });
+      return closed && all_handshaked && !dropped && get_objects_samples;
+    }
+
+  private:
+    template<typename t_func>
+    void for_each_peer(std::vector<std::unique_ptr<load_peer>> &peers, t_func f)
+    {
+      std::atomic<size_t> next(0);
+      boost::thread_group threads;
+      for (size_t t = 0; t < m_params.threads; ++t)
+      {
+        threads.create_thread([&]() {
+          for (size_t idx = next++; idx < peers.size(); idx = next++)
+            f(idx, *peers[idx]);
+        });
+      }
+      threads.join_all();
+    }
+
+    template<typename t_func>
+    void for_each_peer_thread(std::vector<std::unique_ptr<load_peer>> &peers, t_func f)
+    {
+      std::vector<std::vector<load_peer*>> own(m_params.threads);
+      for (size_t idx = 0; idx < peers.size(); ++idx)
+        if (peers[idx]->handshaked)
+          own[idx % own.size()].push_back(peers[idx].get());
+      boost::thread_group threads;
+      for (size_t t = 0; t < own.size(); ++t)
+      {
+        if (!own[t].empty())
+          threads.create_thread([&, t]() { f(own[t]); });
+      }
+      threads.join_all();
+    }
+
+    static size_t count_handshaked(const std::vector<std::unique_ptr<load_peer>> &peers)
+    {
+      size_t n = 0;
+      for (const auto &peer: peers)
+        n += peer->handshaked ? 1 : 0;
+      return n;
+    }
+
+    void connect_peer(size_t idx, load_peer &peer)
+    {
+      test_connection_context context;
+      if (!m_tcp_server.connect("127.0.0.1", m_params.port, CONNECTION_TIMEOUT, context, peer_bind_ip(idx), epee::net_utils::ssl_support_t::e_ssl_support_disabled))
+      {
+        LOG_PRINT_L0("Failed to connect from " << peer_bind_ip(idx));
+        return;
+      }
+      peer.connection_id = context.m_connection_id;
+
+      COMMAND_HANDSHAKE::request req;
+      req.node_data.network_id = config::NETWORK_ID;
+      req.node_data.peer_id = crypto::rand<uint64_t>();
+      req.node_data.local_time = time(NULL);
+      req.node_data.my_port = 0;
+      req.node_data.rpc_port = 0;
+      req.node_data.rpc_credits_per_hash = 0;
+      req.node_data.support_flags = P2P_SUPPORT_FLAG_FLUFFY_BLOCKS | P2P_SUPPORT_FLAG_COMPRESSION;
+      req.payload_data = make_sync_data();
+      const clock_type::time_point start = clock_type::now();
+      load_peer *p = &peer;
+      load_stats *stats = &m_stats;
+      const bool r = epee::net_utils::async_invoke_remote_command2<COMMAND_HANDSHAKE::response>(peer.connection_id, COMMAND_HANDSHAKE::ID, req,
+        m_tcp_server.get_config_object(), [p, stats, start](int code, const COMMAND_HANDSHAKE::response& rsp, const test_connection_context&) {
+          if (code <= 0)
+            return;
+          stats->latency[req_handshake].add(elapsed_ms(start));
+          ++stats->received;
+          p->handshaked = true;
+        });
+      if (r)
+        ++m_stats.sent;
+    }
+
+    void send_traffic(std::vector<load_peer*> &own, clock_type::time_point deadline)
+    {
+      // traffic mix, in percent: tx floods, fluffy blocks, timed syncs, GET_OBJECTS spans
+      static const unsigned tx_pct = 60, fluffy_pct = 10, sync_pct = 10;
+
+      std::mt19937 rng(crypto::rand<uint32_t>());
+      std::uniform_int_distribution<unsigned> pct(0, 99);
+      const std::chrono::duration<double> interval(m_params.rate > 0 ? 1.0 / (m_params.rate * own.size()) : 0.0);
+      clock_type::time_point next = clock_type::now();
+      for (size_t i = 0; clock_type::now() < deadline; i = (i + 1) % own.size())
+      {
+        load_peer &peer = *own[i];
+        const unsigned p = pct(rng);
+        if (p < tx_pct)
+          send_txs(peer);
+        else if (p < tx_pct + fluffy_pct)
+          send_fluffy_block(peer);
+        else if (p < tx_pct + fluffy_pct + sync_pct)
+          send_timed_sync(peer);
+        else
+          send_get_objects(peer);
+
+        if (m_params.rate > 0)
+        {
+          next += std::chrono::duration_cast<clock_type::duration>(interval);
+          std::this_thread::sleep_until(std::min(next, deadline));
+        }
+      }
+    }
+
+    void send_txs(load_peer &peer)
+    {
+      cryptonote::NOTIFY_NEW_TRANSACTIONS::request req;
+      req.txs.push_back(m_tx_blob);
+      if (epee::net_utils::notify_remote_command2(peer.connection_id, cryptonote::NOTIFY_NEW_TRANSACTIONS::ID, req, m_tcp_server.get_config_object()))
+        ++m_stats.sent;
+    }
+
+    void send_fluffy_block(load_peer &peer)
+    {
+      cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::request req;
+      req.b.pruned = false;
+      req.b.block = m_block_blob;
+      req.b.block_weight = 0;
+      req.current_blockchain_height = 2;
+      if (epee::net_utils::notify_remote_command2(peer.connection_id, cryptonote::NOTIFY_NEW_FLUFFY_BLOCK::ID, req, m_tcp_server.get_config_object()))
+        ++m_stats.sent;
+    }
+
+    void send_timed_sync(load_peer &peer)
+    {
+      if (peer.sync_pending.exchange(true))
+        return;
+      COMMAND_TIMED_SYNC::request req;
+      req.payload_data = make_sync_data();
+      const clock_type::time_point start = clock_type::now();
+      load_peer *p = &peer;
+      load_stats *stats = &m_stats;
+      const bool r = epee::net_utils::async_invoke_remote_command2<COMMAND_TIMED_SYNC::response>(peer.connection_id, COMMAND_TIMED_SYNC::ID, req,
+        m_tcp_server.get_config_object(), [p, stats, start](int code, const COMMAND_TIMED_SYNC::response& rsp, const test_connection_context&) {
+          if (code > 0)
+          {
+            stats->latency[req_timed_sync].add(elapsed_ms(start));
+            ++stats->received;
+          }
+          p->sync_pending = false;
+        });
+      if (r)
+        ++m_stats.sent;
+      else
+        peer.sync_pending = false;
+    }
+
+    void send_get_objects(load_peer &peer)
+    {
+      if (peer.objects_pending.exchange(true))
+        return;
+      cryptonote::NOTIFY_REQUEST_GET_OBJECTS::request req;
+      req.blocks.resize(m_params.span_blocks);
+      for (crypto::hash &h: req.blocks)
+        h = crypto::rand<crypto::hash>();
+      req.prune = false;
+      peer.objects_sent = clock_type::now().time_since_epoch().count();
+      if (epee::net_utils::notify_remote_command2(peer.connection_id, cryptonote::NOTIFY_REQUEST_GET_OBJECTS::ID, req, m_tcp_server.get_config_object()))
+        ++m_stats.sent;
+      else
+        peer.objects_pending = false;
+    }
+
+  private:
+    Server &m_server;
+    load_core &m_core;
+    const load_params m_params;
+    test_tcp_server m_tcp_server;
+    p2p_load_commands_handler *m_commands_handler;
+    load_stats m_stats;
+    cryptonote::blobdata m_block_blob;
+    cryptonote::blobdata m_tx_blob;
+    std::vector<std::unique_ptr<load_peer>> m_peers;
+  };
+
+  bool init_server(Server &server, const std::string &data_dir, const load_params &params, size_t max_connections, int64_t limit_rate)
+  {
+    po::options_description desc_options("Command line options");
+    cryptonote::core::init_options(desc_options);
+    Server::init_options(desc_options);
+
+    // no seeds and no outgoing connections: the only exclusive node is a
+    // closed local port, the simulated peers all connect in
+    const std::vector<std::string> args = {
+      "net_load_tests_p2p",
+      "--data-dir", data_dir,
+      "--p2p-bind-ip", "127.0.0.1",
+      "--p2p-bind-port", params.port,
+      "--add-exclusive-node", "127.0.0.1:1",
+      "--no-igd",
+      "--out-peers", "0",
+      "--in-peers", std::to_string(max_connections),
+      "--limit-rate", std::to_string(limit_rate),
+    };
+    std::vector<const char*> argv;
+    for (const std::string &arg: args)
+      argv.push_back(arg.c_str());
+
+    po::variables_map vm;
+    bool r = command_line::handle_error_helper(desc_options, [&]()
+    {
+      po::store(po::parse_command_line(argv.size(), argv.data(), desc_options), vm);
+      po::notify(vm);
+      return true;
+    });
+    return r && server.init(vm);
+  }
+}
+
+namespace nodetool { template class node_server<cryptonote::t_cryptonote_protocol_handler<load_core>>; }
+namespace cryptonote { template class t_cryptonote_protocol_handler<load_core>; }
+
+int main(int argc, char** argv)
+{
+  TRY_ENTRY();
+  tools::on_startup();
+  //set up logging options
+  mlog_configure(mlog_get_default_log_path("net_load_tests_p2p.log"), true);
+
+  po::options_description desc_options("Command line options");
+  const command_line::arg_descriptor<std::string> arg_connections = { "connections", "Comma separated connection counts to run at", "10,100,1000,10000" };
+  const command_line::arg_descriptor<unsigned> arg_duration = { "duration", "Seconds of traffic at each connection count", 10 };
+  const command_line::arg_descriptor<double> arg_rate = { "rate", "Messages per second sent by each simulated peer, 0 for as fast as possible", 1.0 };
+  const command_line::arg_descriptor<unsigned> arg_threads = { "threads", "Client threads", std::max(min_thread_count, boost::thread::hardware_concurrency() / 2) };
+  const command_line::arg_descriptor<std::string> arg_port = { "p2p-bind-port", "Port the node under test listens on", srv_port };
+  const command_line::arg_descriptor<unsigned> arg_tx_size = { "tx-size", "Size of flooded transaction blobs", 2500 };
+  const command_line::arg_descriptor<unsigned> arg_block_size = { "block-size", "Size of fluffy and GET_OBJECTS block blobs", 4000 };
+  const command_line::arg_descriptor<unsigned> arg_span_blocks = { "span-blocks", "Blocks requested per GET_OBJECTS", 20 };
+  const command_line::arg_descriptor<int64_t> arg_limit_rate = { "limit-rate", "Node rate limit [kB/s]", 1024 * 1024 };
+  command_line::add_arg(desc_options, arg_connections);
+  command_line::add_arg(desc_options, arg_duration);
+  command_line::add_arg(desc_options, arg_rate);
+  command_line::add_arg(desc_options, arg_threads);
+  command_line::add_arg(desc_options, arg_port);
+  command_line::add_arg(desc_options, arg_tx_size);
+  command_line::add_arg(desc_options, arg_block_size);
+  command_line::add_arg(desc_options, arg_span_blocks);
+  command_line::add_arg(desc_options, arg_limit_rate);
+  command_line::add_arg(desc_options, command_line::arg_help);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+  if (command_line::get_arg(vm, command_line::arg_help))
+  {
+    std::cout << desc_options << std::endl;
+    return 0;
+  }
+
+  load_params params;
+  params.port = command_line::get_arg(vm, arg_port);
+  params.duration = command_line::get_arg(vm, arg_duration);
+  params.rate = command_line::get_arg(vm, arg_rate);
+  params.threads = std::max<size_t>(1, command_line::get_arg(vm, arg_threads));
+  params.tx_size = command_line::get_arg(vm, arg_tx_size);
+  params.block_size = command_line::get_arg(vm, arg_block_size);
+  params.span_blocks = std::min<size_t>(command_line::get_arg(vm, arg_span_blocks), CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT);
+
+  std::vector<std::string> fields;
+  std::vector<size_t> levels;
+  boost::split(fields, command_line::get_arg(vm, arg_connections), boost::is_any_of(","));
+  for (const std::string &field: fields)
+  {
+    size_t n;
+    if (!epee::string_tools::get_xtype_from_string(n, field) || n == 0)
+    {
+      std::cout << "Invalid connection count: " << field << std::endl;
+      return 1;
+    }
+    levels.push_back(n);
+  }
+  const size_t max_connections = *std::max_element(levels.begin(), levels.end());
+
+  // both ends of every connection live in this process
+  raise_fd_limit();
+
+  const boost::filesystem::path data_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("net_load_tests_p2p-%%%%-%%%%");
+  boost::filesystem::create_directories(data_dir);
+
+  load_core core;
+  cryptonote::t_cryptonote_protocol_handler<load_core> cprotocol(core, NULL);
+  Server server(cprotocol);
+  cprotocol.set_p2p_endpoint(&server);
+  EXIT_ON_ERROR(init_server(server, data_dir.string(), params, max_connections, command_line::get_arg(vm, arg_limit_rate)));
+  boost::thread server_thread([&server]() { server.run(); });
+
+  p2p_load_test test(server, core, params);
+  EXIT_ON_ERROR(test.init());
+
+  bool success = true;
+  for (size_t n: levels)
+    success &= test.run_level(n);
+
+  test.deinit();
+  server.send_stop_signal();
+  server_thread.join();
+  server.deinit();
+  boost::system::error_code ec;
+  boost::filesystem::remove_all(data_dir, ec);
+  return success ? 0 : 1;
+  CATCH_ENTRY_L0("main", 1);
+}
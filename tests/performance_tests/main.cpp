@@ -60,6 +60,7 @@
 #include "bulletproof.h"
 #include "crypto_ops.h"
 #include "multiexp.h"
+#include "portable_storage.h"
 
 namespace po = boost::program_options;
 
@@ -202,6 +203,15 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 32);
   TEST_PERFORMANCE1(filter, p, test_cn_fast_hash, 16384);
 
+  TEST_PERFORMANCE2(filter, p, test_portable_storage_get_objects, false, 10);
+  TEST_PERFORMANCE2(filter, p, test_portable_storage_get_objects, true, 10);
+  TEST_PERFORMANCE2(filter, p, test_portable_storage_get_objects, false, 100);
+  TEST_PERFORMANCE2(filter, p, test_portable_storage_get_objects, true, 100);
+  TEST_PERFORMANCE2(filter, p, test_portable_storage_get_blocks_fast, false, 100);
+  TEST_PERFORMANCE2(filter, p, test_portable_storage_get_blocks_fast, true, 100);
+  TEST_PERFORMANCE2(filter, p, test_portable_storage_store_get_objects, false, 100);
+  TEST_PERFORMANCE2(filter, p, test_portable_storage_store_get_objects, true, 100);
+
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, false);
   TEST_PERFORMANCE2(filter, p, test_ringct_mlsag, 11, true);
 
@@ -0,0 +1,159 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <type_traits>
+
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/cryptonote_protocol_defs.h"
+#include "rpc/core_rpc_server_commands_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+// loads block batches with the storage tree (a_view false) or the view over
+// the binary blob (a_view true)
+template<bool a_view, size_t a_blocks>
+class test_portable_storage_get_objects
+{
+public:
+  static const size_t loop_count = a_blocks <= 10 ? 1000 : 100;
+  static const size_t txes_per_block = 10;
+
+  bool init()
+  {
+    cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+    r.current_blockchain_height = 1000000;
+    r.blocks.resize(a_blocks);
+    for (auto &b: r.blocks)
+    {
+      b.block.resize(200);
+      crypto::rand(b.block.size(), (uint8_t*)&b.block[0]);
+      b.txs.resize(txes_per_block);
+      for (auto &tx: b.txs)
+      {
+        tx.blob.resize(2000);
+        crypto::rand(tx.blob.size(), (uint8_t*)&tx.blob[0]);
+      }
+    }
+    return epee::serialization::store_t_to_binary(r, m_blob);
+  }
+
+  bool test()
+  {
+    typename std::conditional<a_view, epee::serialization::portable_storage_view, epee::serialization::portable_storage>::type stg;
+    if (!stg.load_from_binary(m_blob))
+      return false;
+    cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+    return r.load(stg) && r.blocks.size() == a_blocks;
+  }
+
+private:
+  std::string m_blob;
+};
+
+template<bool a_view, size_t a_blocks>
+class test_portable_storage_get_blocks_fast
+{
+public:
+  static const size_t loop_count = a_blocks <= 10 ? 1000 : 100;
+  static const size_t txes_per_block = 10;
+
+  bool init()
+  {
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response r;
+    r.start_height = 1000000;
+    r.current_height = 1000000 + a_blocks;
+    r.status = CORE_RPC_STATUS_OK;
+    r.blocks.resize(a_blocks);
+    r.output_indices.resize(a_blocks);
+    for (size_t i = 0; i < a_blocks; ++i)
+    {
+      r.blocks[i].block.resize(200);
+      crypto::rand(r.blocks[i].block.size(), (uint8_t*)&r.blocks[i].block[0]);
+      r.blocks[i].txs.resize(txes_per_block);
+      for (auto &tx: r.blocks[i].txs)
+      {
+        tx.blob.resize(2000);
+        crypto::rand(tx.blob.size(), (uint8_t*)&tx.blob[0]);
+      }
+      r.output_indices[i].indices.resize(txes_per_block + 1);
+      for (auto &indices: r.output_indices[i].indices)
+        indices.indices = {crypto::rand<uint64_t>(), crypto::rand<uint64_t>()};
+    }
+    return epee::serialization::store_t_to_binary(r, m_blob);
+  }
+
+  bool test()
+  {
+    typename std::conditional<a_view, epee::serialization::portable_storage_view, epee::serialization::portable_storage>::type stg;
+    if (!stg.load_from_binary(m_blob))
+      return false;
+    cryptonote::COMMAND_RPC_GET_BLOCKS_FAST::response r;
+    return r.load(stg) && r.blocks.size() == a_blocks;
+  }
+
+private:
+  std::string m_blob;
+};
+
+// stores block batches through the storage tree (a_writer false) or straight
+// into the output buffer (a_writer true)
+template<bool a_writer, size_t a_blocks>
+class test_portable_storage_store_get_objects
+{
+public:
+  static const size_t loop_count = a_blocks <= 10 ? 1000 : 100;
+  static const size_t txes_per_block = 10;
+
+  bool init()
+  {
+    m_request.current_blockchain_height = 1000000;
+    m_request.blocks.resize(a_blocks);
+    for (auto &b: m_request.blocks)
+    {
+      b.block.resize(200);
+      crypto::rand(b.block.size(), (uint8_t*)&b.block[0]);
+      b.txs.resize(txes_per_block);
+      for (auto &tx: b.txs)
+      {
+        tx.blob.resize(2000);
+        crypto::rand(tx.blob.size(), (uint8_t*)&tx.blob[0]);
+      }
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    std::string blob;
+    return epee::serialization::store_t_to_binary(m_request, blob, std::integral_constant<bool, a_writer>()) && !blob.empty();
+  }
+
+private:
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request m_request;
+};
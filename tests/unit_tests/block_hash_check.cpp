@@ -0,0 +1,143 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "cryptonote_core/block_hash_check.h"
+
+static std::vector<crypto::hash> make_hashes(uint64_t start, size_t n)
+{
+  std::vector<crypto::hash> hashes(n, crypto::null_hash);
+  for (size_t i = 0; i < n; ++i)
+  {
+    const uint64_t v = start + i;
+    memcpy(&hashes[i], &v, sizeof(v));
+    hashes[i].data[31] = 1;
+  }
+  return hashes;
+}
+
+static std::vector<uint64_t> make_weights(uint64_t start, size_t n)
+{
+  std::vector<uint64_t> weights(n);
+  for (size_t i = 0; i < n; ++i)
+    weights[i] = 1000 + start + i;
+  return weights;
+}
+
+static std::vector<std::pair<crypto::hash, crypto::hash>> make_hash_of_hashes(size_t nchunks)
+{
+  std::vector<std::pair<crypto::hash, crypto::hash>> hoh;
+  for (size_t n = 0; n < nchunks; ++n)
+  {
+    const std::vector<crypto::hash> hashes = make_hashes(n * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP);
+    const std::vector<uint64_t> weights = make_weights(n * HASH_OF_HASHES_STEP, HASH_OF_HASHES_STEP);
+    crypto::hash h, w;
+    crypto::cn_fast_hash(hashes.data(), hashes.size() * sizeof(crypto::hash), h);
+    crypto::cn_fast_hash(weights.data(), weights.size() * sizeof(uint64_t), w);
+    hoh.push_back(std::make_pair(h, w));
+  }
+  return hoh;
+}
+
+TEST(block_hash_check, empty)
+{
+  cryptonote::block_hash_check check(make_hash_of_hashes(4));
+  ASSERT_EQ(check.num_chunks(), 4);
+  ASSERT_EQ(check.size(), 4 * HASH_OF_HASHES_STEP);
+  crypto::hash hash;
+  uint64_t weight;
+  ASSERT_FALSE(check.get_hash(0, hash));
+  ASSERT_FALSE(check.get_weight(0, weight));
+  ASSERT_FALSE(check.has_weights(0, 1));
+  ASSERT_FALSE(check.get_hash(4 * HASH_OF_HASHES_STEP, hash));
+}
+
+TEST(block_hash_check, verify)
+{
+  cryptonote::block_hash_check check(make_hash_of_hashes(4));
+  const std::vector<crypto::hash> hashes = make_hashes(HASH_OF_HASHES_STEP, 2 * HASH_OF_HASHES_STEP);
+  const std::vector<uint64_t> weights = make_weights(HASH_OF_HASHES_STEP, 2 * HASH_OF_HASHES_STEP);
+  ASSERT_EQ(check.verify(1, hashes, weights, 2), 2);
+
+  crypto::hash hash;
+  uint64_t weight;
+  ASSERT_FALSE(check.get_hash(HASH_OF_HASHES_STEP - 1, hash));
+  ASSERT_TRUE(check.get_hash(HASH_OF_HASHES_STEP, hash));
+  ASSERT_EQ(hash, hashes[0]);
+  ASSERT_TRUE(check.get_hash(3 * HASH_OF_HASHES_STEP - 1, hash));
+  ASSERT_EQ(hash, hashes.back());
+  ASSERT_FALSE(check.get_hash(3 * HASH_OF_HASHES_STEP, hash));
+  ASSERT_TRUE(check.get_weight(HASH_OF_HASHES_STEP + 5, weight));
+  ASSERT_EQ(weight, weights[5]);
+  ASSERT_TRUE(check.has_weights(HASH_OF_HASHES_STEP, 2 * HASH_OF_HASHES_STEP));
+  ASSERT_FALSE(check.has_weights(HASH_OF_HASHES_STEP, 2 * HASH_OF_HASHES_STEP + 1));
+}
+
+TEST(block_hash_check, verify_without_weights)
+{
+  cryptonote::block_hash_check check(make_hash_of_hashes(2));
+  const std::vector<crypto::hash> hashes = make_hashes(0, HASH_OF_HASHES_STEP);
+  ASSERT_EQ(check.verify(0, hashes, std::vector<uint64_t>(), 1), 1);
+  crypto::hash hash;
+  uint64_t weight;
+  ASSERT_TRUE(check.get_hash(0, hash));
+  ASSERT_FALSE(check.get_weight(0, weight));
+  ASSERT_FALSE(check.has_weights(0, 1));
+
+  // weights can be added later
+  ASSERT_EQ(check.verify(0, hashes, make_weights(0, HASH_OF_HASHES_STEP), 1), 1);
+  ASSERT_TRUE(check.get_weight(0, weight));
+  ASSERT_EQ(weight, 1000);
+}
+
+TEST(block_hash_check, invalid)
+{
+  cryptonote::block_hash_check check(make_hash_of_hashes(4));
+  std::vector<crypto::hash> hashes = make_hashes(0, 4 * HASH_OF_HASHES_STEP);
+  hashes[2 * HASH_OF_HASHES_STEP + 7].data[0] ^= 1;
+  ASSERT_EQ(check.verify(0, hashes, std::vector<uint64_t>(), 4), 2);
+  crypto::hash hash;
+  ASSERT_TRUE(check.get_hash(2 * HASH_OF_HASHES_STEP - 1, hash));
+  ASSERT_FALSE(check.get_hash(2 * HASH_OF_HASHES_STEP, hash));
+  // chunks after an invalid one are not recorded, even if valid
+  ASSERT_FALSE(check.get_hash(3 * HASH_OF_HASHES_STEP, hash));
+
+  // a bad weight invalidates the chunk
+  std::vector<uint64_t> weights = make_weights(0, 4 * HASH_OF_HASHES_STEP);
+  weights[3] = 0;
+  ASSERT_EQ(check.verify(0, hashes, weights, 4), 0);
+}
+
+TEST(block_hash_check, out_of_range)
+{
+  cryptonote::block_hash_check check(make_hash_of_hashes(2));
+  const std::vector<crypto::hash> hashes = make_hashes(0, 3 * HASH_OF_HASHES_STEP);
+  ASSERT_EQ(check.verify(0, hashes, std::vector<uint64_t>(), 3), 0);
+  ASSERT_EQ(check.verify(0, make_hashes(0, HASH_OF_HASHES_STEP), std::vector<uint64_t>(), 2), 0);
+  ASSERT_EQ(check.verify(0, hashes, std::vector<uint64_t>(), 0), 0);
+}
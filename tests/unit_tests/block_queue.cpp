@@ -86,3 +86,69 @@ TEST(block_queue, flush_uuid)
   bq.add_blocks(0, 200, uuid1());
   ASSERT_EQ(bq.get_max_block_height(), 399);
 }
+
+TEST(block_queue, throughput)
+{
+  cryptonote::block_queue bq;
+  const size_t block_size = 1000;
+
+  // uuid1: 100 kB/s with 0.5 second latency, uuid2: 10 kB/s with no latency
+  uint64_t height = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    const size_t nblocks = i % 2 ? 40 : 10;
+    const size_t size = nblocks * block_size;
+    bq.add_blocks(height, std::vector<cryptonote::block_complete_entry>(nblocks), uuid1(), size / (0.5f + size / 100000.f), size);
+    height += nblocks;
+    bq.add_blocks(height, std::vector<cryptonote::block_complete_entry>(nblocks), uuid2(), 10000.f, size);
+    height += nblocks;
+  }
+
+  cryptonote::block_queue::peer_throughput pt;
+  ASSERT_TRUE(bq.get_peer_throughput(uuid1(), pt));
+  ASSERT_NEAR(pt.bandwidth, 100000.f, 1000.f);
+  ASSERT_NEAR(pt.latency, 0.5f, 0.01f);
+  ASSERT_TRUE(bq.get_peer_throughput(uuid2(), pt));
+  ASSERT_NEAR(pt.bandwidth, 10000.f, 100.f);
+  ASSERT_NEAR(pt.latency, 0.f, 0.01f);
+  ASSERT_NEAR(bq.get_relative_throughput(uuid2()), 0.1f, 0.01f);
+  ASSERT_NEAR(bq.get_expected_span_time(uuid1(), 100), 1.5f, 0.05f);
+
+  // fast peers get larger spans, slow peers smaller ones, and only a
+  // minimal one if the chain is waiting on it
+  ASSERT_EQ(bq.get_span_size(uuid1(), 100, false), 450);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 100, false), 50);
+  ASSERT_EQ(bq.get_span_size(uuid2(), 100, true), 10);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 100, true), 450);
+
+  // unknown peers get the nominal size
+  boost::uuids::uuid uuid3 = crypto::rand<boost::uuids::uuid>();
+  ASSERT_FALSE(bq.get_peer_throughput(uuid3, pt));
+  ASSERT_EQ(bq.get_span_size(uuid3, 100, true), 100);
+
+  // stats go away with the connection
+  bq.flush_stale_spans({uuid1()});
+  ASSERT_TRUE(bq.get_peer_throughput(uuid1(), pt));
+  ASSERT_FALSE(bq.get_peer_throughput(uuid2(), pt));
+}
+
+TEST(block_queue, span_size_capped)
+{
+  cryptonote::block_queue bq;
+  const size_t block_size = 1000;
+
+  // 100 MB/s, enough for far more than a peer will send in one go
+  uint64_t height = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    bq.add_blocks(height, std::vector<cryptonote::block_complete_entry>(100), uuid1(), 100000000.f, 100 * block_size);
+    height += 100;
+  }
+
+  ASSERT_EQ(bq.get_span_size(uuid1(), 100, false), CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 100, true), CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT);
+  ASSERT_EQ(bq.get_span_size(uuid1(), 1000, false), CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT);
+
+  // unknown peers with a large nominal size are capped too
+  ASSERT_EQ(bq.get_span_size(uuid2(), 1000, false), CURRENCY_PROTOCOL_MAX_OBJECT_REQUEST_COUNT);
+}
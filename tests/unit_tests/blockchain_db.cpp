@@ -340,6 +340,69 @@ TYPED_TEST(BlockchainDBTest, RetrieveBlockData)
 
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[0].first), hashes[0]);
   ASSERT_HASH_EQ(get_block_hash(this->m_blocks[1].first), hashes[1]);
+
+  std::vector<uint64_t> rct_distribution;
+  ASSERT_NO_THROW(rct_distribution = this->m_db->get_rct_output_distribution(0, 1));
+  ASSERT_EQ(this->m_db->get_block_cumulative_rct_outputs({0, 1}), rct_distribution);
+  ASSERT_THROW(this->m_db->get_rct_output_distribution(0, 2), BLOCK_DNE);
+
+  for (uint64_t height = 0; height < 2; ++height)
+  {
+    const block &b = this->m_blocks[height].first;
+    crypto::hash miner_tx_hash;
+    std::vector<std::pair<crypto::hash, blobdata>> txs;
+    ASSERT_TRUE(this->m_db->get_block_txs(height, &miner_tx_hash, txs, NULL, false));
+    ASSERT_HASH_EQ(get_transaction_hash(b.miner_tx), miner_tx_hash);
+    ASSERT_EQ(b.tx_hashes.size(), txs.size());
+    for (size_t i = 0; i < txs.size(); ++i)
+    {
+      ASSERT_HASH_EQ(b.tx_hashes[i], txs[i].first);
+      ASSERT_EQ(this->m_txs[height][i].second, txs[i].second);
+    }
+  }
+  std::vector<std::pair<crypto::hash, blobdata>> txs;
+  ASSERT_THROW(this->m_db->get_block_txs(2, NULL, txs, NULL, false), BLOCK_DNE);
+}
+
+TYPED_TEST(BlockchainDBTest, PruneStep)
+{
+  boost::filesystem::path tempPath = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  std::string dirPath = tempPath.string();
+
+  this->set_prefix(dirPath);
+
+  ASSERT_NO_THROW(this->m_db->open(dirPath));
+  this->get_filenames();
+  this->init_hard_fork();
+
+  {
+    db_wtxn_guard guard(this->m_db);
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[0], t_sizes[0], t_sizes[0], t_diffs[0], t_coins[0], this->m_txs[0]));
+    ASSERT_NO_THROW(this->m_db->add_block(this->m_blocks[1], t_sizes[1], t_sizes[1], t_diffs[1], t_coins[1], this->m_txs[1]));
+  }
+
+  // not pruned yet, the first step picks a seed
+  ASSERT_EQ(0, this->m_db->get_blockchain_pruning_seed());
+  bool finished = false;
+  size_t pruned = 0;
+  ASSERT_TRUE(this->m_db->prune_blockchain_step(0, 1, finished, pruned));
+  ASSERT_NE(0, this->m_db->get_blockchain_pruning_seed());
+
+  // one tx per step, the pass resumes where the previous step stopped
+  size_t steps = 1;
+  while (!finished && steps < 16)
+  {
+    ASSERT_TRUE(this->m_db->prune_blockchain_step(0, 1, finished, pruned));
+    ++steps;
+  }
+  ASSERT_TRUE(finished);
+  ASSERT_GT(steps, 1);
+
+  // no pass in progress anymore
+  finished = false;
+  ASSERT_TRUE(this->m_db->prune_blockchain_step(0, 1, finished, pruned));
+  ASSERT_TRUE(finished);
+  ASSERT_EQ(0, pruned);
 }
 
 }  // anonymous namespace
@@ -29,6 +29,7 @@
 // 
 // Parts of this file are originally copyright (c) 2012-2013 The Cryptonote developers
 
+#include <set>
 #include <boost/chrono/chrono.hpp>
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/mutex.hpp>
@@ -81,6 +82,55 @@ namespace
   };
 
   typedef epee::net_utils::boosted_tcp_server<test_protocol_handler> test_tcp_server;
+
+  //! Remembers which io_service each connection ended up on
+  struct shard_protocol_handler: test_protocol_handler
+  {
+    shard_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context)
+      : test_protocol_handler(psnd_hndlr, config, conn_context), m_psnd_hndlr(psnd_hndlr)
+    {
+    }
+
+    void after_init_connection()
+    {
+      boost::unique_lock<boost::mutex> lock(shards_lock);
+      shards.insert(std::addressof(m_psnd_hndlr->get_io_service()));
+    }
+
+    static boost::mutex shards_lock;
+    static std::set<const boost::asio::io_service*> shards;
+
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+  };
+  boost::mutex shard_protocol_handler::shards_lock;
+  std::set<const boost::asio::io_service*> shard_protocol_handler::shards;
+
+  //! Answers any data with a fixed mix of normal and high priority messages
+  struct priority_protocol_handler: test_protocol_handler
+  {
+    priority_protocol_handler(epee::net_utils::i_service_endpoint* psnd_hndlr, config_type& config, connection_context& conn_context)
+      : test_protocol_handler(psnd_hndlr, config, conn_context), m_psnd_hndlr(psnd_hndlr)
+    {
+    }
+
+    static std::vector<epee::byte_slice> message(char c, std::size_t size)
+    {
+      std::vector<epee::byte_slice> out;
+      out.emplace_back(std::string(size, c));
+      return out;
+    }
+
+    bool handle_recv(const void* /*data*/, size_t /*size*/)
+    {
+      // the first is written right away, the others queue behind it
+      return m_psnd_hndlr->do_send(message('a', 256 * 1024), epee::net_utils::send_priority::normal)
+        && m_psnd_hndlr->do_send(message('b', 1024), epee::net_utils::send_priority::normal)
+        && m_psnd_hndlr->do_send(message('h', 100), epee::net_utils::send_priority::high)
+        && m_psnd_hndlr->do_send(message('i', 100), epee::net_utils::send_priority::high);
+    }
+
+    epee::net_utils::i_service_endpoint* m_psnd_hndlr;
+  };
 }
 
 TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
@@ -133,3 +183,62 @@ TEST(boosted_tcp_server, worker_threads_are_exception_resistant)
   ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
   ASSERT_TRUE(srv.deinit_server());
 }
+
+TEST(boosted_tcp_server, io_service_per_thread)
+{
+  epee::net_utils::boosted_tcp_server<shard_protocol_handler> srv(epee::net_utils::e_connection_type_RPC);
+  if (!srv.set_io_service_per_thread(true))
+    return; // no SO_REUSEPORT here
+  ASSERT_TRUE(srv.init_server(test_server_port, test_server_host));
+  ASSERT_TRUE(srv.run_server(4, false));
+
+  boost::asio::io_service io_service;
+  const boost::asio::ip::tcp::endpoint endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port);
+  std::vector<std::unique_ptr<boost::asio::ip::tcp::socket>> clients;
+  for (size_t i = 0; i < 16; ++i)
+  {
+    clients.emplace_back(new boost::asio::ip::tcp::socket(io_service));
+    clients.back()->connect(endpoint);
+  }
+
+  // outgoing connections are spread over the shards too
+  test_connection_context context;
+  ASSERT_TRUE(srv.connect(test_server_host, std::to_string(test_server_port), 5000, context, "0.0.0.0", epee::net_utils::ssl_support_t::e_ssl_support_disabled));
+
+  // the 16 clients, plus both ends of our own connection
+  for (size_t i = 0; i < 100 && srv.get_connections_count() < 18; ++i)
+    epee::misc_utils::sleep_no_w(50);
+  ASSERT_EQ(18, srv.get_connections_count());
+  {
+    boost::unique_lock<boost::mutex> lock(shard_protocol_handler::shards_lock);
+    ASSERT_LT(1, shard_protocol_handler::shards.size());
+  }
+
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
+
+TEST(boosted_tcp_server, high_priority_sends_overtake_queued_ones)
+{
+  epee::net_utils::boosted_tcp_server<priority_protocol_handler> srv(epee::net_utils::e_connection_type_RPC);
+  ASSERT_TRUE(srv.init_server(test_server_port, test_server_host));
+  ASSERT_TRUE(srv.run_server(2, false));
+
+  boost::asio::io_service io_service;
+  boost::asio::ip::tcp::socket client(io_service);
+  client.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string(test_server_host), test_server_port));
+  boost::asio::write(client, boost::asio::buffer("x", 1));
+
+  std::string received(256 * 1024 + 1024 + 2 * 100, 0);
+  boost::asio::read(client, boost::asio::buffer(&received[0], received.size()));
+
+  // the message in flight is never cut, high priority ones keep their order
+  const std::string expected = std::string(256 * 1024, 'a') + std::string(100, 'h') + std::string(100, 'i') + std::string(1024, 'b');
+  ASSERT_TRUE(received == expected);
+
+  client.close();
+  srv.send_stop_signal();
+  ASSERT_TRUE(srv.timed_wait_server_stop(5 * 1000));
+  ASSERT_TRUE(srv.deinit_server());
+}
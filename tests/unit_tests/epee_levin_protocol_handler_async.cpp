@@ -132,6 +132,7 @@ namespace
       : m_io_service(io_service)
       , m_protocol_handler(this, protocol_config, m_context)
       , m_send_return(true)
+      , m_last_send_priority(epee::net_utils::send_priority::normal)
     {
     }
 
@@ -150,6 +151,12 @@ namespace
       return m_send_return;
     }
 
+    virtual bool do_send(std::vector<epee::byte_slice> message, epee::net_utils::send_priority priority)
+    {
+      m_last_send_priority = priority;
+      return i_service_endpoint::do_send(std::move(message), priority);
+    }
+
     virtual bool close()                              { /*std::cout << "test_connection::close()" << std::endl; */return true; }
     virtual bool send_done()                          { /*std::cout << "test_connection::send_done()" << std::endl; */return true; }
     virtual bool call_run_once_service_io()           { std::cout << "test_connection::call_run_once_service_io()" << std::endl; return true; }
@@ -166,6 +173,8 @@ namespace
     bool send_return() const { return m_send_return; }
     void send_return(bool v) { m_send_return = v; }
 
+    epee::net_utils::send_priority last_send_priority() const { return m_last_send_priority; }
+
   public:
     test_levin_protocol_handler m_protocol_handler;
 
@@ -179,6 +188,7 @@ namespace
     std::string m_last_send_data;
 
     bool m_send_return;
+    epee::net_utils::send_priority m_last_send_priority;
   };
 
   class async_protocol_handler_test : public ::testing::Test
@@ -415,6 +425,40 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_TRUE(conn->last_send_data().empty());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_keeps_metrics_only_for_handled_commands)
+{
+  const int unknown_command = 7340215;
+  const int known_command = 7340216;
+
+  test_connection_ptr conn = create_connection();
+
+  std::string in_data(256, 'e');
+
+  epee::levin::bucket_head2 req_head;
+  req_head.m_signature = SWAP64LE(LEVIN_SIGNATURE);
+  req_head.m_cb = SWAP64LE(in_data.size());
+  req_head.m_have_to_return_data = false;
+  req_head.m_command = SWAP32LE(unknown_command);
+  req_head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST);
+  req_head.m_protocol_version = SWAP32LE(LEVIN_PROTOCOL_VER_1);
+
+  std::string buf(reinterpret_cast<const char*>(&req_head), sizeof(req_head));
+  buf += in_data;
+
+  m_commands_handler.return_code(LEVIN_ERROR_CONNECTION_HANDLER_NOT_DEFINED);
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(buf.data(), buf.size()));
+  EXPECT_EQ(nullptr, epee::net_utils::command_metrics::get(unknown_command));
+
+  req_head.m_command = SWAP32LE(known_command);
+  buf.replace(0, sizeof(req_head), reinterpret_cast<const char*>(&req_head), sizeof(req_head));
+  m_commands_handler.return_code(LEVIN_OK);
+  ASSERT_TRUE(conn->m_protocol_handler.handle_recv(buf.data(), buf.size()));
+  const epee::net_utils::traffic_metrics *metrics = epee::net_utils::command_metrics::get(known_command);
+  ASSERT_NE(nullptr, metrics);
+  EXPECT_EQ(1, metrics->messages_in);
+  EXPECT_EQ(in_data.size(), metrics->bytes_in);
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_qued_callback)
 {
   test_connection_ptr conn = create_connection();
@@ -426,6 +470,27 @@ TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_process
   ASSERT_EQ(3, m_commands_handler.callback_counter());
 }
 
+TEST_F(positive_test_connection_to_levin_protocol_handler_calls, notify_passes_priority_to_endpoint)
+{
+  const int expected_command = 4673262;
+  const std::string in_data(256, 'p');
+
+  test_connection_ptr conn = create_connection();
+  const boost::uuids::uuid id = conn->m_protocol_handler.get_connection_id();
+
+  ASSERT_EQ(1, m_handler_config.notify(expected_command, epee::byte_slice{std::string{in_data}}, id));
+  ASSERT_EQ(epee::net_utils::send_priority::normal, conn->last_send_priority());
+
+  ASSERT_EQ(1, m_handler_config.notify(expected_command, epee::byte_slice{std::string{in_data}}, id, 0, epee::net_utils::send_priority::high));
+  ASSERT_EQ(epee::net_utils::send_priority::high, conn->last_send_priority());
+
+  // the endpoint without a queue still gets the whole message
+  const epee::byte_slice expected = epee::levin::make_notify(expected_command, epee::strspan<std::uint8_t>(in_data));
+  ASSERT_EQ(2u, conn->send_counter());
+  ASSERT_EQ(2 * expected.size(), conn->last_send_data().size());
+  ASSERT_EQ(0, std::memcmp(expected.data(), conn->last_send_data().data() + expected.size(), expected.size()));
+}
+
 TEST_F(positive_test_connection_to_levin_protocol_handler_calls, handler_processes_handle_read_as_dummy)
 {
   // Setup
@@ -640,3 +705,40 @@ TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_short_
 
   ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
 }
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_unexpected_compressed_payload)
+{
+  std::string packed;
+  m_in_data.assign(4096, 'c');
+  ASSERT_TRUE(epee::levin::compress_payload(epee::strspan<std::uint8_t>(m_in_data), packed));
+  m_in_data = std::move(packed);
+  m_req_head.m_cb = SWAP64LE(m_in_data.size());
+  m_req_head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST | LEVIN_PACKET_COMPRESSED);
+  prepare_buf();
+
+  ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(0, m_commands_handler.invoke_counter());
+}
+
+TEST_F(test_levin_protocol_handler__hanle_recv_with_invalid_data, handles_compressed_payload)
+{
+  const std::string unpacked(4096, 'c');
+  m_handler_config.m_max_inflated_size = [](const test_levin_connection_context&, int command) -> std::size_t {
+    return command == expected_command ? 4096 : 0;
+  };
+
+  std::string packed;
+  ASSERT_TRUE(epee::levin::compress_payload(epee::strspan<std::uint8_t>(unpacked), packed));
+  m_in_data = packed;
+  m_req_head.m_cb = SWAP64LE(m_in_data.size());
+  m_req_head.m_flags = SWAP32LE(LEVIN_PACKET_REQUEST | LEVIN_PACKET_COMPRESSED);
+  prepare_buf();
+
+  ASSERT_TRUE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+  ASSERT_EQ(unpacked, m_commands_handler.last_in_buf());
+
+  m_handler_config.m_max_inflated_size = [](const test_levin_connection_context&, int) -> std::size_t { return 4095; };
+  ASSERT_FALSE(m_conn->m_protocol_handler.handle_recv(m_buf.data(), m_buf.size()));
+  ASSERT_EQ(1, m_commands_handler.invoke_counter());
+}
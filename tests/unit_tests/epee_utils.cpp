@@ -35,6 +35,7 @@
 #include <cstdint>
 #include <gtest/gtest.h>
 #include <iterator>
+#include <limits>
 #include <string>
 #include <sstream>
 #include <vector>
@@ -50,6 +51,8 @@
 #include "net/net_utils_base.h"
 #include "net/local_ip.h"
 #include "net/buffer.h"
+#include "net/connection_metrics.h"
+#include "net/token_bucket.h"
 #include "p2p/net_peerlist_boost_serialization.h"
 #include "span.h"
 #include "string_tools.h"
@@ -809,6 +812,23 @@ TEST(ByteSlice, GetSlice)
   EXPECT_TRUE(boost::range::equal(base_string, original));
 }
 
+TEST(ByteSlice, TotalSize)
+{
+  std::vector<epee::byte_slice> chain;
+  EXPECT_EQ(0u, epee::get_total_size(chain));
+
+  chain.emplace_back(std::string{"header"});
+  chain.emplace_back();
+  chain.emplace_back(std::string{"payload"});
+  EXPECT_EQ(sizeof("header") - 1 + sizeof("payload") - 1, epee::get_total_size(chain));
+
+  // pieces cut off a chain keep pointing into the original storage
+  const std::uint8_t* const payload = chain.back().data();
+  epee::byte_slice piece = chain.back().take_slice(3);
+  EXPECT_EQ(payload, piece.data());
+  EXPECT_EQ(sizeof("header") - 1 + sizeof("payload") - 1 - 3, epee::get_total_size(chain));
+}
+
 TEST(ToHex, String)
 {
   EXPECT_TRUE(epee::to_hex::string(nullptr).empty());
@@ -1298,6 +1318,134 @@ TEST(net_buffer, move)
   ASSERT_TRUE(!memcmp(span.data() + 1, std::string(4000, '0').c_str(), 4000));
 }
 
+TEST(net_buffer, reserve)
+{
+  epee::net_utils::buffer buf;
+
+  buf.append("abc", 3);
+  buf.erase(1);
+  buf.reserve(10000);
+  ASSERT_EQ(buf.size(), 2);
+  ASSERT_GE(buf.capacity(), 10002);
+  const size_t capacity = buf.capacity();
+  buf.append(std::string(10000, '0').c_str(), 10000);
+  ASSERT_EQ(buf.capacity(), capacity);
+  ASSERT_EQ(buf.size(), 10002);
+  epee::span<const uint8_t> span = buf.span(10002);
+  ASSERT_TRUE(!memcmp(span.data(), "bc", 2));
+  ASSERT_TRUE(!memcmp(span.data() + 2, std::string(10000, '0').c_str(), 10000));
+
+  buf.release(capacity);
+  ASSERT_EQ(buf.capacity(), capacity);
+  buf.erase(10002);
+  buf.release(capacity);
+  ASSERT_EQ(buf.capacity(), capacity);
+  buf.release(100);
+  ASSERT_EQ(buf.capacity(), 0);
+  ASSERT_EQ(buf.size(), 0);
+}
+
+TEST(token_bucket, unlimited)
+{
+  epee::net_utils::token_bucket bucket;
+  EXPECT_EQ(0, bucket.consume(1000000));
+  bucket.count(10);
+  uint64_t packets, bytes;
+  bucket.get_stats(packets, bytes);
+  EXPECT_EQ(2, packets);
+  EXPECT_EQ(1000010, bytes);
+}
+
+TEST(token_bucket, rate)
+{
+  epee::net_utils::token_bucket bucket(1000, 1.0);
+  EXPECT_EQ(1000, bucket.get_rate());
+
+  // a full second of burst is available up front
+  EXPECT_EQ(0, bucket.consume(1000));
+
+  // then the debt grows at the rate, whichever thread is charged
+  double delay = bucket.consume(1000);
+  EXPECT_GT(delay, 0.9);
+  EXPECT_LE(delay, 1.0);
+  delay = bucket.consume(500);
+  EXPECT_GT(delay, 1.4);
+  EXPECT_LE(delay, 1.5);
+
+  // changing the rate forgives the debt
+  bucket.set_rate(2000);
+  EXPECT_EQ(0, bucket.consume(2000));
+  EXPECT_GT(bucket.consume(1000), 0.4);
+}
+
+TEST(connection_metrics, histogram)
+{
+  epee::net_utils::histogram h;
+  epee::net_utils::histogram::snapshot s = h.get();
+  EXPECT_EQ(0, s.count);
+  EXPECT_EQ(0, s.percentile(0.5));
+
+  for (uint64_t v = 1; v <= 100; ++v)
+    h.add(v);
+  h.add(0);
+  s = h.get();
+  EXPECT_EQ(101, s.count);
+  EXPECT_EQ(5050, s.sum);
+  EXPECT_EQ(100, s.max);
+  EXPECT_EQ(1, s.counts[0]);
+  EXPECT_EQ(1, s.counts[1]);
+  EXPECT_EQ(2, s.counts[2]);
+  EXPECT_EQ(37, s.counts[7]);
+
+  // percentiles are the upper bound of their bucket
+  EXPECT_EQ(63, s.percentile(0.5));
+  EXPECT_EQ(100, s.percentile(0.99));
+  EXPECT_EQ(0, s.percentile(0.001));
+
+  h.add(std::numeric_limits<uint64_t>::max());
+  s = h.get();
+  EXPECT_EQ(1, s.counts[epee::net_utils::histogram::buckets - 1]);
+  EXPECT_EQ(std::numeric_limits<uint64_t>::max(), s.max);
+}
+
+TEST(connection_metrics, commands)
+{
+  EXPECT_EQ(nullptr, epee::net_utils::command_metrics::get(987654));
+  epee::net_utils::traffic_metrics *m = epee::net_utils::command_metrics::add(987654);
+  ASSERT_NE(nullptr, m);
+  EXPECT_EQ(m, epee::net_utils::command_metrics::add(987654));
+  EXPECT_EQ(m, epee::net_utils::command_metrics::get(987654));
+  m->received(100);
+  m->received(50);
+  m->sent(10);
+
+  bool found = false;
+  epee::net_utils::command_metrics::for_each([&](uint32_t command, const epee::net_utils::traffic_metrics &metrics) {
+    if (command != 987654)
+      return;
+    found = true;
+    EXPECT_EQ(2, metrics.messages_in);
+    EXPECT_EQ(150, metrics.bytes_in);
+    EXPECT_EQ(1, metrics.messages_out);
+    EXPECT_EQ(10, metrics.bytes_out);
+    EXPECT_EQ(2, metrics.size_in.get().count);
+  });
+  EXPECT_TRUE(found);
+}
+
+TEST(connection_metrics, shared_by_context_copies)
+{
+  epee::net_utils::connection_context_base context;
+  epee::net_utils::connection_context_base copy = context;
+  epee::net_utils::connection_context_base other;
+  EXPECT_EQ(context.m_metrics, copy.m_metrics);
+  EXPECT_NE(context.m_metrics, other.m_metrics);
+  EXPECT_EQ(0u, other.m_metrics->send_queue_bytes.load());
+  other = context;
+  EXPECT_EQ(context.m_metrics, other.m_metrics);
+  EXPECT_EQ(3, context.m_metrics.use_count());
+}
+
 TEST(parsing, isspace)
 {
   ASSERT_FALSE(epee::misc_utils::parse::isspace(0));
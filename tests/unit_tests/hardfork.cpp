@@ -124,6 +124,46 @@ TEST(major, Only)
   db.add_block(mkblock(2, 1), 0, 0, 0, 0, 0, crypto::hash());
 }
 
+TEST(get, rebuilt_on_init)
+{
+  TestDB db;
+  HardFork hf(db, 1, 0, 0, 0, 12, 0); // no voting
+
+  //                      v  h  t
+  ASSERT_TRUE(hf.add_fork(1, 0, 0));
+  ASSERT_TRUE(hf.add_fork(2, 3, 1));
+  ASSERT_TRUE(hf.add_fork(4, 7, 2));
+  hf.init();
+
+  static const uint8_t expected_versions[] = { 1, 1, 1, 2, 2, 2, 2, 4, 4, 4, 4, 4 };
+  for (uint64_t h = 0; h < 12; ++h) {
+    db.add_block(mkblock(hf, h, 4), 0, 0, 0, 0, 0, crypto::hash());
+    ASSERT_TRUE(hf.add(db.get_block_from_height(h), h));
+  }
+
+  // a fresh object recovers every past version from the blocks alone
+  HardFork hf2(db, 1, 0, 0, 0, 12, 0);
+  ASSERT_TRUE(hf2.add_fork(1, 0, 0));
+  ASSERT_TRUE(hf2.add_fork(2, 3, 1));
+  ASSERT_TRUE(hf2.add_fork(4, 7, 2));
+  hf2.init();
+  for (uint64_t h = 0; h < 12; ++h) {
+    ASSERT_EQ(hf.get(h), expected_versions[h]);
+    ASSERT_EQ(hf2.get(h), expected_versions[h]);
+    ASSERT_EQ(db.get_hard_fork_version(h), expected_versions[h]);
+  }
+  ASSERT_EQ(hf2.get_current_version(), 4);
+
+  // popping back across a fork forgets the versions above the new top
+  for (uint64_t h = 5; h < 12; ++h)
+    db.remove_block();
+  hf2.on_block_popped(7);
+  ASSERT_EQ(hf2.get_current_version(), 2);
+  for (uint64_t h = 0; h < 5; ++h)
+    ASSERT_EQ(hf2.get(h), expected_versions[h]);
+  ASSERT_EQ(hf2.get(5), 2);
+}
+
 TEST(empty_hardforks, Success)
 {
   TestDB db;
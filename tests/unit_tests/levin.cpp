@@ -146,6 +146,12 @@ namespace
         {
             return context_.m_connection_id;
         }
+
+        //! Makes the connection look like it has `bytes` waiting to be sent
+        void set_send_queue_bytes(const std::uint64_t bytes) noexcept
+        {
+            context_.m_metrics->send_queue_bytes = bytes;
+        }
     };
 
     struct received_message
@@ -426,6 +432,52 @@ TEST(make_fragment, multiple)
     EXPECT_EQ(18, std::count(fragment.cbegin(), fragment.cend(), 0));
 }
 
+TEST(compress_payload, round_trip)
+{
+    const std::string bytes(64 * 1024, 'a');
+
+    std::string packed;
+    ASSERT_TRUE(epee::levin::compress_payload(epee::strspan<std::uint8_t>(bytes), packed));
+    EXPECT_GT(bytes.size(), packed.size());
+
+    std::string unpacked;
+    ASSERT_TRUE(epee::levin::decompress_payload(epee::strspan<std::uint8_t>(packed), unpacked, bytes.size()));
+    EXPECT_EQ(bytes, unpacked);
+}
+
+TEST(compress_payload, incompressible)
+{
+    std::string bytes(1024, 0);
+    std::generate(bytes.begin(), bytes.end(), crypto::random_device{});
+
+    std::string packed;
+    EXPECT_FALSE(epee::levin::compress_payload(epee::strspan<std::uint8_t>(bytes), packed));
+}
+
+TEST(decompress_payload, too_large)
+{
+    const std::string bytes(64 * 1024, 'a');
+
+    std::string packed;
+    ASSERT_TRUE(epee::levin::compress_payload(epee::strspan<std::uint8_t>(bytes), packed));
+
+    std::string unpacked;
+    EXPECT_FALSE(epee::levin::decompress_payload(epee::strspan<std::uint8_t>(packed), unpacked, bytes.size() - 1));
+}
+
+TEST(decompress_payload, invalid)
+{
+    const std::string bytes(64 * 1024, 'a');
+
+    std::string packed;
+    ASSERT_TRUE(epee::levin::compress_payload(epee::strspan<std::uint8_t>(bytes), packed));
+
+    std::string unpacked;
+    EXPECT_FALSE(epee::levin::decompress_payload(epee::strspan<std::uint8_t>(packed.substr(0, packed.size() / 2)), unpacked, bytes.size()));
+    EXPECT_FALSE(epee::levin::decompress_payload(epee::strspan<std::uint8_t>(packed + "x"), unpacked, bytes.size()));
+    EXPECT_FALSE(epee::levin::decompress_payload(epee::strspan<std::uint8_t>(bytes), unpacked, bytes.size()));
+}
+
 TEST_F(levin_notify, defaulted)
 {
     cryptonote::levin::notify notifier{};
@@ -466,6 +518,12 @@ TEST_F(levin_notify, flood)
         auto context = contexts_.begin();
         EXPECT_TRUE(notifier.send_txs(txs, context->get_id(), false));
 
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        for (auto& other : contexts_)
+            EXPECT_EQ(0u, other.process_send_queue());
+
+        notifier.run_fluff();
         io_service_.reset();
         ASSERT_LT(0u, io_service_.poll());
         EXPECT_EQ(0u, context->process_send_queue());
@@ -479,6 +537,7 @@ TEST_F(levin_notify, flood)
             EXPECT_EQ(txs, notification.txs);
             EXPECT_TRUE(notification._.empty());
         }
+        EXPECT_EQ(1u, notifier.fluff_payloads());
     }
 
     ASSERT_EQ(10u, contexts_.size());
@@ -486,6 +545,12 @@ TEST_F(levin_notify, flood)
         auto context = contexts_.begin();
         EXPECT_TRUE(notifier.send_txs(txs, context->get_id(), true));
 
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        for (auto& other : contexts_)
+            EXPECT_EQ(0u, other.process_send_queue());
+
+        notifier.run_fluff();
         io_service_.reset();
         ASSERT_LT(0u, io_service_.poll());
         EXPECT_EQ(0u, context->process_send_queue());
@@ -499,6 +564,133 @@ TEST_F(levin_notify, flood)
             EXPECT_EQ(txs, notification.txs);
             EXPECT_FALSE(notification._.empty());
         }
+        EXPECT_EQ(2u, notifier.fluff_payloads());
+    }
+}
+
+TEST_F(levin_notify, flood_batched)
+{
+    cryptonote::levin::notify notifier = make_notifier(0, true);
+
+    for (unsigned count = 0; count < 10; ++count)
+        add_connection(count % 2 == 0);
+
+    std::vector<cryptonote::blobdata> txs(2);
+    txs[0].resize(100, 'e');
+    txs[1].resize(200, 'f');
+
+    ASSERT_EQ(10u, contexts_.size());
+    {
+        auto context = contexts_.begin();
+        EXPECT_TRUE(notifier.send_txs({txs[0]}, context->get_id(), false));
+        EXPECT_TRUE(notifier.send_txs({txs[1]}, context->get_id(), false));
+
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        notifier.run_fluff();
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+
+        // both txes go out in a single notification to each peer
+        EXPECT_EQ(0u, context->process_send_queue());
+        for (++context; context != contexts_.end(); ++context)
+            EXPECT_EQ(1u, context->process_send_queue());
+
+        ASSERT_EQ(9u, receiver_.notified_size());
+        for (unsigned count = 0; count < 9; ++count)
+        {
+            auto notification = receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>().second;
+            EXPECT_EQ(txs, notification.txs);
+            EXPECT_TRUE(notification._.empty());
+        }
+        EXPECT_EQ(1u, notifier.fluff_payloads());
+    }
+
+    // nothing left to send
+    notifier.run_fluff();
+    io_service_.reset();
+    io_service_.poll();
+    for (auto& context : contexts_)
+        EXPECT_EQ(0u, context.process_send_queue());
+    EXPECT_EQ(1u, notifier.fluff_payloads());
+
+    // each source misses its own tx, so ten peers need three distinct notifications
+    {
+        EXPECT_TRUE(notifier.send_txs({txs[0]}, contexts_[0].get_id(), false));
+        EXPECT_TRUE(notifier.send_txs({txs[1]}, contexts_[1].get_id(), false));
+
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        notifier.run_fluff();
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+
+        for (auto& context : contexts_)
+            EXPECT_EQ(1u, context.process_send_queue());
+        EXPECT_EQ(4u, notifier.fluff_payloads());
+
+        ASSERT_EQ(10u, receiver_.notified_size());
+        for (unsigned count = 0; count < 10; ++count)
+        {
+            auto notification = receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>();
+            if (notification.first == contexts_[0].get_id())
+                EXPECT_EQ(std::vector<cryptonote::blobdata>{txs[1]}, notification.second.txs);
+            else if (notification.first == contexts_[1].get_id())
+                EXPECT_EQ(std::vector<cryptonote::blobdata>{txs[0]}, notification.second.txs);
+            else
+                EXPECT_EQ(txs, notification.second.txs);
+        }
+    }
+}
+
+TEST_F(levin_notify, flood_congested_bounded)
+{
+    cryptonote::levin::notify notifier = make_notifier(0, true);
+
+    for (unsigned count = 0; count < 3; ++count)
+        add_connection(false);
+    contexts_[1].set_send_queue_bytes(P2P_SEND_QUEUE_CONGESTED_BYTES);
+
+    // every fifth round pushes a batch over the cap
+    static constexpr const std::size_t rounds = 12;
+    static constexpr const std::size_t per_batch = 4;
+    std::vector<cryptonote::blobdata> txs;
+    for (std::size_t count = 0; count < rounds; ++count)
+    {
+        txs.emplace_back(P2P_FLUFF_BATCH_MAX_BYTES / per_batch, char('a' + count));
+        EXPECT_TRUE(notifier.send_txs({txs.back()}, random_generator_(), false));
+        io_service_.reset();
+        io_service_.poll();
+    }
+
+    notifier.run_fluff();
+    io_service_.reset();
+    ASSERT_LT(0u, io_service_.poll());
+
+    // the congested peer only gets the newest txes, within the cap
+    ASSERT_EQ(1u, contexts_[1].process_send_queue());
+    ASSERT_EQ(1u, receiver_.notified_size());
+    {
+        const auto notification = receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>().second;
+        std::size_t bytes = 0;
+        for (const cryptonote::blobdata& tx : notification.txs)
+            bytes += tx.size();
+        EXPECT_GE(P2P_FLUFF_BATCH_MAX_BYTES, bytes);
+        EXPECT_EQ(std::vector<cryptonote::blobdata>(txs.end() - per_batch, txs.end()), notification.txs);
+    }
+
+    // the others get everything, without waiting for the delay once a batch is full
+    for (const std::size_t index : {0u, 2u})
+    {
+        EXPECT_LT(1u, contexts_[index].process_send_queue());
+        std::vector<cryptonote::blobdata> received;
+        while (receiver_.notified_size())
+        {
+            const auto notification = receiver_.get_notification<cryptonote::NOTIFY_NEW_TRANSACTIONS>();
+            EXPECT_EQ(contexts_[index].get_id(), notification.first);
+            received.insert(received.end(), notification.second.txs.begin(), notification.second.txs.end());
+        }
+        EXPECT_EQ(txs, received);
     }
 }
 
@@ -531,6 +723,12 @@ TEST_F(levin_notify, private_flood)
         auto context = contexts_.begin();
         EXPECT_TRUE(notifier.send_txs(txs, context->get_id(), false));
 
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        for (auto& other : contexts_)
+            EXPECT_EQ(0u, other.process_send_queue());
+
+        notifier.run_fluff();
         io_service_.reset();
         ASSERT_LT(0u, io_service_.poll());
         EXPECT_EQ(0u, context->process_send_queue());
@@ -554,6 +752,12 @@ TEST_F(levin_notify, private_flood)
         auto context = contexts_.begin();
         EXPECT_TRUE(notifier.send_txs(txs, context->get_id(), true));
 
+        io_service_.reset();
+        ASSERT_LT(0u, io_service_.poll());
+        for (auto& other : contexts_)
+            EXPECT_EQ(0u, other.process_send_queue());
+
+        notifier.run_fluff();
         io_service_.reset();
         ASSERT_LT(0u, io_service_.poll());
         EXPECT_EQ(0u, context->process_send_queue());
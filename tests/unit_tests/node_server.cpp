@@ -77,9 +77,11 @@ public:
   cryptonote::network_type get_nettype() const { return cryptonote::MAINNET; }
   bool get_pool_transaction(const crypto::hash& id, cryptonote::blobdata& tx_blob, cryptonote::relay_category tx_category) const { return false; }
   bool pool_has_tx(const crypto::hash &txid) const { return false; }
+  bool get_pool_transaction_hashes(std::vector<crypto::hash>& txs, bool include_sensitive_txes = false) const { return false; }
   bool get_blocks(uint64_t start_offset, size_t count, std::vector<std::pair<cryptonote::blobdata, cryptonote::block>>& blocks, std::vector<cryptonote::blobdata>& txs) const { return false; }
   bool get_transactions(const std::vector<crypto::hash>& txs_ids, std::vector<cryptonote::transaction>& txs, std::vector<crypto::hash>& missed_txs) const { return false; }
   bool get_block_by_hash(const crypto::hash &h, cryptonote::block &blk, bool *orphan = NULL) const { return false; }
+  bool get_recent_block(const crypto::hash &h, bool pruned, cryptonote::block_complete_entry &e) const { return false; }
   uint8_t get_ideal_hard_fork_version() const { return 0; }
   uint8_t get_ideal_hard_fork_version(uint64_t height) const { return 0; }
   uint8_t get_hard_fork_version(uint64_t height) const { return 0; }
@@ -308,5 +310,39 @@ TEST(node_server, bind_same_p2p_port)
   EXPECT_TRUE(init(new_node(), port_another));
 }
 
+TEST(node_server, connect_race)
+{
+  nodetool::connect_race race(2, 3);
+
+  // the first attempt starts right away, the others after their head start
+  ASSERT_TRUE(race.wait_to_start(0));
+  ASSERT_TRUE(race.wait_to_start(0));
+  ASSERT_TRUE(race.wait_to_start(0));
+  ASSERT_FALSE(race.full());
+
+  // three attempts are running, so a fourth has to wait for one to end
+  std::atomic<bool> started(false);
+  boost::thread waiter([&]() { started = race.wait_to_start(0); });
+  boost::this_thread::sleep_for(boost::chrono::milliseconds(50));
+  ASSERT_FALSE(started);
+  race.finish();
+  waiter.join();
+  ASSERT_TRUE(started);
+
+  // only as many peers as wanted may connect
+  ASSERT_TRUE(race.claim());
+  ASSERT_TRUE(race.claim());
+  ASSERT_TRUE(race.full());
+  ASSERT_FALSE(race.claim());
+  ASSERT_FALSE(race.wait_to_start(0));
+
+  // a failed handshake frees its slot again
+  race.release();
+  ASSERT_FALSE(race.full());
+  ASSERT_EQ(race.won(), 1);
+  ASSERT_TRUE(race.claim());
+  ASSERT_EQ(race.won(), 2);
+}
+
 namespace nodetool { template class node_server<cryptonote::t_cryptonote_protocol_handler<test_core>>; }
 namespace cryptonote { template class t_cryptonote_protocol_handler<test_core>; }
@@ -0,0 +1,109 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "cryptonote_core/output_key_cache.h"
+
+static cryptonote::output_data_t make_output(uint64_t height)
+{
+  cryptonote::output_data_t data = {};
+  data.height = height;
+  data.unlock_time = height + 10;
+  return data;
+}
+
+TEST(output_key_cache, empty)
+{
+  cryptonote::output_key_cache cache(64);
+  cryptonote::output_data_t data;
+  ASSERT_FALSE(cache.get(0, 0, data));
+  const cryptonote::output_key_cache::stats stats = cache.get_stats();
+  ASSERT_EQ(stats.hits, 0);
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(stats.entries, 0);
+}
+
+TEST(output_key_cache, add_get)
+{
+  cryptonote::output_key_cache cache(64);
+  cache.add(0, 5, make_output(100));
+  cache.add(1000, 5, make_output(7));
+  cryptonote::output_data_t data;
+  ASSERT_TRUE(cache.get(0, 5, data));
+  ASSERT_EQ(data.height, 100);
+  ASSERT_TRUE(cache.get(1000, 5, data));
+  ASSERT_EQ(data.height, 7);
+  ASSERT_FALSE(cache.get(0, 6, data));
+  const cryptonote::output_key_cache::stats stats = cache.get_stats();
+  ASSERT_EQ(stats.hits, 2);
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(stats.entries, 2);
+}
+
+TEST(output_key_cache, bounded)
+{
+  cryptonote::output_key_cache cache(64);
+  for (uint64_t i = 0; i < 10000; ++i)
+    cache.add(0, i, make_output(i));
+  ASSERT_LE(cache.get_stats().entries, 64);
+  cryptonote::output_data_t data;
+  ASSERT_FALSE(cache.get(0, 0, data));
+}
+
+TEST(output_key_cache, disabled)
+{
+  cryptonote::output_key_cache cache(0);
+  cache.add(0, 1, make_output(1));
+  cryptonote::output_data_t data;
+  ASSERT_FALSE(cache.get(0, 1, data));
+  ASSERT_EQ(cache.get_stats().entries, 0);
+}
+
+TEST(output_key_cache, invalidate_from_height)
+{
+  cryptonote::output_key_cache cache(1024);
+  for (uint64_t i = 0; i < 100; ++i)
+    cache.add(0, i, make_output(i));
+  cache.invalidate_from_height(50);
+  ASSERT_EQ(cache.get_stats().entries, 50);
+  cryptonote::output_data_t data;
+  ASSERT_TRUE(cache.get(0, 49, data));
+  ASSERT_FALSE(cache.get(0, 50, data));
+  ASSERT_FALSE(cache.get(0, 99, data));
+}
+
+TEST(output_key_cache, shrink)
+{
+  cryptonote::output_key_cache cache(1024);
+  for (uint64_t i = 0; i < 1000; ++i)
+    cache.add(0, i, make_output(i));
+  cache.set_max_entries(16);
+  ASSERT_LE(cache.get_stats().entries, 16);
+  cache.clear();
+  ASSERT_EQ(cache.get_stats().entries, 0);
+}
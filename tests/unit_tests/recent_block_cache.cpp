@@ -0,0 +1,196 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include "gtest/gtest.h"
+#include "cryptonote_core/recent_block_cache.h"
+
+static crypto::hash make_hash(uint64_t n)
+{
+  crypto::hash h = crypto::null_hash;
+  memcpy(&h, &n, sizeof(n));
+  h.data[31] = 1;
+  return h;
+}
+
+static void add_block(cryptonote::recent_block_cache &cache, uint64_t height, size_t tx_size = 100, bool commit = true)
+{
+  std::vector<cryptonote::recent_block_cache::tx_entry> txs;
+  txs.push_back({make_hash(height * 16 + 1), std::string(tx_size, 'a') + std::string(tx_size, 'b'), tx_size, make_hash(height * 16 + 2), false});
+  txs.push_back({make_hash(height * 16 + 3), std::string(tx_size, 'c'), tx_size / 2, make_hash(height * 16 + 4), true});
+  cache.add(height, make_hash(height), "block" + std::to_string(height), 1000 + height, make_hash(height * 16), std::move(txs));
+  if (commit)
+    cache.commit();
+}
+
+TEST(recent_block_cache, empty)
+{
+  cryptonote::recent_block_cache cache(1024 * 1024);
+  cryptonote::block_complete_entry e;
+  ASSERT_FALSE(cache.get(make_hash(0), false, e));
+  const cryptonote::recent_block_cache::stats stats = cache.get_stats();
+  ASSERT_EQ(stats.hits, 0);
+  ASSERT_EQ(stats.misses, 1);
+  ASSERT_EQ(stats.blocks, 0);
+  ASSERT_EQ(stats.size, 0);
+}
+
+TEST(recent_block_cache, unpruned)
+{
+  cryptonote::recent_block_cache cache(1024 * 1024);
+  add_block(cache, 10);
+  cryptonote::block_complete_entry e;
+  uint64_t height = 0;
+  ASSERT_TRUE(cache.get(make_hash(10), false, e, &height));
+  ASSERT_EQ(height, 10);
+  ASSERT_FALSE(e.pruned);
+  ASSERT_EQ(e.block, "block10");
+  ASSERT_EQ(e.block_weight, 0);
+  ASSERT_EQ(e.txs.size(), 2);
+  ASSERT_EQ(e.txs[0].blob, std::string(100, 'a') + std::string(100, 'b'));
+  ASSERT_EQ(e.txs[1].blob, std::string(100, 'c'));
+
+  cryptonote::blobdata block_blob;
+  crypto::hash miner_tx_hash;
+  std::vector<std::pair<crypto::hash, cryptonote::blobdata>> txs;
+  ASSERT_TRUE(cache.get(10, false, block_blob, miner_tx_hash, txs));
+  ASSERT_EQ(block_blob, "block10");
+  ASSERT_EQ(miner_tx_hash, make_hash(160));
+  ASSERT_EQ(txs.size(), 2);
+  ASSERT_EQ(txs[0].first, make_hash(161));
+  ASSERT_EQ(txs[0].second, std::string(100, 'a') + std::string(100, 'b'));
+  ASSERT_EQ(txs[1].first, make_hash(163));
+}
+
+TEST(recent_block_cache, pruned)
+{
+  cryptonote::recent_block_cache cache(1024 * 1024);
+  add_block(cache, 10);
+  cryptonote::block_complete_entry e;
+  ASSERT_TRUE(cache.get(make_hash(10), true, e));
+  ASSERT_TRUE(e.pruned);
+  ASSERT_EQ(e.block_weight, 1010);
+  ASSERT_EQ(e.txs.size(), 2);
+  ASSERT_EQ(e.txs[0].blob, std::string(100, 'a'));
+  ASSERT_EQ(e.txs[0].prunable_hash, make_hash(162));
+  // v1 txes are sent whole to peers
+  ASSERT_EQ(e.txs[1].blob, std::string(100, 'c'));
+  ASSERT_EQ(e.txs[1].prunable_hash, crypto::null_hash);
+
+  cryptonote::blobdata block_blob;
+  crypto::hash miner_tx_hash;
+  std::vector<std::pair<crypto::hash, cryptonote::blobdata>> txs;
+  ASSERT_TRUE(cache.get(10, true, block_blob, miner_tx_hash, txs));
+  ASSERT_EQ(txs.size(), 2);
+  ASSERT_EQ(txs[0].second, std::string(100, 'a'));
+  ASSERT_EQ(txs[1].second, std::string(50, 'c'));
+}
+
+TEST(recent_block_cache, bounded)
+{
+  cryptonote::recent_block_cache cache(4096);
+  for (uint64_t h = 0; h < 100; ++h)
+    add_block(cache, h);
+  const cryptonote::recent_block_cache::stats stats = cache.get_stats();
+  ASSERT_LE(stats.size, 4096);
+  ASSERT_GT(stats.blocks, 0);
+  cryptonote::block_complete_entry e;
+  ASSERT_FALSE(cache.get(make_hash(0), false, e));
+  ASSERT_TRUE(cache.get(make_hash(99), false, e));
+  ASSERT_TRUE(cache.get(make_hash(100 - stats.blocks), false, e));
+  ASSERT_FALSE(cache.get(make_hash(99 - stats.blocks), false, e));
+}
+
+TEST(recent_block_cache, invalidate)
+{
+  cryptonote::recent_block_cache cache(1024 * 1024);
+  for (uint64_t h = 0; h < 10; ++h)
+    add_block(cache, h);
+  cache.invalidate_from_height(7);
+  cryptonote::block_complete_entry e;
+  ASSERT_TRUE(cache.get(make_hash(6), false, e));
+  ASSERT_FALSE(cache.get(make_hash(7), false, e));
+  ASSERT_FALSE(cache.get(make_hash(9), false, e));
+  ASSERT_EQ(cache.get_stats().blocks, 7);
+
+  // a block replacing a cached height drops it and the ones above
+  add_block(cache, 5, 10);
+  ASSERT_EQ(cache.get_stats().blocks, 6);
+  ASSERT_FALSE(cache.get(make_hash(6), false, e));
+
+  // a gap drops everything
+  add_block(cache, 8);
+  ASSERT_EQ(cache.get_stats().blocks, 1);
+  ASSERT_TRUE(cache.get(make_hash(8), false, e));
+
+  cache.clear();
+  ASSERT_EQ(cache.get_stats().blocks, 0);
+  ASSERT_EQ(cache.get_stats().size, 0);
+}
+
+TEST(recent_block_cache, uncommitted)
+{
+  cryptonote::recent_block_cache cache(1024 * 1024);
+  for (uint64_t h = 0; h < 5; ++h)
+    add_block(cache, h);
+
+  // blocks of a batch in progress are not served
+  add_block(cache, 5, 100, false);
+  add_block(cache, 6, 100, false);
+  cryptonote::block_complete_entry e;
+  cryptonote::blobdata block_blob;
+  crypto::hash miner_tx_hash;
+  std::vector<std::pair<crypto::hash, cryptonote::blobdata>> txs;
+  ASSERT_TRUE(cache.get(make_hash(4), false, e));
+  ASSERT_FALSE(cache.get(make_hash(5), false, e));
+  ASSERT_FALSE(cache.get(6, false, block_blob, miner_tx_hash, txs));
+
+  // an aborted batch drops them, and only them
+  cache.rollback();
+  ASSERT_EQ(cache.get_stats().blocks, 5);
+  ASSERT_TRUE(cache.get(make_hash(4), false, e));
+
+  // a replaced height is not served until committed either
+  add_block(cache, 4, 10, false);
+  add_block(cache, 5, 100, false);
+  ASSERT_FALSE(cache.get(make_hash(4), false, e));
+  ASSERT_TRUE(cache.get(make_hash(3), false, e));
+  cache.commit();
+  ASSERT_TRUE(cache.get(make_hash(4), false, e));
+  ASSERT_TRUE(cache.get(5, false, block_blob, miner_tx_hash, txs));
+  cache.rollback();
+  ASSERT_EQ(cache.get_stats().blocks, 6);
+}
+
+TEST(recent_block_cache, disabled)
+{
+  cryptonote::recent_block_cache cache(0);
+  add_block(cache, 0);
+  cryptonote::block_complete_entry e;
+  ASSERT_FALSE(cache.get(make_hash(0), false, e));
+  ASSERT_EQ(cache.get_stats().blocks, 0);
+}
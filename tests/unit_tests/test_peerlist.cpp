@@ -31,6 +31,9 @@
 
 #include "gtest/gtest.h"
 
+#include <boost/filesystem.hpp>
+#include <fstream>
+
 #include "common/util.h"
 #include "p2p/net_peerlist.h"
 #include "net/net_utils_base.h"
@@ -40,8 +43,8 @@ TEST(peer_list, peer_list_general)
   nodetool::peerlist_manager plm;
   plm.init(nodetool::peerlist_types{}, false);
 #define MAKE_IPV4_ADDRESS(a,b,c,d,e) epee::net_utils::ipv4_network_address{MAKE_IP(a,b,c,d),e}
-#define ADD_GRAY_NODE(addr_, id_, last_seen_) {  nodetool::peerlist_entry ple; ple.last_seen=last_seen_;ple.adr = addr_; ple.id = id_;plm.append_with_peer_gray(ple);}  
-#define ADD_WHITE_NODE(addr_, id_, last_seen_) {  nodetool::peerlist_entry ple;ple.last_seen=last_seen_; ple.adr = addr_; ple.id = id_;plm.append_with_peer_white(ple);}  
+#define ADD_GRAY_NODE(addr_, id_, last_seen_) {  nodetool::peerlist_entry ple = AUTO_VAL_INIT(ple); ple.last_seen=last_seen_;ple.adr = addr_; ple.id = id_;plm.append_with_peer_gray(ple);}  
+#define ADD_WHITE_NODE(addr_, id_, last_seen_) {  nodetool::peerlist_entry ple = AUTO_VAL_INIT(ple);ple.last_seen=last_seen_; ple.adr = addr_; ple.id = id_;plm.append_with_peer_white(ple);}  
 
 #define PRINT_HEAD(step) {std::vector<nodetool::peerlist_entry> bs_head; bool r = plm.get_peerlist_head(bs_head, 100);std::cout << "step " << step << ": " << bs_head.size() << std::endl;}
 
@@ -80,7 +83,7 @@ TEST(peer_list, merge_peer_lists)
   nodetool::peerlist_manager plm;
   plm.init(nodetool::peerlist_types{}, false);
   std::vector<nodetool::peerlist_entry> outer_bs;
-#define ADD_NODE_TO_PL(ip_, port_, id_, timestamp_) {  nodetool::peerlist_entry ple; epee::string_tools::get_ip_int32_from_string(ple.adr.ip, ip_); ple.last_seen = timestamp_; ple.adr.port = port_; ple.id = id_;outer_bs.push_back(ple);}  
+#define ADD_NODE_TO_PL(ip_, port_, id_, timestamp_) {  nodetool::peerlist_entry ple = AUTO_VAL_INIT(ple); epee::string_tools::get_ip_int32_from_string(ple.adr.ip, ip_); ple.last_seen = timestamp_; ple.adr.port = port_; ple.id = id_;outer_bs.push_back(ple);}  
 }
 
 namespace
@@ -255,3 +258,172 @@ TEST(peerlist_storage, store)
   EXPECT_EQ(24u, types.anchor[1].id);
   EXPECT_EQ(22u, types.anchor[1].first_seen);
 }
+
+TEST(peer_list, score)
+{
+  nodetool::peerlist_manager plm;
+  plm.init(nodetool::peerlist_types{}, false);
+  const epee::net_utils::ipv4_network_address fast{MAKE_IP(123,43,12,1), 8080};
+  const epee::net_utils::ipv4_network_address slow{MAKE_IP(123,43,12,2), 8080};
+  const epee::net_utils::ipv4_network_address failing{MAKE_IP(123,43,12,3), 8080};
+  const epee::net_utils::ipv4_network_address unknown{MAKE_IP(123,43,12,4), 8080};
+  for (const auto &addr: {fast, slow, failing})
+    ASSERT_TRUE(plm.append_with_peer_gray({addr, 1, 100}));
+
+  ASSERT_TRUE(plm.record_peer_rtt(fast, 0.05f));
+  ASSERT_TRUE(plm.record_peer_rtt(slow, 2.0f));
+  ASSERT_TRUE(plm.record_peer_failure(failing));
+  ASSERT_TRUE(plm.record_peer_failure(failing));
+  ASSERT_FALSE(plm.record_peer_failure(unknown));
+
+  // promotion to the white list keeps the measurements
+  ASSERT_TRUE(plm.set_peer_just_seen(1, fast, 0, 0, 0));
+  ASSERT_TRUE(plm.record_peer_throughput(fast, 1024 * 1024));
+  ASSERT_TRUE(plm.append_with_peer_white({fast, 1, 200}));
+
+  std::vector<nodetool::peerlist_entry> gray, white;
+  plm.get_peerlist(gray, white);
+  ASSERT_EQ(1u, white.size());
+  ASSERT_EQ(2u, gray.size());
+  EXPECT_FLOAT_EQ(0.05f, white[0].rtt);
+  EXPECT_FLOAT_EQ(1024 * 1024, white[0].throughput);
+
+  const int64_t now = time(NULL);
+  ASSERT_TRUE(gray[0].adr == slow || gray[0].adr == failing);
+  const nodetool::peerlist_entry &slow_pe = gray[0].adr == slow ? gray[0] : gray[1];
+  const nodetool::peerlist_entry &failing_pe = gray[0].adr == slow ? gray[1] : gray[0];
+  const float default_score = nodetool::peerlist_manager::get_peer_score({unknown, 1, 100}, now);
+  EXPECT_FLOAT_EQ(0.5f, default_score);
+  EXPECT_GT(nodetool::peerlist_manager::get_peer_score(white[0], now), default_score);
+  EXPECT_LT(nodetool::peerlist_manager::get_peer_score(slow_pe, now), default_score);
+  EXPECT_LT(nodetool::peerlist_manager::get_peer_score(failing_pe, now), default_score);
+
+  // failures are forgotten over time
+  EXPECT_NEAR(default_score, nodetool::peerlist_manager::get_peer_score(failing_pe, now + 10 * P2P_PEER_SCORE_HALF_LIFE), 0.01f);
+
+  // and survive a round trip through p2pstate.bin
+  nodetool::peerlist_types types{};
+  plm.get_peerlist(types);
+  std::ostringstream stream{};
+  ASSERT_TRUE(nodetool::peerlist_storage{}.store(stream, types));
+  std::istringstream istream{stream.str()};
+  boost::optional<nodetool::peerlist_storage> read_peers = nodetool::peerlist_storage::open(istream, true);
+  ASSERT_TRUE(bool(read_peers));
+  types = read_peers->take_zone(epee::net_utils::zone::public_);
+  ASSERT_EQ(1u, types.white.size());
+  EXPECT_NEAR(0.05f, types.white[0].rtt, 1e-5f);
+  EXPECT_FLOAT_EQ(1024 * 1024, types.white[0].throughput);
+  EXPECT_EQ(white[0].score_time, types.white[0].score_time);
+  for (const auto &pe: types.gray)
+    if (pe.adr == failing)
+      EXPECT_NEAR(2.0f, pe.failures, 0.01f);
+}
+
+TEST(peerlist_storage, journal)
+{
+  using zone = epee::net_utils::zone;
+
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  const epee::net_utils::ipv4_network_address first{MAKE_IP(123,43,12,1), 8080};
+  const epee::net_utils::ipv4_network_address second{MAKE_IP(123,43,12,2), 8080};
+  const epee::net_utils::ipv4_network_address third{MAKE_IP(123,43,12,3), 8080};
+
+  nodetool::peerlist_types types{};
+  types.white.push_back({first, 1, 100});
+  types.gray.push_back({second, 2, 200});
+  ASSERT_TRUE(nodetool::peerlist_storage{}.store(path.string(), types, {{"1.2.3.4", time(NULL) + 3600}}));
+
+  nodetool::peerlist_journal journal;
+  ASSERT_TRUE(journal.open(path.string()));
+  {
+    nodetool::peerlist_manager plm;
+    plm.init(nodetool::peerlist_storage::open(path.string())->take_zone(zone::public_), false);
+    plm.set_journal(&journal);
+    ASSERT_TRUE(plm.append_with_peer_gray({third, 3, 300}));
+    ASSERT_TRUE(plm.append_with_peer_white({second, 2, 400}));
+    ASSERT_TRUE(plm.record_peer_rtt(first, 0.5f));
+  }
+  journal.block("5.6.7.8", time(NULL) + 3600);
+  journal.unblock("1.2.3.4");
+  ASSERT_TRUE(journal.close());
+
+  boost::optional<nodetool::peerlist_storage> read_peers = nodetool::peerlist_storage::open(path.string());
+  ASSERT_TRUE(bool(read_peers));
+  const std::map<std::string, time_t> blocked = read_peers->take_blocked();
+  ASSERT_EQ(1u, blocked.size());
+  EXPECT_EQ("5.6.7.8", blocked.begin()->first);
+
+  types = read_peers->take_zone(zone::public_);
+  ASSERT_EQ(2u, types.white.size());
+  ASSERT_EQ(1u, types.gray.size());
+  EXPECT_TRUE(types.gray[0].adr == third);
+  for (const auto& pe : types.white)
+  {
+    ASSERT_TRUE(pe.adr == first || pe.adr == second);
+    if (pe.adr == first)
+      EXPECT_NEAR(0.5f, pe.rtt, 1e-5f);
+  }
+
+  // a partial record left by a crash is ignored
+  {
+    std::ofstream file{path.string(), std::ios_base::binary | std::ios_base::app};
+    file.put(1);
+    file.put(1);
+  }
+  read_peers = nodetool::peerlist_storage::open(path.string());
+  ASSERT_TRUE(bool(read_peers));
+  types = read_peers->take_zone(zone::public_);
+  EXPECT_EQ(2u, types.white.size());
+  EXPECT_EQ(1u, types.gray.size());
+
+  boost::filesystem::remove(path);
+}
+
+TEST(peerlist_storage, journal_rewrite)
+{
+  using zone = epee::net_utils::zone;
+
+  const boost::filesystem::path path = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path();
+  const epee::net_utils::ipv4_network_address first{MAKE_IP(123,43,12,1), 8080};
+  const epee::net_utils::ipv4_network_address second{MAKE_IP(123,43,12,2), 8080};
+  const epee::net_utils::ipv4_network_address third{MAKE_IP(123,43,12,3), 8080};
+
+  nodetool::peerlist_types types{};
+  types.white.push_back({first, 1, 100});
+  ASSERT_TRUE(nodetool::peerlist_storage{}.store(path.string(), types, {{"1.2.3.4", time(NULL) + 3600}}));
+
+  nodetool::peerlist_journal journal;
+  ASSERT_TRUE(journal.open(path.string()));
+
+  // queued before the snapshot, so superseded by it
+  journal.add_peer(true, {first, 1, 200});
+
+  types.white[0].last_seen = 500;
+  types.gray.push_back({second, 2, 200});
+  ASSERT_TRUE(journal.rewrite([&](std::ostream& dest) {
+    // queued while the snapshot runs, so replayed on top of it
+    journal.add_peer(false, {third, 3, 300});
+    journal.block("5.6.7.8", time(NULL) + 3600);
+    return nodetool::peerlist_storage{}.store(dest, types);
+  }));
+  journal.remove_peer(false, second);
+  ASSERT_TRUE(journal.close());
+
+  boost::optional<nodetool::peerlist_storage> read_peers = nodetool::peerlist_storage::open(path.string());
+  ASSERT_TRUE(bool(read_peers));
+  const std::map<std::string, time_t> blocked = read_peers->take_blocked();
+  ASSERT_EQ(1u, blocked.size());
+  EXPECT_EQ("5.6.7.8", blocked.begin()->first);
+
+  types = read_peers->take_zone(zone::public_);
+  ASSERT_EQ(1u, types.white.size());
+  EXPECT_TRUE(types.white[0].adr == first);
+  EXPECT_EQ(500, types.white[0].last_seen);
+  ASSERT_EQ(1u, types.gray.size());
+  EXPECT_TRUE(types.gray[0].adr == third);
+
+  // a closed journal refuses to rewrite
+  EXPECT_FALSE(journal.rewrite([](std::ostream&) { return true; }));
+
+  boost::filesystem::remove(path);
+}
@@ -55,3 +55,266 @@ TEST(protocol_pack, protocol_pack_command)
     ASSERT_TRUE(r.total_height == 3);
   }
 }
+
+namespace
+{
+  template<class t_storage, class t_struct>
+  bool load_with(t_struct& out, const std::string& buff)
+  {
+    t_storage stg;
+    return stg.load_from_binary(buff) && out.load(stg);
+  }
+
+  struct view_inner
+  {
+    std::string name;
+    std::vector<uint64_t> values;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(name)
+      KV_SERIALIZE(values)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct view_outer
+  {
+    uint32_t small;
+    int64_t negative;
+    double real;
+    bool flag;
+    std::string blob;
+    std::vector<std::string> strings;
+    std::vector<bool> flags;
+    view_inner inner;
+    std::list<view_inner> inners;
+    uint64_t missing;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(small)
+      KV_SERIALIZE(negative)
+      KV_SERIALIZE(real)
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(blob)
+      KV_SERIALIZE(strings)
+      KV_SERIALIZE(flags)
+      KV_SERIALIZE(inner)
+      KV_SERIALIZE(inners)
+      KV_SERIALIZE_OPT(missing, (uint64_t)7)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  // same keys, but narrower or wider types, and no "missing" on the wire
+  struct view_wire
+  {
+    uint8_t small;
+    int32_t negative;
+    double real;
+    bool flag;
+    std::string blob;
+    std::vector<std::string> strings;
+    std::vector<bool> flags;
+    view_inner inner;
+    std::list<view_inner> inners;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(small)
+      KV_SERIALIZE(negative)
+      KV_SERIALIZE(real)
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(blob)
+      KV_SERIALIZE(strings)
+      KV_SERIALIZE(flags)
+      KV_SERIALIZE(inner)
+      KV_SERIALIZE(inners)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct view_narrow
+  {
+    std::vector<uint32_t> values;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(values)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  bool operator==(const view_inner& a, const view_inner& b)
+  {
+    return a.name == b.name && a.values == b.values;
+  }
+
+  bool operator==(const view_outer& a, const view_outer& b)
+  {
+    return a.small == b.small && a.negative == b.negative && a.real == b.real && a.flag == b.flag &&
+      a.blob == b.blob && a.strings == b.strings && a.flags == b.flags && a.inner == b.inner &&
+      a.inners == b.inners && a.missing == b.missing;
+  }
+}
+
+TEST(protocol_pack, view_matches_portable_storage)
+{
+  view_wire w;
+  w.small = 200;
+  w.negative = -123456;
+  w.real = 2.5;
+  w.flag = true;
+  w.blob = std::string("\0\1\2binary", 9);
+  w.strings = {"", "a", std::string(300, 'x')};
+  w.flags = {true, false, true};
+  w.inner.name = "inner";
+  w.inner.values = {1, 2, 3};
+  w.inners.resize(3);
+  w.inners.back().name = "last";
+  w.inners.back().values = {std::numeric_limits<uint64_t>::max()};
+
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(w, buff));
+
+  view_outer tree, view;
+  ASSERT_TRUE(load_with<epee::serialization::portable_storage>(tree, buff));
+  ASSERT_TRUE(load_with<epee::serialization::portable_storage_view>(view, buff));
+  ASSERT_TRUE(tree == view);
+  ASSERT_EQ(view.small, 200);
+  ASSERT_EQ(view.negative, -123456);
+  ASSERT_EQ(view.missing, 7);
+  ASSERT_EQ(view.inners.size(), 3);
+  ASSERT_EQ(view.inners.back().values.front(), std::numeric_limits<uint64_t>::max());
+
+  // a value that does not fit fails both ways
+  view_inner big;
+  big.values = {uint64_t(1) << 40};
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(big, buff));
+  view_narrow narrow;
+  ASSERT_FALSE(load_with<epee::serialization::portable_storage>(narrow, buff));
+  ASSERT_FALSE(load_with<epee::serialization::portable_storage_view>(narrow, buff));
+}
+
+TEST(protocol_pack, view_rejects_truncated)
+{
+  view_wire w;
+  w.blob = std::string(100, 'b');
+  w.inners.resize(2);
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(w, buff));
+  for (size_t len = 0; len < buff.size(); ++len)
+  {
+    epee::serialization::portable_storage_view view;
+    ASSERT_FALSE(view.load_from_binary(epee::strspan<uint8_t>(buff.substr(0, len))));
+  }
+  epee::serialization::portable_storage_view view;
+  ASSERT_TRUE(view.load_from_binary(epee::strspan<uint8_t>(buff)));
+}
+
+TEST(protocol_pack, get_objects_view)
+{
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+  r.current_blockchain_height = 1234;
+  r.missed_ids.resize(3, crypto::hash{});
+  r.missed_ids[1].data[0] = 1;
+  for (size_t i = 0; i < 4; ++i)
+  {
+    cryptonote::block_complete_entry b;
+    b.pruned = i & 1;
+    b.block = std::string(80 + i, 'b');
+    b.block_weight = b.pruned ? 1000 + i : 0;
+    for (size_t t = 0; t < i; ++t)
+      b.txs.push_back({std::string(50 + t, 't'), b.pruned ? crypto::hash{} : crypto::null_hash});
+    r.blocks.push_back(b);
+  }
+
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(r, buff));
+
+  static_assert(epee::serialization::load_from_binary_view<cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request>::value, "view not used");
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request tree, view;
+  ASSERT_TRUE(load_with<epee::serialization::portable_storage>(tree, buff));
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(view, buff));
+
+  ASSERT_EQ(view.current_blockchain_height, 1234);
+  ASSERT_TRUE(view.missed_ids == tree.missed_ids);
+  ASSERT_EQ(view.blocks.size(), tree.blocks.size());
+  for (size_t i = 0; i < view.blocks.size(); ++i)
+  {
+    ASSERT_EQ(view.blocks[i].pruned, tree.blocks[i].pruned);
+    ASSERT_EQ(view.blocks[i].block, tree.blocks[i].block);
+    ASSERT_EQ(view.blocks[i].block_weight, tree.blocks[i].block_weight);
+    ASSERT_EQ(view.blocks[i].txs.size(), tree.blocks[i].txs.size());
+    for (size_t t = 0; t < view.blocks[i].txs.size(); ++t)
+    {
+      ASSERT_EQ(view.blocks[i].txs[t].blob, tree.blocks[i].txs[t].blob);
+      ASSERT_EQ(view.blocks[i].txs[t].prunable_hash, tree.blocks[i].txs[t].prunable_hash);
+    }
+  }
+}
+
+TEST(protocol_pack, writer_matches_portable_storage)
+{
+  view_wire w;
+  w.small = 200;
+  w.negative = -123456;
+  w.real = 2.5;
+  w.flag = true;
+  w.blob = std::string("\0\1\2binary", 9);
+  w.strings = {"", "a", std::string(300, 'x')};
+  w.flags = {true, false, true};
+  w.inner.name = "inner";
+  w.inner.values.resize(20000, 5);
+  w.inners.resize(100);
+  w.inners.back().name = "last";
+
+  std::string tree_buff;
+  epee::serialization::portable_storage ps;
+  w.store(ps);
+  ASSERT_TRUE(ps.store_to_binary(tree_buff));
+
+  epee::serialization::portable_storage_writer writer;
+  w.store(writer);
+  const size_t size = writer.size();
+  std::string writer_buff;
+  writer.start_output(writer_buff);
+  w.store(writer);
+  ASSERT_TRUE(writer.finish());
+  ASSERT_EQ(writer_buff.size(), size);
+  // entries are written in KV map order rather than sorted by name
+  ASSERT_EQ(writer_buff.size(), tree_buff.size());
+
+  view_outer tree, view;
+  ASSERT_TRUE(load_with<epee::serialization::portable_storage>(tree, tree_buff));
+  ASSERT_TRUE(load_with<epee::serialization::portable_storage>(view, writer_buff));
+  ASSERT_TRUE(tree == view);
+}
+
+TEST(protocol_pack, get_objects_writer)
+{
+  static_assert(epee::serialization::store_to_binary_writer<cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request>::value, "writer not used");
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r;
+  r.current_blockchain_height = 1234;
+  r.missed_ids.resize(2, crypto::hash{});
+  for (size_t i = 0; i < 3; ++i)
+  {
+    cryptonote::block_complete_entry b;
+    b.pruned = i & 1;
+    b.block = std::string(80 + i, 'b');
+    b.block_weight = b.pruned ? 1000 + i : 0;
+    for (size_t t = 0; t < i + 1; ++t)
+      b.txs.push_back({std::string(50 + t, 't'), crypto::null_hash});
+    r.blocks.push_back(b);
+  }
+
+  std::string buff;
+  ASSERT_TRUE(epee::serialization::store_t_to_binary(r, buff));
+  cryptonote::NOTIFY_RESPONSE_GET_OBJECTS::request r2;
+  ASSERT_TRUE(load_with<epee::serialization::portable_storage>(r2, buff));
+  ASSERT_EQ(r2.current_blockchain_height, 1234);
+  ASSERT_EQ(r2.missed_ids.size(), 2);
+  ASSERT_EQ(r2.blocks.size(), 3);
+  for (size_t i = 0; i < 3; ++i)
+  {
+    ASSERT_EQ(r2.blocks[i].pruned, r.blocks[i].pruned);
+    ASSERT_EQ(r2.blocks[i].block, r.blocks[i].block);
+    ASSERT_EQ(r2.blocks[i].block_weight, r.blocks[i].block_weight);
+    ASSERT_EQ(r2.blocks[i].txs.size(), r.blocks[i].txs.size());
+    for (size_t t = 0; t < r2.blocks[i].txs.size(); ++t)
+      ASSERT_EQ(r2.blocks[i].txs[t].blob, r.blocks[i].txs[t].blob);
+  }
+}
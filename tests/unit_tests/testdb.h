@@ -140,6 +140,7 @@ public:
 
   virtual uint32_t get_blockchain_pruning_seed() const { return 0; }
   virtual bool prune_blockchain(uint32_t pruning_seed = 0) { return true; }
+  virtual bool prune_blockchain_step(uint32_t pruning_seed, size_t max_txes, bool &finished, size_t &pruned) { finished = true; pruned = 0; return true; }
   virtual bool update_pruning() { return true; }
   virtual bool check_pruning() { return true; }
   virtual void prune_outputs(uint64_t amount) {}
@@ -0,0 +1,133 @@
+// Copyright (c) 2020, The BitTube Project
+// 
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without modification, are
+// permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice, this list of
+//    conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice, this list
+//    of conditions and the following disclaimer in the documentation and/or other
+//    materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its contributors may be
+//    used to endorse or promote products derived from this software without specific
+//    prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY
+// EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES OF
+// MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL
+// THE COPYRIGHT HOLDER OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+// SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+// PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT,
+// STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+// THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+#include <algorithm>
+#include "gtest/gtest.h"
+#include "crypto/crypto.h"
+#include "cryptonote_protocol/tx_reconciliation.h"
+
+static std::vector<uint64_t> make_ids(size_t n)
+{
+  std::vector<uint64_t> ids;
+  for (size_t i = 0; i < n; ++i)
+    ids.push_back(cryptonote::get_tx_short_id(crypto::rand<crypto::hash>(), 42));
+  return ids;
+}
+
+TEST(tx_reconciliation, short_id)
+{
+  const crypto::hash txid = crypto::rand<crypto::hash>();
+  ASSERT_EQ(cryptonote::get_tx_short_id(txid, 1), cryptonote::get_tx_short_id(txid, 1));
+  ASSERT_NE(cryptonote::get_tx_short_id(txid, 1), cryptonote::get_tx_short_id(txid, 2));
+}
+
+TEST(tx_reconciliation, resolve_short_ids)
+{
+  std::vector<crypto::hash> pool;
+  for (size_t i = 0; i < 100; ++i)
+    pool.push_back(crypto::rand<crypto::hash>());
+  const crypto::hash absent = crypto::rand<crypto::hash>();
+
+  const std::vector<crypto::hash> block_txids{pool[7], absent, pool[0], pool[99]};
+  std::vector<uint64_t> short_ids;
+  for (const crypto::hash &txid: block_txids)
+    short_ids.push_back(cryptonote::get_tx_short_id(txid, 5));
+
+  std::vector<uint64_t> missing;
+  const std::vector<crypto::hash> resolved = cryptonote::resolve_tx_short_ids(short_ids, 5, pool, missing);
+  ASSERT_EQ(resolved.size(), 4);
+  ASSERT_EQ(resolved[0], pool[7]);
+  ASSERT_EQ(resolved[1], crypto::null_hash);
+  ASSERT_EQ(resolved[2], pool[0]);
+  ASSERT_EQ(resolved[3], pool[99]);
+  ASSERT_EQ(missing, std::vector<uint64_t>{1});
+
+  // a different salt resolves nothing
+  missing.clear();
+  cryptonote::resolve_tx_short_ids(short_ids, 6, pool, missing);
+  ASSERT_EQ(missing.size(), 4);
+}
+
+TEST(tx_reconciliation, identical)
+{
+  const std::vector<uint64_t> ids = make_ids(500);
+  cryptonote::tx_sketch a(16), b(16);
+  for (uint64_t id: ids)
+  {
+    a.add(id);
+    b.add(id);
+  }
+  ASSERT_TRUE(a.subtract(b));
+  ASSERT_TRUE(a.empty());
+  std::vector<uint64_t> ours, theirs;
+  ASSERT_TRUE(a.decode(ours, theirs));
+  ASSERT_TRUE(ours.empty());
+  ASSERT_TRUE(theirs.empty());
+}
+
+TEST(tx_reconciliation, difference)
+{
+  const std::vector<uint64_t> common = make_ids(1000), only_a = make_ids(20), only_b = make_ids(12);
+  cryptonote::tx_sketch a(64), b(64);
+  for (uint64_t id: common)
+  {
+    a.add(id);
+    b.add(id);
+  }
+  for (uint64_t id: only_a)
+    a.add(id);
+  for (uint64_t id: only_b)
+    b.add(id);
+
+  // go through the wire format, as a peer's sketch would
+  cryptonote::tx_sketch remote;
+  ASSERT_FALSE(remote.deserialize(b.serialize(), 32));
+  ASSERT_TRUE(remote.deserialize(b.serialize(), 64));
+  ASSERT_TRUE(a.subtract(remote));
+
+  std::vector<uint64_t> ours, theirs;
+  ASSERT_TRUE(a.decode(ours, theirs));
+  std::sort(ours.begin(), ours.end());
+  std::sort(theirs.begin(), theirs.end());
+  std::vector<uint64_t> expected_ours = only_a, expected_theirs = only_b;
+  std::sort(expected_ours.begin(), expected_ours.end());
+  std::sort(expected_theirs.begin(), expected_theirs.end());
+  ASSERT_EQ(ours, expected_ours);
+  ASSERT_EQ(theirs, expected_theirs);
+}
+
+TEST(tx_reconciliation, overflow)
+{
+  cryptonote::tx_sketch a(8), b(8);
+  for (uint64_t id: make_ids(200))
+    a.add(id);
+  ASSERT_TRUE(a.subtract(b));
+  std::vector<uint64_t> ours, theirs;
+  ASSERT_FALSE(a.decode(ours, theirs));
+  ASSERT_FALSE(a.subtract(cryptonote::tx_sketch(16)));
+}